@@ -0,0 +1,226 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file Benchmark.cpp
+** \brief Timing, allocation counting and statistics for benchmark stages
+*/
+
+#include "Benchmark.h"
+
+#include <QAtomicInt>
+#include <QTime>
+#include <QtAlgorithms>
+
+#include <stdlib.h>
+#include <new>
+
+#if defined(Q_OS_UNIX)
+#include <time.h>
+#endif
+
+
+/** Number of heap allocations made so far. This is a QBasicAtomicInt so
+ * that it is initialized statically, before the first allocation. */
+static QBasicAtomicInt allocations = Q_BASIC_ATOMIC_INITIALIZER(0);
+
+#if defined(__GLIBC__)
+/* glibc exports its allocator under these names as well, so the process's
+ * malloc() can be replaced with a counting wrapper that every library,
+ * including Qt, will call instead. */
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *
+malloc(size_t size) __THROW
+{
+  allocations.fetchAndAddRelaxed(1);
+  return __libc_malloc(size);
+}
+
+void *
+calloc(size_t n, size_t size) __THROW
+{
+  allocations.fetchAndAddRelaxed(1);
+  return __libc_calloc(n, size);
+}
+
+void *
+realloc(void *ptr, size_t size) __THROW
+{
+  allocations.fetchAndAddRelaxed(1);
+  return __libc_realloc(ptr, size);
+}
+}
+#else
+/* Without a way to wrap malloc(), count C++ allocations only. */
+void *
+operator new(size_t size) throw(std::bad_alloc)
+{
+  allocations.fetchAndAddRelaxed(1);
+  void *ptr = malloc(size ? size : 1);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void *
+operator new[](size_t size) throw(std::bad_alloc)
+{
+  return operator new(size);
+}
+
+void
+operator delete(void *ptr) throw()
+{
+  free(ptr);
+}
+
+void
+operator delete[](void *ptr) throw()
+{
+  free(ptr);
+}
+#endif
+
+/** Returns a monotonic timestamp in nanoseconds. */
+quint64
+bench_clock_nsecs()
+{
+#if defined(Q_OS_UNIX)
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return quint64(ts.tv_sec) * 1000000000ULL + quint64(ts.tv_nsec);
+#else
+  static QTime clock;
+  if (clock.isNull())
+    clock.start();
+  return quint64(clock.elapsed()) * 1000000ULL;
+#endif
+}
+
+/** Returns the number of heap allocations made by the process so far. The
+ * counter is 32 bits wide, so only differences of less than 2^32 between
+ * two counts are meaningful. */
+quint64
+bench_allocation_count()
+{
+  return quint32(int(allocations));
+}
+
+
+/** Constructor. */
+BenchmarkStage::BenchmarkStage(const QString &name, const QString &unit)
+  : _name(name), _unit(unit)
+{
+  _ops = 0;
+  _startTime = 0;
+  _elapsed = 0;
+  _startAllocs = 0;
+  _allocs = 0;
+  _opStart = 0;
+}
+
+/** Starts the stage's wall clock and allocation counter. */
+void
+BenchmarkStage::begin(int expectedSamples)
+{
+  _samples.reserve(_samples.size() + expectedSamples);
+  _startAllocs = bench_allocation_count();
+  _startTime = bench_clock_nsecs();
+}
+
+/** Stops the stage's wall clock and allocation counter. A stage can be
+ * begun and ended several times; the results accumulate. */
+void
+BenchmarkStage::end()
+{
+  _elapsed += bench_clock_nsecs() - _startTime;
+  _allocs += quint32(bench_allocation_count() - _startAllocs);
+}
+
+/** Stops timing the operation started by startOp(). */
+void
+BenchmarkStage::stopOp(int ops)
+{
+  addSample(bench_clock_nsecs() - _opStart, ops);
+}
+
+/** Records <b>ops</b> operations that together took <b>nsecs</b>. */
+void
+BenchmarkStage::addSample(quint64 nsecs, int ops)
+{
+  _samples << nsecs;
+  _ops += ops;
+}
+
+/** Returns the <b>percent</b> percentile of the latency samples, in
+ * nanoseconds, or 0 if there are no samples. */
+quint64
+BenchmarkStage::percentile(qreal percent) const
+{
+  if (_samples.isEmpty())
+    return 0;
+
+  QVector<quint64> sorted = _samples;
+  qSort(sorted);
+  int rank = int((percent / 100.0) * sorted.size() + 0.5);
+  return sorted.at(qBound(0, rank - 1, sorted.size() - 1));
+}
+
+/** Formats <b>nsecs</b> as microseconds. */
+static QString
+usecs(quint64 nsecs)
+{
+  return QString::number(nsecs / 1000.0, 'f', 1);
+}
+
+/** Returns the column headings matching toString(). */
+QString
+BenchmarkStage::header()
+{
+  return QString("%1 %2 %3 %4 %5 %6 %7")
+           .arg("stage", -28)
+           .arg("ops", 9)
+           .arg("ops/s", 11)
+           .arg("allocs/op", 10)
+           .arg("p50(us)", 10)
+           .arg("p99(us)", 10)
+           .arg("max(us)", 10);
+}
+
+/** Returns a one-line summary of the stage's results. Latency columns are
+ * shown as "-" for stages that record no latency samples. */
+QString
+BenchmarkStage::toString() const
+{
+  qreal secs = _elapsed / 1e9;
+  QString rate = (secs > 0) ? QString::number(_ops / secs, 'f', 0) : "-";
+  QString allocs = _ops ? QString::number(qreal(_allocs) / _ops, 'f', 1)
+                        : "-";
+  QString p50 = "-", p99 = "-", max = "-";
+  if (!_samples.isEmpty()) {
+    p50 = usecs(percentile(50));
+    p99 = usecs(percentile(99));
+    max = usecs(percentile(100));
+  }
+
+  return QString("%1 %2 %3 %4 %5 %6 %7")
+           .arg(QString("%1 (%2)").arg(_name).arg(_unit), -28)
+           .arg(_ops, 9)
+           .arg(rate, 11)
+           .arg(allocs, 10)
+           .arg(p50, 10)
+           .arg(p99, 10)
+           .arg(max, 10);
+}
+
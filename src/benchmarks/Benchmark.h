@@ -0,0 +1,86 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file Benchmark.h
+** \brief Timing, allocation counting and statistics for benchmark stages
+*/
+
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+#include <QString>
+#include <QVector>
+
+
+/** Returns a monotonic timestamp in nanoseconds. Only differences between
+ * two timestamps are meaningful. */
+quint64 bench_clock_nsecs();
+
+/** Returns the number of heap allocations made by the process so far. On
+ * glibc every malloc(), calloc() and realloc() is counted, including those
+ * made inside Qt; elsewhere only C++ operator new is counted. */
+quint64 bench_allocation_count();
+
+
+/** A BenchmarkStage accumulates the results of one benchmarked stage: how
+ * many operations it performed, how long it took, how many allocations it
+ * made and the distribution of per-operation latencies. */
+class BenchmarkStage
+{
+public:
+  /** Constructor. <b>name</b> is shown in the results table and <b>unit</b>
+   * describes what a single operation is (e.g. "reply" or "event"). */
+  BenchmarkStage(const QString &name, const QString &unit);
+
+  /** Starts the stage's wall clock and allocation counter. Room for
+   * <b>expectedSamples</b> latency samples is reserved up front so that
+   * recording them does not skew the allocation count. */
+  void begin(int expectedSamples = 0);
+  /** Stops the stage's wall clock and allocation counter. */
+  void end();
+
+  /** Starts timing a single operation. */
+  void startOp() { _opStart = bench_clock_nsecs(); }
+  /** Stops timing the operation started by startOp() and records it as
+   * <b>ops</b> operations. */
+  void stopOp(int ops = 1);
+  /** Records <b>ops</b> operations that together took <b>nsecs</b>. */
+  void addSample(quint64 nsecs, int ops = 1);
+  /** Records <b>ops</b> operations without a latency sample. */
+  void addOps(int ops) { _ops += ops; }
+
+  /** Returns the number of recorded operations. */
+  quint64 ops() const { return _ops; }
+  /** Returns the number of recorded latency samples. */
+  int samples() const { return _samples.size(); }
+  /** Returns the <b>percent</b> percentile of the latency samples, in
+   * nanoseconds. */
+  quint64 percentile(qreal percent) const;
+
+  /** Returns the column headings matching toString(). */
+  static QString header();
+  /** Returns a one-line summary of the stage's results. */
+  QString toString() const;
+
+private:
+  QString _name; /**< Name of the stage. */
+  QString _unit; /**< What a single operation is. */
+  quint64 _ops; /**< Number of recorded operations. */
+  quint64 _startTime; /**< Wall clock time when the stage began. */
+  quint64 _elapsed; /**< Wall clock duration of the stage. */
+  quint64 _startAllocs; /**< Allocation count when the stage began. */
+  quint64 _allocs; /**< Allocations made during the stage. */
+  quint64 _opStart; /**< Start time of the current operation. */
+  QVector<quint64> _samples; /**< Latency samples, in nanoseconds. */
+};
+
+#endif
+
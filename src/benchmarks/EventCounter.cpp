@@ -0,0 +1,87 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file EventCounter.cpp
+** \brief Records when event signals from TorControl arrive
+*/
+
+#include "EventCounter.h"
+#include "Benchmark.h"
+
+#include "TorControl.h"
+
+#include <QEventLoop>
+#include <QTimer>
+
+
+/** Constructor. Every per-event signal is connected to the same slot, since
+ * only the time of arrival matters. */
+EventCounter::EventCounter(TorControl *tc, QObject *parent)
+  : QObject(parent)
+{
+  _loop = 0;
+  _expected = 0;
+  _lastCount = 0;
+
+  connect(tc, SIGNAL(bandwidthUpdate(quint64, quint64)),
+          this, SLOT(received()));
+  connect(tc, SIGNAL(circuitStatusChanged(Circuit)),
+          this, SLOT(received()));
+  connect(tc, SIGNAL(streamStatusChanged(Stream)),
+          this, SLOT(received()));
+  connect(tc, SIGNAL(logMessage(tc::Severity, QString)),
+          this, SLOT(received()));
+  connect(tc, SIGNAL(newDescriptors(QStringList)),
+          this, SLOT(received()));
+  connect(tc, SIGNAL(addressMapped(QString, QString, QDateTime)),
+          this, SLOT(received()));
+}
+
+/** Runs an event loop until <b>count</b> events have arrived or none has
+ * arrived for <b>idleMsecs</b> milliseconds. */
+bool
+EventCounter::waitFor(int count, int idleMsecs)
+{
+  if (_times.size() >= count)
+    return true;
+
+  QEventLoop loop;
+  QTimer idleTimer;
+  connect(&idleTimer, SIGNAL(timeout()), this, SLOT(checkIdle()));
+
+  _loop = &loop;
+  _expected = count;
+  _lastCount = _times.size();
+  idleTimer.start(idleMsecs);
+  loop.exec();
+  _loop = 0;
+
+  return (_times.size() >= count);
+}
+
+/** Records the arrival of an event. */
+void
+EventCounter::received()
+{
+  _times << bench_clock_nsecs();
+  if (_loop && _times.size() >= _expected)
+    _loop->quit();
+}
+
+/** Stops waiting if no event has arrived since the last check. */
+void
+EventCounter::checkIdle()
+{
+  if (_loop && _times.size() == _lastCount)
+    _loop->quit();
+  _lastCount = _times.size();
+}
+
@@ -0,0 +1,62 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file EventCounter.h
+** \brief Records when event signals from TorControl arrive
+*/
+
+#ifndef _EVENTCOUNTER_H
+#define _EVENTCOUNTER_H
+
+#include <QObject>
+#include <QVector>
+
+class TorControl;
+class QEventLoop;
+
+
+/** An EventCounter connects to the event signals of a TorControl and
+ * records the time at which each one arrives on the GUI thread. */
+class EventCounter : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor. Counts the events emitted by <b>tc</b>. */
+  EventCounter(TorControl *tc, QObject *parent = 0);
+
+  /** Runs an event loop until <b>count</b> events have arrived or no event
+   * has arrived for <b>idleMsecs</b> milliseconds. Returns true if all
+   * <b>count</b> events arrived. */
+  bool waitFor(int count, int idleMsecs);
+
+  /** Returns the number of events received so far. */
+  int count() const { return _times.size(); }
+  /** Returns the arrival time (see bench_clock_nsecs()) of each event. */
+  const QVector<quint64> &times() const { return _times; }
+  /** Discards all recorded arrival times. */
+  void clear() { _times.clear(); }
+
+private slots:
+  /** Records the arrival of an event. */
+  void received();
+  /** Stops waiting if no event has arrived since the last check. */
+  void checkIdle();
+
+private:
+  QVector<quint64> _times; /**< Arrival time of each event. */
+  QEventLoop *_loop; /**< Event loop run by waitFor(). */
+  int _expected; /**< Number of events waitFor() is waiting for. */
+  int _lastCount; /**< Event count at the last idle check. */
+};
+
+#endif
+
@@ -0,0 +1,218 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file Fixtures.cpp
+** \brief Loads and generates network status, descriptor and event fixtures
+*/
+
+#include "Fixtures.h"
+
+#include <QFile>
+#include <QCryptographicHash>
+
+/** Publication time used for every generated router. */
+#define PUBLISHED  "2011-06-01 12:00:00"
+
+
+/** Reads the file <b>fileName</b> and normalizes its line endings. */
+QByteArray
+fixture_read(const QString &fileName, QString *errmsg)
+{
+  QFile file(fileName);
+  if (!file.open(QIODevice::ReadOnly)) {
+    if (errmsg)
+      *errmsg = QString("Unable to read '%1': %2").arg(fileName)
+                                                  .arg(file.errorString());
+    return QByteArray();
+  }
+  QByteArray data = file.readAll();
+  data.replace("\r\n", "\n");
+  return data;
+}
+
+/** Splits <b>capture</b> into individual event messages. An event ends at
+ * its first "650 " line; "650+" lines are followed by a data block that
+ * ends with a line containing only ".". Lines that are not part of an event
+ * message, such as replies to commands, are ignored. */
+QList<QByteArray>
+fixture_split_events(const QByteArray &capture)
+{
+  QList<QByteArray> events;
+  QByteArray current;
+  bool inData = false;
+
+  foreach (QByteArray line, capture.split('\n')) {
+    if (inData) {
+      current += line + "\r\n";
+      if (line == ".")
+        inData = false;
+      continue;
+    }
+    if (line.size() < 4 || !line.startsWith("650"))
+      continue;
+
+    current += line + "\r\n";
+    if (line.at(3) == '+') {
+      inData = true;
+    } else if (line.at(3) == ' ') {
+      events << current;
+      current.clear();
+    }
+  }
+  return events;
+}
+
+/** Returns the 20-byte identity digest of generated router <b>i</b>. */
+static QByteArray
+relay_identity(int i)
+{
+  return QCryptographicHash::hash("identity" + QByteArray::number(i),
+                                  QCryptographicHash::Sha1);
+}
+
+/** Returns the 20-byte descriptor digest of generated router <b>i</b>. */
+static QByteArray
+relay_digest(int i)
+{
+  return QCryptographicHash::hash("digest" + QByteArray::number(i),
+                                  QCryptographicHash::Sha1);
+}
+
+/** Returns the nickname of generated router <b>i</b>. */
+static QByteArray
+relay_name(int i)
+{
+  return "relay" + QByteArray::number(i);
+}
+
+/** Returns the IP address of generated router <b>i</b>. */
+static QByteArray
+relay_address(int i)
+{
+  return QString("10.%1.%2.%3").arg((i >> 16) & 0xff)
+                               .arg((i >> 8) & 0xff)
+                               .arg(i & 0xff).toLatin1();
+}
+
+/** Encodes <b>digest</b> in base64 without trailing padding, as in a
+ * network status document. */
+static QByteArray
+base64_digest(const QByteArray &digest)
+{
+  QByteArray b64 = digest.toBase64();
+  while (b64.endsWith('='))
+    b64.chop(1);
+  return b64;
+}
+
+/** Generates a network status document listing <b>relays</b> routers. */
+QByteArray
+fixture_generate_network_status(int relays)
+{
+  static const char *flags[] = {
+    "Fast Running Stable Valid",
+    "Exit Fast Guard Running Stable V2Dir Valid",
+    "Fast Guard HSDir Running Stable V2Dir Valid",
+    "Running Valid"
+  };
+  QByteArray ns;
+
+  for (int i = 0; i < relays; i++) {
+    ns += "r " + relay_name(i)
+        + " " + base64_digest(relay_identity(i))
+        + " " + base64_digest(relay_digest(i))
+        + " " PUBLISHED " " + relay_address(i) + " 9001 9030\n";
+    ns += "s " + QByteArray(flags[i % 4]) + "\n";
+    ns += "w Bandwidth=" + QByteArray::number(20 + (i % 1000) * 7) + "\n";
+  }
+  return ns;
+}
+
+/** Generates <b>relays</b> concatenated router descriptors. */
+QByteArray
+fixture_generate_descriptors(int relays)
+{
+  QByteArray desc;
+
+  for (int i = 0; i < relays; i++) {
+    QByteArray id = relay_identity(i).toHex().toUpper();
+    QByteArray fingerprint;
+    for (int j = 0; j < id.size(); j += 4) {
+      if (j)
+        fingerprint += ' ';
+      fingerprint += id.mid(j, 4);
+    }
+    int bw = 1048576 + (i % 1000) * 4096;
+
+    desc += "router " + relay_name(i) + " " + relay_address(i)
+          + " 9001 0 9030\n";
+    desc += "platform Tor 0.2.2.35 on Linux\n";
+    desc += "opt protocols Link 1 2 Circuit 1\n";
+    desc += "published " PUBLISHED "\n";
+    desc += "opt fingerprint " + fingerprint + "\n";
+    desc += "uptime " + QByteArray::number(3600 + i) + "\n";
+    desc += "bandwidth " + QByteArray::number(bw) + " "
+          + QByteArray::number(bw * 2) + " "
+          + QByteArray::number(bw / 2) + "\n";
+    desc += "contact relay" + QByteArray::number(i)
+          + " <relay@example.com>\n";
+    desc += "reject *:*\n";
+    desc += "router-signature\n";
+    desc += "-----BEGIN SIGNATURE-----\n";
+    desc += relay_digest(i).toBase64() + "\n";
+    desc += "-----END SIGNATURE-----\n";
+  }
+  return desc;
+}
+
+/** Generates <b>count</b> asynchronous event messages. */
+QList<QByteArray>
+fixture_generate_events(int count, int relays)
+{
+  QList<QByteArray> events;
+  QList<QByteArray> hops;
+
+  relays = qMax(relays, 3);
+  for (int i = 0; i < qMin(relays, 100); i++) {
+    hops << ("$" + relay_identity(i).toHex().toUpper()
+             + "~" + relay_name(i));
+  }
+
+  for (int i = 0; i < count; i++) {
+    int circId = (i / 4) % 1000 + 1;
+    QByteArray event;
+
+    switch (i % 4) {
+      case 0:
+        event = "650 BW " + QByteArray::number(1024 * (i % 97))
+              + " " + QByteArray::number(512 * (i % 89));
+        break;
+      case 1:
+        event = "650 CIRC " + QByteArray::number(circId) + " BUILT "
+              + hops.at(i % hops.size()) + ","
+              + hops.at((i + 1) % hops.size()) + ","
+              + hops.at((i + 2) % hops.size()) + " PURPOSE=GENERAL";
+        break;
+      case 2:
+        event = "650 STREAM " + QByteArray::number(i / 4 + 1)
+              + " SUCCEEDED " + QByteArray::number(circId)
+              + " www.example.com:443";
+        break;
+      default:
+        event = "650 NOTICE Benchmark log message "
+              + QByteArray::number(i / 4);
+        break;
+    }
+    events << (event + "\r\n");
+  }
+  return events;
+}
+
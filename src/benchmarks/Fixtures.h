@@ -0,0 +1,50 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file Fixtures.h
+** \brief Loads and generates network status, descriptor and event fixtures
+*/
+
+#ifndef _FIXTURES_H
+#define _FIXTURES_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+
+/** Reads the file <b>fileName</b> and returns its contents with every line
+ * ending converted to LF. Returns an empty QByteArray and sets
+ * <b>errmsg</b> if the file cannot be read. */
+QByteArray fixture_read(const QString &fileName, QString *errmsg = 0);
+
+/** Splits a capture of asynchronous event messages, as written to a control
+ * port by Tor, into individual events. Each returned event is a complete
+ * message with CRLF line endings, ready to be written to a control
+ * connection. */
+QList<QByteArray> fixture_split_events(const QByteArray &capture);
+
+/** Generates a network status document (as returned by "GETINFO ns/all")
+ * listing <b>relays</b> routers. */
+QByteArray fixture_generate_network_status(int relays);
+
+/** Generates <b>relays</b> concatenated router descriptors (as returned by
+ * "GETINFO desc/all-recent") for the same routers as
+ * fixture_generate_network_status(). */
+QByteArray fixture_generate_descriptors(int relays);
+
+/** Generates <b>count</b> asynchronous event messages in the same form as
+ * fixture_split_events(). The events are a mix of BW, CIRC, STREAM and
+ * NOTICE events whose circuit paths use the first <b>relays</b> routers. */
+QList<QByteArray> fixture_generate_events(int count, int relays);
+
+#endif
+
@@ -0,0 +1,275 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file MockControlServer.cpp
+** \brief In-process fake Tor control port for benchmarks
+*/
+
+#include "MockControlServer.h"
+#include "MockControlSession.h"
+
+#include <QTcpServer>
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QEvent>
+
+/** Version string reported by the mock server. */
+#define MOCK_TOR_VERSION  "0.2.2.35 (mock)"
+
+
+/** Accepts connections on the server thread and hands each one to a new
+ * MockControlSession. Also stops the server thread's event loop when it
+ * receives a QEvent::User, which can be posted before the loop starts. */
+class MockControlListener : public QTcpServer
+{
+public:
+  /** Constructor. */
+  MockControlListener(MockControlServer *server)
+    : _server(server) {}
+
+protected:
+  /** Creates a session for the new connection <b>socketDescriptor</b>. */
+  void incomingConnection(int socketDescriptor)
+  {
+    new MockControlSession(_server, socketDescriptor, this);
+  }
+  /** Stops the server thread on a QEvent::User. */
+  bool event(QEvent *e)
+  {
+    if (e->type() == QEvent::User) {
+      _server->quit();
+      return true;
+    }
+    return QTcpServer::event(e);
+  }
+
+private:
+  MockControlServer *_server; /**< Server that owns this listener. */
+};
+
+
+/** Constructor. */
+MockControlServer::MockControlServer()
+{
+  _eventRate = 0;
+  _listener = 0;
+  _port = 0;
+
+  _values.insert("version", formatValue("version", MOCK_TOR_VERSION));
+  _values.insert("status/bootstrap-phase",
+                 formatValue("status/bootstrap-phase",
+                             "NOTICE BOOTSTRAP PROGRESS=100 TAG=done "
+                             "SUMMARY=\"Done\""));
+  _values.insert("status/circuit-established",
+                 formatValue("status/circuit-established", "1"));
+}
+
+/** Destructor. */
+MockControlServer::~MockControlServer()
+{
+  stop();
+}
+
+/** Sets the network status document and indexes its router status entries
+ * by the hex-encoded identity digest on their "r" line. */
+void
+MockControlServer::setNetworkStatus(const QByteArray &ns)
+{
+  _values.insert("ns/all", formatValue("ns/all", ns));
+  _statusById.clear();
+
+  QByteArray entry, id;
+  foreach (QByteArray line, ns.split('\n')) {
+    if (line.startsWith("r ")) {
+      if (!id.isEmpty())
+        _statusById.insert(id, entry);
+      QList<QByteArray> parts = line.split(' ');
+      id = (parts.size() > 2) ? QByteArray::fromBase64(parts.at(2))
+                                  .toHex().toUpper()
+                              : QByteArray();
+      entry.clear();
+    }
+    if (!line.isEmpty())
+      entry += line + "\n";
+  }
+  if (!id.isEmpty())
+    _statusById.insert(id, entry);
+}
+
+/** Sets the router descriptors and indexes each one by the fingerprint on
+ * its "fingerprint" line. */
+void
+MockControlServer::setDescriptors(const QByteArray &descriptors)
+{
+  _values.insert("desc/all-recent",
+                 formatValue("desc/all-recent", descriptors));
+  _descById.clear();
+
+  QByteArray desc, id;
+  foreach (QByteArray line, descriptors.split('\n')) {
+    if (line.startsWith("router ")) {
+      if (!id.isEmpty())
+        _descById.insert(id, desc);
+      id.clear();
+      desc.clear();
+    }
+    if (line.startsWith("opt fingerprint "))
+      id = line.mid(16).replace(" ", "").toUpper();
+    else if (line.startsWith("fingerprint "))
+      id = line.mid(12).replace(" ", "").toUpper();
+    if (!line.isEmpty())
+      desc += line + "\n";
+  }
+  if (!id.isEmpty())
+    _descById.insert(id, desc);
+}
+
+/** Sets the events replayed after a SETEVENTS command. */
+void
+MockControlServer::setEvents(const QList<QByteArray> &events)
+{
+  _events = events;
+}
+
+/** Sets the event replay rate, in events per second. */
+void
+MockControlServer::setEventRate(int eventsPerSecond)
+{
+  _eventRate = qMax(0, eventsPerSecond);
+}
+
+/** Starts the server thread and waits for it to start listening. */
+quint16
+MockControlServer::listen()
+{
+  if (isRunning())
+    return _port;
+
+  start();
+  _listening.acquire();
+  return _port;
+}
+
+/** Stops the server thread. The request is posted to the listener, so it
+ * takes effect even if the thread has not yet entered its event loop. */
+void
+MockControlServer::stop()
+{
+  if (isRunning() && _listener)
+    QCoreApplication::postEvent(_listener, new QEvent(QEvent::User));
+  wait();
+}
+
+/** Listens on a loopback port and runs the server's event loop. Every
+ * session is a child of the listener, so they are all closed and deleted
+ * when the listener goes out of scope. */
+void
+MockControlServer::run()
+{
+  MockControlListener listener(this);
+
+  if (listener.listen(QHostAddress::LocalHost, 0)) {
+    _port = listener.serverPort();
+    _listener = &listener;
+  } else {
+    _port = 0;
+    _errorString = listener.errorString();
+  }
+  _listening.release();
+
+  if (_port)
+    exec();
+  _listener = 0;
+}
+
+/** Returns the write time of each event replayed since the last call to
+ * clearEventTimes(). */
+QVector<quint64>
+MockControlServer::eventTimes()
+{
+  QMutexLocker locker(&_timesMutex);
+  return _eventTimes;
+}
+
+/** Discards the recorded event write times. */
+void
+MockControlServer::clearEventTimes()
+{
+  QMutexLocker locker(&_timesMutex);
+  _eventTimes.clear();
+}
+
+/** Records that an event was written at <b>time</b>. */
+void
+MockControlServer::recordEventSent(quint64 time)
+{
+  QMutexLocker locker(&_timesMutex);
+  _eventTimes << time;
+}
+
+/** Sets <b>reply</b> to the reply lines for GETINFO <b>key</b>. Router IDs
+ * in "ns/id/" and "desc/id/" keys may be given with or without a leading
+ * "$", in either case. */
+bool
+MockControlServer::getInfo(const QByteArray &key, QByteArray *reply) const
+{
+  if (_values.contains(key)) {
+    *reply = _values.value(key);
+    return true;
+  }
+
+  const QHash<QByteArray,QByteArray> *table;
+  QByteArray id;
+  if (key.startsWith("ns/id/")) {
+    table = &_statusById;
+    id = key.mid(6);
+  } else if (key.startsWith("desc/id/")) {
+    table = &_descById;
+    id = key.mid(8);
+  } else {
+    return false;
+  }
+  if (id.startsWith('$'))
+    id.remove(0, 1);
+  id = id.toUpper();
+  if (!table->contains(id))
+    return false;
+  *reply = formatValue(key, table->value(id));
+  return true;
+}
+
+/** Formats <b>value</b> as the reply line for GETINFO <b>key</b>. Values
+ * that span more than one line are sent as a data block, with lines that
+ * begin with a "." escaped as the control protocol requires. */
+QByteArray
+MockControlServer::formatValue(const QByteArray &key, const QByteArray &value)
+{
+  if (!value.contains('\n'))
+    return "250-" + key + "=" + value + "\r\n";
+
+  QByteArray reply = "250+" + key + "=\r\n";
+  reply.reserve(value.size() + value.count('\n') + key.size() + 16);
+
+  int start = 0;
+  while (start < value.size()) {
+    int end = value.indexOf('\n', start);
+    if (end < 0)
+      end = value.size();
+    if (value.at(start) == '.')
+      reply += '.';
+    reply += value.mid(start, end - start);
+    reply += "\r\n";
+    start = end + 1;
+  }
+  reply += ".\r\n";
+  return reply;
+}
+
@@ -0,0 +1,121 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file MockControlServer.h
+** \brief In-process fake Tor control port for benchmarks
+*/
+
+#ifndef _MOCKCONTROLSERVER_H
+#define _MOCKCONTROLSERVER_H
+
+#include <QThread>
+#include <QMutex>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QByteArray>
+
+class QTcpServer;
+
+
+/** A MockControlServer listens on a loopback TCP port on its own thread and
+ * speaks just enough of Tor's control protocol for a controller to connect,
+ * authenticate, fetch network status documents and router descriptors, and
+ * subscribe to events:
+ *
+ *   PROTOCOLINFO, AUTHENTICATE, USEFEATURE, SETCONF, GETCONF, SIGNAL, QUIT
+ *   GETINFO version, status/bootstrap-phase, status/circuit-established,
+ *           ns/all, ns/id/ID, desc/all-recent, desc/id/ID
+ *   SETEVENTS
+ *
+ * A non-empty SETEVENTS starts replaying the configured event messages, in
+ * order, at the configured rate. The time at which each event is written is
+ * recorded so that delivery latency can be measured in the same process.
+ *
+ * All fixtures must be set before listen() is called.
+ */
+class MockControlServer : public QThread
+{
+public:
+  /** Constructor. */
+  MockControlServer();
+  /** Destructor. Stops the server if it is running. */
+  ~MockControlServer();
+
+  /** Sets the document returned for "GETINFO ns/all". <b>ns</b> uses LF line
+   * endings; router status entries are also indexed for "ns/id/". */
+  void setNetworkStatus(const QByteArray &ns);
+  /** Sets the document returned for "GETINFO desc/all-recent".
+   * <b>descriptors</b> uses LF line endings; each descriptor is also
+   * indexed for "desc/id/". */
+  void setDescriptors(const QByteArray &descriptors);
+  /** Sets the event messages replayed after a SETEVENTS command. Each event
+   * must be a complete message with CRLF line endings. */
+  void setEvents(const QList<QByteArray> &events);
+  /** Sets the rate at which events are replayed, in events per second. A
+   * rate of 0 replays them as fast as the client reads them. Unlike the
+   * fixtures, the rate can be changed while the server is running; it
+   * applies from the next SETEVENTS command. */
+  void setEventRate(int eventsPerSecond);
+
+  /** Starts listening on a loopback port and returns the port number, or 0
+   * if the server could not listen. */
+  quint16 listen();
+  /** Stops the server and closes every client connection. */
+  void stop();
+  /** Returns a description of the last error. */
+  QString errorString() const { return _errorString; }
+
+  /** Returns the monotonic time (see bench_clock_nsecs()) at which each
+   * event replayed since the last call to clearEventTimes() was written. */
+  QVector<quint64> eventTimes();
+  /** Discards the recorded event write times. */
+  void clearEventTimes();
+
+  /** Returns the events replayed after a SETEVENTS command. */
+  const QList<QByteArray> &events() const { return _events; }
+  /** Returns the event replay rate, in events per second. */
+  int eventRate() const { return _eventRate; }
+  /** Sets <b>reply</b> to the reply lines for the GETINFO key <b>key</b>,
+   * not including the final "250 OK". Returns false if the key is not
+   * recognized. */
+  bool getInfo(const QByteArray &key, QByteArray *reply) const;
+  /** Records that an event was written at <b>time</b>. */
+  void recordEventSent(quint64 time);
+
+protected:
+  /** Main thread implementation. */
+  void run();
+
+private:
+  /** Returns <b>value</b> formatted as the reply to GETINFO <b>key</b>. */
+  static QByteArray formatValue(const QByteArray &key,
+                                const QByteArray &value);
+
+  QHash<QByteArray,QByteArray> _values; /**< Formatted fixed GETINFO keys. */
+  QHash<QByteArray,QByteArray> _statusById; /**< Status entries by ID. */
+  QHash<QByteArray,QByteArray> _descById; /**< Router descriptors by ID. */
+  QList<QByteArray> _events; /**< Events replayed after SETEVENTS. */
+  QAtomicInt _eventRate; /**< Event replay rate, in events per second. */
+
+  QTcpServer *_listener; /**< Accepts connections on the server thread. */
+  QSemaphore _listening; /**< Released once the server is listening. */
+  quint16 _port; /**< Port the server is listening on. */
+  QString _errorString; /**< Description of the last error. */
+
+  QMutex _timesMutex; /**< Protects <b>_eventTimes</b>. */
+  QVector<quint64> _eventTimes; /**< Write times of replayed events. */
+};
+
+#endif
+
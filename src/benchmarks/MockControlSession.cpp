@@ -0,0 +1,211 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file MockControlSession.cpp
+** \brief A single client connection to a MockControlServer
+*/
+
+#include "MockControlSession.h"
+#include "MockControlServer.h"
+#include "Benchmark.h"
+
+#include <QTcpSocket>
+#include <QTimer>
+
+/** Interval, in milliseconds, between bursts of rate-limited events. */
+#define REPLAY_INTERVAL     10
+/** Maximum number of events written per burst when replaying as fast as
+ * possible, so that commands from the client are still answered. */
+#define REPLAY_BURST        256
+/** Stop writing events while more than this many bytes are waiting to be
+ * sent to a client that is not keeping up. */
+#define MAX_PENDING_BYTES   (1024*1024)
+
+
+/** Constructor. */
+MockControlSession::MockControlSession(MockControlServer *server,
+                                       int socketDescriptor, QObject *parent)
+  : QObject(parent)
+{
+  _server = server;
+  _replayed = 0;
+  _replayStart = 0;
+  _replayRate = 0;
+  _inData = false;
+
+  _socket = new QTcpSocket(this);
+  _socket->setSocketDescriptor(socketDescriptor);
+  _replayTimer = new QTimer(this);
+
+  QObject::connect(_socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+  QObject::connect(_socket, SIGNAL(disconnected()),
+                   this, SLOT(deleteLater()));
+  QObject::connect(_replayTimer, SIGNAL(timeout()),
+                   this, SLOT(replayEvents()));
+}
+
+/** Reads and answers every complete command line. The data following a
+ * "+" command is skipped and the command is acknowledged once it ends. */
+void
+MockControlSession::onReadyRead()
+{
+  while (_socket->canReadLine()) {
+    QByteArray line = _socket->readLine();
+    while (line.endsWith('\n') || line.endsWith('\r'))
+      line.chop(1);
+
+    if (_inData) {
+      if (line == ".") {
+        _inData = false;
+        write("250 OK\r\n");
+      }
+    } else if (line.startsWith('+')) {
+      _inData = true;
+    } else if (!line.isEmpty()) {
+      handleCommand(line);
+    }
+  }
+}
+
+/** Answers the command <b>line</b>. */
+void
+MockControlSession::handleCommand(const QByteArray &line)
+{
+  int sp = line.indexOf(' ');
+  QByteArray keyword = line.left(sp < 0 ? line.size() : sp).toUpper();
+  QByteArray args = (sp < 0) ? QByteArray() : line.mid(sp + 1).trimmed();
+
+  if (keyword == "PROTOCOLINFO") {
+    write("250-PROTOCOLINFO 1\r\n"
+          "250-AUTH METHODS=NULL\r\n"
+          "250-VERSION Tor=\"0.2.2.35\"\r\n"
+          "250 OK\r\n");
+  } else if (keyword == "GETINFO") {
+    handleGetInfo(args);
+  } else if (keyword == "GETCONF") {
+    handleGetConf(args);
+  } else if (keyword == "SETEVENTS") {
+    handleSetEvents(args);
+  } else if (keyword == "AUTHENTICATE" || keyword == "USEFEATURE"
+               || keyword == "SETCONF" || keyword == "RESETCONF"
+               || keyword == "SIGNAL" || keyword == "TAKEOWNERSHIP") {
+    write("250 OK\r\n");
+  } else if (keyword == "QUIT") {
+    write("250 closing connection\r\n");
+    _socket->disconnectFromHost();
+  } else {
+    write("510 Unrecognized command \"" + keyword + "\"\r\n");
+  }
+}
+
+/** Answers a GETINFO command. Like Tor, the whole command fails if any one
+ * of the keys is not recognized. */
+void
+MockControlSession::handleGetInfo(const QByteArray &keys)
+{
+  QByteArray reply, value;
+
+  foreach (QByteArray key, keys.split(' ')) {
+    if (key.isEmpty())
+      continue;
+    if (!_server->getInfo(key, &value)) {
+      write("552 Unrecognized key \"" + key + "\"\r\n");
+      return;
+    }
+    reply += value;
+  }
+  write(reply + "250 OK\r\n");
+}
+
+/** Answers a GETCONF command. Every option is reported as having its default
+ * value. */
+void
+MockControlSession::handleGetConf(const QByteArray &keys)
+{
+  QList<QByteArray> lines;
+
+  foreach (QByteArray key, keys.split(' ')) {
+    if (!key.isEmpty())
+      lines << key;
+  }
+  if (lines.isEmpty()) {
+    write("250 OK\r\n");
+    return;
+  }
+
+  QByteArray reply;
+  for (int i = 0; i < lines.size(); i++) {
+    reply += (i < lines.size() - 1) ? "250-" : "250 ";
+    reply += lines.at(i) + "\r\n";
+  }
+  write(reply);
+}
+
+/** Starts replaying events from the beginning if <b>events</b> is not
+ * empty, or stops replaying them otherwise. */
+void
+MockControlSession::handleSetEvents(const QByteArray &events)
+{
+  write("250 OK\r\n");
+
+  if (events.isEmpty()) {
+    _replayTimer->stop();
+    return;
+  }
+  if (_replayTimer->isActive() || _server->events().isEmpty())
+    return;
+
+  _replayed = 0;
+  _replayRate = _server->eventRate();
+  _replayStart = bench_clock_nsecs();
+  _replayTimer->start(_replayRate > 0 ? REPLAY_INTERVAL : 0);
+}
+
+/** Writes however many events are due. At a fixed rate, that is every event
+ * whose scheduled time has passed; otherwise it is the next burst, unless
+ * the client has fallen behind, in which case we back off for a
+ * millisecond rather than spin. */
+void
+MockControlSession::replayEvents()
+{
+  const QList<QByteArray> &events = _server->events();
+  int due;
+
+  if (_replayRate > 0) {
+    quint64 elapsed = bench_clock_nsecs() - _replayStart;
+    due = int(qMin(quint64(events.size()),
+                   elapsed * _replayRate / 1000000000ULL + 1));
+  } else {
+    bool behind = (_socket->bytesToWrite() > MAX_PENDING_BYTES);
+    _replayTimer->setInterval(behind ? 1 : 0);
+    if (behind)
+      return;
+    due = qMin(events.size(), _replayed + REPLAY_BURST);
+  }
+
+  for (; _replayed < due; _replayed++) {
+    _socket->write(events.at(_replayed));
+    _server->recordEventSent(bench_clock_nsecs());
+  }
+  _socket->flush();
+
+  if (_replayed >= events.size())
+    _replayTimer->stop();
+}
+
+/** Writes <b>reply</b> to the client. */
+void
+MockControlSession::write(const QByteArray &reply)
+{
+  _socket->write(reply);
+  _socket->flush();
+}
+
@@ -0,0 +1,69 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file MockControlSession.h
+** \brief A single client connection to a MockControlServer
+*/
+
+#ifndef _MOCKCONTROLSESSION_H
+#define _MOCKCONTROLSESSION_H
+
+#include <QObject>
+#include <QByteArray>
+
+class MockControlServer;
+class QTcpSocket;
+class QTimer;
+
+
+/** A MockControlSession reads commands from one client of a
+ * MockControlServer, answers them, and replays events to the client once
+ * it has subscribed to any. It lives on the server's thread. */
+class MockControlSession : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor. Takes over the connected socket <b>socketDescriptor</b>
+   * and answers commands from the fixtures held by <b>server</b>. */
+  MockControlSession(MockControlServer *server, int socketDescriptor,
+                     QObject *parent = 0);
+
+private slots:
+  /** Reads and answers every complete command line. */
+  void onReadyRead();
+  /** Writes however many events are due at the configured replay rate. */
+  void replayEvents();
+
+private:
+  /** Answers the command <b>line</b>. */
+  void handleCommand(const QByteArray &line);
+  /** Answers a GETINFO command for the space-separated <b>keys</b>. */
+  void handleGetInfo(const QByteArray &keys);
+  /** Answers a GETCONF command for the space-separated <b>keys</b>. */
+  void handleGetConf(const QByteArray &keys);
+  /** Starts or stops replaying events, depending on whether the SETEVENTS
+   * command subscribed to any. */
+  void handleSetEvents(const QByteArray &events);
+  /** Writes <b>reply</b> to the client. */
+  void write(const QByteArray &reply);
+
+  MockControlServer *_server; /**< Server holding the fixtures. */
+  QTcpSocket *_socket; /**< Connection to the client. */
+  QTimer *_replayTimer; /**< Drives event replay. */
+  int _replayed; /**< Number of events replayed so far. */
+  quint64 _replayStart; /**< Time at which event replay began. */
+  int _replayRate; /**< Events per second, or 0 for as fast as possible. */
+  bool _inData; /**< True while skipping the data of a "+" command. */
+};
+
+#endif
+
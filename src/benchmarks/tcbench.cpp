@@ -0,0 +1,579 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file tcbench.cpp
+** \brief Benchmarks the control protocol stack against a mock control port
+*/
+
+#include "Benchmark.h"
+#include "EventCounter.h"
+#include "Fixtures.h"
+#include "MockControlServer.h"
+
+#include "ControlSocket.h"
+#include "RouterDescriptor.h"
+#include "RouterStatus.h"
+#include "TorControl.h"
+#include "TorEvents.h"
+#include "tcglobal.h"
+
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QTimer>
+#include <QTextStream>
+#include <QStringList>
+
+#include <stdlib.h>
+
+/** Milliseconds to wait for a connection to the mock server. */
+#define CONNECT_TIMEOUT   5000
+/** Milliseconds without an event after which the event stream stage gives
+ * up waiting for the rest. */
+#define EVENT_IDLE_TIMEOUT  2000
+
+/** Every stage, in the order they are run. */
+static const char *stages[] = {
+  "readreply-ns", "routerstatus", "descriptor", "parse-ns", "parse-desc",
+  "readreply-events", "handleevent", "getnetworkstatus", "getdescriptors",
+  "eventstream", 0
+};
+
+/** Settings and fixtures shared by every stage. */
+struct BenchContext {
+  MockControlServer *server; /**< Mock control port. */
+  quint16 port;              /**< Port the mock server is listening on. */
+  int iterations;            /**< Repetitions of each request stage. */
+  int rate;                  /**< Event rate for the event stream stage. */
+  int threads;               /**< Parser threads for the parse stages. */
+  QByteArray networkStatus;  /**< Network status fixture. */
+  QByteArray descriptors;    /**< Router descriptor fixture. */
+  QList<QByteArray> events;  /**< Event fixture. */
+  QList<ControlReply> eventReplies; /**< Events read by readreply-events. */
+};
+
+
+/** Prints usage information and exits. */
+void
+print_usage_and_exit()
+{
+  QTextStream error(stderr);
+  error << "usage: tcbench [-n <ns>] [-d <desc>] [-e <events>] "
+           "[-r <relays>] [-c <count>]\n"
+           "               [-R <rate>] [-t <threads>] [-i <iterations>] "
+           "[-s <stage>]...\n";
+  error << "  -n <ns>          Network status fixture (GETINFO ns/all)\n";
+  error << "  -d <desc>        Descriptor fixture (GETINFO desc/all-recent)\n";
+  error << "  -e <events>      Captured 650 event messages\n";
+  error << "  -r <relays>      Relays to generate without -n/-d "
+           "(default: 5000)\n";
+  error << "  -c <count>       Events to generate without -e "
+           "(default: 20000)\n";
+  error << "  -R <rate>        Events per second in the eventstream stage "
+           "(default: 0,\n"
+           "                   as fast as possible)\n";
+  error << "  -t <threads>     Parser threads in the parse-ns and parse-desc "
+           "stages\n"
+           "                   (default: 0, one per CPU; 1 parses serially)\n";
+  error << "  -i <iterations>  Repetitions of each request (default: 10)\n";
+  error << "  -s <stage>       Run only the named stage; may be repeated\n";
+  error << "stages:";
+  for (int i = 0; stages[i]; i++)
+    error << " " << stages[i];
+  error << "\n";
+  error.flush();
+  exit(1);
+}
+
+/** Prints <b>msg</b> as an error. */
+void
+print_error(const QString &msg)
+{
+  QTextStream error(stderr);
+  error << "tcbench: " << msg << "\n";
+}
+
+/** Runs an event loop until <b>obj</b> emits <b>signal</b> or
+ * <b>msecs</b> milliseconds have passed. Returns true if the signal was
+ * emitted. */
+bool
+wait_for_signal(QObject *obj, const char *signal, int msecs)
+{
+  QEventLoop loop;
+  QTimer timer;
+  timer.setSingleShot(true);
+  QObject::connect(obj, signal, &loop, SLOT(quit()));
+  QObject::connect(&timer, SIGNAL(timeout()), &loop, SLOT(quit()));
+  timer.start(msecs);
+  loop.exec();
+  return timer.isActive();
+}
+
+/** Opens <b>socket</b> to the mock server. */
+bool
+connect_socket(ControlSocket *socket, quint16 port)
+{
+  socket->connectToHost(QHostAddress::LocalHost, port);
+  if (!socket->isConnected()
+        && !wait_for_signal(socket, SIGNAL(connected()), CONNECT_TIMEOUT)) {
+    print_error("Unable to connect to the mock control port.");
+    return false;
+  }
+  return true;
+}
+
+/** Connects and authenticates <b>tc</b> to the mock server. */
+bool
+connect_control(TorControl *tc, quint16 port)
+{
+  QString errmsg;
+
+  tc->connect(QHostAddress::LocalHost, port);
+  if (!tc->isConnected()
+        && !wait_for_signal(tc, SIGNAL(connected()), CONNECT_TIMEOUT)) {
+    print_error("Unable to connect to the mock control port.");
+    return false;
+  }
+  if (!tc->authenticate(QString(), &errmsg)) {
+    print_error("Authentication failed: " + errmsg);
+    return false;
+  }
+  return true;
+}
+
+/** Splits <b>lines</b> into groups, each starting at a line that begins
+ * with <b>keyword</b>. */
+QList<QStringList>
+split_at(const QStringList &lines, const QString &keyword)
+{
+  QList<QStringList> groups;
+  foreach (QString line, lines) {
+    if (line.startsWith(keyword) || groups.isEmpty())
+      groups << QStringList();
+    groups.last() << line;
+  }
+  return groups;
+}
+
+/** Times "GETINFO ns/all" round trips through a ControlSocket, which is
+ * dominated by ControlSocket::readReply(). */
+bool
+bench_readreply_ns(BenchContext *ctx, BenchmarkStage *stage)
+{
+  ControlSocket socket;
+  if (!connect_socket(&socket, ctx->port))
+    return false;
+
+  stage->begin(ctx->iterations);
+  for (int i = 0; i < ctx->iterations; i++) {
+    ControlReply reply;
+    QString errmsg;
+
+    stage->startOp();
+    if (!socket.sendCommand(ControlCommand("GETINFO", "ns/all"), &errmsg)
+          || !socket.readReply(reply, &errmsg)) {
+      print_error(errmsg);
+      return false;
+    }
+    stage->stopOp();
+  }
+  stage->end();
+  return true;
+}
+
+/** Times parsing each router status entry into a RouterStatus. */
+bool
+bench_routerstatus(BenchContext *ctx, BenchmarkStage *stage)
+{
+  QStringList lines = QString::fromLatin1(ctx->networkStatus)
+                        .split("\n", QString::SkipEmptyParts);
+  QList<QStringList> entries = split_at(lines, "r ");
+
+  stage->begin(ctx->iterations * entries.size());
+  for (int i = 0; i < ctx->iterations; i++) {
+    foreach (QStringList entry, entries) {
+      stage->startOp();
+      RouterStatus rs(entry);
+      stage->stopOp();
+      if (!rs.isValid()) {
+        print_error("Invalid router status entry: " + entry.join("\n"));
+        return false;
+      }
+    }
+  }
+  stage->end();
+  return true;
+}
+
+/** Times parsing each router descriptor into a RouterDescriptor. */
+bool
+bench_descriptor(BenchContext *ctx, BenchmarkStage *stage)
+{
+  QStringList lines = QString::fromLatin1(ctx->descriptors)
+                        .split("\n", QString::SkipEmptyParts);
+  QList<QStringList> descriptors = split_at(lines, "router ");
+
+  stage->begin(ctx->iterations * descriptors.size());
+  for (int i = 0; i < ctx->iterations; i++) {
+    foreach (QStringList desc, descriptors) {
+      stage->startOp();
+      RouterDescriptor rd(desc);
+      stage->stopOp();
+    }
+  }
+  stage->end();
+  return true;
+}
+
+/** Times parsing the whole network status document at once with
+ * parse_network_status(), as getNetworkStatus() does with a full
+ * consensus. */
+bool
+bench_parse_ns(BenchContext *ctx, BenchmarkStage *stage)
+{
+  QStringList lines = QString::fromLatin1(ctx->networkStatus)
+                        .split("\n", QString::SkipEmptyParts);
+
+  stage->begin(ctx->iterations);
+  for (int i = 0; i < ctx->iterations; i++) {
+    stage->startOp();
+    NetworkStatus ns = parse_network_status(lines, ctx->threads);
+    stage->stopOp();
+    if (ns.isEmpty()) {
+      print_error("No valid router status entries in the fixture.");
+      return false;
+    }
+  }
+  stage->end();
+  return true;
+}
+
+/** Times parsing every descriptor at once with parse_router_descriptors(),
+ * as getRouterDescriptors() does with "desc/all-recent". */
+bool
+bench_parse_desc(BenchContext *ctx, BenchmarkStage *stage)
+{
+  QStringList lines = QString::fromLatin1(ctx->descriptors)
+                        .split("\n", QString::SkipEmptyParts);
+
+  stage->begin(ctx->iterations);
+  for (int i = 0; i < ctx->iterations; i++) {
+    RouterDescriptorMap descriptors;
+    stage->startOp();
+    parse_router_descriptors(lines, descriptors, ctx->threads);
+    stage->stopOp();
+    if (descriptors.isEmpty()) {
+      print_error("No valid router descriptors in the fixture.");
+      return false;
+    }
+  }
+  stage->end();
+  return true;
+}
+
+/** Times reading each replayed event message with
+ * ControlSocket::readReply(). The events are kept for the handleevent
+ * stage. */
+bool
+bench_readreply_events(BenchContext *ctx, BenchmarkStage *stage)
+{
+  ControlSocket socket;
+  ControlReply reply;
+  QString errmsg;
+
+  if (!connect_socket(&socket, ctx->port))
+    return false;
+
+  /* Events are replayed as fast as possible here; the eventstream stage is
+   * the one that honors the configured rate. */
+  ctx->server->setEventRate(0);
+  ctx->eventReplies.clear();
+  if (!socket.sendCommand(ControlCommand("SETEVENTS", "BW"), &errmsg)
+        || !socket.readReply(reply, &errmsg)) {
+    print_error(errmsg);
+    return false;
+  }
+
+  stage->begin(ctx->events.size());
+  for (int i = 0; i < ctx->events.size(); i++) {
+    ControlReply event;
+    stage->startOp();
+    if (!socket.readReply(event, &errmsg)) {
+      print_error(errmsg);
+      return false;
+    }
+    stage->stopOp();
+    ctx->eventReplies << event;
+  }
+  stage->end();
+
+  socket.sendCommand(ControlCommand("SETEVENTS"));
+  socket.readReply(reply);
+  return true;
+}
+
+/** Times TorEvents::handleEvent() on each event read by the
+ * readreply-events stage. */
+bool
+bench_handleevent(BenchContext *ctx, BenchmarkStage *stage)
+{
+  if (ctx->eventReplies.isEmpty()) {
+    BenchmarkStage unused("readreply-events", "event");
+    if (!bench_readreply_events(ctx, &unused))
+      return false;
+  }
+
+  TorEvents events;
+  stage->begin(ctx->iterations * ctx->eventReplies.size());
+  for (int i = 0; i < ctx->iterations; i++) {
+    foreach (ControlReply reply, ctx->eventReplies) {
+      stage->startOp();
+      events.handleEvent(reply);
+      stage->stopOp();
+    }
+  }
+  stage->end();
+  return true;
+}
+
+/** Times TorControl::getNetworkStatus(), which includes sending the
+ * command, reading the reply on the control thread and parsing it. */
+bool
+bench_getnetworkstatus(BenchContext *ctx, BenchmarkStage *stage)
+{
+  TorControl tc;
+  if (!connect_control(&tc, ctx->port))
+    return false;
+
+  stage->begin(ctx->iterations);
+  for (int i = 0; i < ctx->iterations; i++) {
+    QString errmsg;
+    stage->startOp();
+    NetworkStatus ns = tc.getNetworkStatus(&errmsg);
+    stage->stopOp();
+    if (ns.isEmpty()) {
+      print_error("getNetworkStatus() failed: " + errmsg);
+      return false;
+    }
+  }
+  stage->end();
+  tc.disconnect();
+  return true;
+}
+
+/** Times TorControl::getRouterDescriptors() for every recent descriptor. */
+bool
+bench_getdescriptors(BenchContext *ctx, BenchmarkStage *stage)
+{
+  TorControl tc;
+  if (!connect_control(&tc, ctx->port))
+    return false;
+
+  stage->begin(ctx->iterations);
+  for (int i = 0; i < ctx->iterations; i++) {
+    QString errmsg;
+    stage->startOp();
+    RouterDescriptorMap descriptors = tc.getRouterDescriptors(&errmsg);
+    stage->stopOp();
+    if (descriptors.isEmpty()) {
+      print_error("getRouterDescriptors() failed: " + errmsg);
+      return false;
+    }
+  }
+  stage->end();
+  tc.disconnect();
+  return true;
+}
+
+/** Replays the events through a TorControl at the configured rate and
+ * times each one from the moment the mock server writes it to the moment
+ * the corresponding signal arrives on this thread. Latencies are paired up
+ * in order, which assumes every replayed event produces exactly one
+ * signal. */
+bool
+bench_eventstream(BenchContext *ctx, BenchmarkStage *stage)
+{
+  TorControl tc;
+  EventCounter counter(&tc);
+
+  if (!connect_control(&tc, ctx->port))
+    return false;
+
+  tc.setEvent(TorEvents::Bandwidth, true, false);
+  tc.setEvent(TorEvents::CircuitStatus, true, false);
+  tc.setEvent(TorEvents::StreamStatus, true, false);
+  tc.setEvent(TorEvents::LogNotice, true, false);
+  tc.setEvent(TorEvents::NewDescriptor, true, false);
+  tc.setEvent(TorEvents::AddressMap, true, false);
+
+  ctx->server->setEventRate(ctx->rate);
+  ctx->server->clearEventTimes();
+
+  stage->begin(ctx->events.size());
+  QString errmsg;
+  if (!tc.setEvents(&errmsg)) {
+    print_error("SETEVENTS failed: " + errmsg);
+    return false;
+  }
+  bool complete = counter.waitFor(ctx->events.size(), EVENT_IDLE_TIMEOUT);
+  stage->end();
+
+  QVector<quint64> sent = ctx->server->eventTimes();
+  const QVector<quint64> &received = counter.times();
+  int n = qMin(sent.size(), received.size());
+  for (int i = 0; i < n; i++)
+    stage->addSample(received.at(i) - qMin(sent.at(i), received.at(i)));
+
+  if (!complete) {
+    print_error(QString("eventstream: %1 of %2 events produced a signal; "
+                        "latencies are approximate.")
+                  .arg(received.size()).arg(sent.size()));
+  }
+  tc.disconnect();
+  return true;
+}
+
+/** Runs the stage called <b>name</b> and prints its results. */
+bool
+run_stage(BenchContext *ctx, const QString &name)
+{
+  BenchmarkStage *stage;
+  bool ok;
+
+  if (name == "readreply-ns") {
+    stage = new BenchmarkStage(name, "reply");
+    ok = bench_readreply_ns(ctx, stage);
+  } else if (name == "routerstatus") {
+    stage = new BenchmarkStage(name, "entry");
+    ok = bench_routerstatus(ctx, stage);
+  } else if (name == "descriptor") {
+    stage = new BenchmarkStage(name, "desc");
+    ok = bench_descriptor(ctx, stage);
+  } else if (name == "parse-ns") {
+    stage = new BenchmarkStage(name, "document");
+    ok = bench_parse_ns(ctx, stage);
+  } else if (name == "parse-desc") {
+    stage = new BenchmarkStage(name, "document");
+    ok = bench_parse_desc(ctx, stage);
+  } else if (name == "readreply-events") {
+    stage = new BenchmarkStage(name, "event");
+    ok = bench_readreply_events(ctx, stage);
+  } else if (name == "handleevent") {
+    stage = new BenchmarkStage(name, "event");
+    ok = bench_handleevent(ctx, stage);
+  } else if (name == "getnetworkstatus") {
+    stage = new BenchmarkStage(name, "call");
+    ok = bench_getnetworkstatus(ctx, stage);
+  } else if (name == "getdescriptors") {
+    stage = new BenchmarkStage(name, "call");
+    ok = bench_getdescriptors(ctx, stage);
+  } else if (name == "eventstream") {
+    stage = new BenchmarkStage(name, "event");
+    ok = bench_eventstream(ctx, stage);
+  } else {
+    print_error("Unknown stage: " + name);
+    return false;
+  }
+
+  if (ok) {
+    QTextStream out(stdout);
+    out << stage->toString() << "\n";
+  }
+  delete stage;
+  return ok;
+}
+
+int
+main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  QString nsFile, descFile, eventsFile, errmsg;
+  QStringList selected;
+  int relays = 5000, eventCount = 20000;
+  BenchContext ctx;
+
+  ctx.iterations = 10;
+  ctx.rate = 0;
+  ctx.threads = 0;
+  for (int i = 1; i < argc; i++) {
+    QString arg(argv[i]);
+    if (arg == "-n" && ++i < argc)
+      nsFile = argv[i];
+    else if (arg == "-d" && ++i < argc)
+      descFile = argv[i];
+    else if (arg == "-e" && ++i < argc)
+      eventsFile = argv[i];
+    else if (arg == "-r" && ++i < argc)
+      relays = QString(argv[i]).toInt();
+    else if (arg == "-c" && ++i < argc)
+      eventCount = QString(argv[i]).toInt();
+    else if (arg == "-R" && ++i < argc)
+      ctx.rate = QString(argv[i]).toInt();
+    else if (arg == "-t" && ++i < argc)
+      ctx.threads = qMax(0, QString(argv[i]).toInt());
+    else if (arg == "-i" && ++i < argc)
+      ctx.iterations = qMax(1, QString(argv[i]).toInt());
+    else if (arg == "-s" && ++i < argc)
+      selected << argv[i];
+    else
+      print_usage_and_exit();
+  }
+  if (selected.isEmpty()) {
+    for (int i = 0; stages[i]; i++)
+      selected << stages[i];
+  }
+
+  /* The control library's debug output would swamp the results */
+  tc::setMessageThreshold(QtWarningMsg);
+
+  /* Load the fixtures, generating whichever ones were not given */
+  ctx.networkStatus = nsFile.isEmpty()
+                        ? fixture_generate_network_status(relays)
+                        : fixture_read(nsFile, &errmsg);
+  ctx.descriptors = descFile.isEmpty()
+                      ? fixture_generate_descriptors(relays)
+                      : fixture_read(descFile, &errmsg);
+  ctx.events = eventsFile.isEmpty()
+                 ? fixture_generate_events(eventCount, relays)
+                 : fixture_split_events(fixture_read(eventsFile, &errmsg));
+  if (!errmsg.isEmpty()) {
+    print_error(errmsg);
+    return 1;
+  }
+
+  MockControlServer server;
+  server.setNetworkStatus(ctx.networkStatus);
+  server.setDescriptors(ctx.descriptors);
+  server.setEvents(ctx.events);
+  ctx.server = &server;
+  ctx.port = server.listen();
+  if (!ctx.port) {
+    print_error("Unable to start the mock control port: "
+                  + server.errorString());
+    return 1;
+  }
+
+  QTextStream out(stdout);
+  out << QString("fixtures: %1 bytes of network status, %2 bytes of "
+                 "descriptors, %3 events\n")
+           .arg(ctx.networkStatus.size()).arg(ctx.descriptors.size())
+           .arg(ctx.events.size());
+  out << BenchmarkStage::header() << "\n";
+  out.flush();
+
+  int failed = 0;
+  foreach (QString name, selected) {
+    if (!run_stage(&ctx, name))
+      failed++;
+  }
+  server.stop();
+  return (failed ? 1 : 0);
+}
+
@@ -14,21 +14,18 @@
 */
 
 #include "Log.h"
-
-#include <QDateTime>
-#include <QTextStream>
+#include "LogWriter.h"
 
 /** Open log files for appending as write-only text. */
 #define LOGFILE_MODE  \
   (QIODevice::WriteOnly|QIODevice::Append|QIODevice::Text)
-/** Format for log message timestamps. */
-#define TIMESTAMP_FMT   "MMM dd HH:mm:ss.zzz"
 
 
 /** Default constructor. Logs at level Notice by default. */
 Log::Log()
 {
   _logLevel = Notice;
+  _writer = 0;
 }
 
 /** Destructor. Closes the log file. */
@@ -54,7 +51,7 @@ Log::setLogLevel(LogLevel level)
   if (level >= Debug && level < Unknown)
     _logLevel = level;
   if (level == Off)
-    _logFile.close();
+    close();
 }
 
 /** Opens <b>file</b> for appending, to which log messages will be written. */
@@ -65,7 +62,7 @@ Log::open(FILE *file)
     close();
 
   _logFile.open(file, LOGFILE_MODE);
-  return isOpen();
+  return startWriter();
 }
 
 /** Opens <b>file</b> for appending, to which log messages will be written. */
@@ -77,19 +74,60 @@ Log::open(QString file)
 
   _logFile.setFileName(file);
   _logFile.open(LOGFILE_MODE);
-  return isOpen();
+  return startWriter();
 }
 
-/** Flushes any outstanding log messages and closes the log file. */
+/** Flushes any outstanding log messages and closes the log file. Messages
+ * logged by other threads until then are still written. */
 void
 Log::close()
 {
+  QMutexLocker locker(&_writerMutex);
+  if (_writer) {
+    _writer->stop();
+    delete _writer;
+    _writer = 0;
+  }
   if (_logFile.isOpen()) {
     _logFile.flush();
     _logFile.close();
   }
 }
 
+/** Starts the thread that writes log messages to the newly opened log file.
+ * Returns true if the log file is open and ready for writing. */
+bool
+Log::startWriter()
+{
+  if (!isOpen())
+    return false;
+  QMutexLocker locker(&_writerMutex);
+  _writer = new LogWriter(&_logFile);
+  _writer->start(QThread::LowPriority);
+  return true;
+}
+
+/** Writes every queued log message to the log file on the calling thread.
+ * This is mainly useful right before the application aborts. */
+void
+Log::flush()
+{
+  QMutexLocker locker(&_writerMutex);
+  if (_writer)
+    _writer->flush();
+}
+
+/** Queues the complete message <b>msg</b> with severity <b>level</b> to be
+ * written to the log file. The writer is only used while holding
+ * <b>_writerMutex</b>, since another thread may be closing the log. */
+void
+Log::write(LogLevel level, const QString &msg)
+{
+  QMutexLocker locker(&_writerMutex);
+  if (_writer)
+    _writer->write(level, msg);
+}
+
 /** Creates a log message with severity <b>level</b> and initial message
  * contents <b>message</b>. The log message can be appended to until the
  * returned LogMessage's destructor is called, at which point the complete
@@ -97,9 +135,10 @@ Log::close()
 inline Log::LogMessage
 Log::log(LogLevel level)
 {
-  if (level < _logLevel)
-    return LogMessage(level, 0);
-  return LogMessage(level, &_logFile);
+  /* This is only a shortcut; write() checks the writer again under lock */
+  if (level < _logLevel || !_writer)
+    return LogMessage();
+  return LogMessage(level, this);
 }
 
 /** Creates a log message with severity <b>level</b>. The log message can be
@@ -112,7 +151,7 @@ Log::log(LogLevel level, QString msg)
 }
 
 /** Returns a string description of the given LogLevel <b>level</b>. */
-inline QString
+QString
 Log::logLevelToString(LogLevel level)
 {
   switch (level) {
@@ -147,27 +186,13 @@ Log::stringToLogLevel(QString str)
   return Unknown;
 }
 
-/** Returns a formatted log message, prefixed with a timestamp and the log
- * message severity level. */
-inline QString
-Log::LogMessage::toString() const
-{
-  QString msg = QDateTime::currentDateTime().toString(TIMESTAMP_FMT);
-  msg.append(" [" + Log::logLevelToString(stream->type) + "] ");
-  msg.append(stream->buf);
-  return msg;
-}
-
-/** Destructor. Writes the buffered log message out to the log file specified
- * in the constructor. */
+/** Destructor. Queues the buffered log message to be written by the log
+ * specified in the constructor. */
 Log::LogMessage::~LogMessage()
 {
-  if (!--stream->ref) {
-    if (stream->out && !stream->buf.isEmpty()) {
-      QTextStream log(stream->out);
-      log << toString() << endl;
-      log.flush();
-    }
+  if (stream && !--stream->ref) {
+    if (!stream->buf.isEmpty())
+      stream->log->write(stream->type, stream->buf);
     delete stream;
   }
 }
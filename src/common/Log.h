@@ -21,6 +21,9 @@
 #include <QStringList>
 #include <QIODevice>
 #include <QHostAddress>
+#include <QMutex>
+
+class LogWriter;
 
 
 /** The Log class is similar to the QDebug class provided with Qt, but with
@@ -41,6 +44,7 @@ public:
     Unknown     /**< Unknown/invalid log level. */
   };
   class LogMessage;
+  friend class LogMessage;
   
   /** Default constructor. */
   Log();
@@ -54,6 +58,8 @@ public:
   bool open(QString file);
   /** Closes the log file. */ 
   void close();
+  /** Writes every queued log message to the log file. */
+  void flush();
   /** Returns true if the log file is open and ready for writing. */
   bool isOpen() { return _logFile.isOpen() && _logFile.isWritable(); }
   /** Returns a string description of the last file error encountered. */
@@ -61,10 +67,12 @@ public:
   
   /** Sets the current log level to <b>level</b>. */
   void setLogLevel(LogLevel level);
+  /** Returns the current log level. */
+  LogLevel logLevel() const { return _logLevel; }
   /** Returns a list of strings representing valid log levels. */
   static QStringList logLevels();
   /** Returns a string description of the given LogLevel <b>level</b>. */
-  static inline QString logLevelToString(LogLevel level);
+  static QString logLevelToString(LogLevel level);
   /** Returns a LogLevel for the level given by <b>str</b>. */
   static LogLevel stringToLogLevel(QString str);
   
@@ -79,77 +87,90 @@ public:
   inline LogMessage log(LogLevel level);
   
 private:
+  /** Starts the thread that writes messages to the open log file. */
+  bool startWriter();
+  /** Queues the complete message <b>msg</b> with severity <b>level</b> to be
+   * written to the log file. */
+  void write(LogLevel level, const QString &msg);
+
   LogLevel _logLevel; /**< Minimum log severity level. */
   QFile _logFile;     /**< Log output destination. */
+  LogWriter *_writer; /**< Writes queued messages to <b>_logFile</b>. */
+  /** Keeps <b>_writer</b> from being deleted while another thread is handing
+   * it a message. */
+  QMutex _writerMutex;
 };
 
 /** This internal class represents a single message that is to be written to 
- * the log destination. The message is buffered until it is written to the
- * log in this class's destructor. */
+ * the log destination. The message is buffered until it is handed to the
+ * log's writer thread in this class's destructor. A message whose severity
+ * is below the current log level has no stream at all, so appending to it
+ * costs nothing beyond a null check. */
 class Log::LogMessage
 {
 public:
   struct Stream {
-    Stream(Log::LogLevel t, QIODevice *o) 
-      : type(t), out(o), ref(1) {}
+    Stream(Log::LogLevel t, Log *l) 
+      : type(t), log(l), ref(1) {}
     Log::LogLevel type;
-    QIODevice *out;
+    Log *log;
     int ref;
     QString buf;
   } *stream;
  
-  inline LogMessage(Log::LogLevel t, QIODevice *o)
-    : stream(new Stream(t,o)) {}
+  inline LogMessage()
+    : stream(0) {}
+  inline LogMessage(Log::LogLevel t, Log *l)
+    : stream(new Stream(t,l)) {}
   inline LogMessage(const LogMessage &o) 
-    : stream(o.stream) { ++stream->ref; }
-  inline QString toString() const;
+    : stream(o.stream) { if (stream) ++stream->ref; }
   ~LogMessage();
  
   /* Support both the << and .arg() methods */
   inline LogMessage &operator<<(const QString &t) 
-    { stream->buf += t; return *this; }
+    { if (stream) stream->buf += t; return *this; }
   inline LogMessage arg(const QString &a)
-    { stream->buf = stream->buf.arg(a); return *this; }
+    { if (stream) stream->buf = stream->buf.arg(a); return *this; }
   inline LogMessage &operator<<(const QStringList &a)
-    { stream->buf += a.join(","); return *this; }
+    { if (stream) stream->buf += a.join(","); return *this; }
   inline LogMessage arg(const QStringList &a)
-    { stream->buf = stream->buf.arg(a.join(",")); return *this; }
+    { if (stream) stream->buf = stream->buf.arg(a.join(",")); return *this; }
   inline LogMessage &operator<<(const QHostAddress &a)
-    { stream->buf += a.toString(); return *this; }
+    { if (stream) stream->buf += a.toString(); return *this; }
   inline LogMessage arg(const QHostAddress &a)
-    { stream->buf = stream->buf.arg(a.toString()); return *this; }
+    { if (stream) stream->buf = stream->buf.arg(a.toString()); return *this; }
   inline LogMessage &operator<<(short a)
-    { stream->buf += QString::number(a); return *this; }
+    { if (stream) stream->buf += QString::number(a); return *this; }
   inline LogMessage arg(short a)
-    { stream->buf = stream->buf.arg(a); return *this; }
+    { if (stream) stream->buf = stream->buf.arg(a); return *this; }
   inline LogMessage &operator<<(ushort a)
-    { stream->buf += QString::number(a); return *this; }
+    { if (stream) stream->buf += QString::number(a); return *this; }
   inline LogMessage arg(ushort a)
-    { stream->buf = stream->buf.arg(a); return *this; }
+    { if (stream) stream->buf = stream->buf.arg(a); return *this; }
   inline LogMessage &operator<<(int a)
-    { stream->buf += QString::number(a); return *this; }
+    { if (stream) stream->buf += QString::number(a); return *this; }
   inline LogMessage arg(int a)
-    { stream->buf = stream->buf.arg(a); return *this; }
+    { if (stream) stream->buf = stream->buf.arg(a); return *this; }
   inline LogMessage &operator<<(uint a)
-    { stream->buf += QString::number(a); return *this; }
+    { if (stream) stream->buf += QString::number(a); return *this; }
   inline LogMessage arg(uint a)
-    { stream->buf = stream->buf.arg(a); return *this; }
+    { if (stream) stream->buf = stream->buf.arg(a); return *this; }
   inline LogMessage &operator<<(long a)
-    { stream->buf += QString::number(a); return *this; }
+    { if (stream) stream->buf += QString::number(a); return *this; }
   inline LogMessage arg(long a)
-    { stream->buf = stream->buf.arg(a); return *this; }
+    { if (stream) stream->buf = stream->buf.arg(a); return *this; }
   inline LogMessage &operator<<(ulong a)
-    { stream->buf += QString::number(a); return *this; }
+    { if (stream) stream->buf += QString::number(a); return *this; }
   inline LogMessage arg(ulong a)
-    { stream->buf = stream->buf.arg(a); return *this; }
+    { if (stream) stream->buf = stream->buf.arg(a); return *this; }
   inline LogMessage &operator<<(qlonglong a)
-    { stream->buf += QString::number(a); return *this; }
+    { if (stream) stream->buf += QString::number(a); return *this; }
   inline LogMessage arg(qlonglong a)
-    { stream->buf = stream->buf.arg(a); return *this; }
+    { if (stream) stream->buf = stream->buf.arg(a); return *this; }
   inline LogMessage &operator<<(qulonglong a)
-    { stream->buf += QString::number(a); return *this; }
+    { if (stream) stream->buf += QString::number(a); return *this; }
   inline LogMessage arg(qulonglong a)
-    { stream->buf = stream->buf.arg(a); return *this; }
+    { if (stream) stream->buf = stream->buf.arg(a); return *this; }
 };
 
 #endif
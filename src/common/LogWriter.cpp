@@ -0,0 +1,135 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file LogWriter.cpp
+** \brief Writes log messages to a file on a background thread
+*/
+
+#include "LogWriter.h"
+
+#include <QMutexLocker>
+#include <QTextStream>
+
+/** Format for log message timestamps. */
+#define TIMESTAMP_FMT   "MMM dd HH:mm:ss.zzz"
+/** Maximum time (in milliseconds) a message stays queued before the writer
+ * thread wakes up to write it. */
+#define WRITE_INTERVAL  100
+
+
+/** Constructor. */
+LogWriter::LogWriter(QFile *file)
+  : _file(file), _queue(0)
+{
+  _stopping = false;
+}
+
+/** Destructor. */
+LogWriter::~LogWriter()
+{
+  stop();
+}
+
+/** Queues the message <b>msg</b> with severity <b>level</b>. The message is
+ * pushed onto the front of a singly-linked stack with a compare-and-swap, so
+ * producers never wait on each other or on the writer. */
+void
+LogWriter::write(Log::LogLevel level, const QString &msg)
+{
+  Entry *entry = new Entry;
+  entry->time = QDateTime::currentDateTime();
+  entry->level = level;
+  entry->message = msg;
+
+  Entry *head;
+  do {
+    head = _queue;
+    entry->next = head;
+  } while (!_queue.testAndSetOrdered(head, entry));
+}
+
+/** Writes every queued message on the calling thread and flushes the log
+ * file. This is used before aborting on a fatal error. */
+void
+LogWriter::flush()
+{
+  writeQueued();
+}
+
+/** Writes every queued message and stops the writer thread. Messages queued
+ * after this returns are written by the next flush(). */
+void
+LogWriter::stop()
+{
+  _waitMutex.lock();
+  _stopping = true;
+  _waitCond.wakeOne();
+  _waitMutex.unlock();
+
+  wait();
+  writeQueued();
+
+  _waitMutex.lock();
+  _stopping = false;
+  _waitMutex.unlock();
+}
+
+/** Takes the whole queue in a single atomic exchange and writes it to the
+ * log file oldest message first. Since the consumer never removes individual
+ * entries, the stack is not subject to the ABA problem. */
+void
+LogWriter::writeQueued()
+{
+  QMutexLocker locker(&_writeMutex);
+
+  Entry *entry = _queue.fetchAndStoreOrdered(0);
+  if (!entry)
+    return;
+
+  /* The stack holds the newest message first, so reverse it */
+  Entry *oldest = 0;
+  while (entry) {
+    Entry *next = entry->next;
+    entry->next = oldest;
+    oldest = entry;
+    entry = next;
+  }
+
+  QTextStream out(_file);
+  for (entry = oldest; entry; entry = oldest) {
+    out << entry->time.toString(TIMESTAMP_FMT)
+        << " [" << Log::logLevelToString(entry->level) << "] "
+        << entry->message << '\n';
+    oldest = entry->next;
+    delete entry;
+  }
+  out.flush();
+  _file->flush();
+}
+
+/** Wakes up every WRITE_INTERVAL milliseconds and writes whatever has been
+ * queued in the meantime. */
+void
+LogWriter::run()
+{
+  bool stopping;
+
+  do {
+    _waitMutex.lock();
+    if (!_stopping)
+      _waitCond.wait(&_waitMutex, WRITE_INTERVAL);
+    stopping = _stopping;
+    _waitMutex.unlock();
+
+    writeQueued();
+  } while (!stopping);
+}
+
@@ -0,0 +1,78 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file LogWriter.h
+** \brief Writes log messages to a file on a background thread
+*/
+
+#ifndef _LOGWRITER_H
+#define _LOGWRITER_H
+
+#include "Log.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicPointer>
+#include <QDateTime>
+#include <QFile>
+
+
+/** A LogWriter owns the thread that writes Log messages to the log file.
+ * Any number of threads can queue messages without taking a lock: each
+ * message is pushed onto a lock-free stack, which the writer thread empties
+ * all at once and writes out in the order the messages were queued,
+ * flushing the file once per batch rather than once per message.
+ */
+class LogWriter : public QThread
+{
+public:
+  /** Constructor. Messages will be written to <b>file</b>, which must
+   * already be open and must outlive the writer. */
+  LogWriter(QFile *file);
+  /** Destructor. Writes any queued messages and stops the writer thread. */
+  ~LogWriter();
+
+  /** Queues the message <b>msg</b> with severity <b>level</b>. This never
+   * blocks and may be called from any thread. */
+  void write(Log::LogLevel level, const QString &msg);
+  /** Writes every queued message on the calling thread and flushes the log
+   * file. */
+  void flush();
+  /** Writes every queued message and stops the writer thread. */
+  void stop();
+
+protected:
+  /** Main thread implementation. */
+  void run();
+
+private:
+  /** A queued log message. */
+  struct Entry {
+    QDateTime time;      /**< Time the message was queued. */
+    Log::LogLevel level; /**< Severity of the message. */
+    QString message;     /**< Message text. */
+    Entry *next;         /**< Next older message in the queue. */
+  };
+
+  /** Removes every queued message and writes them to the log file. */
+  void writeQueued();
+
+  QFile *_file; /**< Log output destination. */
+  QAtomicPointer<Entry> _queue; /**< Most recently queued message. */
+  QMutex _writeMutex; /**< Serializes writes to <b>_file</b>. */
+  QMutex _waitMutex; /**< Protects <b>_stopping</b>. */
+  QWaitCondition _waitCond; /**< Wakes the writer thread early. */
+  bool _stopping; /**< Set when the writer thread should exit. */
+};
+
+#endif
+
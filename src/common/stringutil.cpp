@@ -252,35 +252,34 @@ string_parse_keyvals(const QString &str, bool *ok)
   while (i < len && str[i].isSpace())
     i++; /* Skip initial whitespace */
   while (i < len) {
-    QString key, val;
-    
+    int start = i;
     while (i < len && !str[i].isSpace() && str[i] != '=')
-      key.append(str[i++]);
+      i++;
+    QString key = str.mid(start, i - start);
       
     if (i < len && str[i] == '=') {
       if (++i < len && str[i] == '\"') {
         /* The value is wrapped in quotes */
-        val.append(str[i]);
+        start = i;
         while (++i < len) {
-          val.append(str[i]);
           if (str[i] == '\\') {
             if (++i == len)
               goto error;
-            val.append(str[i]);
           } else if (str[i] == '\"') {
             i++;
             break;
           } 
         }
-        val = string_unescape(val, &tmp_ok);
+        QString val = string_unescape(str.mid(start, i - start), &tmp_ok);
         if (!tmp_ok)
           goto error;
         keyvals.insert(key, val);
       } else {
         /* The value was not wrapped in quotes */
+        start = i;
         while (i < len && !str[i].isSpace())
-          val.append(str[i++]);
-        keyvals.insert(key, val);
+          i++;
+        keyvals.insert(key, str.mid(start, i - start));
       }
     } else {
       /* The key had no value */
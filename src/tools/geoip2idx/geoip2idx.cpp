@@ -0,0 +1,379 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+#include <QFile>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QTextStream>
+#include <QHostAddress>
+#include <stdlib.h>
+#include <string.h>
+
+#include "GeoIpIndexFormat.h"
+
+
+/** Maps lowercase country codes to their index in <b>countries</b>. */
+typedef QHash<QByteArray,quint32> CountryTable;
+
+/** Returns true if range <b>a</b> starts before range <b>b</b>. */
+bool
+range4_less_than(const GeoIpIndexRange4 &a, const GeoIpIndexRange4 &b)
+{
+  return (a.first < b.first);
+}
+
+/** Returns true if range <b>a</b> starts before range <b>b</b>. */
+bool
+range6_less_than(const GeoIpIndexRange6 &a, const GeoIpIndexRange6 &b)
+{
+  return (a.firstHigh < b.firstHigh
+            || (a.firstHigh == b.firstHigh && a.firstLow < b.firstLow));
+}
+
+/** Returns the index of the country with code <b>code</b>, adding it to
+ * <b>countries</b> (without coordinates) if it is not already known. */
+quint32
+country_index(const QByteArray &code, QList<GeoIpIndexCountry> *countries,
+              CountryTable *table)
+{
+  QByteArray cc = code.trimmed().toLower();
+  if (table->contains(cc))
+    return table->value(cc);
+
+  GeoIpIndexCountry country;
+  memset(&country, 0, sizeof(country));
+  country.code[0] = cc.at(0);
+  country.code[1] = cc.at(1);
+  country.latitude  = -180.0;
+  country.longitude = -180.0;
+
+  quint32 index = countries->size();
+  countries->append(country);
+  table->insert(cc, index);
+  return index;
+}
+
+/** Returns true if <b>code</b> looks like a usable two-letter country code.
+ * Tor uses "??" for address ranges with no known country. */
+bool
+is_valid_country_code(const QByteArray &code)
+{
+  QByteArray cc = code.trimmed();
+  return (cc.size() == 2 && cc != "??" && cc != "--");
+}
+
+/** Splits an IPv6 address into its high and low 64 bits. Returns false if
+ * <b>str</b> is not a valid IPv6 address. */
+bool
+parse_ipv6(const QByteArray &str, quint64 *high, quint64 *low)
+{
+  QHostAddress addr;
+  if (! addr.setAddress(QString::fromLatin1(str.trimmed()))
+        || addr.protocol() != QAbstractSocket::IPv6Protocol)
+    return false;
+
+  Q_IPV6ADDR ip = addr.toIPv6Address();
+  *high = *low = 0;
+  for (int i = 0; i < 8; i++) {
+    *high = (*high << 8) | ip[i];
+    *low  = (*low << 8) | ip[i+8];
+  }
+  return true;
+}
+
+/** Reads the country coordinates from <b>fname</b> into <b>countries</b>.
+ * Returns the number of entries read, or -1 if the file could not be read. */
+int
+load_coordinates(const QString &fname, QList<GeoIpIndexCountry> *countries,
+                 CountryTable *table)
+{
+  QFile file(fname);
+  if (! file.open(QIODevice::ReadOnly))
+    return -1;
+
+  int n = 0;
+  foreach (QByteArray line, file.readAll().split('\n')) {
+    bool ok1, ok2;
+    QList<QByteArray> parts = line.trimmed().split(',');
+    if (parts.size() < 3 || ! is_valid_country_code(parts[0]))
+      continue;
+    float latitude  = parts[1].toFloat(&ok1);
+    float longitude = parts[2].toFloat(&ok2);
+    if (! ok1 || ! ok2)
+      continue;
+
+    quint32 index = country_index(parts[0], countries, table);
+    (*countries)[index].latitude  = latitude;
+    (*countries)[index].longitude = longitude;
+    n++;
+  }
+  return n;
+}
+
+/** Reads Tor's IPv4 "geoip" file, whose lines have the form
+ * "INTIPLOW,INTIPHIGH,CC". Returns the number of lines skipped, or -1 if the
+ * file could not be read. */
+int
+load_ipv4(const QString &fname, QList<GeoIpIndexRange4> *ranges,
+          QList<GeoIpIndexCountry> *countries, CountryTable *table)
+{
+  QFile file(fname);
+  if (! file.open(QIODevice::ReadOnly))
+    return -1;
+
+  int skipped = 0;
+  foreach (QByteArray line, file.readAll().split('\n')) {
+    line = line.trimmed();
+    if (line.isEmpty() || line.startsWith('#'))
+      continue;
+
+    bool ok1, ok2;
+    QList<QByteArray> parts = line.split(',');
+    if (parts.size() < 3 || ! is_valid_country_code(parts[2])) {
+      skipped++;
+      continue;
+    }
+    GeoIpIndexRange4 range;
+    range.first = parts[0].toUInt(&ok1);
+    range.last  = parts[1].toUInt(&ok2);
+    if (! ok1 || ! ok2 || range.first > range.last) {
+      skipped++;
+      continue;
+    }
+    range.country = country_index(parts[2], countries, table);
+    ranges->append(range);
+  }
+  return skipped;
+}
+
+/** Reads Tor's "geoip6" file, whose lines have the form
+ * "IPV6LOW,IPV6HIGH,CC". Returns the number of lines skipped, or -1 if the
+ * file could not be read. */
+int
+load_ipv6(const QString &fname, QList<GeoIpIndexRange6> *ranges,
+          QList<GeoIpIndexCountry> *countries, CountryTable *table)
+{
+  QFile file(fname);
+  if (! file.open(QIODevice::ReadOnly))
+    return -1;
+
+  int skipped = 0;
+  foreach (QByteArray line, file.readAll().split('\n')) {
+    line = line.trimmed();
+    if (line.isEmpty() || line.startsWith('#'))
+      continue;
+
+    QList<QByteArray> parts = line.split(',');
+    if (parts.size() < 3 || ! is_valid_country_code(parts[2])) {
+      skipped++;
+      continue;
+    }
+    GeoIpIndexRange6 range;
+    memset(&range, 0, sizeof(range));
+    if (! parse_ipv6(parts[0], &range.firstHigh, &range.firstLow)
+          || ! parse_ipv6(parts[1], &range.lastHigh, &range.lastLow)) {
+      skipped++;
+      continue;
+    }
+    range.country = country_index(parts[2], countries, table);
+    ranges->append(range);
+  }
+  return skipped;
+}
+
+/** Sorts <b>ranges</b>, drops ranges that overlap an earlier one and merges
+ * adjacent ranges that belong to the same country. */
+void
+normalize_ipv4(QList<GeoIpIndexRange4> *ranges)
+{
+  qSort(ranges->begin(), ranges->end(), range4_less_than);
+
+  QList<GeoIpIndexRange4> out;
+  foreach (GeoIpIndexRange4 r, *ranges) {
+    if (! out.isEmpty()) {
+      GeoIpIndexRange4 &prev = out.last();
+      if (r.first <= prev.last)
+        continue;
+      if (r.country == prev.country && r.first == prev.last + 1) {
+        prev.last = r.last;
+        continue;
+      }
+    }
+    out.append(r);
+  }
+  *ranges = out;
+}
+
+/** Sorts <b>ranges</b>, drops ranges that overlap an earlier one and merges
+ * adjacent ranges that belong to the same country. */
+void
+normalize_ipv6(QList<GeoIpIndexRange6> *ranges)
+{
+  qSort(ranges->begin(), ranges->end(), range6_less_than);
+
+  QList<GeoIpIndexRange6> out;
+  foreach (GeoIpIndexRange6 r, *ranges) {
+    if (! out.isEmpty()) {
+      GeoIpIndexRange6 &prev = out.last();
+      if (r.firstHigh < prev.lastHigh
+            || (r.firstHigh == prev.lastHigh && r.firstLow <= prev.lastLow))
+        continue;
+
+      /* Compute prev.last + 1 with carry into the high word */
+      quint64 nextLow  = prev.lastLow + 1;
+      quint64 nextHigh = prev.lastHigh + (nextLow == 0 ? 1 : 0);
+      if (r.country == prev.country
+            && r.firstHigh == nextHigh && r.firstLow == nextLow) {
+        prev.lastHigh = r.lastHigh;
+        prev.lastLow  = r.lastLow;
+        continue;
+      }
+    }
+    out.append(r);
+  }
+  *ranges = out;
+}
+
+/** Pads <b>file</b> with zeros up to the next 8-byte boundary. */
+void
+write_padding(QFile *file)
+{
+  static const char zeros[8] = { 0 };
+  qint64 pos = file->pos();
+  file->write(zeros, GEOIP_INDEX_ALIGN(pos) - pos);
+}
+
+/** Writes the index to <b>fname</b>. Returns true on success. */
+bool
+write_index(const QString &fname, const QList<GeoIpIndexCountry> &countries,
+            const QList<GeoIpIndexRange4> &ipv4,
+            const QList<GeoIpIndexRange6> &ipv6)
+{
+  QFile file(fname);
+  if (! file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    return false;
+
+  GeoIpIndexHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, GEOIP_INDEX_MAGIC, 4);
+  header.byteOrder = GEOIP_INDEX_BYTE_ORDER;
+  header.version = GEOIP_INDEX_VERSION;
+  header.countryCount = countries.size();
+  header.ipv4Count = ipv4.size();
+  header.ipv6Count = ipv6.size();
+
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  write_padding(&file);
+  foreach (GeoIpIndexCountry c, countries)
+    file.write(reinterpret_cast<const char *>(&c), sizeof(c));
+  write_padding(&file);
+  foreach (GeoIpIndexRange4 r, ipv4)
+    file.write(reinterpret_cast<const char *>(&r), sizeof(r));
+  write_padding(&file);
+  foreach (GeoIpIndexRange6 r, ipv6)
+    file.write(reinterpret_cast<const char *>(&r), sizeof(r));
+
+  bool ok = (file.error() == QFile::NoError);
+  file.close();
+  return ok;
+}
+
+/** Display application usage and exit. */
+void
+print_usage_and_exit()
+{
+  QTextStream error(stderr);
+  error << "usage: geoip2idx [-q] -c <coordinates.csv> [-4 <geoip>] "
+           "[-6 <geoip6>] -o <outfile>\n";
+  error << "  -q (optional)        Quiet mode (errors are still displayed)\n";
+  error << "  -c <coordinates.csv> Country coordinates file\n";
+  error << "  -4 <geoip>           Tor's IPv4 geoip file\n";
+  error << "  -6 <geoip6>          Tor's IPv6 geoip6 file\n";
+  error << "  -o <outfile>         Output GeoIP index file\n";
+  error.flush();
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  QTextStream error(stderr);
+  QString coordFile, ipv4File, ipv6File, outFile;
+  bool quiet = false;
+
+  for (int i = 1; i < argc; i++) {
+    QString arg(argv[i]);
+    if (!arg.compare("-q", Qt::CaseInsensitive))
+      quiet = true;
+    else if (!arg.compare("-c", Qt::CaseInsensitive) && ++i < argc)
+      coordFile = argv[i];
+    else if (!arg.compare("-4", Qt::CaseInsensitive) && ++i < argc)
+      ipv4File = argv[i];
+    else if (!arg.compare("-6", Qt::CaseInsensitive) && ++i < argc)
+      ipv6File = argv[i];
+    else if (!arg.compare("-o", Qt::CaseInsensitive) && ++i < argc)
+      outFile = argv[i];
+    else
+      print_usage_and_exit();
+  }
+  if (coordFile.isEmpty() || outFile.isEmpty()
+        || (ipv4File.isEmpty() && ipv6File.isEmpty()))
+    print_usage_and_exit();
+
+  QList<GeoIpIndexCountry> countries;
+  QList<GeoIpIndexRange4> ipv4;
+  QList<GeoIpIndexRange6> ipv6;
+  CountryTable table;
+
+  /* Load the coordinates first so every known country has a location */
+  int n = load_coordinates(coordFile, &countries, &table);
+  if (n < 0) {
+    error << QString("Unable to read '%1'.\n").arg(coordFile);
+    return 1;
+  }
+
+  int skipped = 0;
+  if (! ipv4File.isEmpty()) {
+    n = load_ipv4(ipv4File, &ipv4, &countries, &table);
+    if (n < 0) {
+      error << QString("Unable to read '%1'.\n").arg(ipv4File);
+      return 1;
+    }
+    skipped += n;
+  }
+  if (! ipv6File.isEmpty()) {
+    n = load_ipv6(ipv6File, &ipv6, &countries, &table);
+    if (n < 0) {
+      error << QString("Unable to read '%1'.\n").arg(ipv6File);
+      return 1;
+    }
+    skipped += n;
+  }
+  normalize_ipv4(&ipv4);
+  normalize_ipv6(&ipv6);
+
+  if (! write_index(outFile, countries, ipv4, ipv6)) {
+    error << QString("Unable to write '%1'.\n").arg(outFile);
+    return 2;
+  }
+
+  if (!quiet) {
+    QTextStream results(stdout);
+    results << QString("Wrote %1 IPv4 ranges, %2 IPv6 ranges and %3 countries "
+                       "to %4 (%5 lines skipped).\n").arg(ipv4.size())
+                                                      .arg(ipv6.size())
+                                                      .arg(countries.size())
+                                                      .arg(outFile)
+                                                      .arg(skipped);
+  }
+  return 0;
+}
+
@@ -0,0 +1,276 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+#include <QDir>
+#include <QFile>
+#include <QMap>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+#include <stdlib.h>
+#include <string.h>
+
+#include "HelpIndexFormat.h"
+
+
+/** Positions of one term on each page containing it, by page index. */
+typedef QMap<quint32, QList<quint32> > TermPostings;
+/** Postings of every term, sorted by the term's text. */
+typedef QMap<QString, TermPostings> TermTable;
+
+/** Returns the character named by the HTML entity <b>name</b> (without the
+ * leading '&' and trailing ';'), or a null QChar if it is not known. */
+QChar
+decode_entity(const QString &name)
+{
+  static const struct {
+    const char *name;
+    ushort value;
+  } entities[] = {
+    { "amp",   '&' },    { "lt",    '<' },    { "gt",    '>' },
+    { "quot",  '"' },    { "apos",  '\'' },   { "nbsp",  ' ' },
+    { "auml",  0x00e4 }, { "ouml",  0x00f6 }, { "uuml",  0x00fc },
+    { "Auml",  0x00c4 }, { "Ouml",  0x00d6 }, { "Uuml",  0x00dc },
+    { "szlig", 0x00df }, { "eacute", 0x00e9 }, { "egrave", 0x00e8 },
+    { "agrave", 0x00e0 }, { "ccedil", 0x00e7 }, { "copy", 0x00a9 },
+    { 0, 0 }
+  };
+
+  if (name.startsWith("#")) {
+    bool ok;
+    uint value = (name.startsWith("#x", Qt::CaseInsensitive)
+                    ? name.mid(2).toUInt(&ok, 16) : name.mid(1).toUInt(&ok));
+    return ((ok && value <= 0xffff) ? QChar(ushort(value)) : QChar());
+  }
+  for (int i = 0; entities[i].name; i++) {
+    if (name == QLatin1String(entities[i].name))
+      return QChar(entities[i].value);
+  }
+  return QChar();
+}
+
+/** Returns the text of the HTML page <b>html</b>, without comments, tags,
+ * or the contents of script and style elements. Each tag is replaced by a
+ * space so words on either side of it are kept apart. */
+QString
+extract_text(const QString &html)
+{
+  QString text;
+  int i = 0;
+
+  text.reserve(html.length());
+  while (i < html.length()) {
+    QChar c = html.at(i);
+    if (c == QLatin1Char('<')) {
+      int end;
+      if (html.mid(i, 4) == QLatin1String("<!--")) {
+        end = html.indexOf("-->", i + 4);
+        end = (end < 0) ? html.length() : end + 3;
+      } else {
+        end = html.indexOf('>', i + 1);
+        end = (end < 0) ? html.length() : end + 1;
+
+        /* Skip to the end of elements whose contents aren't displayed */
+        QString tag = html.mid(i + 1, end - i - 1).toLower();
+        if (tag.startsWith("script") || tag.startsWith("style")) {
+          QString close = tag.startsWith("script") ? "</script" : "</style";
+          int j = html.indexOf(close, end, Qt::CaseInsensitive);
+          end = (j < 0) ? html.length() : html.indexOf('>', j) + 1;
+          if (end <= 0)
+            end = html.length();
+        }
+      }
+      text.append(QLatin1Char(' '));
+      i = end;
+    } else if (c == QLatin1Char('&')) {
+      int end = html.indexOf(';', i + 1);
+      QChar decoded = (end > i && end - i <= 10)
+                        ? decode_entity(html.mid(i + 1, end - i - 1))
+                        : QChar();
+      if (decoded.isNull()) {
+        text.append(c);
+        i++;
+      } else {
+        text.append(decoded);
+        i = end + 1;
+      }
+    } else {
+      text.append(c);
+      i++;
+    }
+  }
+  return text;
+}
+
+/** Adds the words of the help page <b>fname</b> to <b>terms</b> as page
+ * number <b>page</b>. Returns the number of words on the page, or -1 if it
+ * can't be read. */
+int
+index_page(const QString &fname, quint32 page, TermTable *terms)
+{
+  QFile file(fname);
+  if (! file.open(QIODevice::ReadOnly))
+    return -1;
+
+  QStringList words = help_index_words(extract_text(
+                        QString::fromUtf8(file.readAll())));
+  for (int i = 0; i < words.size(); i++)
+    (*terms)[words.at(i)][page].append(i);
+  return words.size();
+}
+
+/** Appends the UTF-16 code units of <b>str</b> to <b>strings</b> and
+ * returns the offset at which they start. */
+quint32
+add_string(const QString &str, QList<ushort> *strings)
+{
+  quint32 offset = strings->size();
+  for (int i = 0; i < str.length(); i++)
+    strings->append(str.at(i).unicode());
+  return offset;
+}
+
+/** Writes the index of <b>pages</b>, whose word counts are in
+ * <b>wordCounts</b>, to <b>fname</b>. Returns true on success. */
+bool
+write_index(const QString &fname, const QStringList &pages,
+            const QList<quint32> &wordCounts, const TermTable &terms)
+{
+  QList<HelpIndexPage> pageTable;
+  QList<HelpIndexTerm> termTable;
+  QList<HelpIndexPosting> postings;
+  QList<quint32> positions;
+  QList<ushort> strings;
+
+  for (int i = 0; i < pages.size(); i++) {
+    HelpIndexPage p;
+    p.name = add_string(pages.at(i), &strings);
+    p.nameLength = pages.at(i).length();
+    p.wordCount = wordCounts.at(i);
+    pageTable.append(p);
+  }
+  for (TermTable::const_iterator t = terms.constBegin();
+       t != terms.constEnd(); ++t) {
+    HelpIndexTerm term;
+    term.text = add_string(t.key(), &strings);
+    term.textLength = t.key().length();
+    term.firstPosting = postings.size();
+    term.postingCount = t.value().size();
+    termTable.append(term);
+
+    for (TermPostings::const_iterator p = t.value().constBegin();
+         p != t.value().constEnd(); ++p) {
+      HelpIndexPosting posting;
+      posting.page = p.key();
+      posting.firstPosition = positions.size();
+      posting.positionCount = p.value().size();
+      postings.append(posting);
+      positions += p.value();
+    }
+  }
+
+  QFile file(fname);
+  if (! file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    return false;
+
+  HelpIndexHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, HELP_INDEX_MAGIC, 4);
+  header.byteOrder = HELP_INDEX_BYTE_ORDER;
+  header.version = HELP_INDEX_VERSION;
+  header.pageCount = pageTable.size();
+  header.termCount = termTable.size();
+  header.postingCount = postings.size();
+  header.positionCount = positions.size();
+  header.stringCount = strings.size();
+
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  foreach (HelpIndexPage p, pageTable)
+    file.write(reinterpret_cast<const char *>(&p), sizeof(p));
+  foreach (HelpIndexTerm t, termTable)
+    file.write(reinterpret_cast<const char *>(&t), sizeof(t));
+  foreach (HelpIndexPosting p, postings)
+    file.write(reinterpret_cast<const char *>(&p), sizeof(p));
+  foreach (quint32 pos, positions)
+    file.write(reinterpret_cast<const char *>(&pos), sizeof(pos));
+  foreach (ushort c, strings)
+    file.write(reinterpret_cast<const char *>(&c), sizeof(c));
+
+  bool ok = (file.error() == QFile::NoError);
+  file.close();
+  return ok;
+}
+
+/** Display application usage and exit. */
+void
+print_usage_and_exit()
+{
+  QTextStream error(stderr);
+  error << "usage: help2idx [-q] -o <outfile> <helpdir>\n";
+  error << "  -q (optional)  Quiet mode (errors are still displayed)\n";
+  error << "  -o <outfile>   Output help search index file\n";
+  error << "  <helpdir>      Directory of one language's help pages\n";
+  error.flush();
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  QTextStream error(stderr);
+  QString helpDir, outFile;
+  bool quiet = false;
+
+  for (int i = 1; i < argc; i++) {
+    QString arg(argv[i]);
+    if (!arg.compare("-q", Qt::CaseInsensitive))
+      quiet = true;
+    else if (!arg.compare("-o", Qt::CaseInsensitive) && ++i < argc)
+      outFile = argv[i];
+    else if (helpDir.isEmpty() && !arg.startsWith("-"))
+      helpDir = arg;
+    else
+      print_usage_and_exit();
+  }
+  if (helpDir.isEmpty() || outFile.isEmpty())
+    print_usage_and_exit();
+
+  QDir dir(helpDir);
+  QStringList pages = dir.entryList(QStringList() << "*.html", QDir::Files,
+                                    QDir::Name);
+  QList<quint32> wordCounts;
+  TermTable terms;
+
+  for (int i = 0; i < pages.size(); i++) {
+    int n = index_page(dir.filePath(pages.at(i)), i, &terms);
+    if (n < 0) {
+      error << QString("Unable to read '%1'.\n")
+                                          .arg(dir.filePath(pages.at(i)));
+      return 1;
+    }
+    wordCounts.append(n);
+  }
+
+  if (! write_index(outFile, pages, wordCounts, terms)) {
+    error << QString("Unable to write '%1'.\n").arg(outFile);
+    return 2;
+  }
+
+  if (!quiet) {
+    QTextStream results(stdout);
+    results << QString("Wrote %1 terms from %2 pages to %3.\n")
+                                                      .arg(terms.size())
+                                                      .arg(pages.size())
+                                                      .arg(outFile);
+  }
+  return 0;
+}
+
@@ -28,9 +28,10 @@
 
 
 /** Default constructor. */
-ControlConnection::ControlConnection(ControlMethod::Method method, TorEvents *events)
+ControlConnection::ControlConnection(ControlMethod::Method method,
+                                     TorEventWorker *eventWorker)
 {
-  _events = events;
+  _eventWorker = eventWorker;
   _status = Unset;
   _sock = 0;
   _sendWaiter = new SendCommandEvent::SendWaiter();
@@ -135,6 +136,8 @@ ControlConnection::disconnect()
 void
 ControlConnection::onConnected()
 {
+  /* Latencies from a previous connection say nothing about this one */
+  _latency.clear();
   setStatus(Connected);
   emit connected();
 }
@@ -239,32 +242,45 @@ bool
 ControlConnection::send(const ControlCommand &cmd,
                         ControlReply &reply, QString *errmsg)
 {
-  bool result = false;
-  QString errstr;
+  PendingReply *pending = sendAsync(cmd);
+  bool result = pending->waitForFinished();
 
-  _recvMutex.lock();
-  if (send(cmd, &errstr)) {
-    /* Create and enqueue a new receive waiter */
-    ReceiveWaiter *w = new ReceiveWaiter();
-    _recvQueue.enqueue(w);
-    _recvMutex.unlock();
-
-    /* Wait for and get the result, clean up, and return */
-    result = w->getResult(&reply, &errstr);
-    if (!result)
-      tc::error("Failed to receive control reply: %1").arg(errstr);
-    delete w;
+  if (result) {
+    reply = pending->reply();
   } else {
-    tc::error("Failed to send control command (%1): %2").arg(cmd.keyword())
-                                                        .arg(errstr);
-    _recvMutex.unlock();
+    tc::error("Failed to receive control reply (%1): %2").arg(cmd.keyword())
+                                              .arg(pending->errorString());
+    if (errmsg)
+      *errmsg = pending->errorString();
   }
-
-  if (!result && errmsg)
-    *errmsg = errstr;
+  delete pending;
   return result;
 }
 
+/** Sends a control command to Tor without waiting for the command to be
+ * written or for Tor's reply. The PendingReply is queued in the same order
+ * the command is handed to the control socket, which is the order in which
+ * Tor will answer. */
+PendingReply*
+ControlConnection::sendAsync(const ControlCommand &cmd)
+{
+  PendingReply *pending = new PendingReply();
+
+  QMutexLocker locker(&_connMutex);
+  if (!_sock || !_sock->isConnected()) {
+    pending->setResult(false, ControlReply(),
+                       tr("Control socket is not connected."));
+    return pending;
+  }
+
+  _recvMutex.lock();
+  _recvQueue.enqueue(pending);
+  QCoreApplication::postEvent(_sock, new SendCommandEvent(cmd));
+  _recvMutex.unlock();
+
+  return pending;
+}
+
 /** Sends a control command to Tor and returns true if the command was sent
  * successfully. Otherwise, returns false and <b>*errmsg</b> (if supplied)
  * will be set. */
@@ -287,27 +303,33 @@ void
 ControlConnection::onReadyRead()
 {
   QMutexLocker locker(&_connMutex);
-  ReceiveWaiter *waiter;
+  QList<ControlReply> events;
+  PendingReply *pending;
   QString errmsg;
  
   while (_sock->canReadLine()) {
     ControlReply reply;
     if (_sock->readReply(reply, &errmsg)) {
       if (reply.getStatus() == "650") {
-        /* Asynchronous event message */
-        tc::debug("Control Event: %1").arg(reply.toString());
+        /* Asynchronous event message. Parsing it is left to the event
+         * worker, so replies to commands that arrive behind a burst of
+         * events are not held up. */
+        if (tc::isDebugEnabled())
+          tc::debug("Control Event: %1").arg(reply.toString());
         
-        if (_events) {
-          _events->handleEvent(reply);
+        if (_eventWorker) {
+          events << reply;
         }
       } else {
         /* Response to a previous command */
-        tc::debug("Control Reply: %1").arg(reply.toString());
+        if (tc::isDebugEnabled())
+          tc::debug("Control Reply: %1").arg(reply.toString());
         
         _recvMutex.lock();
         if (!_recvQueue.isEmpty()) {
-          waiter = _recvQueue.dequeue();
-          waiter->setResult(true, reply);
+          pending = _recvQueue.dequeue();
+          _latency.record(pending->elapsed());
+          pending->setResult(true, reply);
         }
         _recvMutex.unlock();
       }
@@ -315,6 +337,12 @@ ControlConnection::onReadyRead()
       tc::error("Unable to read control reply: %1").arg(errmsg);
     }
   }
+  locker.unlock();
+
+  /* Hand the events over without holding the socket mutex, so commands can
+   * be sent while the worker's queue is busy */
+  if (!events.isEmpty())
+    _eventWorker->enqueue(events);
 }
 
 /** Main thread implementation. Creates and connects a control socket, then
@@ -342,7 +370,7 @@ ControlConnection::run()
                    Qt::DirectConnection);
 
   _connMutex.unlock();
-  
+
   /* Attempt to connect to Tor */
   connect();
   tc::debug("Starting control connection event loop.");
@@ -363,50 +391,10 @@ ControlConnection::run()
 
   _recvMutex.lock();
   while (!_recvQueue.isEmpty()) {
-    ReceiveWaiter *w = _recvQueue.dequeue();
-    w->setResult(false, ControlReply(), 
-                 tr("Control socket is not connected."));
+    PendingReply *pending = _recvQueue.dequeue();
+    pending->setResult(false, ControlReply(),
+                       tr("Control socket is not connected."));
   }
   _recvMutex.unlock();
 }
 
-
-/*
- * ControlConnection::ReceiveWaiter
- */
-/** Waits for and gets the reply from a control command. */
-bool 
-ControlConnection::ReceiveWaiter::getResult(ControlReply *reply, 
-                                            QString *errmsg)
-{
-  forever {
-    _mutex.lock();
-    if (_status == Waiting) {
-      _waitCond.wait(&_mutex);
-      _mutex.unlock();
-    } else {
-      _mutex.unlock();
-      break;
-    }
-  }
-  if (errmsg) {
-    *errmsg = _errmsg;
-  }
-  *reply = _reply;
-  return (_status == Success);
-}
-
-/** Sets the result and reply from a control command. */
-void 
-ControlConnection::ReceiveWaiter::setResult(bool success, 
-                                            const ControlReply &reply, 
-                                            const QString &errmsg)
-{
-  _mutex.lock();
-  _status = (success ? Success : Failed);
-  _reply = reply; 
-  _errmsg = errmsg;
-  _mutex.unlock();
-  _waitCond.wakeAll();
-}
-
@@ -20,6 +20,9 @@
 #include "ControlSocket.h"
 #include "TorEvents.h"
 #include "SendCommandEvent.h"
+#include "PendingReply.h"
+#include "TorEventWorker.h"
+#include "LatencyHistogram.h"
 
 #include <QThread>
 #include <QMutex>
@@ -43,8 +46,10 @@ public:
     Connected      /**< Control connection established.      */
   };
 
-  /** Default constructor. */
-  ControlConnection(ControlMethod::Method method, TorEvents *events = 0);
+  /** Default constructor. Asynchronous events are queued on
+   * <b>eventWorker</b>, if given, which remains owned by the caller. */
+  ControlConnection(ControlMethod::Method method,
+                    TorEventWorker *eventWorker = 0);
   /** Destructor. */
   ~ControlConnection();
 
@@ -64,6 +69,15 @@ public:
   bool send(const ControlCommand &cmd, ControlReply &reply, QString *errmsg = 0);
   /** Sends a control command to Tor and does not wait for a reply. */
   bool send(const ControlCommand &cmd, QString *errmsg = 0);
+  /** Sends a control command to Tor without blocking and returns a
+   * PendingReply that will be completed when Tor's reply arrives. Any number
+   * of commands may be in flight at once. If the command could not be sent,
+   * the returned PendingReply will already be finished. The caller takes
+   * ownership of the returned object. */
+  PendingReply* sendAsync(const ControlCommand &cmd);
+  /** Returns a histogram of the time between queueing each command and
+   * reading Tor's reply to it, since the connection was last opened. */
+  LatencyHistogram* latency() { return &_latency; }
 
 signals:
   /** Emitted when a control connection has been established. */
@@ -96,36 +110,20 @@ private:
   ControlSocket* _sock; /**< Socket used to communicate with Tor. */
   ControlMethod::Method _method; /** Method used to communicate with Tor. */
   QString _path; /**< Path to the socket */
-  TorEvents* _events; /**< Dispatches asynchronous events from Tor. */
+  TorEventWorker* _eventWorker; /**< Dispatches asynchronous events from
+                                     Tor on a thread of its own. */
+  LatencyHistogram _latency; /**< Command round-trip times. */
   Status _status; /**< Status of the control connection. */
   QHostAddress _addr; /**< Address of Tor's control interface. */
   quint16 _port; /**< Port of Tor's control interface. */
   QMutex _connMutex; /**< Mutex around the control socket. */
-  QMutex _recvMutex; /**< Mutex around the queue of ReceiveWaiters. */
+  QMutex _recvMutex; /**< Mutex around the queue of PendingReplys. */
   QMutex _statusMutex; /**< Mutex around the connection status value. */
   int _connectAttempt; /**< How many times we've tried to connect to Tor while
                             waiting for Tor to start. */
   QTimer* _connectTimer; /**< Timer used to delay connect attempts. */
 
-  /** Private class used to wait for a response to a control command. */
-  class ReceiveWaiter {
-    public:
-      /** Default constructor. */
-      ReceiveWaiter() { _status = Waiting; }
-      /** Waits for and gets the reply from a control command. */
-      bool getResult(ControlReply *reply, QString *errmsg = 0);
-      /** Sets the result and reply from a control command. */
-      void setResult(bool success, const ControlReply &reply, 
-                     const QString &errmsg = QString());
-    private:
-      /** Status of the receive waiter. */
-      enum ReceiveStatus { Waiting, Failed, Success } _status;
-      ControlReply _reply; /**< Reply to a previous command. */
-      QMutex _mutex; /**< Mutex around the wait condition. */
-      QWaitCondition _waitCond; /**< Waits for a control rpely. */
-      QString _errmsg; /**< Error message if the reply fails. */
-  };
-  QQueue<ReceiveWaiter *> _recvQueue; /**< Objects waiting for a reply. */
+  QQueue<PendingReply *> _recvQueue; /**< Commands waiting for a reply. */
   SendCommandEvent::SendWaiter* _sendWaiter;
 };
 
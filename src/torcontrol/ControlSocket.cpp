@@ -19,6 +19,9 @@
 
 #include "stringutil.h"
 
+#include <ctype.h>
+#include <string.h>
+
 /** Timeout reads in 250ms. We can set this to a short value because if there
 * isn't any data to read, we want to return anyway. */
 #define READ_TIMEOUT  250
@@ -29,6 +32,7 @@ ControlSocket::ControlSocket(ControlMethod::Method method)
 {
   _tcpSocket = new QTcpSocket();
   _localSocket = new QLocalSocket();
+  _bufferPos = 0;
   _method = method;
   switch(_method) {
     case ControlMethod::Port:
@@ -92,10 +96,14 @@ ControlSocket::disconnectFromServer()
   _localSocket->disconnectFromServer();
 }
 
-/** Interface to QTcpSocket::canReadLine */
+/** Returns true if a complete line is waiting in either our own receive
+ * buffer or the socket's. */
 bool
 ControlSocket::canReadLine()
 {
+  if (memchr(_buffer.constData() + _bufferPos, '\n',
+             _buffer.size() - _bufferPos))
+    return true;
   return _socket->canReadLine();
 }
 
@@ -145,8 +153,15 @@ ControlSocket::customEvent(QEvent *event)
 
     QString errmsg;
     bool result = sendCommand(sce->command(), &errmsg);
-    if (sce->waiter())
+    if (sce->waiter()) {
       sce->waiter()->setResult(result, errmsg);
+    } else if (! result && isConnected()) {
+      /* Nobody is waiting to hear about this failure, but a reply has
+       * already been queued for this command. Replies can no longer be
+       * matched to the commands they answer, so drop the connection. */
+      tc::error("Closing control connection: %1").arg(errmsg);
+      _socket->close();
+    }
     sce->accept();
   }
 }
@@ -167,10 +182,12 @@ ControlSocket::sendCommand(ControlCommand cmd, QString *errmsg)
   
   /* Format the control command */
   QString strCmd = cmd.toString();
-  tc::debug("Control Command: %1").arg(strCmd.trimmed());
+  if (tc::isDebugEnabled())
+    tc::debug("Control Command: %1").arg(strCmd.trimmed());
 
   /* Attempt to send the command to Tor */
-  if (_socket->write(strCmd.toLocal8Bit()) != strCmd.length()) {
+  QByteArray data = strCmd.toLocal8Bit();
+  if (_socket->write(data) != data.length()) {
     return err(errmsg, tr("Error sending control command. [%1]")
                                             .arg(_socket->errorString()));
   }
@@ -198,90 +215,114 @@ ControlSocket::sendCommand(ControlCommand cmd, QString *errmsg)
  *    ReplyLine = StatusCode [ SP ReplyText ]  CRLF
  *    ReplyText = XXXX
  *    StatusCode = XXiX
+ *
+ * Lines are located directly in the raw receive buffer. Only the status and
+ * message of each ReplyLine are converted to QStrings here; the data portion
+ * is copied out as a single block and decoded only if somebody asks for it.
  */
 bool
 ControlSocket::readReply(ControlReply &reply, QString *errmsg)
 {
-  QChar c;
-  QString line;
+  char c;
+  int start, len;
 
   if (!isConnected()) {
     return false;
   }
 
+  /* Drop whatever we have already parsed, but don't bother shifting the
+   * buffer around unless that frees up at least half of it. */
+  if (_bufferPos >= _buffer.size()) {
+    _buffer.clear();
+    _bufferPos = 0;
+  } else if (_bufferPos > _buffer.size() / 2) {
+    _buffer.remove(0, _bufferPos);
+    _bufferPos = 0;
+  }
+
   /* The implementation below is (loosely) based on the Java control library
    * from Tor */
   do {
     /* Read a line of the response */
-    if (!readLine(line, errmsg)) {
+    if (!readLine(start, len, errmsg)) {
       return false;
     }
-    
-    if (line.length() < 4) {
-      return err(errmsg, tr("Invalid control reply. [%1]").arg(line));
+
+    const char *line = _buffer.constData() + start;
+    if (len < 4) {
+      return err(errmsg, tr("Invalid control reply. [%1]")
+                           .arg(QString::fromLocal8Bit(line, len)));
     }
 
     /* Parse the status and message */
-    ReplyLine replyLine(line.mid(0, 3), line.mid(4));
-    c = line.at(3);
+    ReplyLine replyLine(QString::fromLatin1(line, 3),
+                        QString::fromLocal8Bit(line + 4, len - 4));
+    c = line[3];
 
     /* If the reply line contains data, then parse out the data up until the
      * trailing CRLF "." CRLF */
-    if (c == QChar('+') &&
-        !line.startsWith("250+PROTOCOLINFO")) {
+    if (c == '+' &&
+        !(len >= 16 && !qstrncmp(line, "250+PROTOCOLINFO", 16))) {
         /* XXX The second condition above is a hack to deal with Tor
          * 0.2.0.5-alpha that gives a malformed PROTOCOLINFO reply. This
          * should be removed once that version of Tor is sufficiently dead. */
+      int dataStart = _bufferPos;
+      int dataEnd   = _bufferPos;
       while (true) {
-        if (!readLine(line, errmsg)) {
+        if (!readLine(start, len, errmsg)) {
           return false;
         }
-        if (line.trimmed() == ".") {
+        line = _buffer.constData() + start;
+        while (len > 0 && isspace((unsigned char)line[0])) {
+          line++;
+          len--;
+        }
+        while (len > 0 && isspace((unsigned char)line[len-1])) {
+          len--;
+        }
+        if (len == 1 && line[0] == '.') {
           break;
         }
-        replyLine.appendData(line);
+        dataEnd = _bufferPos;
       }
+      replyLine.setRawData(_buffer.mid(dataStart, dataEnd - dataStart));
     }
     reply.appendLine(replyLine);
-  } while (c != QChar(' '));
-  return true;
-}
-
-/** Reads line data, one chunk at a time, until a newline character is
- * encountered. */
-bool
-ControlSocket::readLineData(QString &line, QString *errmsg)
-{
-  char buffer[1024];  /* Read in 1024 byte chunks at a time */
-  int bytesRecv = _socket->readLine(buffer, 1024);
-  while (bytesRecv != -1) {
-    line.append(QString::fromLocal8Bit(buffer, bytesRecv));
-    if (buffer[bytesRecv-1] == '\n') {
-      break;
-    }
-    bytesRecv = _socket->readLine(buffer, 1024);
-  }
-  if (bytesRecv == -1) {
-    return err(errmsg, _socket->errorString());
-  }
+  } while (c != ' ');
   return true;
 }
 
 /** Reads a line of data from the socket and returns true if successful or
  * false if an error occurred while waiting for a line of data to become
- * available. */
+ * available. On success, <b>start</b> and <b>length</b> are set to the
+ * position of the line in the receive buffer, not including its line
+ * ending. */
 bool
-ControlSocket::readLine(QString &line, QString *errmsg)
+ControlSocket::readLine(int &start, int &length, QString *errmsg)
 {
-  /* Make sure we have data to read before attempting anything. Note that this
-   * essentially makes our socket a blocking socket */
-  while (!_socket->canReadLine()) {
+  const char *eol;
+
+  /* Make sure we have a complete line to read before attempting anything.
+   * Note that this essentially makes our socket a blocking socket */
+  forever {
+    eol = (const char *)memchr(_buffer.constData() + _bufferPos, '\n',
+                               _buffer.size() - _bufferPos);
+    if (eol)
+      break;
     if (!isConnected()) {
       return err(errmsg, tr("Socket disconnected while attempting "
                             "to read a line of data."));
     }
-    _socket->waitForReadyRead(READ_TIMEOUT);
+    if (!_socket->bytesAvailable())
+      _socket->waitForReadyRead(READ_TIMEOUT);
+    _buffer.append(_socket->readAll());
   }
-  line.clear();
-  return readLineData(line, errmsg);
+
+  start  = _bufferPos;
+  length = (int)(eol - _buffer.constData()) - start;
+  _bufferPos = start + length + 1;
+  if (length > 0 && _buffer.at(start + length - 1) == '\r')
+    length--;
+  return true;
 }
+
@@ -67,16 +67,17 @@ protected:
   /** Processes custom events sent to this object (e.g. SendCommandEvents)
    * from other threads. */
   void customEvent(QEvent *event);
-  /** Reads line data off the socket in chunks. */
-  bool readLineData(QString &line, QString *errmsg = 0);
-  /** Reads a line of data from the socket (blocking) */
-  bool readLine(QString &line, QString *errmsg = 0);
+  /** Reads a line of data from the socket into the receive buffer (blocking)
+   * and returns its offset and length, excluding the trailing CRLF. */
+  bool readLine(int &start, int &length, QString *errmsg = 0);
 
 private:
   QTcpSocket *_tcpSocket; /**< Socket used in the connection */
   QLocalSocket *_localSocket; /**< Socket used in the connection */
   QIODevice *_socket; /**< Abstract pointer to transparently use both sockets */
   ControlMethod::Method _method;
+  QByteArray _buffer; /**< Bytes read from the socket but not yet parsed. */
+  int _bufferPos; /**< Offset of the first unparsed byte in _buffer. */
 };
 
 #endif
@@ -0,0 +1,174 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file DirectoryParser.cpp
+** \brief Helpers for parsing network status and descriptor documents
+*/
+
+#include "DirectoryParser.h"
+
+
+/** Finds up to <b>max</b> space-separated tokens in <b>line</b>, starting
+ * at <b>pos</b>. Returns the number of tokens found. */
+int
+dir_split_tokens(const QString &line, int pos, int *starts, int *lens,
+                 int max)
+{
+  const QChar *data = line.constData();
+  int len = line.length();
+  int n = 0;
+
+  while (n < max) {
+    while (pos < len && data[pos] == QLatin1Char(' '))
+      pos++;
+    if (pos >= len)
+      break;
+    starts[n] = pos;
+    while (pos < len && data[pos] != QLatin1Char(' '))
+      pos++;
+    lens[n] = pos - starts[n];
+    n++;
+  }
+  return n;
+}
+
+/** Parses the <b>len</b> decimal digits at <b>pos</b> in <b>line</b>. */
+quint64
+dir_parse_uint(const QString &line, int pos, int len, bool *ok)
+{
+  const QChar *data = line.constData() + pos;
+  quint64 value = 0;
+
+  if (len <= 0 || pos + len > line.length()) {
+    if (ok)
+      *ok = false;
+    return 0;
+  }
+  for (int i = 0; i < len; i++) {
+    ushort c = data[i].unicode();
+    if (c < '0' || c > '9') {
+      if (ok)
+        *ok = false;
+      return 0;
+    }
+    value = value * 10 + (c - '0');
+  }
+  if (ok)
+    *ok = true;
+  return value;
+}
+
+/** Returns the value of the base64 digit <b>c</b>, or -1. */
+static inline int
+base64_value(ushort c)
+{
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A';
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 26;
+  if (c >= '0' && c <= '9')
+    return c - '0' + 52;
+  if (c == '+')
+    return 62;
+  if (c == '/')
+    return 63;
+  return -1;
+}
+
+/** Decodes the <b>len</b> base64 characters at <b>pos</b> in <b>line</b>
+ * straight into uppercase hexadecimal, allocating only the result. */
+QString
+dir_base64_to_base16(const QString &line, int pos, int len)
+{
+  static const char hexDigits[] = "0123456789ABCDEF";
+  quint32 bits = 0;
+  int nbits = 0;
+
+  /* Check the bounds before reading anything, padding included */
+  if (pos < 0 || len <= 0 || pos + len > line.length())
+    return QString();
+  const QChar *data = line.constData() + pos;
+  while (len > 0 && data[len-1] == QLatin1Char('='))
+    len--;
+  if (len <= 0)
+    return QString();
+
+  /* Every 4 base64 digits make 3 bytes; leftover bits are dropped */
+  QString hex;
+  hex.resize(2 * ((len * 6) / 8));
+  QChar *out = hex.data();
+  for (int i = 0; i < len; i++) {
+    int value = base64_value(data[i].unicode());
+    if (value < 0)
+      return QString();
+    bits = (bits << 6) | value;
+    nbits += 6;
+    if (nbits >= 8) {
+      nbits -= 8;
+      quint8 byte = quint8(bits >> nbits);
+      *out++ = QLatin1Char(hexDigits[byte >> 4]);
+      *out++ = QLatin1Char(hexDigits[byte & 0xf]);
+    }
+  }
+  return hex;
+}
+
+/** Parses a "YYYY-MM-DD" date at <b>datePos</b> and an "HH:MM:SS" time at
+ * <b>timePos</b> in <b>line</b>, without the format string interpretation
+ * QDateTime::fromString() does on every call. */
+QDateTime
+dir_parse_time(const QString &line, int datePos, int timePos)
+{
+  const QChar *date = line.constData() + datePos;
+  const QChar *time = line.constData() + timePos;
+  bool ok[6];
+
+  if (datePos + 10 > line.length() || timePos + 8 > line.length()
+        || date[4] != QLatin1Char('-') || date[7] != QLatin1Char('-')
+        || time[2] != QLatin1Char(':') || time[5] != QLatin1Char(':'))
+    return QDateTime();
+
+  QDate d(int(dir_parse_uint(line, datePos, 4, &ok[0])),
+          int(dir_parse_uint(line, datePos+5, 2, &ok[1])),
+          int(dir_parse_uint(line, datePos+8, 2, &ok[2])));
+  QTime t(int(dir_parse_uint(line, timePos, 2, &ok[3])),
+          int(dir_parse_uint(line, timePos+3, 2, &ok[4])),
+          int(dir_parse_uint(line, timePos+6, 2, &ok[5])));
+  for (int i = 0; i < 6; i++) {
+    if (! ok[i])
+      return QDateTime();
+  }
+  return QDateTime(d, t);
+}
+
+/** Splits <b>lines</b> into at most <b>max</b> ranges of roughly equal
+ * size. Each range but the first is moved forward to start at the next line
+ * beginning with <b>keyword</b>, so no record is split between two
+ * ranges. */
+QList<QPair<int,int> >
+dir_split_records(const QStringList &lines, const QString &keyword, int max)
+{
+  QList<QPair<int,int> > ranges;
+  int len = lines.size();
+  int begin = 0;
+
+  if (max < 1)
+    max = 1;
+  for (int i = 1; i <= max && begin < len; i++) {
+    int end = (i == max) ? len : qMax(begin + 1, int(qint64(len) * i / max));
+    while (end < len && ! lines.at(end).startsWith(keyword))
+      end++;
+    ranges << qMakePair(begin, end);
+    begin = end;
+  }
+  return ranges;
+}
+
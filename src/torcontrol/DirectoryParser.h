@@ -0,0 +1,132 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file DirectoryParser.h
+** \brief Helpers for parsing network status and descriptor documents
+*/
+
+#ifndef _DIRECTORYPARSER_H
+#define _DIRECTORYPARSER_H
+
+#include <QThread>
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QList>
+#include <QPair>
+
+/** Documents with fewer lines than this are parsed on the calling thread,
+ * since starting a thread would cost more than it saves. */
+#define DIR_PARALLEL_MIN_LINES  8192
+
+
+/** Finds up to <b>max</b> space-separated tokens in <b>line</b>, starting
+ * at <b>pos</b>, and stores the offset and length of each in <b>starts</b>
+ * and <b>lens</b>. Runs of spaces are skipped. Returns the number of tokens
+ * found. */
+int dir_split_tokens(const QString &line, int pos, int *starts, int *lens,
+                     int max);
+
+/** Parses the <b>len</b> decimal digits at <b>pos</b> in <b>line</b>.
+ * Sets <b>ok</b> to false if they are not all digits or if there are
+ * none. */
+quint64 dir_parse_uint(const QString &line, int pos, int len, bool *ok = 0);
+
+/** Decodes the <b>len</b> base64 characters at <b>pos</b> in <b>line</b>
+ * and returns the bytes as an uppercase hexadecimal string, as
+ * base16_encode() would. Trailing '=' padding is optional. Returns an empty
+ * string if the characters are not valid base64. */
+QString dir_base64_to_base16(const QString &line, int pos, int len);
+
+/** Parses a "YYYY-MM-DD" date at <b>datePos</b> and an "HH:MM:SS" time at
+ * <b>timePos</b> in <b>line</b>. Returns an invalid QDateTime if either
+ * can't be parsed. */
+QDateTime dir_parse_time(const QString &line, int datePos, int timePos);
+
+/** Splits <b>lines</b> into at most <b>max</b> ranges of roughly equal
+ * size, each starting at a line that begins with <b>keyword</b> (except the
+ * first, which starts at line 0). Each range is returned as a pair of the
+ * first line and one past the last line. */
+QList<QPair<int,int> > dir_split_records(const QStringList &lines,
+                                         const QString &keyword, int max);
+
+
+/** A DirectoryParseThread runs a parse function over one range of lines of
+ * a directory document. */
+template <class T>
+class DirectoryParseThread : public QThread
+{
+public:
+  /** Parses the records in lines <b>begin</b> to <b>end</b>-1 of
+   * <b>lines</b> and appends them to <b>result</b>. */
+  typedef void (*ParseFunction)(const QStringList &lines, int begin,
+                                int end, T *result);
+
+  /** Constructor. */
+  DirectoryParseThread(ParseFunction parse, const QStringList &lines,
+                       const QPair<int,int> &range)
+    : _parse(parse), _lines(lines), _range(range) {}
+
+  /** Returns the parsed records. Only valid after the thread finished. */
+  const T& result() const { return _result; }
+
+protected:
+  /** Main thread implementation. */
+  void run() { _parse(_lines, _range.first, _range.second, &_result); }
+
+private:
+  ParseFunction _parse;   /**< Parses records into _result. */
+  QStringList _lines;     /**< Document being parsed (shared, not copied). */
+  QPair<int,int> _range;  /**< Lines to parse. */
+  T _result;              /**< Parsed records. */
+};
+
+/** Parses <b>lines</b> with <b>parse</b>, first splitting them at lines
+ * starting with <b>keyword</b> into one range per thread. The first range
+ * is parsed on the calling thread while the others are parsed on threads
+ * of their own. <b>maxThreads</b> limits the number of ranges; if it is 0,
+ * QThread::idealThreadCount() is used. Returns the results of each range, in
+ * document order. */
+template <class T>
+QList<T>
+dir_parse_parallel(const QStringList &lines, const QString &keyword,
+                   typename DirectoryParseThread<T>::ParseFunction parse,
+                   int maxThreads = 0)
+{
+  QList<DirectoryParseThread<T>*> threads;
+  QList<QPair<int,int> > ranges;
+  QList<T> results;
+
+  if (maxThreads <= 0)
+    maxThreads = QThread::idealThreadCount();
+  if (lines.size() < DIR_PARALLEL_MIN_LINES)
+    maxThreads = 1;
+  ranges = dir_split_records(lines, keyword, maxThreads);
+
+  for (int i = 1; i < ranges.size(); i++) {
+    threads << new DirectoryParseThread<T>(parse, lines, ranges.at(i));
+    threads.last()->start();
+  }
+
+  results << T();
+  if (! ranges.isEmpty())
+    parse(lines, ranges.at(0).first, ranges.at(0).second, &results.last());
+
+  for (int i = 0; i < threads.size(); i++) {
+    threads.at(i)->wait();
+    results << threads.at(i)->result();
+    delete threads.at(i);
+  }
+  return results;
+}
+
+#endif
+
@@ -0,0 +1,137 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file LatencyHistogram.cpp
+** \brief Thread-safe histogram of command round-trip times
+*/
+
+#include "LatencyHistogram.h"
+
+#include <QMutexLocker>
+#include <QStringList>
+
+
+/** Default constructor. */
+LatencyHistogram::LatencyHistogram()
+{
+  clear();
+}
+
+/** Returns the bucket that a sample of <b>msecs</b> falls into. */
+int
+LatencyHistogram::bucket(int msecs)
+{
+  int i = 0;
+  while (msecs > 0 && i < LATENCY_BUCKETS-1) {
+    msecs >>= 1;
+    i++;
+  }
+  return i;
+}
+
+/** Returns the upper bound of <b>bucket</b>, in milliseconds. The last
+ * bucket is unbounded, so its lower bound is returned instead. */
+int
+LatencyHistogram::upperBound(int bucket)
+{
+  if (bucket >= LATENCY_BUCKETS-1)
+    return (1 << (LATENCY_BUCKETS-2));
+  return (1 << bucket);
+}
+
+/** Records a sample of <b>msecs</b> milliseconds. */
+void
+LatencyHistogram::record(int msecs)
+{
+  msecs = qMax(0, msecs);
+
+  QMutexLocker locker(&_mutex);
+  _buckets[bucket(msecs)]++;
+  _count++;
+  _max = qMax(_max, msecs);
+}
+
+/** Discards every recorded sample. */
+void
+LatencyHistogram::clear()
+{
+  QMutexLocker locker(&_mutex);
+  for (int i = 0; i < LATENCY_BUCKETS; i++)
+    _buckets[i] = 0;
+  _count = 0;
+  _max = 0;
+}
+
+/** Returns the number of recorded samples. */
+quint64
+LatencyHistogram::count()
+{
+  QMutexLocker locker(&_mutex);
+  return _count;
+}
+
+/** Returns the largest recorded sample, in milliseconds. */
+int
+LatencyHistogram::maximum()
+{
+  QMutexLocker locker(&_mutex);
+  return _max;
+}
+
+/** Returns an upper bound, in milliseconds, on the <b>percent</b> percentile
+ * of the recorded samples, or 0 if nothing has been recorded. */
+int
+LatencyHistogram::percentile(qreal percent)
+{
+  QMutexLocker locker(&_mutex);
+  return percentileLocked(percent);
+}
+
+/** Returns the <b>percent</b> percentile. Must be called with <b>_mutex</b>
+ * held. */
+int
+LatencyHistogram::percentileLocked(qreal percent)
+{
+  if (!_count)
+    return 0;
+
+  quint64 rank = quint64((percent / 100.0) * _count + 0.5);
+  quint64 seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += _buckets[i];
+    if (seen >= rank && seen > 0)
+      return qMin(upperBound(i), _max);
+  }
+  return _max;
+}
+
+/** Returns a one-line summary of the recorded samples, such as
+ * "n=120 p50<=2ms p99<=64ms max=75ms [<1:10 <2:50 <4:40 ...]". Empty
+ * buckets are omitted. */
+QString
+LatencyHistogram::toString()
+{
+  QMutexLocker locker(&_mutex);
+  QStringList buckets;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    if (!_buckets[i])
+      continue;
+    QString bound = QString((i < LATENCY_BUCKETS-1) ? "<%1" : ">=%1")
+                                                  .arg(upperBound(i));
+    buckets << QString("%1:%2").arg(bound).arg(_buckets[i]);
+  }
+  return QString("n=%1 p50<=%2ms p99<=%3ms max=%4ms [%5]").arg(_count)
+                                            .arg(percentileLocked(50))
+                                            .arg(percentileLocked(99))
+                                            .arg(_max)
+                                            .arg(buckets.join(" "));
+}
+
@@ -0,0 +1,70 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file LatencyHistogram.h
+** \brief Thread-safe histogram of command round-trip times
+*/
+
+#ifndef _LATENCYHISTOGRAM_H
+#define _LATENCYHISTOGRAM_H
+
+#include <QMutex>
+#include <QString>
+
+/** Number of buckets in a LatencyHistogram. The last bucket holds every
+ * sample of at least 2^(LATENCY_BUCKETS-2) milliseconds. */
+#define LATENCY_BUCKETS  18
+
+
+/** Counts samples in buckets whose upper bounds are successive powers of
+ * two milliseconds. Bucket 0 holds samples under 1 ms, bucket <i>i</i>
+ * holds samples of [2^(<i>i</i>-1), 2^<i>i</i>) ms. Samples can be recorded
+ * from any thread.
+ */
+class LatencyHistogram
+{
+public:
+  /** Default constructor. */
+  LatencyHistogram();
+
+  /** Records a sample of <b>msecs</b> milliseconds. */
+  void record(int msecs);
+  /** Discards every recorded sample. */
+  void clear();
+
+  /** Returns the number of recorded samples. */
+  quint64 count();
+  /** Returns the largest recorded sample, in milliseconds. */
+  int maximum();
+  /** Returns an upper bound, in milliseconds, on the <b>percent</b>
+   * percentile of the recorded samples. */
+  int percentile(qreal percent);
+  /** Returns a one-line summary of the recorded samples and their
+   * distribution, suitable for logging. */
+  QString toString();
+
+private:
+  /** Returns the bucket that a sample of <b>msecs</b> falls into. */
+  static int bucket(int msecs);
+  /** Returns the upper bound of <b>bucket</b>, in milliseconds. */
+  static int upperBound(int bucket);
+  /** Returns the <b>percent</b> percentile. Must be called with
+   * <b>_mutex</b> held. */
+  int percentileLocked(qreal percent);
+
+  QMutex _mutex; /**< Protects everything below. */
+  quint64 _buckets[LATENCY_BUCKETS]; /**< Sample count in each bucket. */
+  quint64 _count; /**< Total number of samples. */
+  int _max; /**< Largest sample, in milliseconds. */
+};
+
+#endif
+
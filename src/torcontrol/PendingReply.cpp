@@ -0,0 +1,94 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If 
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia, 
+**  including this file, may be copied, modified, propagated, or distributed 
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file PendingReply.cpp
+** \brief Handle for the reply to a control command that is still in flight
+*/
+
+#include "PendingReply.h"
+
+#include <QMutexLocker>
+
+
+/** Constructor. */
+PendingReply::PendingReply(QObject *parent)
+  : QObject(parent)
+{
+  _status = Waiting;
+  _completed = false;
+  _time.start();
+}
+
+/** Returns true if a reply has been received or the command failed. */
+bool
+PendingReply::isFinished()
+{
+  QMutexLocker locker(&_mutex);
+  return (_status != Waiting);
+}
+
+/** Returns true if the command failed before a reply was received. */
+bool
+PendingReply::isError()
+{
+  QMutexLocker locker(&_mutex);
+  return (_status == Failed);
+}
+
+/** Returns the reply read from Tor. */
+ControlReply
+PendingReply::reply()
+{
+  QMutexLocker locker(&_mutex);
+  return _reply;
+}
+
+/** Returns a description of the error if isError() is true. */
+QString
+PendingReply::errorString()
+{
+  QMutexLocker locker(&_mutex);
+  return _errmsg;
+}
+
+/** Blocks until a reply has been received or the command has failed.
+ * Returns true if a reply was received. */
+bool
+PendingReply::waitForFinished()
+{
+  QMutexLocker locker(&_mutex);
+  while (! _completed)
+    _waitCond.wait(&_mutex);
+  return (_status == Success);
+}
+
+/** Sets the result of the command and wakes up anybody waiting on it.
+ * Blocked callers are only woken after finished() has been emitted, since
+ * they are free to delete this object as soon as waitForFinished()
+ * returns. */
+void
+PendingReply::setResult(bool success, const ControlReply &reply,
+                        const QString &errmsg)
+{
+  _mutex.lock();
+  _status = (success ? Success : Failed);
+  _reply  = reply;
+  _errmsg = errmsg;
+  _mutex.unlock();
+
+  emit finished();
+
+  _mutex.lock();
+  _completed = true;
+  _waitCond.wakeAll();
+  _mutex.unlock();
+}
+
@@ -0,0 +1,83 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If 
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia, 
+**  including this file, may be copied, modified, propagated, or distributed 
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file PendingReply.h
+** \brief Handle for the reply to a control command that is still in flight
+*/
+
+#ifndef _PENDINGREPLY_H
+#define _PENDINGREPLY_H
+
+#include "ControlReply.h"
+
+#include <QObject>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QTime>
+
+
+/** A PendingReply is handed out for every command sent to Tor without
+ * waiting for its response. Any number of commands can be in flight at
+ * once; Tor answers them in the order they were sent and each PendingReply
+ * is completed as its reply is read off the control socket.
+ *
+ * Callers can either connect to finished(), which is delivered in the
+ * thread the PendingReply lives in, or block in waitForFinished(). The
+ * caller owns the object, but must not delete it before it has finished.
+ * Use deleteLater() from a slot connected to finished().
+ */
+class PendingReply : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor. */
+  PendingReply(QObject *parent = 0);
+
+  /** Returns true if a reply has been received or the command failed. */
+  bool isFinished();
+  /** Returns true if the command failed before a reply was received. */
+  bool isError();
+  /** Returns the reply read from Tor. The returned reply is empty until
+   * isFinished() returns true or if isError() is true. */
+  ControlReply reply();
+  /** Returns a description of the error if isError() is true. */
+  QString errorString();
+  /** Blocks until a reply has been received or the command has failed.
+   * Returns true if a reply was received. */
+  bool waitForFinished();
+  /** Returns the number of milliseconds since this PendingReply was
+   * created, which is when its command was queued to be sent. */
+  int elapsed() const { return _time.elapsed(); }
+
+  /** Sets the result of the command and wakes up anybody waiting on it.
+   * This is called by the ControlConnection and should not be called
+   * otherwise. */
+  void setResult(bool success, const ControlReply &reply,
+                 const QString &errmsg = QString());
+
+signals:
+  /** Emitted once a reply has been received or the command has failed. */
+  void finished();
+
+private:
+  /** Status of the pending reply. */
+  enum ReplyStatus { Waiting, Failed, Success } _status;
+  bool _completed; /**< Set once finished() has been emitted. */
+  ControlReply _reply; /**< Reply to the command. */
+  QString _errmsg; /**< Error message if the command failed. */
+  QMutex _mutex; /**< Mutex around the reply and its status. */
+  QWaitCondition _waitCond; /**< Waits for a control reply. */
+  QTime _time; /**< Started when the command was queued. */
+};
+
+#endif
+
@@ -15,6 +15,9 @@
 
 #include "ReplyLine.h"
 
+#include <ctype.h>
+#include <string.h>
+
 
 /** Default constructor */
 ReplyLine::ReplyLine()
@@ -73,11 +76,42 @@ ReplyLine::appendData(const QString &data)
   _data << unescape(data);
 }
 
-/** Returns a QStringList of all data lines for this reply line */
+/** Sets the data portion of this reply line to <b>data</b>, exactly as it
+ * was read from the control socket. */
+void
+ReplyLine::setRawData(const QByteArray &data)
+{
+  _rawData = data;
+}
+
+/** Returns a QStringList of all data lines for this reply line. Any raw data
+ * set with setRawData() is split into lines, unescaped and converted to
+ * QStrings here, so callers that never look at the data never pay for it. */
 QStringList
 ReplyLine::getData() const
 {
-  return _data;
+  QStringList data = _data;
+  const char *buf = _rawData.constData();
+  int len = _rawData.size();
+  int pos = 0;
+
+  while (pos < len) {
+    const char *eol = (const char *)memchr(buf + pos, '\n', len - pos);
+    int end = (eol ? (int)(eol - buf) : len);
+    int start = pos;
+    pos = end + 1;
+
+    /* If the line starts with a "." and was escaped, then unescape it */
+    if (end - start >= 2 && buf[start] == '.' && buf[start+1] == '.')
+      start++;
+    /* Trim off leading and trailing whitespace (including \r\n) */
+    while (start < end && isspace((unsigned char)buf[start]))
+      start++;
+    while (end > start && isspace((unsigned char)buf[end-1]))
+      end--;
+    data << QString::fromLocal8Bit(buf + start, end - start);
+  }
+  return data;
 }
 
 /** Unescapes special characters in <b>str</b> and returns the unescaped
@@ -99,9 +133,9 @@ QString
 ReplyLine::toString() const
 {
   QString str = _status + " " + _message;
-  if (!_data.isEmpty()) {
+  if (hasData()) {
     str.append("\n");
-    str.append(_data.join("\n"));
+    str.append(getData().join("\n"));
   }
   return str;
 }
@@ -17,6 +17,7 @@
 #define _REPLYLINE_H
 
 #include <QStringList>
+#include <QByteArray>
 
 
 class ReplyLine
@@ -38,10 +39,17 @@ public:
 
   /** Appends <b>data</b> to this reply line. */
   void appendData(const QString &data);
+  /** Sets the data portion of this reply line to <b>data</b>, exactly as it
+   * was read from the control socket. The data is not decoded until
+   * getData() is called. */
+  void setRawData(const QByteArray &data);
+  /** Returns the undecoded data portion of this reply line, as set by
+   * setRawData(). Lines are still CRLF-terminated and dot-escaped. */
+  QByteArray rawData() const { return _rawData; }
   /** Returns a QStringList of all data lines for this reply line. */
   QStringList getData() const;
   /** Returns true if this reply contained a data portion. */ 
-  bool hasData() const { return _data.size() > 0; }
+  bool hasData() const { return (_data.size() > 0 || !_rawData.isEmpty()); }
 
   /** Returns the entire contents of this reply line, including the status,
    * message, and any extra data. */
@@ -55,6 +63,7 @@ private:
   QString _status;    /**< Response status code. */
   QString _message;   /**< ReplyText portion of this reply line. */
   QStringList _data;  /**< Contents of any DataReplyLines in this line. */
+  QByteArray _rawData; /**< Undecoded contents of any DataReplyLines. */
 };
 
 #endif
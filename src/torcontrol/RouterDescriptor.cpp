@@ -14,6 +14,7 @@
 */
 
 #include "RouterDescriptor.h"
+#include "DirectoryParser.h"
 
 #include <QtGlobal>
 
@@ -24,46 +25,114 @@
 RouterDescriptor::RouterDescriptor(QStringList descriptor)
 {
   _status = Online;
+  _orPort = 0;
+  _dirPort = 0;
+  _uptime = 0;
+  _avgBandwidth = 0;
+  _burstBandwidth = 0;
+  _observedBandwidth = 0;
   parseDescriptor(descriptor);
 }
 
-/** Parses this router's descriptor for relevant information. */
+/** Constructor. Fills in the router's name, ID, address and ports from its
+ * network status entry <b>rs</b>. Clients that only fetch microdescriptors
+ * have no full descriptor for most routers, so this is all they know. */
+RouterDescriptor::RouterDescriptor(const ::RouterStatus &rs)
+{
+  _status = Online;
+  _id = rs.id();
+  _fingerprint = rs.id();
+  _name = rs.name();
+  _ip = rs.ipAddress();
+  _orPort = rs.orPort();
+  _dirPort = rs.dirPort();
+  _published = rs.published();
+  _uptime = 0;
+  _avgBandwidth = 0;
+  _burstBandwidth = 0;
+  _observedBandwidth = 0;
+}
+
+/** Returns true if the <b>len</b> characters at <b>pos</b> in <b>line</b>
+ * are the keyword <b>keyword</b>. */
+static inline bool
+keyword_equals(const QString &line, int pos, int len, const char *keyword)
+{
+  const QChar *data = line.constData() + pos;
+  for (int i = 0; i < len; i++) {
+    if (data[i] != QLatin1Char(keyword[i]))
+      return false;
+  }
+  return !keyword[len];
+}
+
+/** Parses this router's descriptor for relevant information. Each line's
+ * keyword is found once and dispatched on its length, and values are copied
+ * straight out of the line rather than out of a modified copy of it. */
 void
 RouterDescriptor::parseDescriptor(QStringList descriptor)
 {
-  foreach (QString line, descriptor) {
-    if (line.startsWith("router ")) {
-      QStringList parts = line.remove(0,qstrlen("router ")).split(" ");
-      _name    = parts.at(0);
-      _ip      = QHostAddress(parts.at(1));
-      _orPort  = (quint16)parts.at(2).toUInt();
-      _dirPort = (quint16)parts.at(4).toUInt();
-    } else if (line.startsWith("platform ")) {
-      _platform = line.remove(0,qstrlen("platform "));
-    } else if (line.startsWith("published ")) {
-      _published = QDateTime::fromString(
-                               line.remove(0,qstrlen("published ")),
-                               "yyyy-MM-dd HH:mm:ss");
-      _published.setTimeSpec(Qt::UTC);
-    } else if (line.startsWith("opt fingerprint ")) {
-      _fingerprint = line.remove(0,qstrlen("opt fingerprint "));
-      _id = _fingerprint.remove(" ");
-    } else if (line.startsWith("fingerprint ")) {
-      _fingerprint = line.remove(0,qstrlen("fingerprint "));
-      _id = _fingerprint.remove(" ");
-    } else if (line.startsWith("uptime ")) {
-      _uptime = (quint64)line.remove(0,qstrlen("uptime ")).toULongLong();
-    } else if (line.startsWith("bandwidth ")) {
-      QStringList bw = line.remove(0,qstrlen("bandwidth ")).split(" ");
-      _avgBandwidth      = (quint64)bw.at(0).toULongLong();
-      _burstBandwidth    = (quint64)bw.at(1).toULongLong();
-      _observedBandwidth = (quint64)bw.at(2).toULongLong();
-    } else if (line.startsWith("contact ")) {
-      _contact = line.remove(0,qstrlen("contact "));
-    } else if (line.startsWith("hibernating ")) {
-      if (line.remove(0,qstrlen("hibernating ")).trimmed() == "1") {
-        _status = Hibernating;
-      }
+  int starts[6], lens[6];
+
+  for (int i = 0; i < descriptor.size(); i++) {
+    const QString &line = descriptor.at(i);
+    int pos = line.indexOf(QLatin1Char(' '));
+    if (pos < 0)
+      continue;
+    int klen = pos, kstart = 0;
+    if (keyword_equals(line, 0, klen, "opt")) {
+      /* "opt" just says the keyword that follows may be ignored */
+      kstart = ++pos;
+      pos = line.indexOf(QLatin1Char(' '), kstart);
+      if (pos < 0)
+        continue;
+      klen = pos - kstart;
+    }
+    pos++; /* Skip the space after the keyword */
+
+    switch (klen) {
+      case 6:
+        if (keyword_equals(line, kstart, klen, "router")) {
+          if (dir_split_tokens(line, pos, starts, lens, 5) < 5)
+            break;
+          _name    = line.mid(starts[0], lens[0]);
+          _ip      = QHostAddress(line.mid(starts[1], lens[1]));
+          _orPort  = quint16(dir_parse_uint(line, starts[2], lens[2]));
+          _dirPort = quint16(dir_parse_uint(line, starts[4], lens[4]));
+        } else if (keyword_equals(line, kstart, klen, "uptime")) {
+          _uptime = dir_parse_uint(line, pos, line.length() - pos);
+        }
+        break;
+      case 7:
+        if (keyword_equals(line, kstart, klen, "contact"))
+          _contact = line.mid(pos);
+        break;
+      case 8:
+        if (keyword_equals(line, kstart, klen, "platform"))
+          _platform = line.mid(pos);
+        break;
+      case 9:
+        if (keyword_equals(line, kstart, klen, "published")) {
+          _published = dir_parse_time(line, pos, pos + 11);
+          _published.setTimeSpec(Qt::UTC);
+        } else if (keyword_equals(line, kstart, klen, "bandwidth")) {
+          if (dir_split_tokens(line, pos, starts, lens, 3) < 3)
+            break;
+          _avgBandwidth      = dir_parse_uint(line, starts[0], lens[0]);
+          _burstBandwidth    = dir_parse_uint(line, starts[1], lens[1]);
+          _observedBandwidth = dir_parse_uint(line, starts[2], lens[2]);
+        }
+        break;
+      case 11:
+        if (keyword_equals(line, kstart, klen, "fingerprint")) {
+          _fingerprint = line.mid(pos);
+          _fingerprint.remove(QLatin1Char(' '));
+          _id = _fingerprint;
+        } else if (keyword_equals(line, kstart, klen, "hibernating")) {
+          if (line.mid(pos).trimmed() == "1")
+            _status = Hibernating;
+        }
+        break;
     }
   }
 }
@@ -80,3 +149,47 @@ RouterDescriptor::status()
   return tr("Offline");
 }
 
+
+
+/** Appends the router descriptors in lines <b>begin</b> to <b>end</b>-1 of
+ * <b>lines</b> to <b>descriptors</b>. */
+static void
+parse_router_descriptors_range(const QStringList &lines, int begin, int end,
+                               QList<RouterDescriptor> *descriptors)
+{
+  int i = begin;
+
+  /* Skip over anything preceding the first descriptor */
+  while (i < end && ! lines.at(i).startsWith("router "))
+    i++;
+
+  while (i < end) {
+    int first = i;
+    while (++i < end && ! lines.at(i).startsWith("router "))
+      ;
+
+    RouterDescriptor rd(lines.mid(first, i - first));
+    if (! rd.isEmpty() && ! rd.id().isEmpty())
+      *descriptors << rd;
+  }
+}
+
+/** Splits <b>lines</b>, containing one or more concatenated router
+ * descriptors, at each "router" keyword and adds each parsed descriptor to
+ * <b>descriptors</b>. A large document, such as "desc/all-recent", is split
+ * into one range of descriptors per thread and the ranges are parsed in
+ * parallel. */
+void
+parse_router_descriptors(const QStringList &lines,
+                         RouterDescriptorMap &descriptors, int maxThreads)
+{
+  QList<QList<RouterDescriptor> > ranges =
+    dir_parse_parallel<QList<RouterDescriptor> >(
+      lines, "router ", parse_router_descriptors_range, maxThreads);
+
+  foreach (QList<RouterDescriptor> range, ranges) {
+    foreach (RouterDescriptor rd, range) {
+      descriptors.insert(rd.id(), rd);
+    }
+  }
+}
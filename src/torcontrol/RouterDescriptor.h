@@ -20,8 +20,11 @@
 #include <QStringList>
 #include <QDateTime>
 #include <QList>
+#include <QHash>
 #include <QHostAddress>
 
+#include "RouterStatus.h"
+
 
 class RouterDescriptor
 {
@@ -39,6 +42,9 @@ public:
   RouterDescriptor() {}
   /** Constructor. */ 
   RouterDescriptor(QStringList descriptor);
+  /** Constructor for a router whose descriptor Tor doesn't have, holding
+   * only what its network status entry <b>rs</b> says about it. */
+  RouterDescriptor(const ::RouterStatus &rs);
   
   /** Returns the router's name. */
   QString name() const { return _name; }
@@ -86,6 +92,33 @@ public:
   /** Sets the descriptors status to Offline if <b>offline</b> is true. */
   void setOffline(bool offline) { _status = (offline ? Offline : Online); }
 
+  /* The following setters let a descriptor be rebuilt from a copy of its
+   * fields kept elsewhere, rather than from the descriptor text. */
+  /** Sets the router's availability status. */
+  void setStatus(RouterStatus status) { _status = status; }
+  /** Sets the router's ID, which is also its fingerprint. */
+  void setId(const QString &id) { _id = id; _fingerprint = id; }
+  /** Sets the router's name. */
+  void setName(const QString &name) { _name = name; }
+  /** Sets the router's IP address. */
+  void setIp(const QHostAddress &ip) { _ip = ip; }
+  /** Sets the router's ORPort. */
+  void setOrPort(quint16 orPort) { _orPort = orPort; }
+  /** Sets the router's DirPort. */
+  void setDirPort(quint16 dirPort) { _dirPort = dirPort; }
+  /** Sets the platform on which the router is running. */
+  void setPlatform(const QString &platform) { _platform = platform; }
+  /** Sets the router operator's contact information. */
+  void setContact(const QString &contact) { _contact = contact; }
+  /** Sets the date and time the router was published. */
+  void setPublished(const QDateTime &published) { _published = published; }
+  /** Sets the length of time the router had been up when published. */
+  void setUptime(quint64 uptime) { _uptime = uptime; }
+  /** Sets the router's average, burst and observed bandwidths. */
+  void setBandwidth(quint64 average, quint64 burst, quint64 observed)
+    { _avgBandwidth = average; _burstBandwidth = burst;
+      _observedBandwidth = observed; }
+
 private:
   /** Parses this router's descriptor for relevant information. */
   void parseDescriptor(QStringList descriptor);
@@ -107,5 +140,17 @@ private:
   QString _location;       /**< Geographic location information. */
 };
 
+/** A collection of RouterDescriptor objects, keyed by router ID. */
+typedef QHash<QString,RouterDescriptor> RouterDescriptorMap;
+
+/** Splits <b>lines</b>, containing one or more concatenated router
+ * descriptors, at each "router" keyword and adds each parsed descriptor to
+ * <b>descriptors</b>. Large documents are parsed on up to
+ * <b>maxThreads</b> threads, or QThread::idealThreadCount() threads if it
+ * is 0. */
+void parse_router_descriptors(const QStringList &lines,
+                              RouterDescriptorMap &descriptors,
+                              int maxThreads = 0);
+
 #endif
 
@@ -15,11 +15,10 @@
 
 #include "RouterStatus.h"
 
-#include "stringutil.h"
+#include "DirectoryParser.h"
 
-/** Defines the time format used when parsing the published date and time from
- * a router's status. */
-#define TIME_FORMAT  "yyyy-MM-dd HH:mm:ss"
+/** Number of space-separated fields in an "r" line. */
+#define R_LINE_FIELDS  9
 
 
 /** Constructor. Parses <b>status</b> for router status information. The given
@@ -35,89 +34,196 @@
  * */
 RouterStatus::RouterStatus(const QStringList &status)
 {
-  bool ok;
-
   _valid = false;
   _flags = 0;
+  _orPort = 0;
+  _dirPort = 0;
 
-  foreach (QString line, status) {
-    if (line.startsWith("r ")) {
-      QStringList parts = line.split(" ", QString::SkipEmptyParts);
-      if (parts.size() < 9)
-        return;
-
-      /* Nickname */
-      _name = parts.at(1);
-      /* Identity key digest */
-      _id = base16_encode(QByteArray::fromBase64(parts.at(2).toAscii()));
-      if (_id.isEmpty())
-        return;
-      /* Most recent descriptor digest */
-      _digest = base16_encode(QByteArray::fromBase64(parts.at(3).toAscii()));
-      if (_digest.isEmpty())
-        return;
-      /* Most recent publication date */
-      _published = QDateTime::fromString(parts.at(4) + " " + parts.at(5),
-                                         TIME_FORMAT);
-      if (!_published.isValid())
-        return;
-      /* IP address */
-      _ipAddress = QHostAddress(parts.at(6));
-      if (_ipAddress.isNull())
-        return;
-      /* ORPort */
-      _orPort = parts.at(7).toUInt(&ok);
-      if (!ok)
-        return;
-      /* DirPort */
-      _dirPort = parts.at(8).toUInt(&ok);
-      if (!ok)
-        return;
-
-      _valid = true;
-    } else if (line.startsWith("s ")) {
-      /* Status flags */
-      QStringList flags = line.split(" ", QString::SkipEmptyParts);
-      flags.removeFirst(); /* Remove the "s" */
-
-      foreach (QString flag, flags) {
-        _flags |= flagValue(flag);
-      }
+  for (int i = 0; i < status.size(); i++) {
+    const QString &line = status.at(i);
+    if (line.length() < 2 || line.at(1) != QLatin1Char(' '))
+      continue;
+
+    /* Every line we care about has a one-letter keyword */
+    switch (line.at(0).unicode()) {
+      case 'r':
+        if (! parseRouterLine(line))
+          return;
+        _valid = true;
+        break;
+      case 's':
+        parseFlagsLine(line);
+        break;
+      default:
+        break;
     }
   }
 }
 
-/** Returns a Flags enum value for the given router status <b>flag</b>. If
- * <b>flag</b> is not recognized, then <i>Unknown</i> is returned. */
+/** Parses the fields of an "r" line into this object. Returns false if any
+ * of them is missing or malformed. */
+bool
+RouterStatus::parseRouterLine(const QString &line)
+{
+  int starts[R_LINE_FIELDS], lens[R_LINE_FIELDS];
+  bool ok;
+
+  if (dir_split_tokens(line, 0, starts, lens, R_LINE_FIELDS) < R_LINE_FIELDS)
+    return false;
+
+  /* Nickname */
+  _name = line.mid(starts[1], lens[1]);
+  /* Identity key digest */
+  _id = dir_base64_to_base16(line, starts[2], lens[2]);
+  if (_id.isEmpty())
+    return false;
+  /* Most recent descriptor digest */
+  _digest = dir_base64_to_base16(line, starts[3], lens[3]);
+  if (_digest.isEmpty())
+    return false;
+  /* Most recent publication date */
+  if (lens[4] != 10 || lens[5] != 8)
+    return false;
+  _published = dir_parse_time(line, starts[4], starts[5]);
+  if (!_published.isValid())
+    return false;
+  /* IP address */
+  _ipAddress = QHostAddress(line.mid(starts[6], lens[6]));
+  if (_ipAddress.isNull())
+    return false;
+  /* ORPort */
+  _orPort = quint16(dir_parse_uint(line, starts[7], lens[7], &ok));
+  if (!ok)
+    return false;
+  /* DirPort */
+  _dirPort = quint16(dir_parse_uint(line, starts[8], lens[8], &ok));
+  if (!ok)
+    return false;
+  return true;
+}
+
+/** Parses the status flags on an "s" line into this object. */
+void
+RouterStatus::parseFlagsLine(const QString &line)
+{
+  const QChar *data = line.constData();
+  int len = line.length();
+  int pos = 2; /* Skip the "s " */
+
+  while (pos < len) {
+    while (pos < len && data[pos] == QLatin1Char(' '))
+      pos++;
+    int start = pos;
+    while (pos < len && data[pos] != QLatin1Char(' '))
+      pos++;
+    if (pos > start)
+      _flags |= flagValue(data + start, pos - start);
+  }
+}
+
+/** Returns true if the <b>len</b> characters at <b>str</b> match the ASCII
+ * string <b>name</b>, ignoring case. */
+static bool
+flag_equals(const QChar *str, int len, const char *name)
+{
+  for (int i = 0; i < len; i++) {
+    QChar c = QLatin1Char(name[i]);
+    if (c.isNull() || str[i].toLower() != c.toLower())
+      return false;
+  }
+  return !name[len];
+}
+
+/** Returns a Flags enum value for the <b>len</b>-character router status
+ * flag at <b>flag</b>. If the flag is not recognized, then <i>Unknown</i>
+ * is returned. Flags are told apart by their length and first letter, so
+ * each needs at most one full comparison. */
 RouterStatus::Flag
-RouterStatus::flagValue(const QString &flag)
+RouterStatus::flagValue(const QChar *flag, int len)
 {
-  if (!flag.compare("Authority", Qt::CaseInsensitive))
-    return Authority;
-  if (!flag.compare("BadExit", Qt::CaseInsensitive))
-    return BadExit;
-  if (!flag.compare("BadDirectory", Qt::CaseInsensitive))
-    return BadDirectory;
-  if (!flag.compare("Exit", Qt::CaseInsensitive))
-    return Exit;
-  if (!flag.compare("Fast", Qt::CaseInsensitive))
-    return Fast;
-  if (!flag.compare("Guard", Qt::CaseInsensitive))
-    return Guard;
-  if (!flag.compare("HSDir", Qt::CaseInsensitive))
-    return HSDir;
-  if (!flag.compare("Named", Qt::CaseInsensitive))
-    return Named;
-  if (!flag.compare("Running", Qt::CaseInsensitive))
-    return Running;
-  if (!flag.compare("Stable", Qt::CaseInsensitive))
-    return Stable;
-  if (!flag.compare("Valid", Qt::CaseInsensitive))
-    return Valid;
-  if (!flag.compare("V2Dir", Qt::CaseInsensitive))
-    return V2Dir;
-  if (!flag.compare("V3Dir", Qt::CaseInsensitive))
-    return V3Dir;
+  switch (len) {
+    case 4:
+      if (flag_equals(flag, len, "Fast"))
+        return Fast;
+      if (flag_equals(flag, len, "Exit"))
+        return Exit;
+      break;
+    case 5:
+      switch (flag[0].toLower().unicode()) {
+        case 'g':
+          return (flag_equals(flag, len, "Guard") ? Guard : Unknown);
+        case 'h':
+          return (flag_equals(flag, len, "HSDir") ? HSDir : Unknown);
+        case 'n':
+          return (flag_equals(flag, len, "Named") ? Named : Unknown);
+        case 'v':
+          if (flag_equals(flag, len, "Valid"))
+            return Valid;
+          if (flag_equals(flag, len, "V2Dir"))
+            return V2Dir;
+          if (flag_equals(flag, len, "V3Dir"))
+            return V3Dir;
+          break;
+      }
+      break;
+    case 6:
+      return (flag_equals(flag, len, "Stable") ? Stable : Unknown);
+    case 7:
+      if (flag_equals(flag, len, "Running"))
+        return Running;
+      if (flag_equals(flag, len, "BadExit"))
+        return BadExit;
+      break;
+    case 9:
+      return (flag_equals(flag, len, "Authority") ? Authority : Unknown);
+    case 12:
+      return (flag_equals(flag, len, "BadDirectory") ? BadDirectory
+                                                     : Unknown);
+  }
   return Unknown; /* Unknown status flag */
 }
 
+
+/** Appends the valid router status entries in lines <b>begin</b> to
+ * <b>end</b>-1 of <b>lines</b> to <b>networkStatus</b>. */
+static void
+parse_network_status_range(const QStringList &lines, int begin, int end,
+                           NetworkStatus *networkStatus)
+{
+  int i = begin;
+
+  while (i < end) {
+    /* Extract the "r", "s", and whatever other status lines */
+    int first = i;
+    while (++i < end && ! lines.at(i).startsWith("r "))
+      ;
+
+    /* Create a new RouterStatus object and add it to the network status, if
+     * it's valid. */
+    RouterStatus routerStatus(lines.mid(first, i - first));
+    if (routerStatus.isValid())
+      *networkStatus << routerStatus;
+  }
+}
+
+/** Splits <b>lines</b>, containing zero or more router status entries, at
+ * each "r" line and returns the valid entries. A large document, such as a
+ * full consensus, is split into one range of entries per thread and the
+ * ranges are parsed in parallel. */
+NetworkStatus
+parse_network_status(const QStringList &lines, int maxThreads)
+{
+  QList<NetworkStatus> ranges =
+    dir_parse_parallel<NetworkStatus>(lines, "r ",
+                                      parse_network_status_range,
+                                      maxThreads);
+  if (ranges.size() == 1)
+    return ranges.first();
+
+  NetworkStatus networkStatus;
+  foreach (NetworkStatus range, ranges) {
+    networkStatus += range;
+  }
+  return networkStatus;
+}
+
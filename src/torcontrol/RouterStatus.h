@@ -74,9 +74,15 @@ public:
   bool isValid() const { return _valid; }
 
 private:
-  /** Returns a Flags enum value for the given router status <b>flag</b>. If
-   * <b>flag</b> is not recognized, then <i>Unknown</i> is returned. */
-  Flag flagValue(const QString &flag);
+  /** Parses the fields of an "r" line. Returns false if any of them is
+   * missing or malformed. */
+  bool parseRouterLine(const QString &line);
+  /** Parses the status flags on an "s" line. */
+  void parseFlagsLine(const QString &line);
+  /** Returns a Flags enum value for the <b>len</b>-character router status
+   * flag at <b>flag</b>. If the flag is not recognized, then <i>Unknown</i>
+   * is returned. */
+  Flag flagValue(const QChar *flag, int len);
 
   bool _valid;   /**< True if this object is a valid RouterStatus. */
   QString _name; /**< Router nickname. */
@@ -96,5 +102,12 @@ Q_DECLARE_OPERATORS_FOR_FLAGS(RouterStatus::Flags)
 /** A collection of RouterStatus objects. */
 typedef QList<RouterStatus> NetworkStatus;
 
+/** Parses <b>lines</b>, containing zero or more router status entries as
+ * found in a consensus, into a NetworkStatus. Invalid entries are
+ * skipped. Large documents are parsed on up to <b>maxThreads</b> threads,
+ * or QThread::idealThreadCount() threads if it is 0. */
+NetworkStatus parse_network_status(const QStringList &lines,
+                                   int maxThreads = 0);
+
 #endif
 
@@ -23,6 +23,13 @@
 #include <QHostAddress>
 #include <QVariantMap>
 
+/** Maximum number of addresses to look up in a single "GETINFO
+ * ip-to-country/..." request. */
+#define MAX_IP_TO_COUNTRY_KEYS  500
+/** Maximum number of GETINFO requests made for one batch of router
+ * descriptors, each leaving out a key Tor had no descriptor for. */
+#define MAX_DESCRIPTOR_REQUESTS  4
+
 
 /** Default constructor */
 TorControl::TorControl(ControlMethod::Method method)
@@ -41,8 +48,13 @@ TorControl::TorControl(ControlMethod::Method method)
   RELAY_SIGNAL(_eventHandler, SIGNAL(bandwidthUpdate(quint64, quint64)));
   RELAY_SIGNAL(_eventHandler, SIGNAL(circuitStatusChanged(Circuit)));
   RELAY_SIGNAL(_eventHandler, SIGNAL(streamStatusChanged(Stream)));
+  RELAY_SIGNAL(_eventHandler, SIGNAL(circuitStatusesChanged(CircuitList)));
+  RELAY_SIGNAL(_eventHandler, SIGNAL(streamStatusesChanged(StreamList)));
   RELAY_SIGNAL(_eventHandler, SIGNAL(newDescriptors(QStringList)));
+  RELAY_SIGNAL(_eventHandler, SIGNAL(newConsensus(NetworkStatus)));
+  RELAY_SIGNAL(_eventHandler, SIGNAL(networkStatusChanged(NetworkStatus)));
   RELAY_SIGNAL(_eventHandler, SIGNAL(logMessage(tc::Severity, QString)));
+  RELAY_SIGNAL(_eventHandler, SIGNAL(logMessages(LogEventList)));
   RELAY_SIGNAL(_eventHandler, SIGNAL(dangerousPort(quint16, bool)));
   RELAY_SIGNAL(_eventHandler, SIGNAL(socksError(tc::SocksError, QString)));
   RELAY_SIGNAL(_eventHandler, SIGNAL(bootstrapStatusChanged(BootstrapStatus)));
@@ -65,15 +77,45 @@ TorControl::TorControl(ControlMethod::Method method)
   RELAY_SIGNAL(_eventHandler,
                SIGNAL(serverDescriptorAccepted(QHostAddress, quint16)));
   RELAY_SIGNAL(_eventHandler, SIGNAL(serverDescriptorAccepted()));
+  QObject::connect(_eventHandler, SIGNAL(confChanged(QVariantMap)),
+                   this, SLOT(onConfChanged(QVariantMap)));
+  _confSnapshotLoaded = false;
+  _confChangedEnabled = false;
+  _authenticated = false;
+
+  /* Subscriptions changed in a burst are registered with Tor together */
+  _updateEventsTimer.setSingleShot(true);
+  _updateEventsTimer.setInterval(0);
+  QObject::connect(&_updateEventsTimer, SIGNAL(timeout()),
+                   this, SLOT(updateEvents()));
+
+  /* Asynchronous events from either connection are parsed on a single
+   * worker thread, so the event handler is never used by two threads at
+   * once and events are handled in the order they were read. */
+  _eventWorker = new TorEventWorker(_eventHandler);
+  _eventWorker->start();
 
   /* Create an instance of a connection to Tor's control interface and give
-   * it an object to use to handle asynchronous events. */
-  _controlConn = new ControlConnection(method, _eventHandler);
+   * it the worker to hand asynchronous events to. */
+  _controlConn = new ControlConnection(method, _eventWorker);
   RELAY_SIGNAL(_controlConn, SIGNAL(connected()));
   RELAY_SIGNAL(_controlConn, SIGNAL(connectFailed(QString)));
   QObject::connect(_controlConn, SIGNAL(disconnected()),
                    this, SLOT(onDisconnected()));
 
+  /* Create the connection used for events if a separate event connection is
+   * enabled. It uses the same event worker as the command connection. */
+  _eventConn = new ControlConnection(method, _eventWorker);
+  _useEventConn = false;
+  _eventConnReady = false;
+  _controlPort = 0;
+  QObject::connect(_eventConn, SIGNAL(connected()),
+                   this, SLOT(onEventConnectionConnected()));
+  QObject::connect(_eventConn, SIGNAL(disconnected()),
+                   this, SLOT(onEventConnectionClosed()));
+  QObject::connect(_eventConn, SIGNAL(connectFailed(QString)),
+                   this, SLOT(onEventConnectionFailed(QString)));
+
   /* Create an object used to start and stop a Tor process. */
   _torProcess = new TorProcess(this);
   RELAY_SIGNAL(_torProcess, SIGNAL(started()));
@@ -105,7 +147,10 @@ TorControl::~TorControl()
   if (isVidaliaRunningTor()) {
     stop();
   }
+  delete _eventConn;
   delete _controlConn;
+  /* Dispatch any events that are still queued and stop the event worker */
+  delete _eventWorker;
 }
 
 /** Start the Tor process using the executable <b>tor</b> and the list of
@@ -190,6 +235,8 @@ TorControl::onLogStdout(const QString &severity, const QString &message)
 void
 TorControl::connect(const QHostAddress &address, quint16 port)
 {
+  _controlAddr = address;
+  _controlPort = port;
   _controlConn->connect(address, port);
 }
 
@@ -198,6 +245,7 @@ TorControl::connect(const QHostAddress &address, quint16 port)
 void
 TorControl::connect(const QString &path)
 {
+  _controlPath = path;
   _controlConn->connect(path);
 }
 
@@ -246,8 +294,22 @@ TorControl::onDisconnected()
      * running. In this case, there may be relevant information in the logs. */
     _torProcess->openStdout();
   }
-  /* Tor isn't running, so it has no version */
+  /* Tor isn't running, so it has no version or configuration */
   _torVersion = QString();
+  _confChangedEnabled = false;
+  clearConfCache();
+  /* Events have to be registered again on the next connection */
+  _authenticated = false;
+  _registeredEvents = 0;
+  _updateEventsTimer.stop();
+
+  /* Close the event connection along with the command connection */
+  _authCommand = ControlCommand();
+  _eventConnReady = false;
+  if (_eventConn->status() == ControlConnection::Connecting)
+    _eventConn->cancelConnect();
+  else if (_eventConn->isConnected())
+    _eventConn->disconnect();
 
   /* Let interested parties know we lost our control connection */
   emit disconnected();
@@ -260,6 +322,13 @@ TorControl::isConnected()
   return _controlConn->isConnected();
 }
 
+/** Returns true if the controller has authenticated to Tor. */
+bool
+TorControl::isAuthenticated()
+{
+  return (_authenticated && isConnected());
+}
+
 /** Send a message to Tor and reads the response. If Vidalia was unable to
  * send the command to Tor or read its response, false is returned. If the
  * response was read and the status code is not 250 OK, false is also
@@ -267,7 +336,17 @@ TorControl::isConnected()
 bool
 TorControl::send(ControlCommand cmd, ControlReply &reply, QString *errmsg)
 {
-  if (_controlConn->send(cmd, reply, errmsg)) {
+  return send(_controlConn, cmd, reply, errmsg);
+}
+
+/** Sends a message to Tor on the control connection <b>conn</b> and reads
+ * the response. Returns true only if the response's status code is 250
+ * OK. */
+bool
+TorControl::send(ControlConnection *conn, ControlCommand cmd,
+                 ControlReply &reply, QString *errmsg)
+{
+  if (conn->send(cmd, reply, errmsg)) {
     if (reply.getStatus() == "250") {
       return true;
     }
@@ -278,6 +357,22 @@ TorControl::send(ControlCommand cmd, ControlReply &reply, QString *errmsg)
   return false;
 }
 
+/** Waits for <b>pending</b> to finish and copies Tor's reply into
+ * <b>reply</b>. Returns true if a reply was received and its status code is
+ * 250 OK. */
+bool
+TorControl::checkReply(PendingReply *pending, ControlReply &reply,
+                       QString *errmsg)
+{
+  if (!pending->waitForFinished())
+    return err(errmsg, pending->errorString());
+
+  reply = pending->reply();
+  if (reply.getStatus() == "250")
+    return true;
+  return err(errmsg, reply.getMessage());
+}
+
 /** Sends a message to Tor and discards the response. */
 bool
 TorControl::send(ControlCommand cmd, QString *errmsg)
@@ -301,6 +396,7 @@ TorControl::authenticate(const QByteArray cookie, QString *errmsg)
     emit authenticationFailed(str);
     return err(errmsg, str);
   }
+  _authCommand = cmd;
   onAuthenticated();
   return true;
 }
@@ -320,6 +416,7 @@ TorControl::authenticate(const QString &password, QString *errmsg)
     emit authenticationFailed(str);
     return err(errmsg, str);
   }
+  _authCommand = cmd;
   onAuthenticated();
   return true;
 }
@@ -331,6 +428,9 @@ TorControl::onAuthenticated()
   /* The version of Tor isn't going to change while we're connected to it, so
    * save it for later. */
   getInfo("version", _torVersion);
+  _authenticated = true;
+  /* Tor may have been reconfigured since we last talked to it */
+  clearConfCache();
   /* We want to use verbose names in events and GETINFO results. */
   useFeature("VERBOSE_NAMES");
   /* We want to use extended events in all async events */
@@ -338,9 +438,109 @@ TorControl::onAuthenticated()
 
   getBootstrapPhase();
 
+  /* Open the event connection, if enabled. Until it is authenticated, events
+   * are registered on this connection. */
+  connectEventConnection();
+
   emit authenticated();
 }
 
+/** Opens a second connection to the same control interface, if a separate
+ * event connection is enabled and it is not already open. */
+void
+TorControl::connectEventConnection()
+{
+  if (!_useEventConn || _authCommand.keyword().isEmpty()
+        || _eventConn->isRunning())
+    return;
+
+  if (_method == ControlMethod::Socket)
+    _eventConn->connect(_controlPath);
+  else
+    _eventConn->connect(_controlAddr, _controlPort);
+}
+
+/** Called when the event connection is established. Authenticates it with
+ * the credentials Tor accepted on the command connection, enables the same
+ * features, and moves all event registrations over to it. */
+void
+TorControl::onEventConnectionConnected()
+{
+  ControlReply reply;
+  QString errmsg;
+
+  if (!send(_eventConn, _authCommand, reply, &errmsg)
+        || !send(_eventConn, ControlCommand("USEFEATURE", "VERBOSE_NAMES"),
+                 reply, &errmsg)
+        || !send(_eventConn, ControlCommand("USEFEATURE", "EXTENDED_EVENTS"),
+                 reply, &errmsg)) {
+    tc::warn("Unable to set up a separate event connection: %1").arg(errmsg);
+    _eventConn->disconnect();
+    return;
+  }
+  _eventConnReady = true;
+  tc::debug("Receiving events on a separate control connection.");
+
+  /* Register for events on the new connection before unregistering them on
+   * the command connection, so that no events are lost in between. */
+  if ((_events | _subscribedEvents) && setEvents(&errmsg))
+    send(_controlConn, ControlCommand("SETEVENTS"), reply);
+}
+
+/** Called when the event connection could not be opened. Events simply
+ * stay registered on the command connection. */
+void
+TorControl::onEventConnectionFailed(const QString &errmsg)
+{
+  tc::warn("Unable to open a separate event connection: %1").arg(errmsg);
+  /* Stop the event connection's thread so it can be started again */
+  _eventConn->cancelConnect();
+}
+
+/** Called when the event connection is closed. If the command connection is
+ * still open, events are registered on it again. */
+void
+TorControl::onEventConnectionClosed()
+{
+  if (!_eventConnReady)
+    return;
+
+  _eventConnReady = false;
+  /* Configuration changes are missed until events are registered again */
+  _confChangedEnabled = false;
+  if (isConnected()) {
+    tc::warn("The separate event connection was closed. Receiving events "
+             "on the command connection instead.");
+    setEvents();
+  }
+}
+
+/** Enables or disables the separate event connection. */
+void
+TorControl::setSeparateEventConnection(bool enabled)
+{
+  _useEventConn = enabled;
+  if (!isConnected())
+    return;
+
+  if (enabled) {
+    connectEventConnection();
+  } else if (_eventConn->isConnected()) {
+    /* Move event registrations back to the command connection first */
+    _eventConnReady = false;
+    setEvents();
+    _eventConn->disconnect();
+  }
+}
+
+/** Returns a histogram of the round-trip time of commands sent on the command
+ * connection since it was last opened. */
+LatencyHistogram*
+TorControl::commandLatency()
+{
+  return _controlConn->latency();
+}
+
 /** Sends a PROTOCOLINFO command to Tor and parses the response. */
 ProtocolInfo
 TorControl::protocolInfo(QString *errmsg)
@@ -485,11 +685,40 @@ TorControl::getInfo(const QStringList &keys, QString *errmsg)
 {
   ControlCommand cmd("GETINFO");
   ControlReply reply;
-  QVariantMap infoMap;
 
   cmd.addArguments(keys);
   if (!send(cmd, reply, errmsg))
     return QVariantMap();
+  return parseInfoReply(reply);
+}
+
+/** Sends a GETINFO message to Tor using the given list of <b>keys</b>
+ * without waiting for Tor's response. */
+PendingReply*
+TorControl::getInfoAsync(const QStringList &keys)
+{
+  ControlCommand cmd("GETINFO");
+  cmd.addArguments(keys);
+  return _controlConn->sendAsync(cmd);
+}
+
+/** Returns a QVariantMap containing the keys and values from the finished
+ * GETINFO reply in <b>pending</b>. Returns a default constructed QVariantMap
+ * if the command failed. */
+QVariantMap
+TorControl::getInfo(PendingReply *pending, QString *errmsg)
+{
+  ControlReply reply;
+  if (!checkReply(pending, reply, errmsg))
+    return QVariantMap();
+  return parseInfoReply(reply);
+}
+
+/** Parses the keys and values in a successful GETINFO <b>reply</b>. */
+QVariantMap
+TorControl::parseInfoReply(const ControlReply &reply)
+{
+  QVariantMap infoMap;
 
   foreach (ReplyLine line, reply.getLines()) {
     QString msg = line.getMessage();
@@ -558,7 +787,12 @@ TorControl::signal(TorSignal::Signal sig, QString *errmsg)
      * asking it to stop running, so don't try to get a response. */
     return _controlConn->send(cmd, errmsg);
   }
-  return send(cmd, errmsg);
+  bool ret = send(cmd, errmsg);
+  if (sig == TorSignal::Reload) {
+    /* Tor reread its torrc, so any option may have changed */
+    clearConfCache();
+  }
+  return ret;
 }
 
 /** Returns an address on which Tor is listening for application
@@ -693,23 +927,161 @@ bool
 TorControl::setEvent(TorEvents::Event e, bool add, bool set, QString *errmsg)
 {
   _events = (add ? (_events | e) : (_events & ~e));
-  if (set && isConnected())
+  if (set && isConnected() && eventsToRegister() != _registeredEvents)
     return setEvents(errmsg);
   return true;
 }
 
+/** Adds <b>events</b> to the events <b>consumer</b> is interested in. */
+void
+TorControl::subscribeEvents(QObject *consumer, TorEvents::Events events)
+{
+  TorEvents::Events current = _subscribers.value(consumer);
+  if (!(events & ~current))
+    return;
+
+  if (!_subscribers.contains(consumer)) {
+    QObject::connect(consumer, SIGNAL(destroyed(QObject*)),
+                     this, SLOT(onConsumerDestroyed(QObject*)));
+  }
+  _subscribers.insert(consumer, current | events);
+  refEvents(events & ~current, 1);
+}
+
+/** Removes <b>events</b> from the events <b>consumer</b> is interested
+ * in. */
+void
+TorControl::unsubscribeEvents(QObject *consumer, TorEvents::Events events)
+{
+  TorEvents::Events current = _subscribers.value(consumer);
+  if (!(events & current))
+    return;
+
+  if (current & ~events) {
+    _subscribers.insert(consumer, current & ~events);
+  } else {
+    _subscribers.remove(consumer);
+    QObject::disconnect(consumer, SIGNAL(destroyed(QObject*)),
+                        this, SLOT(onConsumerDestroyed(QObject*)));
+  }
+  refEvents(events & current, -1);
+}
+
+/** Called when a consumer that subscribed to events is destroyed. Releases
+ * its events. */
+void
+TorControl::onConsumerDestroyed(QObject *consumer)
+{
+  refEvents(_subscribers.take(consumer), -1);
+}
+
+/** Adds <b>delta</b> to the number of consumers subscribed to each event in
+ * <b>events</b>, and schedules registering the events with Tor if any
+ * event gained its first consumer or lost its last one. */
+void
+TorControl::refEvents(TorEvents::Events events, int delta)
+{
+  TorEvents::Events subscribed = _subscribedEvents;
+
+  for (TorEvents::Event e = TorEvents::EVENT_MIN; e <= TorEvents::EVENT_MAX;) {
+    if (events & e) {
+      int refs = _eventRefs.value(e) + delta;
+      if (refs > 0) {
+        _eventRefs.insert(e, refs);
+        _subscribedEvents |= e;
+      } else {
+        _eventRefs.remove(e);
+        _subscribedEvents &= ~e;
+      }
+    }
+    e = static_cast<TorEvents::Event>(e << 1);
+  }
+  if (_subscribedEvents != subscribed)
+    _updateEventsTimer.start();
+}
+
+/** Registers the events consumers are currently subscribed to with Tor, if
+ * they differ from the events last registered. */
+void
+TorControl::updateEvents()
+{
+  QString errmsg;
+  if (isAuthenticated() && eventsToRegister() != _registeredEvents
+        && !setEvents(&errmsg))
+    tc::warn("Unable to register for events: %1").arg(errmsg);
+}
+
+/** Returns true if the version of Tor we're connected to can send events of
+ * type <b>e</b>. */
+bool
+TorControl::supportsEvent(TorEvents::Event e)
+{
+  switch (e) {
+    case TorEvents::NewConsensus:
+      return (getTorVersion() >= 0x02010d); /* 0.2.1.13-alpha */
+    case TorEvents::ConfChanged:
+      return (getTorVersion() >= 0x020303); /* 0.2.3.3-alpha */
+    default:
+      break;
+  }
+  return true;
+}
+
+/** Sets the interval over which circuit, stream and log events are
+ * batched. */
+void
+TorControl::setEventBatchInterval(int msecs)
+{
+  _eventHandler->setBatchInterval(msecs);
+}
+
 /** Register for the events currently in the event list */
 bool
 TorControl::setEvents(QString *errmsg)
 {
   ControlCommand cmd("SETEVENTS");
+  TorEvents::Events events = eventsToRegister();
 
   for (TorEvents::Event e = TorEvents::EVENT_MIN; e <= TorEvents::EVENT_MAX;) {
-    if (_events & e)
+    if (events & e)
       cmd.addArgument(TorEvents::toString(e));
     e = static_cast<TorEvents::Event>(e << 1);
   }
-  return send(cmd, errmsg);
+
+  /* Events go to the separate event connection once it is ready */
+  ControlReply reply;
+  if (!send(_eventConnReady ? _eventConn : _controlConn, cmd, reply, errmsg)) {
+    _confChangedEnabled = false;
+    return false;
+  }
+
+  _registeredEvents = events;
+  _updateEventsTimer.stop();
+
+  /* Anything cached before Tor started reporting changes may be stale */
+  bool confChanged = events.testFlag(TorEvents::ConfChanged);
+  if (confChanged && !_confChangedEnabled)
+    clearConfCache();
+  _confChangedEnabled = confChanged;
+  return true;
+}
+
+/** Returns the events set with setEvent() or subscribed to by a consumer,
+ * and CONF_CHANGED, without any the running version of Tor can't send. */
+TorEvents::Events
+TorControl::eventsToRegister()
+{
+  /* Always ask for configuration changes, to keep the cache up to date */
+  TorEvents::Events events = _events | _subscribedEvents
+                               | TorEvents::ConfChanged;
+
+  for (TorEvents::Event e = TorEvents::EVENT_MIN; e <= TorEvents::EVENT_MAX;) {
+    /* Tor rejects the whole command if it doesn't know one of the events */
+    if ((events & e) && !supportsEvent(e))
+      events &= ~e;
+    e = static_cast<TorEvents::Event>(e << 1);
+  }
+  return events;
 }
 
 /** Sets each configuration key in <b>map</b> to the value associated
@@ -734,6 +1106,8 @@ TorControl::setConf(QHash<QString,QString> map, QString *errmsg)
       else
         cmd.addArgument(key);
     }
+    /* Keys given as "key=value" carry their value with them */
+    uncacheConf(key.section('=', 0, 0));
   }
   return send(cmd, errmsg);
 }
@@ -846,11 +1220,40 @@ TorControl::getConf(const QStringList &keys, QString *errmsg)
 {
   ControlCommand cmd("GETCONF");
   ControlReply reply;
-  QVariantMap confMap;
 
   cmd.addArguments(keys);
   if (!send(cmd, reply, errmsg))
     return QVariantMap();
+  return parseConfReply(reply);
+}
+
+/** Sends a GETCONF message to Tor using the given list of <b>keys</b>
+ * without waiting for Tor's response. */
+PendingReply*
+TorControl::getConfAsync(const QStringList &keys)
+{
+  ControlCommand cmd("GETCONF");
+  cmd.addArguments(keys);
+  return _controlConn->sendAsync(cmd);
+}
+
+/** Returns a QVariantMap containing the keys and values from the finished
+ * GETCONF reply in <b>pending</b>. Returns a default constructed QVariantMap
+ * if the command failed. */
+QVariantMap
+TorControl::getConf(PendingReply *pending, QString *errmsg)
+{
+  ControlReply reply;
+  if (!checkReply(pending, reply, errmsg))
+    return QVariantMap();
+  return parseConfReply(reply);
+}
+
+/** Parses the keys and values in a successful GETCONF <b>reply</b>. */
+QVariantMap
+TorControl::parseConfReply(const ControlReply &reply)
+{
+  QVariantMap confMap;
 
   foreach (ReplyLine line, reply.getLines()) {
     QString msg = line.getMessage();
@@ -889,6 +1292,106 @@ TorControl::getConf(const QString &key, QString *errmsg)
   return map.value(key);
 }
 
+/** Returns the value of the configuration option <b>key</b> from the cached
+ * copy of Tor's configuration, fetching the whole configuration first if it
+ * has not been fetched since the cache was last cleared. Options that are
+ * not part of the snapshot are fetched and cached individually. Returns a
+ * default constructed QVariant on failure. */
+QVariant
+TorControl::cachedConf(const QString &key, QString *errmsg)
+{
+  if (!_confSnapshotLoaded)
+    loadConfSnapshot();
+
+  QString lkey = key.toLower();
+  QHash<QString,QVariant>::const_iterator it = _confCache.constFind(lkey);
+  if (it != _confCache.constEnd())
+    return it.value();
+
+  /* Virtual options like HiddenServiceOptions are answered with other keys,
+   * so cache whatever Tor returns. */
+  QVariantMap conf = getConf(QStringList() << key, errmsg);
+  QVariantMap::const_iterator i;
+  for (i = conf.constBegin(); i != conf.constEnd(); ++i)
+    _confCache.insert(i.key().toLower(), i.value());
+  return _confCache.value(lkey);
+}
+
+/** Discards the cached configuration, unless Tor reports every change to it
+ * with CONF_CHANGED events. */
+void
+TorControl::expireConfCache()
+{
+  if (!_confChangedEnabled)
+    clearConfCache();
+}
+
+/** Fetches every option Tor knows about with a single GETCONF. The option
+ * names are listed by "GETINFO config/names", one per line, each followed by
+ * its type. Virtual options and the options that depend on them are left
+ * out, since asking for them in bulk can fail the whole command. If the
+ * snapshot can't be fetched, options are fetched one at a time instead. */
+void
+TorControl::loadConfSnapshot()
+{
+  _confSnapshotLoaded = true;
+
+  QStringList keys;
+  foreach (QString line, getInfo("config/names").toStringList()) {
+    QStringList parts = line.split(' ', QString::SkipEmptyParts);
+    if (parts.size() < 2
+          || parts.at(1) == "Virtual" || parts.at(1) == "Dependant")
+      continue;
+    keys << parts.at(0);
+  }
+  if (keys.isEmpty())
+    return;
+
+  QString errmsg;
+  QVariantMap conf = getConf(keys, &errmsg);
+  if (conf.isEmpty()) {
+    tc::warn("Unable to fetch Tor's configuration: %1").arg(errmsg);
+    return;
+  }
+  QVariantMap::const_iterator i;
+  for (i = conf.constBegin(); i != conf.constEnd(); ++i)
+    _confCache.insert(i.key().toLower(), i.value());
+}
+
+/** Discards the cached configuration. */
+void
+TorControl::clearConfCache()
+{
+  _confCache.clear();
+  _confSnapshotLoaded = false;
+}
+
+/** Removes the option <b>key</b> from the cached configuration, so the next
+ * cachedConf() asks Tor for its new value. */
+void
+TorControl::uncacheConf(const QString &key)
+{
+  _confCache.remove(key.toLower());
+}
+
+/** Called when Tor reports that its configuration changed. Changed options
+ * are updated in the cache and options reset to their defaults are removed,
+ * since Tor doesn't say what the default is. */
+void
+TorControl::onConfChanged(const QVariantMap &changes)
+{
+  if (_confSnapshotLoaded) {
+    QVariantMap::const_iterator i;
+    for (i = changes.constBegin(); i != changes.constEnd(); ++i) {
+      if (i.value().isValid())
+        _confCache.insert(i.key().toLower(), i.value());
+      else
+        _confCache.remove(i.key().toLower());
+    }
+  }
+  emit confChanged(changes);
+}
+
 /** Sends a GETCONF message to Tor with the single key and returns a QString
  * containing the value returned by Tor */
 QString
@@ -929,6 +1432,7 @@ TorControl::resetConf(QStringList keys, QString *errmsg)
   /* Add each key to the argument list */
   foreach (QString key, keys) {
     cmd.addArgument(key);
+    uncacheConf(key);
   }
   return send(cmd, errmsg);
 }
@@ -960,6 +1464,83 @@ TorControl::getRouterDescriptor(const QString &id, QString *errmsg)
   return RouterDescriptor(getRouterDescriptorText(id, errmsg));
 }
 
+/** Requests the descriptor for the router whose fingerprint matches
+ * <b>id</b> without waiting for Tor's response. */
+PendingReply*
+TorControl::getRouterDescriptorAsync(const QString &id)
+{
+  return getInfoAsync(QStringList() << ("desc/id/" + id));
+}
+
+/** Returns the descriptor contained in the finished reply to a
+ * getRouterDescriptorAsync() request. If the command failed or the
+ * descriptor cannot be parsed, then an invalid RouterDescriptor is
+ * returned. */
+RouterDescriptor
+TorControl::getRouterDescriptor(PendingReply *pending, QString *errmsg)
+{
+  QVariantMap map = getInfo(pending, errmsg);
+  if (map.isEmpty())
+    return RouterDescriptor();
+  return RouterDescriptor(map.constBegin().value().toStringList());
+}
+
+/** Returns a RouterDescriptor for every router whose most recent descriptor
+ * Tor knows about, keyed by router ID. All descriptors are fetched with a
+ * single "GETINFO desc/all-recent" instead of one request per router. If the
+ * descriptors cannot be retrieved, then an empty RouterDescriptorMap is
+ * returned. */
+RouterDescriptorMap
+TorControl::getRouterDescriptors(QString *errmsg)
+{
+  RouterDescriptorMap descriptors;
+  parse_router_descriptors(getInfo("desc/all-recent", errmsg).toStringList(),
+                           descriptors);
+  return descriptors;
+}
+
+/** Returns the descriptors for each router whose fingerprint is listed in
+ * <b>ids</b>, keyed by router ID. All "desc/id/" keys are packed into a
+ * single GETINFO. Tor rejects the entire request over the first key it has
+ * no descriptor for, naming that key, so the request is retried without it,
+ * up to MAX_DESCRIPTOR_REQUESTS times in all. If every descriptor is still
+ * not available by then, such as on a client that only fetches
+ * microdescriptors, nothing is returned. */
+RouterDescriptorMap
+TorControl::getRouterDescriptors(const QStringList &ids, QString *errmsg)
+{
+  RouterDescriptorMap descriptors;
+  QStringList keys;
+  QString str;
+
+  foreach (QString id, ids) {
+    keys << ("desc/id/" + id);
+  }
+
+  for (int i = 0; i < MAX_DESCRIPTOR_REQUESTS && !keys.isEmpty(); i++) {
+    QVariantMap map = getInfo(keys, &str);
+    if (! map.isEmpty()) {
+      foreach (QString key, keys) {
+        parse_router_descriptors(map.value(key).toStringList(), descriptors);
+      }
+      return descriptors;
+    }
+
+    /* The error reads 'Unrecognized key "desc/id/..."' */
+    int start = str.indexOf("\"desc/id/");
+    int end = str.indexOf('"', start + 1);
+    if (start < 0 || end < 0 || !keys.removeAll(str.mid(start+1, end-start-1)))
+      break;
+  }
+  if (! keys.isEmpty()) {
+    tc::debug("Unable to get the descriptors of %1 routers: %2")
+                                                  .arg(keys.size()).arg(str);
+  }
+  if (errmsg)
+    *errmsg = str;
+  return descriptors;
+}
+
 /** Returns the status of the router whose fingerprint matches <b>id</b>. If
  * <b>id</b> is invalid or the router's status cannot be parsed, then an
  * invalid RouterStatus is returned. */
@@ -976,25 +1557,7 @@ TorControl::getRouterStatus(const QString &id, QString *errmsg)
 NetworkStatus
 TorControl::getNetworkStatus(QString *errmsg)
 {
-  QStringList networkStatusLines = getInfo("ns/all", errmsg).toStringList();
-  QList<RouterStatus> networkStatus;
-  int len = networkStatusLines.size();
-  int i = 0;
-
-  while (i < len) {
-    /* Extract the "r", "s", and whatever other status lines */
-    QStringList routerStatusLines;
-    do {
-      routerStatusLines << networkStatusLines.at(i);
-    } while (++i < len && ! networkStatusLines.at(i).startsWith("r "));
-
-    /* Create a new RouterStatus object and add it to the network status, if
-     * it's valid. */
-    RouterStatus routerStatus(routerStatusLines);
-    if (routerStatus.isValid())
-      networkStatus << routerStatus;
-  }
-  return networkStatus;
+  return parse_network_status(getInfo("ns/all", errmsg).toStringList());
 }
 
 /** Returns the annotations for the router whose fingerprint matches
@@ -1134,6 +1697,52 @@ TorControl::ipToCountry(const QHostAddress &ip, QString *errmsg)
   return QString();
 }
 
+/** Gets the ISO-3166 two-letter country codes for every address in
+ * <b>ips</b> from Tor. The addresses are split into batches of at most
+ * MAX_IP_TO_COUNTRY_KEYS "ip-to-country/" keys, all of which are sent
+ * before waiting for the first reply. If Tor rejects a batch, the addresses
+ * in it are looked up one at a time. Returns a map of each address (as a
+ * string) to its country code. */
+QHash<QString,QString>
+TorControl::ipToCountry(const QList<QHostAddress> &ips, QString *errmsg)
+{
+  QHash<QString,QString> countries;
+  QList<PendingReply *> pending;
+  QList<QStringList> batches;
+  QStringList keys;
+
+  foreach (QHostAddress ip, ips) {
+    keys << QString("ip-to-country/%1").arg(ip.toString());
+    if (keys.size() == MAX_IP_TO_COUNTRY_KEYS) {
+      batches << keys;
+      keys.clear();
+    }
+  }
+  if (! keys.isEmpty())
+    batches << keys;
+
+  foreach (QStringList batch, batches) {
+    pending << getInfoAsync(batch);
+  }
+
+  for (int i = 0; i < batches.size(); i++) {
+    QVariantMap map = getInfo(pending.at(i), errmsg);
+    delete pending.at(i);
+
+    foreach (QString key, batches.at(i)) {
+      QString ip = key.mid(key.indexOf("/") + 1);
+      QString countryCode;
+      if (! map.isEmpty())
+        countryCode = map.value(key).toString();
+      else
+        countryCode = ipToCountry(QHostAddress(ip));
+      if (! countryCode.isEmpty())
+        countries.insert(ip, countryCode);
+    }
+  }
+  return countries;
+}
+
 /** Takes ownership of the tor process it's communicating to */
 bool
 TorControl::takeOwnership(QString *errmsg)
@@ -18,6 +18,7 @@
 
 #include "tcglobal.h"
 #include "ControlConnection.h"
+#include "TorEventWorker.h"
 #include "TorProcess.h"
 #include "TorEvents.h"
 #include "TorSignal.h"
@@ -35,9 +36,11 @@
 
 #include <QObject>
 #include <QHash>
+#include <QMap>
 #include <QList>
 #include <QStringList>
 #include <QVariantMap>
+#include <QTimer>
 
 class ProtocolInfo;
 
@@ -75,6 +78,9 @@ public:
   void disconnect();
   /** Check if we're connected to Tor's control socket */
   bool isConnected();
+  /** Returns true if the controller has authenticated to Tor since the
+   * control connection was opened. */
+  bool isAuthenticated();
   /** Sends an authentication cookie to Tor. */
   bool authenticate(const QByteArray cookie, QString *errmsg = 0);
   /** Sends an authentication password to Tor. */
@@ -103,6 +109,14 @@ public:
    * QVariant containing the value returned by Tor. Returns a default
    * constructed QVariant on failure. */
   QVariant getInfo(const QString &key, QString *errmsg = 0);
+  /** Sends a GETINFO message to Tor using the given list of <b>keys</b>
+   * without waiting for the reply. The result can be retrieved with
+   * getInfo(PendingReply *) once the returned PendingReply has finished. */
+  PendingReply* getInfoAsync(const QStringList &keys);
+  /** Returns a QVariantMap containing the keys and values in the reply to a
+   * previous getInfoAsync(), blocking if the reply has not arrived yet.
+   * Returns a default constructed QVariantMap on failure. */
+  static QVariantMap getInfo(PendingReply *pending, QString *errmsg = 0);
 
   /** Sends a signal to Tor */
   bool signal(TorSignal::Signal sig, QString *errmsg = 0);
@@ -132,6 +146,37 @@ public:
                 QString *errmsg = 0);
   /** Register events of interest with Tor */
   bool setEvents(QString *errmsg = 0);
+  /** Adds <b>events</b> to the events <b>consumer</b> is interested in.
+   * Each event stays registered with Tor for as long as at least one
+   * consumer (or setEvent()) asks for it. Changes are registered once
+   * control returns to the event loop, so a burst of calls sends at most one
+   * SETEVENTS command, and none if the registered events don't change. A
+   * consumer's events are released when it is destroyed. */
+  void subscribeEvents(QObject *consumer, TorEvents::Events events);
+  /** Removes <b>events</b> from the events <b>consumer</b> is interested
+   * in. Events no other consumer wants are unregistered with Tor. */
+  void unsubscribeEvents(QObject *consumer, TorEvents::Events events);
+  /** Returns true if the version of Tor we're connected to can send events
+   * of type <b>e</b>. Events it can't send are left out when registering
+   * events with Tor. */
+  bool supportsEvent(TorEvents::Event e);
+  /** Sets the interval, in milliseconds, over which circuit, stream and log
+   * events are collected and delivered through circuitStatusesChanged(),
+   * streamStatusesChanged() and logMessages() instead of one signal per
+   * event. Repeated status changes of a circuit or stream within an
+   * interval are collapsed into its latest status. An interval of zero
+   * (the default) disables batching. */
+  void setEventBatchInterval(int msecs);
+  /** Enables or disables a second control connection that carries only
+   * asynchronous events, so that a flood of events never delays the reply
+   * to a command. When enabled, the event connection is opened and
+   * authenticated with the same credentials each time the controller
+   * authenticates, and all events are registered on it. If it cannot be
+   * set up, events are received on the command connection as usual. */
+  void setSeparateEventConnection(bool enabled);
+  /** Returns a histogram of the round-trip time of every command sent on
+   * the command connection since it was last opened. */
+  LatencyHistogram* commandLatency();
 
   /** Sets each configuration key in <b>map</b> to the value associated with its key. */
   bool setConf(QHash<QString,QString> map, QString *errmsg = 0);
@@ -157,6 +202,26 @@ public:
    * QVariant containing the value returned by Tor. Returns a default
    * constructed QVariant on failure. */
   QVariant getConf(const QString &key, QString *errmsg = 0);
+  /** Sends a GETCONF message to Tor using the given list of <b>keys</b>
+   * without waiting for the reply. The result can be retrieved with
+   * getConf(PendingReply *) once the returned PendingReply has finished. */
+  PendingReply* getConfAsync(const QStringList &keys);
+  /** Returns a QVariantMap containing the keys and values in the reply to a
+   * previous getConfAsync(), blocking if the reply has not arrived yet.
+   * Returns a default constructed QVariantMap on failure. */
+  static QVariantMap getConf(PendingReply *pending, QString *errmsg = 0);
+  /** Returns the value of the configuration option <b>key</b> from a cached
+   * copy of Tor's configuration. The first call after connecting fetches
+   * every option with a single GETCONF; the copy is then kept current from
+   * CONF_CHANGED events and from changes made through this object. Options
+   * with several values are returned as a QStringList. Returns a default
+   * constructed QVariant on failure. */
+  QVariant cachedConf(const QString &key, QString *errmsg = 0);
+  /** Discards the cached configuration unless Tor reports changes to it
+   * with CONF_CHANGED events, which Tor versions before 0.2.3.3-alpha
+   * don't. Call this before reading options that another controller may
+   * have changed. */
+  void expireConfCache();
   /** Sends a GETCONF message to Tor with the single key and returns a QString
    * containing the value returned by Tor */
   QString getHiddenServiceConf(const QString &key, QString *errmsg = 0);
@@ -177,6 +242,26 @@ public:
    * <b>id</b>. If <b>id</b> is invalid or the router's descriptor cannot be
    * parsed, then an invalid RouterDescriptor is returned. */
   RouterDescriptor getRouterDescriptor(const QString &id, QString *errmsg = 0);
+  /** Requests the descriptor for the router whose fingerprint matches
+   * <b>id</b> without waiting for the reply. The descriptor can be retrieved
+   * with getRouterDescriptor(PendingReply *). */
+  PendingReply* getRouterDescriptorAsync(const QString &id);
+  /** Returns the descriptor in the reply to a previous
+   * getRouterDescriptorAsync(), blocking if the reply has not arrived yet.
+   * Returns an invalid RouterDescriptor on failure. */
+  static RouterDescriptor getRouterDescriptor(PendingReply *pending,
+                                              QString *errmsg = 0);
+  /** Returns a RouterDescriptor for every router whose most recent
+   * descriptor Tor knows about, fetched with a single GETINFO request and
+   * keyed by router ID. If the descriptors cannot be retrieved, then an
+   * empty RouterDescriptorMap is returned. */
+  RouterDescriptorMap getRouterDescriptors(QString *errmsg = 0);
+  /** Returns the descriptors for each router whose fingerprint is listed in
+   * <b>ids</b>, keyed by router ID. All descriptors are requested in a single
+   * GETINFO if possible. Routers whose descriptors are unavailable are
+   * omitted from the result, as is every router if more than a few are. */
+  RouterDescriptorMap getRouterDescriptors(const QStringList &ids,
+                                           QString *errmsg = 0);
   /** Returns the status of the router whose fingerprint matches <b>id</b>. If
    * <b>id</b> is invalid or the router's status cannot be parsed, then an
    * invalid RouterStatus is returned. */
@@ -208,6 +293,12 @@ public:
    * is not known for <b>ip</b>. On failure, <b>errmsg</b> will be set if
    * it's not NULL. */
   QString ipToCountry(const QHostAddress &ip, QString *errmsg = 0);
+  /** Gets the ISO-3166 two-letter country codes for every address in
+   * <b>ips</b> from Tor, packing many addresses into each GETINFO request.
+   * Returns a map of each address (as a string) to its country code.
+   * Addresses whose country code is not known are omitted. */
+  QHash<QString,QString> ipToCountry(const QList<QHostAddress> &ips,
+                                     QString *errmsg = 0);
 
   /** Takes ownership of the tor process it's communicating to */
   bool takeOwnership(QString *errmsg);
@@ -245,6 +336,12 @@ signals:
    */
   void logMessage(tc::Severity level, const QString &msg);
 
+  /** Emitted instead of logMessage() when event batching is enabled, with
+   * every log message received during the last batch interval.
+   * \sa setEventBatchInterval()
+   */
+  void logMessages(const LogEventList &messages);
+
   /** Emitted when Tor sends a bandwidth usage update (roughly once every
    * second). <b>bytesReceived</b> is the number of bytes read by Tor over
    * the previous second and <b>bytesWritten</b> is the number of bytes
@@ -260,6 +357,21 @@ signals:
    */
   void circuitStatusChanged(const Circuit &circuit);
 
+  /** Emitted instead of circuitStatusChanged() when event batching is
+   * enabled, with the latest status of each circuit that changed during the
+   * last batch interval.
+   * \sa setEventBatchInterval()
+   */
+  void circuitStatusesChanged(const CircuitList &circuits);
+
+  /** Emitted instead of streamStatusChanged() when event batching is
+   * enabled, with the latest status of each stream that changed during the
+   * last batch interval. This always follows circuitStatusesChanged() for
+   * the same interval.
+   * \sa setEventBatchInterval()
+   */
+  void streamStatusesChanged(const StreamList &streams);
+
   /** Emitted when Tor has mapped the address <b>from</b> to the address
    * <b>to</b>. <b>expires</b> indicates the time at which when the address
    * mapping will no longer be considered valid.
@@ -272,6 +384,24 @@ signals:
    */
   void newDescriptors(const QStringList &ids);
 
+  /** Emitted when Tor's configuration has changed, after the configuration
+   * cache has been updated. <b>changes</b> maps each changed option to its
+   * new value, or to an invalid QVariant if it was reset to its default.
+   * Requires Tor 0.2.3.3-alpha or later.
+   */
+  void confChanged(const QVariantMap &changes);
+
+  /** Emitted when Tor has a new consensus. <b>consensus</b> contains the
+   * status of every router listed in it. Requires Tor 0.2.1.13-alpha or
+   * later.
+   */
+  void newConsensus(const NetworkStatus &consensus);
+
+  /** Emitted when Tor's view of the status of one or more routers has
+   * changed. <b>changes</b> contains the new status of only those routers.
+   */
+  void networkStatusChanged(const NetworkStatus &changes);
+
   /** Indicates Tor has been able to successfully establish one or more
    * circuits.
    */
@@ -379,13 +509,49 @@ signals:
 private:
   /** Instantiates a connection used to talk to Tor's control port */
   ControlConnection* _controlConn;
+  /** Optional second connection to Tor's control port that only carries
+   * event registrations and asynchronous events. */
+  ControlConnection* _eventConn;
+  /** Set if the event connection should be used. */
+  bool _useEventConn;
+  /** Set once the event connection is authenticated and events should be
+   * registered on it. */
+  bool _eventConnReady;
+  /** The AUTHENTICATE command that was last accepted by Tor, used to
+   * authenticate the event connection. */
+  ControlCommand _authCommand;
+  /** Address, port or socket path of Tor's control interface. */
+  QHostAddress _controlAddr;
+  quint16 _controlPort;
+  QString _controlPath;
   /** Manages and monitors the Tor process */
   TorProcess* _torProcess;
   /** Keep track of which events we're interested in */
   TorEvents* _eventHandler;
+  /** Parses the asynchronous events read by both connections, one at a
+   * time. */
+  TorEventWorker* _eventWorker;
   TorEvents::Events _events;
+  /** Events each consumer has asked for with subscribeEvents(). */
+  QHash<QObject*,TorEvents::Events> _subscribers;
+  /** Number of consumers subscribed to each event. */
+  QMap<TorEvents::Event,int> _eventRefs;
+  /** Events at least one consumer is subscribed to. */
+  TorEvents::Events _subscribedEvents;
+  /** Events Tor accepted in the last SETEVENTS command. */
+  TorEvents::Events _registeredEvents;
+  /** Timer that registers changed subscriptions with Tor. */
+  QTimer _updateEventsTimer;
+  /** Set once the controller has authenticated to Tor. */
+  bool _authenticated;
   /** The version of Tor we're currently talking to. */
   QString _torVersion;
+  /** Cached configuration options, keyed by lowercase option name. */
+  QHash<QString,QVariant> _confCache;
+  /** Set once the whole configuration has been requested for _confCache. */
+  bool _confSnapshotLoaded;
+  /** Set if Tor reports configuration changes with CONF_CHANGED events. */
+  bool _confChangedEnabled;
   ControlMethod::Method _method;
 #if defined(Q_OS_WIN32)
   /** Manages the Tor service, if supported and enabled */
@@ -396,6 +562,32 @@ private:
   bool send(ControlCommand cmd, ControlReply &reply, QString *errmsg = 0);
   /** Send a message to Tor and discard the response */
   bool send(ControlCommand cmd, QString *errmsg = 0);
+  /** Send a message to Tor on <b>conn</b> and read the response */
+  bool send(ControlConnection *conn, ControlCommand cmd, ControlReply &reply,
+            QString *errmsg = 0);
+  /** Opens the event connection, if it is enabled and not already open. */
+  void connectEventConnection();
+  /** Waits for <b>pending</b> to finish and copies Tor's reply into
+   * <b>reply</b>. Returns true if the reply's status is 250 OK. */
+  static bool checkReply(PendingReply *pending, ControlReply &reply,
+                         QString *errmsg = 0);
+  /** Parses the keys and values in a successful GETINFO <b>reply</b>. */
+  static QVariantMap parseInfoReply(const ControlReply &reply);
+  /** Parses the keys and values in a successful GETCONF <b>reply</b>. */
+  static QVariantMap parseConfReply(const ControlReply &reply);
+  /** Fetches every configuration option into the configuration cache. */
+  void loadConfSnapshot();
+  /** Discards the cached configuration. */
+  void clearConfCache();
+  /** Removes the option <b>key</b> from the configuration cache. */
+  void uncacheConf(const QString &key);
+  /** Returns the events that should be registered with Tor: those set with
+   * setEvent() or subscribed to by a consumer, and CONF_CHANGED, without
+   * any the running version of Tor can't send. */
+  TorEvents::Events eventsToRegister();
+  /** Adds <b>delta</b> to the number of consumers subscribed to each event
+   * in <b>events</b>. */
+  void refEvents(TorEvents::Events events, int delta);
   /** Tells Tor the controller wants to enable <b>feature</b> via the
    * USEFEATURE control command. Returns true if the given feature was
    * successfully enabled. */
@@ -408,6 +600,12 @@ private slots:
   void onDisconnected();
   void onLogStdout(const QString &severity, const QString &message);
   void onAuthenticated();
+  void onEventConnectionConnected();
+  void onEventConnectionFailed(const QString &errmsg);
+  void onEventConnectionClosed();
+  void onConfChanged(const QVariantMap &changes);
+  void updateEvents();
+  void onConsumerDestroyed(QObject *consumer);
 };
 
 #endif
@@ -0,0 +1,147 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file TorEventBatcher.cpp
+** \brief Coalesces high-volume asynchronous events into periodic batches
+*/
+
+#include "TorEventBatcher.h"
+
+#include <QMutexLocker>
+
+
+/** Constructor. */
+TorEventBatcher::TorEventBatcher(QObject *parent)
+  : QObject(parent)
+{
+  qRegisterMetaType<CircuitList>("CircuitList");
+  qRegisterMetaType<StreamList>("StreamList");
+  qRegisterMetaType<LogEventList>("LogEventList");
+
+  _interval = 0;
+  _flushPending = false;
+  _timer.setSingleShot(true);
+  connect(&_timer, SIGNAL(timeout()), this, SLOT(flush()));
+}
+
+/** Sets the batching interval to <b>msecs</b> milliseconds. */
+void
+TorEventBatcher::setInterval(int msecs)
+{
+  _mutex.lock();
+  _interval = qMax(0, msecs);
+  _mutex.unlock();
+
+  if (msecs <= 0)
+    flush();
+}
+
+/** Returns the current batching interval, in milliseconds. */
+int
+TorEventBatcher::interval()
+{
+  QMutexLocker locker(&_mutex);
+  return _interval;
+}
+
+/** Adds <b>circuit</b> to the current batch. */
+void
+TorEventBatcher::addCircuit(const Circuit &circuit)
+{
+  QMutexLocker locker(&_mutex);
+  if (_circuitIndex.contains(circuit.id())) {
+    _circuits[_circuitIndex.value(circuit.id())] = circuit;
+  } else {
+    _circuitIndex.insert(circuit.id(), _circuits.size());
+    _circuits << circuit;
+  }
+  requestFlush();
+}
+
+/** Adds <b>stream</b> to the current batch. */
+void
+TorEventBatcher::addStream(const Stream &stream)
+{
+  QMutexLocker locker(&_mutex);
+  if (_streamIndex.contains(stream.id())) {
+    _streams[_streamIndex.value(stream.id())] = stream;
+  } else {
+    _streamIndex.insert(stream.id(), _streams.size());
+    _streams << stream;
+  }
+  requestFlush();
+}
+
+/** Adds a log message to the current batch. */
+void
+TorEventBatcher::addLogMessage(tc::Severity severity, const QString &msg)
+{
+  QMutexLocker locker(&_mutex);
+  _logMessages << LogEvent(severity, msg);
+  requestFlush();
+}
+
+/** Asks the batcher's thread to start the flush timer. Since the timer can
+ * only be started from the thread it lives in, this posts a queued call
+ * rather than starting it directly. */
+void
+TorEventBatcher::requestFlush()
+{
+  if (!_flushPending) {
+    _flushPending = true;
+    QMetaObject::invokeMethod(this, "scheduleFlush", Qt::QueuedConnection);
+  }
+}
+
+/** Starts the flush timer, if it is not already running. */
+void
+TorEventBatcher::scheduleFlush()
+{
+  int msecs = interval();
+  if (msecs > 0) {
+    if (!_timer.isActive())
+      _timer.start(msecs);
+  } else {
+    flush();
+  }
+}
+
+/** Delivers all accumulated events. Circuits are delivered before streams,
+ * so that streams attached to a circuit created in the same interval can
+ * find their circuit. */
+void
+TorEventBatcher::flush()
+{
+  CircuitList circuits;
+  StreamList streams;
+  LogEventList messages;
+
+  _mutex.lock();
+  circuits = _circuits;
+  streams = _streams;
+  messages = _logMessages;
+  _circuits.clear();
+  _circuitIndex.clear();
+  _streams.clear();
+  _streamIndex.clear();
+  _logMessages.clear();
+  _flushPending = false;
+  _mutex.unlock();
+
+  _timer.stop();
+  if (!circuits.isEmpty())
+    emit circuitStatusesChanged(circuits);
+  if (!streams.isEmpty())
+    emit streamStatusesChanged(streams);
+  if (!messages.isEmpty())
+    emit logMessages(messages);
+}
+
@@ -0,0 +1,114 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file TorEventBatcher.h
+** \brief Coalesces high-volume asynchronous events into periodic batches
+*/
+
+#ifndef _TOREVENTBATCHER_H
+#define _TOREVENTBATCHER_H
+
+#include "tcglobal.h"
+#include "Circuit.h"
+#include "Stream.h"
+
+#include <QObject>
+#include <QMutex>
+#include <QTimer>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QMetaType>
+
+/** A log message received from Tor and its severity. */
+typedef QPair<tc::Severity,QString> LogEvent;
+/** A list of log messages received from Tor, in the order they arrived. */
+typedef QList<LogEvent> LogEventList;
+Q_DECLARE_METATYPE(CircuitList);
+Q_DECLARE_METATYPE(StreamList);
+Q_DECLARE_METATYPE(LogEventList);
+
+
+/** A TorEventBatcher collects circuit, stream and log events as they are
+ * parsed on the control connection's thread, and delivers them to the
+ * thread the batcher lives in at most once per interval. A circuit or
+ * stream that changes state several times within one interval is only
+ * delivered in its latest state, so widgets can apply a whole burst of
+ * events in a single update.
+ */
+class TorEventBatcher : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor. Batching is disabled until setInterval() is called with a
+   * positive interval. */
+  TorEventBatcher(QObject *parent = 0);
+
+  /** Sets the number of milliseconds over which events are accumulated
+   * before being delivered. An interval of zero disables batching and
+   * delivers any events already accumulated. */
+  void setInterval(int msecs);
+  /** Returns the current batching interval, in milliseconds. */
+  int interval();
+  /** Returns true if events should be handed to this batcher rather than
+   * emitted individually. */
+  bool isEnabled() { return (interval() > 0); }
+
+  /** Adds <b>circuit</b> to the current batch, replacing any earlier status
+   * of the same circuit in that batch. This may be called from any thread. */
+  void addCircuit(const Circuit &circuit);
+  /** Adds <b>stream</b> to the current batch, replacing any earlier status
+   * of the same stream in that batch. This may be called from any thread. */
+  void addStream(const Stream &stream);
+  /** Adds the log message <b>msg</b> with severity <b>severity</b> to the
+   * current batch. This may be called from any thread. */
+  void addLogMessage(tc::Severity severity, const QString &msg);
+
+public slots:
+  /** Delivers all accumulated events immediately. */
+  void flush();
+
+signals:
+  /** Emitted with the latest status of every circuit that changed during
+   * the last interval, in the order in which they first changed. */
+  void circuitStatusesChanged(const CircuitList &circuits);
+  /** Emitted with the latest status of every stream that changed during
+   * the last interval, in the order in which they first changed. This is
+   * always emitted after circuitStatusesChanged() for the same interval. */
+  void streamStatusesChanged(const StreamList &streams);
+  /** Emitted with every log message received during the last interval. */
+  void logMessages(const LogEventList &messages);
+
+private slots:
+  /** Starts the flush timer, if it is not already running. This is always
+   * invoked in the batcher's own thread. */
+  void scheduleFlush();
+
+private:
+  /** Requests a flush from the batcher's thread, unless one is already
+   * pending. Must be called with <b>_mutex</b> held. */
+  void requestFlush();
+
+  QMutex _mutex;    /**< Protects everything below. */
+  int _interval;    /**< Batching interval, in milliseconds. */
+  bool _flushPending; /**< True if a flush has been requested. */
+  QTimer _timer;    /**< Single-shot timer that triggers the next flush. */
+
+  CircuitList _circuits; /**< Circuits changed during this interval. */
+  QHash<CircuitId,int> _circuitIndex; /**< Circuit ID to index in _circuits */
+  StreamList _streams;   /**< Streams changed during this interval. */
+  QHash<StreamId,int> _streamIndex;   /**< Stream ID to index in _streams */
+  LogEventList _logMessages; /**< Log messages received this interval. */
+};
+
+#endif
+
@@ -0,0 +1,108 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file TorEventWorker.cpp
+** \brief Parses asynchronous events from Tor on a dedicated thread
+*/
+
+#include "TorEventWorker.h"
+#include "TorEvents.h"
+#include "tcglobal.h"
+
+#include <QMutexLocker>
+
+/** Maximum number of events waiting to be dispatched. */
+#define MAX_QUEUED_EVENTS  4096
+
+
+/** Constructor. */
+TorEventWorker::TorEventWorker(TorEvents *events, QObject *parent)
+  : QThread(parent)
+{
+  _events = events;
+  _dropped = 0;
+  _stopping = false;
+}
+
+/** Destructor. */
+TorEventWorker::~TorEventWorker()
+{
+  stop();
+}
+
+/** Queues <b>replies</b> to be dispatched on the worker thread. This never
+ * blocks the reading thread: once MAX_QUEUED_EVENTS events are waiting, any
+ * more are dropped and counted until the worker catches up. */
+void
+TorEventWorker::enqueue(const QList<ControlReply> &replies)
+{
+  QMutexLocker locker(&_mutex);
+  foreach (ControlReply reply, replies) {
+    if (_queue.size() < MAX_QUEUED_EVENTS)
+      _queue << reply;
+    else
+      _dropped++;
+  }
+  _waitCond.wakeOne();
+}
+
+/** Asks the worker thread to exit once the queue is empty, and waits for it
+ * to do so. The worker can be started again afterwards. */
+void
+TorEventWorker::stop()
+{
+  _mutex.lock();
+  _stopping = true;
+  _waitCond.wakeOne();
+  _mutex.unlock();
+
+  wait();
+
+  _mutex.lock();
+  _stopping = false;
+  _mutex.unlock();
+}
+
+/** Waits for events and dispatches them. Everything queued is taken in one
+ * go, so the control connection only contends for the mutex once per batch
+ * rather than once per event. */
+void
+TorEventWorker::run()
+{
+  QList<ControlReply> events;
+  quint64 dropped;
+
+  forever {
+    _mutex.lock();
+    while (_queue.isEmpty() && !_stopping)
+      _waitCond.wait(&_mutex);
+    if (_queue.isEmpty()) {
+      _mutex.unlock();
+      break;
+    }
+    events = _queue;
+    _queue.clear();
+    dropped = _dropped;
+    _dropped = 0;
+    _mutex.unlock();
+
+    if (dropped > 0) {
+      tc::warn("Dropped %1 events from Tor that arrived faster than they "
+               "could be handled.").arg(QString::number(dropped));
+    }
+
+    foreach (ControlReply reply, events) {
+      _events->handleEvent(reply);
+    }
+    events.clear();
+  }
+}
+
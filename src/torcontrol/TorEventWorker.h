@@ -0,0 +1,71 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If
+**  you did not receive the LICENSE file with this file, you may obtain it
+**  from the Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file TorEventWorker.h
+** \brief Parses asynchronous events from Tor on a dedicated thread
+*/
+
+#ifndef _TOREVENTWORKER_H
+#define _TOREVENTWORKER_H
+
+#include "ControlReply.h"
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+
+class TorEvents;
+
+
+/** A TorEventWorker takes asynchronous event messages read by one or more
+ * ControlConnections and hands them to TorEvents::handleEvent() on its own
+ * thread, in the order they were queued. This keeps the control
+ * connections' threads free to read command replies while a burst of events
+ * is being parsed, and means TorEvents is only ever used by one thread at a
+ * time. At most MAX_QUEUED_EVENTS events are queued at once; events that
+ * arrive while the queue is full are dropped and reported, rather than
+ * stalling the connection that read them.
+ */
+class TorEventWorker : public QThread
+{
+  Q_OBJECT
+
+public:
+  /** Constructor. Events will be dispatched to <b>events</b>. */
+  TorEventWorker(TorEvents *events, QObject *parent = 0);
+  /** Destructor. Stops the worker thread after it has dispatched every
+   * queued event. */
+  ~TorEventWorker();
+
+  /** Queues <b>replies</b> to be dispatched on the worker thread, dropping
+   * any that don't fit. This may be called from any thread and never
+   * blocks for long. */
+  void enqueue(const QList<ControlReply> &replies);
+  /** Asks the worker thread to exit once the queue is empty, and waits for
+   * it to do so. */
+  void stop();
+
+protected:
+  /** Main thread implementation. */
+  void run();
+
+private:
+  TorEvents *_events; /**< Dispatches parsed events. */
+  QMutex _mutex; /**< Protects everything below. */
+  QWaitCondition _waitCond; /**< Signalled when an event is queued. */
+  QList<ControlReply> _queue; /**< Events waiting to be dispatched. */
+  quint64 _dropped; /**< Events dropped since the last batch. */
+  bool _stopping; /**< Set when the thread should exit. */
+};
+
+#endif
+
@@ -41,9 +41,26 @@ TorEvents::TorEvents(QObject *parent)
   qRegisterMetaType<BootstrapStatus>("BootstrapStatus");
   qRegisterMetaType<Circuit>("Circuit");
   qRegisterMetaType<Stream>("Stream");
+  qRegisterMetaType<NetworkStatus>("NetworkStatus");
 
   qRegisterMetaType<QHostAddress>("QHostAddress");
   qRegisterMetaType<QDateTime>("QDateTime");
+
+  _batcher = new TorEventBatcher(this);
+  connect(_batcher, SIGNAL(circuitStatusesChanged(CircuitList)),
+          this, SIGNAL(circuitStatusesChanged(CircuitList)));
+  connect(_batcher, SIGNAL(streamStatusesChanged(StreamList)),
+          this, SIGNAL(streamStatusesChanged(StreamList)));
+  connect(_batcher, SIGNAL(logMessages(LogEventList)),
+          this, SIGNAL(logMessages(LogEventList)));
+}
+
+/** Sets the interval over which circuit, stream and log events are
+ * batched. */
+void
+TorEvents::setBatchInterval(int msecs)
+{
+  _batcher->setInterval(msecs);
 }
 
 /** Converts an event type to a string Tor understands */
@@ -65,85 +82,168 @@ TorEvents::toString(Event e)
     case GeneralStatus:   event = "STATUS_GENERAL"; break;
     case ClientStatus:    event = "STATUS_CLIENT"; break;
     case ServerStatus:    event = "STATUS_SERVER"; break;
+    case ConfChanged:     event = "CONF_CHANGED"; break;
+    case NewConsensus:    event = "NEWCONSENSUS"; break;
+    case NetworkStatusChanged: event = "NS"; break;
     default: event = "UNKNOWN"; break;
   }
   return event;
 }
 
-/** Converts an event in the string form sent by Tor to its enum value */
+/** Event keywords sent by Tor, in the order of the indices stored in
+ * eventSlots below. */
+static const struct {
+  const char *keyword;
+  int length;
+  TorEvents::Event event;
+} eventKeywords[] = {
+  { "BW",             2,  TorEvents::Bandwidth },
+  { "CIRC",           4,  TorEvents::CircuitStatus },
+  { "STREAM",         6,  TorEvents::StreamStatus },
+  { "DEBUG",          5,  TorEvents::LogDebug },
+  { "INFO",           4,  TorEvents::LogInfo },
+  { "NOTICE",         6,  TorEvents::LogNotice },
+  { "WARN",           4,  TorEvents::LogWarn },
+  { "ERR",            3,  TorEvents::LogError },
+  { "NEWDESC",        7,  TorEvents::NewDescriptor },
+  { "ADDRMAP",        7,  TorEvents::AddressMap },
+  { "STATUS_GENERAL", 14, TorEvents::GeneralStatus },
+  { "STATUS_CLIENT",  13, TorEvents::ClientStatus },
+  { "STATUS_SERVER",  13, TorEvents::ServerStatus },
+  { "CONF_CHANGED",   12, TorEvents::ConfChanged },
+  { "NEWCONSENSUS",   12, TorEvents::NewConsensus },
+  { "NS",             2,  TorEvents::NetworkStatusChanged }
+};
+
+/** Perfect hash of an event keyword with length <b>len</b> and last
+ * character <b>last</b>. Every keyword in eventKeywords hashes to a
+ * different slot, so a lookup costs a single string comparison. If you add
+ * a keyword, make sure it still doesn't collide and update eventSlots. */
+#define EVENT_HASH(len, last)  (((len) + 3*(last)) & 63)
+
+/** Maps each EVENT_HASH() value to an index into eventKeywords, or -1. */
+static const qint8 eventSlots[64] = {
+  -1, -1, -1, 12, -1, 14, -1,  0,
+  -1, 11, -1, -1, -1,  1, -1, -1,
+   8, -1, -1, -1, -1,  5, -1, -1,
+  13, -1,  3, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1, -1, -1, -1,
+  -1, -1, -1, -1, -1,  2,  6, -1,
+  -1,  4, 10, -1, -1, -1, -1,  9,
+  -1,  7, -1, 15, -1, -1, -1, -1
+};
+
+/** Converts the <b>len</b> characters of an event keyword starting at
+ * <b>str</b> to its enum value, without creating a temporary string. */
 TorEvents::Event
-TorEvents::toTorEvent(const QString &event)
+TorEvents::toTorEvent(const QChar *str, int len)
 {
-  Event e;
-  if (event == "BW") {
-    e = Bandwidth;
-  } else if (event == "CIRC") {
-    e = CircuitStatus;
-  } else if (event == "STREAM") {
-    e = StreamStatus;
-  } else if (event == "DEBUG") {
-    e = LogDebug;
-  } else if (event == "INFO") {
-    e = LogInfo;
-  } else if (event == "NOTICE") {
-    e = LogNotice;
-  } else if (event == "WARN") {
-    e = LogWarn;
-  } else if (event == "ERR") {
-    e = LogError;
-  } else if (event == "NEWDESC") {
-    e = NewDescriptor;
-  } else if (event == "ADDRMAP") {
-    e = AddressMap;
-  } else if (event == "STATUS_GENERAL") {
-    e = GeneralStatus;
-  } else if (event == "STATUS_CLIENT") {
-    e = ClientStatus;
-  } else if (event == "STATUS_SERVER") {
-    e = ServerStatus;
-  } else {
-    e = Unknown;
+  if (len <= 0)
+    return Unknown;
+
+  int slot = eventSlots[EVENT_HASH(len, str[len-1].unicode())];
+  if (slot < 0 || eventKeywords[slot].length != len)
+    return Unknown;
+
+  const char *keyword = eventKeywords[slot].keyword;
+  for (int i = 0; i < len; i++) {
+    if (str[i].unicode() != (ushort)keyword[i])
+      return Unknown;
   }
-  return e;
+  return eventKeywords[slot].event;
 }
 
-/** Parse the event type out of a message line and return the corresponding
- * Event enum value */
+/** Converts an event in the string form sent by Tor to its enum value */
 TorEvents::Event
-TorEvents::parseEventType(const ReplyLine &line)
+TorEvents::toTorEvent(const QString &event)
 {
-  QString msg = line.getMessage();
-  int i = msg.indexOf(" ");
-  return toTorEvent(msg.mid(0, i));
+  return toTorEvent(event.constData(), event.length());
+}
+
+/** Splits <b>str</b>, starting at <b>from</b>, into space-separated tokens
+ * in a single pass. Quoted strings are kept intact (including their quotes)
+ * as a single token. If <b>max</b> is greater than zero, then at most
+ * <b>max</b> tokens are returned and the last one contains the remainder of
+ * the string. */
+QStringList
+TorEvents::tokenize(const QString &str, int from, int max)
+{
+  QStringList tokens;
+  const QChar *buf = str.constData();
+  int len = str.length();
+  int i = from;
+
+  while (i < len) {
+    while (i < len && buf[i] == QLatin1Char(' '))
+      i++;
+    if (i >= len)
+      break;
+
+    int start = i;
+    if (max > 0 && tokens.size() == max-1) {
+      tokens << str.mid(start);
+      break;
+    }
+
+    bool quoted = false;
+    while (i < len && (quoted || buf[i] != QLatin1Char(' '))) {
+      if (buf[i] == QLatin1Char('\\') && quoted)
+        i++;
+      else if (buf[i] == QLatin1Char('\"'))
+        quoted = !quoted;
+      i++;
+    }
+    tokens << str.mid(start, qMin(i, len) - start);
+  }
+  return tokens;
 }
 
 /** Handles an event message from Tor. An event message can potentially have
  * more than one line, so we will iterate through them all and dispatch the
- * necessary events. */
+ * necessary events. The event keyword is matched in place and each handler
+ * is given the offset of the event's arguments in the message, so the
+ * message is only scanned once. */
 void
 TorEvents::handleEvent(const ControlReply &reply)
 {
-  foreach(ReplyLine line, reply.getLines()) {
-    switch (parseEventType(line)) {
-      case Bandwidth:      handleBandwidthUpdate(line); break;
-      case CircuitStatus:  handleCircuitStatus(line); break;
-      case StreamStatus:   handleStreamStatus(line); break;
-      case NewDescriptor:  handleNewDescriptor(line); break;
-      case AddressMap:     handleAddressMap(line); break;
+  const QList<ReplyLine> lines = reply.getLines();
+
+  for (int i = 0; i < lines.size(); i++) {
+    const ReplyLine &line = lines.at(i);
+    QString msg = line.getMessage();
+    int len = msg.indexOf(QLatin1Char(' '));
+    if (len < 0)
+      len = msg.length();
+    int pos = len + 1;
+
+    Event e = toTorEvent(msg.constData(), len);
+    switch (e) {
+      case Bandwidth:      handleBandwidthUpdate(msg, pos); break;
+      case CircuitStatus:  handleCircuitStatus(msg, pos); break;
+      case StreamStatus:   handleStreamStatus(msg, pos); break;
+      case NewDescriptor:  handleNewDescriptor(msg, pos); break;
+      case AddressMap:     handleAddressMap(msg, pos); break;
+
+      case NewConsensus:
+      case NetworkStatusChanged:
+        handleNetworkStatus(e, line); break;
+
+      case ConfChanged:
+        /* The remaining lines are the changed options, not events */
+        handleConfChanged(lines, i+1);
+        return;
 
       case GeneralStatus:
-        handleStatusEvent(GeneralStatus, line); break;
       case ClientStatus:
-        handleStatusEvent(ClientStatus, line); break;
       case ServerStatus:
-        handleStatusEvent(ServerStatus, line); break;
+        handleStatusEvent(e, msg, pos); break;
 
       case LogDebug: 
       case LogInfo:
       case LogNotice:
       case LogWarn:
       case LogError:
-        handleLogMessage(line); break;
+        handleLogMessage(e, line, pos); break;
       default: break;
     }
   }
@@ -157,12 +257,12 @@ TorEvents::handleEvent(const ControlReply &reply)
  *     BytesWritten = 1*DIGIT
  */
 void
-TorEvents::handleBandwidthUpdate(const ReplyLine &line)
+TorEvents::handleBandwidthUpdate(const QString &msg, int pos)
 {
-  QStringList msg = line.getMessage().split(" ");
-  if (msg.size() >= 3) {
-    quint64 bytesIn = (quint64)msg.at(1).toULongLong();
-    quint64 bytesOut = (quint64)msg.at(2).toULongLong();
+  QStringList args = tokenize(msg, pos);
+  if (args.size() >= 2) {
+    quint64 bytesIn = (quint64)args.at(0).toULongLong();
+    quint64 bytesOut = (quint64)args.at(1).toULongLong();
   
     /* Post the event to each of the interested targets */
     emit bandwidthUpdate(bytesIn, bytesOut);
@@ -181,14 +281,16 @@ TorEvents::handleBandwidthUpdate(const ReplyLine &line)
  *    Path = ServerID *("," ServerID)
  */
 void
-TorEvents::handleCircuitStatus(const ReplyLine &line)
+TorEvents::handleCircuitStatus(const QString &msg, int pos)
 {
-  QString msg = line.getMessage().trimmed();
-  int i = msg.indexOf(" ") + 1;
-  if (i > 0) {
+  if (pos < msg.length()) {
     /* Post the event to each of the interested targets */
-    Circuit circ(msg.mid(i));
-    if (circ.isValid())
+    Circuit circ(msg.mid(pos));
+    if (! circ.isValid())
+      return;
+    if (_batcher->isEnabled())
+      _batcher->addCircuit(circ);
+    else
       emit circuitStatusChanged(circ);
   }
 }
@@ -210,13 +312,15 @@ TorEvents::handleCircuitStatus(const ReplyLine &line)
  *  If the circuit ID is 0, then the stream is unattached.      
  */
 void
-TorEvents::handleStreamStatus(const ReplyLine &line)
+TorEvents::handleStreamStatus(const QString &msg, int pos)
 {
-  QString msg = line.getMessage().trimmed();
-  int i  = msg.indexOf(" ") + 1;
-  if (i > 0) {
-    Stream stream = Stream::fromString(msg.mid(i));
-    if (stream.isValid())
+  if (pos < msg.length()) {
+    Stream stream = Stream::fromString(msg.mid(pos));
+    if (! stream.isValid())
+      return;
+    if (_batcher->isEnabled())
+      _batcher->addStream(stream);
+    else
       emit streamStatusChanged(stream);
   }
 }
@@ -230,15 +334,28 @@ TorEvents::handleStreamStatus(const ReplyLine &line)
  *     Severity = "DEBUG" / "INFO" / "NOTICE" / "WARN"/ "ERR"
  */
 void
-TorEvents::handleLogMessage(const ReplyLine &line)
+TorEvents::handleLogMessage(Event e, const ReplyLine &line, int pos)
 {
-  QString msg = line.getMessage();
-  int i = msg.indexOf(" ");
-  tc::Severity severity = tc::severityFromString(msg.mid(0, i));
-  QString logLine = (line.getData().size() > 0 ? line.getData().join("\n") :
-                                                 msg.mid(i+1));
+  tc::Severity severity;
+  switch (e) {
+    case LogDebug:  severity = tc::DebugSeverity; break;
+    case LogInfo:   severity = tc::InfoSeverity; break;
+    case LogNotice: severity = tc::NoticeSeverity; break;
+    case LogWarn:   severity = tc::WarnSeverity; break;
+    case LogError:  severity = tc::ErrorSeverity; break;
+    default:        severity = tc::UnrecognizedSeverity; break;
+  }
+
+  QString msg;
+  if (line.hasData())
+    msg = line.getData().join("\n");
+  else
+    msg = line.getMessage().mid(pos);
 
-  emit logMessage(severity, logLine);
+  if (_batcher->isEnabled())
+    _batcher->addLogMessage(severity, msg);
+  else
+    emit logMessage(severity, msg);
 }
 
 /** Handles a new descriptor event. The format for event messages of this type
@@ -247,11 +364,9 @@ TorEvents::handleLogMessage(const ReplyLine &line)
  *   "650" SP "NEWDESC" 1*(SP ServerID)
  */
 void
-TorEvents::handleNewDescriptor(const ReplyLine &line)
+TorEvents::handleNewDescriptor(const QString &msg, int pos)
 {
-  QString descs = line.getMessage();
-  QStringList descList = descs.mid(descs.indexOf(" ")+1).split(" ");
-  emit newDescriptors(descList);
+  emit newDescriptors(tokenize(msg, pos));
 }
 
 /** Handles a new or updated address mapping event. The format for event
@@ -263,17 +378,76 @@ TorEvents::handleNewDescriptor(const ReplyLine &line)
  *   Expiry is expressed as the local time (rather than GMT).
  */
 void
-TorEvents::handleAddressMap(const ReplyLine &line)
+TorEvents::handleAddressMap(const QString &msg, int pos)
 {
-  QStringList msg = line.getMessage().split(" ");
-  if (msg.size() >= 4) {
+  QStringList args = tokenize(msg, pos);
+  if (args.size() >= 3) {
     QDateTime expires;
-    if (msg.size() >= 5 && msg.at(3) != "NEVER")
-      expires = QDateTime::fromString(msg.at(3) + " " + msg.at(4), DATE_FMT);
-    emit addressMapped(msg.at(1), msg.at(2), expires);
+    if (args.at(2) != "NEVER")
+      expires = QDateTime::fromString(args.at(2), DATE_FMT);
+    emit addressMapped(args.at(0), args.at(1), expires);
   }
 }
 
+/** Handles a configuration change event. The format for event messages of
+ * this type is:
+ *
+ *   "650-CONF_CHANGED" CRLF
+ *   *("650-" Keyword ["=" Value] CRLF)
+ *   "650 OK" CRLF
+ *
+ * A keyword without a value means the option was reset to its default.
+ */
+void
+TorEvents::handleConfChanged(const QList<ReplyLine> &lines, int first)
+{
+  QVariantMap changes;
+
+  for (int i = first; i < lines.size(); i++) {
+    QString msg = lines.at(i).getMessage();
+    if (i == lines.size()-1 && msg == "OK")
+      break;
+
+    int index = msg.indexOf(QLatin1Char('='));
+    if (index < 0) {
+      changes.insert(msg, QVariant());
+      continue;
+    }
+    QString key = msg.left(index);
+    QString val = msg.mid(index+1);
+    if (changes.contains(key)) {
+      QStringList values = changes.value(key).toStringList();
+      values << val;
+      changes.insert(key, values);
+    } else {
+      changes.insert(key, val);
+    }
+  }
+  if (!changes.isEmpty())
+    emit confChanged(changes);
+}
+
+/** Handles a new consensus or network status event. The format for event
+ * messages of these types is:
+ *
+ *   "650" "+" ("NEWCONSENSUS" / "NS") CRLF
+ *   1*NetworkStatus
+ *   "." CRLF
+ *   "650" SP "OK" CRLF
+ *
+ * A NEWCONSENSUS event lists every router in the new consensus; an NS event
+ * lists only the routers whose status changed.
+ */
+void
+TorEvents::handleNetworkStatus(Event e, const ReplyLine &line)
+{
+  NetworkStatus networkStatus = parse_network_status(line.getData());
+  if (e == NewConsensus)
+    emit newConsensus(networkStatus);
+  else
+    emit networkStatusChanged(networkStatus);
+}
+
 /** Handles a Tor status event. The format for event messages of this type is:
  *
  *  "650" SP StatusType SP StatusSeverity SP StatusAction
@@ -288,16 +462,19 @@ TorEvents::handleAddressMap(const ReplyLine &line)
  *  StatusValue = 1*(ALNUM / '_')  / QuotedString
  */
 void
-TorEvents::handleStatusEvent(Event e, const ReplyLine &line)
+TorEvents::handleStatusEvent(Event e, const QString &msg, int pos)
 {
   QString status;
   tc::Severity severity;
   QHash<QString,QString> args;
-  QString msg = line.getMessage();
-  
-  severity = tc::severityFromString(msg.section(' ', 1, 1));
-  status   = msg.section(' ', 2, 2);
-  args     = string_parse_keyvals(msg.section(' ', 3));
+  QStringList tokens = tokenize(msg, pos, 3);
+  if (tokens.size() < 2)
+    return;
+
+  severity = tc::severityFromString(tokens.at(0));
+  status   = tokens.at(1);
+  if (tokens.size() > 2)
+    args   = string_parse_keyvals(tokens.at(2));
   switch (e) {
     case ClientStatus:
       handleClientStatusEvent(severity, status, args);
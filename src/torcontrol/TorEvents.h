@@ -17,10 +17,14 @@
 #define _TOREVENTS_H
 
 #include "tcglobal.h"
+#include "TorEventBatcher.h"
+#include "RouterStatus.h"
 
 #include <QObject>
 #include <QMultiHash>
 #include <QList>
+#include <QStringList>
+#include <QVariantMap>
 #include <QFlags>
 
 class Circuit;
@@ -55,10 +59,13 @@ public:
     AddressMap    = (1u << 10),
     GeneralStatus = (1u << 11),
     ClientStatus  = (1u << 12),
-    ServerStatus  = (1u << 13)
+    ServerStatus  = (1u << 13),
+    ConfChanged   = (1u << 14),
+    NewConsensus  = (1u << 15),
+    NetworkStatusChanged = (1u << 16)
   };
   static const Event EVENT_MIN = TorEvents::Bandwidth;
-  static const Event EVENT_MAX = TorEvents::ServerStatus;
+  static const Event EVENT_MAX = TorEvents::NetworkStatusChanged;
   Q_DECLARE_FLAGS(Events, Event);
 
   /** Default Constructor */
@@ -70,12 +77,25 @@ public:
   /** Converts an Event to a string */
   static QString toString(TorEvents::Event e);
 
+  /** Sets the interval, in milliseconds, over which circuit, stream and log
+   * events are accumulated and delivered together through the batch
+   * signals, rather than through one signal per event. An interval of zero
+   * disables batching.
+   * \sa TorEventBatcher
+   */
+  void setBatchInterval(int msecs);
+
 signals:
   /** Emitted when Tor writes the message <b>msg</b> to the control port
    * with message severity <b>level</b>.
    */
   void logMessage(tc::Severity level, const QString &msg);
 
+  /** Emitted instead of logMessage() when batching is enabled, with every
+   * log message received during the last batch interval.
+   */
+  void logMessages(const LogEventList &messages);
+
   /** Emitted when Tor sends a bandwidth usage update (roughly once every
    * second). <b>bytesReceived</b> is the number of bytes read by Tor over
    * the previous second and <b>bytesWritten</b> is the number of bytes
@@ -91,6 +111,18 @@ signals:
    */
   void circuitStatusChanged(const Circuit &circuit);
 
+  /** Emitted instead of circuitStatusChanged() when batching is enabled,
+   * with the latest status of each circuit that changed during the last
+   * batch interval.
+   */
+  void circuitStatusesChanged(const CircuitList &circuits);
+
+  /** Emitted instead of streamStatusChanged() when batching is enabled,
+   * with the latest status of each stream that changed during the last
+   * batch interval.
+   */
+  void streamStatusesChanged(const StreamList &streams);
+
   /** Emitted when Tor has mapped the address <b>from</b> to the address
    * <b>to</b>. <b>expires</b> indicates the time at which when the address
    * mapping will no longer be considered valid.
@@ -103,6 +135,23 @@ signals:
    */
   void newDescriptors(const QStringList &ids);
 
+  /** Emitted when Tor's configuration has changed. <b>changes</b> maps each
+   * changed option to its new value, or to an invalid QVariant if the
+   * option was reset to its default. Options with several values map to a
+   * QStringList.
+   */
+  void confChanged(const QVariantMap &changes);
+
+  /** Emitted when Tor has a new consensus. <b>consensus</b> contains the
+   * status of every router listed in it.
+   */
+  void newConsensus(const NetworkStatus &consensus);
+
+  /** Emitted when Tor's view of the status of one or more routers has
+   * changed. <b>changes</b> contains the new status of only those routers.
+   */
+  void networkStatusChanged(const NetworkStatus &changes);
+
   /** Indicates Tor has been able to successfully establish one or more
    * circuits.
    */
@@ -208,32 +257,44 @@ signals:
   void serverDescriptorAccepted();
 
 private:
-  /** Parses the event type from the event message */
-  static Event parseEventType(const ReplyLine &line);
   /** Converts a string to an Event */
   static Event toTorEvent(const QString &event);
+  /** Converts the <b>len</b> characters starting at <b>str</b> to an
+   * Event */
+  static Event toTorEvent(const QChar *str, int len);
+  /** Splits <b>str</b>, starting at <b>from</b>, into space-separated
+   * tokens, keeping quoted strings intact. If <b>max</b> is positive, the
+   * last of at most <b>max</b> tokens holds the rest of the string. */
+  static QStringList tokenize(const QString &str, int from, int max = -1);
   /** Splits a string in the form "IP:PORT" into a QHostAddress and quint16
    * pair. If either portion is invalid, a default-constructed QPair() is
    * returned. */
    static QPair<QHostAddress,quint16> splitAddress(const QString &address);
   
+  /* Each of the handlers below is given the full event message <b>msg</b>
+   * and the offset <b>pos</b> of the first argument after the event
+   * keyword. */
   /** Handle a bandwidth update event */
-  void handleBandwidthUpdate(const ReplyLine &line);
+  void handleBandwidthUpdate(const QString &msg, int pos);
   /** Handle a circuit status event */
-  void handleCircuitStatus(const ReplyLine &line);
+  void handleCircuitStatus(const QString &msg, int pos);
   /** Handle a stream status event */
-  void handleStreamStatus(const ReplyLine &line);
-  /** Handle a log message event */
-  void handleLogMessage(const ReplyLine &line);
-  /** Handle an OR connection status event. */
-  void handleOrConnStatus(const ReplyLine &line);
+  void handleStreamStatus(const QString &msg, int pos);
+  /** Handle a log message event of type <b>e</b>. */
+  void handleLogMessage(Event e, const ReplyLine &line, int pos);
   /** Handles a new list of descriptors event. */
-  void handleNewDescriptor(const ReplyLine &line);
+  void handleNewDescriptor(const QString &msg, int pos);
   /** Handles a new or updated address map event. */
-  void handleAddressMap(const ReplyLine &line);
+  void handleAddressMap(const QString &msg, int pos);
+  /** Handles a CONF_CHANGED event whose changed options are listed in
+   * <b>lines</b>, starting at <b>first</b>. */
+  void handleConfChanged(const QList<ReplyLine> &lines, int first);
+  /** Handles a NEWCONSENSUS or NS event whose router status entries are in
+   * the data of <b>line</b>. */
+  void handleNetworkStatus(Event e, const ReplyLine &line);
 
   /** Handles a Tor status event. */
-  void handleStatusEvent(Event type, const ReplyLine &line);
+  void handleStatusEvent(Event type, const QString &msg, int pos);
   /** Parses and posts a general Tor status event. */
   void handleGeneralStatusEvent(tc::Severity severity,
                                 const QString &action,
@@ -246,6 +307,9 @@ private:
   void handleServerStatusEvent(tc::Severity severity,
                                const QString &action,
                                const QHash<QString,QString> &args);
+
+  /** Accumulates circuit, stream and log events when batching is enabled. */
+  TorEventBatcher *_batcher;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(TorEvents::Events)
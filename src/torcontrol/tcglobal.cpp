@@ -18,11 +18,31 @@
 
 namespace tc {
 
+/** Least severe message type that will be output. This is only written
+ * while the application starts up or its log level changes. */
+static int messageThreshold = QtDebugMsg;
+
+/* Sets the least severe type of message that will be output. */
+void
+setMessageThreshold(QtMsgType type)
+{
+  messageThreshold = type;
+}
+
+/* Returns true if messages of severity <b>type</b> will be output. */
+bool
+isMessageEnabled(QtMsgType type)
+{
+  return (type >= messageThreshold || type == QtFatalMsg);
+}
+
 /* Creates a new message using <b>fmt</b> and a severity level of
  * QtDebugMsg. */
 DebugMessage
 debug(const QString &fmt)
 {
+  if (!isMessageEnabled(QtDebugMsg))
+    return DebugMessage();
   return DebugMessage(QtDebugMsg, fmt);
 }
 
@@ -31,6 +51,8 @@ debug(const QString &fmt)
 DebugMessage
 warn(const QString &fmt)
 {
+  if (!isMessageEnabled(QtWarningMsg))
+    return DebugMessage();
   return DebugMessage(QtWarningMsg, fmt);
 }
 
@@ -39,6 +61,8 @@ warn(const QString &fmt)
 DebugMessage
 error(const QString &fmt)
 {
+  if (!isMessageEnabled(QtCriticalMsg))
+    return DebugMessage();
   return DebugMessage(QtCriticalMsg, fmt);
 }
 
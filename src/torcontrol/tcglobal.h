@@ -20,7 +20,9 @@
 #include <QMetaType>
 
 namespace tc {
-  /** Helper class to handle formatting log messages with arguments. */
+  /** Helper class to handle formatting log messages with arguments. A
+   * DebugMessage whose severity is below the current message threshold has
+   * no buffer at all, and arg() returns without doing any formatting. */
   class DebugMessage {
     struct Stream {
       Stream(QtMsgType t, const QString &fmt)
@@ -31,14 +33,17 @@ namespace tc {
     } *stream;
 
   public:
+    /** Constructs a DebugMessage that will not be output. */
+    inline DebugMessage()
+      : stream(0) {}
     /** Constructs a new DebugMessage with severity <b>t</b> and the message
      * format <b>fmt</b>. */
     inline DebugMessage(QtMsgType t, const QString &fmt)
       : stream(new Stream(t, fmt)) {}
     inline DebugMessage(const DebugMessage &o)
-      : stream(o.stream) { ++stream->ref; }
+      : stream(o.stream) { if (stream) ++stream->ref; }
     virtual ~DebugMessage() {
-      if (!--stream->ref) {
+      if (stream && !--stream->ref) {
         stream->buf.prepend("torcontrol: ");
         qt_message_output(stream->type, qPrintable(stream->buf));
         delete stream;
@@ -46,10 +51,21 @@ namespace tc {
     }
 
     inline DebugMessage arg(const QString &a) 
-      { stream->buf = stream->buf.arg(a); return *this; }
+      { if (stream) stream->buf = stream->buf.arg(a); return *this; }
     inline DebugMessage arg(int a)
-      { stream->buf = stream->buf.arg(a); return *this; }
+      { if (stream) stream->buf = stream->buf.arg(a); return *this; }
   };
+
+  /** Sets the least severe type of message that debug(), warn() and
+   * error() will output. Messages of a lower severity are discarded before
+   * any of their arguments are formatted. QtFatalMsg messages are always
+   * output. */
+  void setMessageThreshold(QtMsgType type);
+  /** Returns true if messages of severity <b>type</b> will be output. Use
+   * this before building an expensive argument for a message. */
+  bool isMessageEnabled(QtMsgType type);
+  /** Returns true if debug() messages will be output. */
+  inline bool isDebugEnabled() { return isMessageEnabled(QtDebugMsg); }
 }
 
 namespace tc {
@@ -0,0 +1,126 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file IconCache.cpp
+** \brief Process-wide cache of decoded icons, flags and badged pixmaps
+*/
+
+#include "IconCache.h"
+
+#include <QCoreApplication>
+#include <QPainter>
+
+#define IMG_FLAG_DIR      ":/images/flags/"
+#define IMG_FLAG_UNKNOWN  ":/images/flags/unknown.png"
+
+IconCache* IconCache::_instance = 0;
+
+
+/** Returns the cache, creating it the first time it is used. It is deleted
+ * when QApplication is destroyed. */
+IconCache*
+IconCache::instance()
+{
+  if (!_instance) {
+    _instance = new IconCache();
+    qAddPostRoutine(IconCache::cleanup);
+  }
+  return _instance;
+}
+
+/** Deletes the cache. */
+void
+IconCache::cleanup()
+{
+  delete _instance;
+  _instance = 0;
+}
+
+/** Returns the image in <b>file</b>, decoding it only the first time. */
+QPixmap
+IconCache::pixmap(const QString &file)
+{
+  IconCache *cache = instance();
+  QHash<QString,QPixmap>::const_iterator it = cache->_pixmaps.constFind(file);
+  if (it != cache->_pixmaps.constEnd())
+    return it.value();
+
+  QPixmap pixmap(file);
+  cache->_pixmaps.insert(file, pixmap);
+  return pixmap;
+}
+
+/** Returns the icon made from the image in <b>file</b>. */
+QIcon
+IconCache::icon(const QString &file)
+{
+  IconCache *cache = instance();
+  QHash<QString,QIcon>::const_iterator it = cache->_icons.constFind(file);
+  if (it != cache->_icons.constEnd())
+    return it.value();
+
+  QIcon icon(pixmap(file));
+  cache->_icons.insert(file, icon);
+  return icon;
+}
+
+/** Returns the flag of the country <b>countryCode</b>. Codes without a flag
+ * are cached too, so their missing image is only looked for once. */
+QIcon
+IconCache::flag(const QString &countryCode)
+{
+  IconCache *cache = instance();
+  QString code = countryCode.toLower();
+  QHash<QString,QIcon>::const_iterator it = cache->_flags.constFind(code);
+  if (it != cache->_flags.constEnd())
+    return it.value();
+
+  QIcon flag;
+  QPixmap pixmap;
+  if (!code.isEmpty())
+    pixmap = QPixmap(IMG_FLAG_DIR + code + ".png");
+  if (pixmap.isNull())
+    flag = icon(IMG_FLAG_UNKNOWN);
+  else
+    flag = QIcon(pixmap);
+  cache->_flags.insert(code, flag);
+  return flag;
+}
+
+/** Returns the image in <b>file</b> with <b>badge</b> drawn over its
+ * lower-right corner, drawing each combination only once. */
+QPixmap
+IconCache::badgedPixmap(const QString &file, const QString &badge)
+{
+  IconCache *cache = instance();
+  QString key = file + '\n' + badge;
+  QHash<QString,QPixmap>::const_iterator it = cache->_badged.constFind(key);
+  if (it != cache->_badged.constEnd())
+    return it.value();
+
+  QPixmap out = addBadge(pixmap(file), pixmap(badge));
+  cache->_badged.insert(key, out);
+  return out;
+}
+
+/** Returns <b>pixmap</b> with <b>badge</b> drawn over its lower-right
+ * corner. */
+QPixmap
+IconCache::addBadge(const QPixmap &pixmap, const QPixmap &badge)
+{
+  QPixmap out = pixmap;
+  QPainter painter(&out);
+  painter.drawPixmap(pixmap.width() - badge.width(),
+                     pixmap.height() - badge.height(),
+                     badge);
+  return out;
+}
+
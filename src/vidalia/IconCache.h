@@ -0,0 +1,66 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file IconCache.h
+** \brief Process-wide cache of decoded icons, flags and badged pixmaps
+*/
+
+#ifndef _ICONCACHE_H
+#define _ICONCACHE_H
+
+#include <QHash>
+#include <QString>
+#include <QPixmap>
+#include <QIcon>
+
+
+/** IconCache decodes each image resource once and hands out shared copies
+ * of the result, so views showing the same icon on thousands of rows (such
+ * as the country flags and bandwidth icons in the router list) share a
+ * single pixmap instead of each decoding their own. It may only be used
+ * from the GUI thread. */
+class IconCache
+{
+public:
+  /** Returns the image in the resource or file <b>file</b>, decoding it the
+   * first time it is asked for. Returns a null pixmap if it can't be
+   * loaded. */
+  static QPixmap pixmap(const QString &file);
+  /** Returns an icon made from the image in <b>file</b>. Every call for the
+   * same file returns a copy of the same icon. */
+  static QIcon icon(const QString &file);
+  /** Returns the flag of the country with the two-letter code
+   * <b>countryCode</b>, or the flag used for unknown countries if there is
+   * none. */
+  static QIcon flag(const QString &countryCode);
+  /** Returns the image in <b>file</b> with the image in <b>badge</b> drawn
+   * over its lower-right corner. Each combination is drawn only once. */
+  static QPixmap badgedPixmap(const QString &file, const QString &badge);
+  /** Returns <b>pixmap</b> with <b>badge</b> drawn over its lower-right
+   * corner. The result isn't cached. */
+  static QPixmap addBadge(const QPixmap &pixmap, const QPixmap &badge);
+
+private:
+  /** Returns the cache, creating it if needed. */
+  static IconCache* instance();
+  /** Deletes the cache, while QApplication can still free pixmaps. */
+  static void cleanup();
+
+  static IconCache* _instance; /**< The process-wide cache. */
+
+  QHash<QString,QPixmap> _pixmaps; /**< Decoded images, by file. */
+  QHash<QString,QIcon> _icons;     /**< Icons, by file. */
+  QHash<QString,QIcon> _flags;     /**< Flags, by lowercase country code. */
+  QHash<QString,QPixmap> _badged;  /**< Badged images, by file and badge. */
+};
+
+#endif
+
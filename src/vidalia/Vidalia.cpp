@@ -20,6 +20,7 @@
 
 #include "stringutil.h"
 #include "html.h"
+#include "tcglobal.h"
 
 #ifdef USE_MARBLE
 #include <MarbleDirs.h>
@@ -60,6 +61,20 @@ Log Vidalia::_log;
 QList<QTranslator *> Vidalia::_translators;
 
 
+/** Returns the least severe Qt message type that qt_msg_handler() would
+ * still write to a log at <b>level</b>. */
+static QtMsgType
+qtMessageThreshold(Log::LogLevel level)
+{
+  switch (level) {
+    case Log::Debug:  return QtDebugMsg;
+    case Log::Info:
+    case Log::Notice: return QtWarningMsg;
+    case Log::Warn:   return QtCriticalMsg;
+    default:          return QtFatalMsg;
+  }
+}
+
 /** Catches debugging messages from Qt and sends them to Vidalia's logs. If Qt
  * emits a QtFatalMsg, we will write the message to the log and then abort().
  */
@@ -83,6 +98,7 @@ Vidalia::qt_msg_handler(QtMsgType type, const char *s)
   }
   if (type == QtFatalMsg) {
     vError("Fatal Qt error. Aborting.");
+    _log.flush();
     abort();
   }
 }
@@ -118,6 +134,8 @@ Vidalia::Vidalia(QStringList args, int &argc, char **argv)
   if (!_args.contains(ARG_LOGLEVEL) && 
       !_args.contains(ARG_LOGFILE))
     _log.setLogLevel(Log::Off);
+  /* Don't let the control library format messages we would discard. */
+  tc::setMessageThreshold(qtMessageThreshold(_log.logLevel()));
 
   /* Translate the GUI to the appropriate language. */
   setLanguage(_args.value(ARG_LANGUAGE));
@@ -126,6 +144,12 @@ Vidalia::Vidalia(QStringList args, int &argc, char **argv)
 
   /* Creates a TorControl object, used to talk to Tor. */
   _torControl = new TorControl(TorSettings().getControlMethod());
+  VidaliaSettings settings;
+  /* Deliver bursts of circuit, stream and log events to the GUI together */
+  _torControl->setEventBatchInterval(settings.eventBatchInterval());
+  /* Keep events off the connection used for commands, if enabled */
+  _torControl->setSeparateEventConnection(
+    settings.useSeparateEventConnection());
 
   /* If we were built with QSslSocket support, then populate the default
    * CA certificate store. */
@@ -23,28 +23,30 @@ GraphFrame::GraphFrame(QWidget *parent)
 : QFrame(parent)
 {
   /* Create Graph Frame related objects */
-  _recvData = new QList<qreal>();
-  _sendData = new QList<qreal>();
   _painter = new QPainter();
   _graphStyle = SolidLine;
   
   /* Initialize graph values */
-  _recvData->prepend(0);
-  _sendData->prepend(0);
-  _maxPoints = getNumPoints();
-  _maxPosition = 0;
+  _nextSeqnum = 0;
+  _count = 0;
+  _pointsStart = 1;
+  _originSeqnum = 0;
   _showRecv = true;
   _showSend = true;
   _maxValue = MIN_SCALE;
+  _totalSend = 0;
+  _totalRecv = 0;
   _scaleWidth = 0;
+  _recvPoints.resize(_pointsStart);
+  _sendPoints.resize(_pointsStart);
+  _maxPoints = qMax(1, getNumPoints() / SCROLL_STEP);
+  setCapacity(_maxPoints + 1);
 }
 
 /** Default destructor */
 GraphFrame::~GraphFrame()
 {
   delete _painter;
-  delete _recvData;
-  delete _sendData;
 }
 
 /** Gets the width of the desktop, which is the maximum number of points 
@@ -55,53 +57,113 @@ GraphFrame::getNumPoints()
   return size().width() - _scaleWidth;
 }
 
+/** Sets the number of data points kept for each series to <b>capacity</b>,
+ * discarding the oldest points if there are currently more than that. We
+ * keep one more point than fits in the graph, so the lines always reach the
+ * y-axis. */
+void
+GraphFrame::setCapacity(int capacity)
+{
+  if (capacity == _recvData.size())
+    return;
+
+  while (_count > capacity)
+    removeOldestPoint();
+
+  /* Move each remaining point to its slot in the resized ring buffers */
+  QVector<qreal> recvData(capacity), sendData(capacity);
+  for (quint64 seqnum = _nextSeqnum - _count; seqnum < _nextSeqnum; seqnum++) {
+    int slot = seqnum % _recvData.size();
+    recvData[seqnum % capacity] = _recvData.at(slot);
+    sendData[seqnum % capacity] = _sendData.at(slot);
+  }
+  _recvData = recvData;
+  _sendData = sendData;
+
+  /* The cached polylines grow to at most twice the capacity before they are
+   * compacted, plus the points that closeSeries() adds */
+  _recvPoints.reserve(2 * capacity + 3);
+  _sendPoints.reserve(2 * capacity + 3);
+}
+
+/** Returns the larger of the sent and received values of the data point with
+ * sequence number <b>seqnum</b>. */
+qreal
+GraphFrame::pointMax(quint64 seqnum) const
+{
+  int slot = seqnum % _recvData.size();
+  return qMax(_recvData.at(slot), _sendData.at(slot));
+}
+
+/** Returns the most recently added value in <b>data</b>, or 0 if the graph
+ * is empty. */
+qreal
+GraphFrame::latestValue(const QVector<qreal> &data) const
+{
+  if (!_count)
+    return 0;
+  return data.at((_nextSeqnum - 1) % data.size());
+}
+
+/** Discards the oldest data point in each series. */
+void
+GraphFrame::removeOldestPoint()
+{
+  quint64 oldest = _nextSeqnum - _count;
+  if (!_maxQueue.isEmpty() && _maxQueue.first() == oldest)
+    _maxQueue.removeFirst();
+  _count--;
+
+  /* Once the unused space at the front of the cached polylines is as large
+   * as the polylines themselves, move the points back to the front and make
+   * the oldest one the new origin. This keeps the coordinates small and
+   * costs O(1) per point, amortized. */
+  _pointsStart++;
+  if (_pointsStart > _count + 1) {
+    int discard = _pointsStart - 1;
+    qreal dx = (oldest + 1 - _originSeqnum) * SCROLL_STEP;
+    _recvPoints.remove(0, discard);
+    _sendPoints.remove(0, discard);
+    for (int i = 1; i < _recvPoints.size(); i++) {
+      _recvPoints[i].rx() -= dx;
+      _sendPoints[i].rx() -= dx;
+    }
+    _pointsStart = 1;
+    _originSeqnum = oldest + 1;
+  }
+}
+
 /** Adds new data points to the graph. */
 void
 GraphFrame::addPoints(qreal recv, qreal send)
 {
   /* If maximum number of points plotted, remove oldest */
-  if (_sendData->size() == _maxPoints) {
-    _sendData->removeLast();
-    _recvData->removeLast();
-  }
+  if (_count == _recvData.size())
+    removeOldestPoint();
 
-  /* Update the displayed maximum */
-  if (_maxPosition >= _maxPoints) {
-    _maxValue = MIN_SCALE;
-    foreach(qreal send, *_sendData)
-      if(send > _maxValue)
-        _maxValue = send;
-    foreach(qreal recv, *_recvData)
-      if(recv > _maxValue)
-        _maxValue = recv;
-    _maxPosition = 0;
-  }
+  /* Add the points to their respective ring buffers and polylines */
+  quint64 seqnum = _nextSeqnum++;
+  int slot = seqnum % _recvData.size();
+  _recvData[slot] = recv;
+  _sendData[slot] = send;
+  _count++;
 
-  /* Add the points to their respective lists */
-  _sendData->prepend(send);
-  _recvData->prepend(recv);
+  qreal x = (seqnum - _originSeqnum) * SCROLL_STEP;
+  _recvPoints << QPointF(x, recv);
+  _sendPoints << QPointF(x, send);
 
   /* Add to the total counters */
   _totalSend += send;
   _totalRecv += recv;
-  
-  bool maxUpdated = false;
-  /* Check for a new maximum value */
-  if (send > _maxValue) {
-    _maxValue = send;
-    maxUpdated = true;
-  }
-
-  if (recv > _maxValue) {
-    _maxValue = recv;
-    maxUpdated = true;
-  }
 
-  if (maxUpdated) {
-    _maxPosition = 0;
-  } else {
-    _maxPosition++;
-  }
+  /* Update the displayed maximum. Any older point that is not larger than
+   * the new one can never be the maximum again, since it will age out
+   * first. */
+  qreal value = qMax(recv, send);
+  while (!_maxQueue.isEmpty() && pointMax(_maxQueue.last()) <= value)
+    _maxQueue.removeLast();
+  _maxQueue.append(seqnum);
+  _maxValue = qMax((qreal)MIN_SCALE, pointMax(_maxQueue.first()));
 
   this->update();
 }
@@ -110,10 +172,12 @@ GraphFrame::addPoints(qreal recv, qreal send)
 void
 GraphFrame::resetGraph()
 {
-  _recvData->clear();
-  _sendData->clear();
-  _recvData->prepend(0);
-  _sendData->prepend(0);
+  _count = 0;
+  _maxQueue.clear();
+  _recvPoints.resize(1);
+  _sendPoints.resize(1);
+  _pointsStart = 1;
+  _originSeqnum = _nextSeqnum;
   _maxValue = MIN_SCALE;
   _totalSend = 0;
   _totalRecv = 0;
@@ -137,7 +201,7 @@ GraphFrame::paintEvent(QPaintEvent *event)
   Q_UNUSED(event);
 
   /* Set current graph dimensions */
-  _rec = this->frameRect();
+  QRect rect = this->frameRect();
   
   /* Start the painter */
   _painter->begin(this);
@@ -147,13 +211,13 @@ GraphFrame::paintEvent(QPaintEvent *event)
   _painter->setRenderHint(QPainter::TextAntialiasing);
   
   /* Fill in the background */
-  _painter->fillRect(_rec, QBrush(BACK_COLOR));
-  _painter->drawRect(_rec);
+  _painter->fillRect(rect, QBrush(BACK_COLOR));
+  _painter->drawRect(rect);
 
   /* Paint the scale */
-  paintScale();
+  paintScale(rect);
   /* Plot the send/receive data */
-  paintData();
+  paintData(rect);
   /* Paint the send/recv totals */
   paintTotals();
 
@@ -164,81 +228,101 @@ GraphFrame::paintEvent(QPaintEvent *event)
 /** Paints an integral and an outline of that integral for each data set (send
  * and/or receive) that is to be displayed. The integrals will be drawn first,
  * followed by the outlines, since we want the area of overlapping integrals
- * to blend, but not the outlines of those integrals. */
+ * to blend, but not the outlines of those integrals. The cached polylines are
+ * mapped onto the graph by the painter's transform, so nothing needs to be
+ * recomputed for points that were already plotted. */
 void
-GraphFrame::paintData()
+GraphFrame::paintData(const QRect &rect)
 {
-  QVector<QPointF> recvPoints, sendPoints;
+  if (!_count)
+    return;
+
+  int y = rect.height();
+  qreal scale = (y - (y/10)) / _maxValue;
+  qreal newestX = (_nextSeqnum - 1 - _originSeqnum) * SCROLL_STEP;
+
+  /* Put the newest point at the right edge of the graph and the x-axis at
+   * its bottom, and keep anything older from spilling over the scale. */
+  _painter->save();
+  _painter->setClipRect(QRect(_scaleWidth, rect.y(),
+                              rect.width() - _scaleWidth, y));
+  _painter->translate(rect.width() - newestX, y);
+  _painter->scale(1.0, -scale);
+
+  const QPointF *recvPoints = closeSeries(_recvPoints);
+  const QPointF *sendPoints = closeSeries(_sendPoints);
+  int count = _count + 2;
 
-  /* Convert the bandwidth data points to graph points */
-  recvPoints = pointsFromData(_recvData);
-  sendPoints = pointsFromData(_sendData);
-  
   if (_graphStyle == AreaGraph) {
     /* Plot the bandwidth data as area graphs */
     if (_showRecv)
-      paintIntegral(recvPoints, RECV_COLOR, 0.6);
+      paintIntegral(recvPoints, count, RECV_COLOR, 0.6);
     if (_showSend)
-      paintIntegral(sendPoints, SEND_COLOR, 0.4);
+      paintIntegral(sendPoints, count, SEND_COLOR, 0.4);
   }
   
   /* Plot the bandwidth as solid lines. If the graph style is currently an
    * area graph, we end up outlining the integrals. */
   if (_showRecv)
-    paintLine(recvPoints, RECV_COLOR);
+    paintLine(recvPoints, count, RECV_COLOR);
   if (_showSend)
-    paintLine(sendPoints, SEND_COLOR);
+    paintLine(sendPoints, count, SEND_COLOR);
+
+  openSeries(_recvPoints);
+  openSeries(_sendPoints);
+  _painter->restore();
 }
 
-/** Returns a list of points on the bandwidth graph based on the supplied set
- * of send or receive values. */
-QVector<QPointF>
-GraphFrame::pointsFromData(QList<qreal>* list)
+/** Closes the cached polyline in <b>points</b> along the x-axis, by storing
+ * a point below its oldest point in the free slot in front of it and
+ * appending a point below its newest point. Returns a pointer to the first
+ * point of the closed polyline. */
+const QPointF*
+GraphFrame::closeSeries(QVector<QPointF> &points)
 {
-  QVector<QPointF> points;
-  int x = _rec.width();
-  int y = _rec.height();
-  qreal scale = (y - (y/10)) / _maxValue;
-  qreal currValue;
-  
-  /* Translate all data points to points on the graph frame */
-  points << QPointF(x, y);
-  for (int i = 0; i < list->size(); i++) {
-    currValue = y - (list->at(i) * scale);
-    if (x - SCROLL_STEP < _scaleWidth) {
-      points << QPointF(_scaleWidth, currValue);
-      break;
-    }
-    points << QPointF(x, currValue);
-    x -= SCROLL_STEP;
-  }
-  points << QPointF(_scaleWidth, y);
-  return points; 
+  points[_pointsStart-1] = QPointF(points.at(_pointsStart).x(), 0);
+  points << QPointF(points.last().x(), 0);
+  return points.constData() + _pointsStart - 1;
 }
 
-/** Plots an integral using the data points in <b>points</b>. The area will be
- * filled in using <b>color</b> and an alpha-blending level of <b>alpha</b>
- * (default is opaque). */
+/** Removes the point appended to <b>points</b> by closeSeries(). */
 void
-GraphFrame::paintIntegral(QVector<QPointF> points, QColor color, qreal alpha)
+GraphFrame::openSeries(QVector<QPointF> &points)
+{
+  points.resize(points.size() - 1);
+}
+
+/** Plots an integral using the <b>count</b> points in <b>points</b>. The area
+ * will be filled in using <b>color</b> and an alpha-blending level of
+ * <b>alpha</b> (default is opaque). */
+void
+GraphFrame::paintIntegral(const QPointF *points, int count, QColor color,
+                          qreal alpha)
 {
   /* Save the current brush, plot the integral, and restore the old brush */
   QBrush oldBrush = _painter->brush();
+  QPen oldPen = _painter->pen();
   color.setAlphaF(alpha);
   _painter->setBrush(QBrush(color));
-  _painter->drawPolygon(points.data(), points.size());
+  _painter->setPen(Qt::NoPen);
+  _painter->drawPolygon(points, count);
+  _painter->setPen(oldPen);
   _painter->setBrush(oldBrush);
 }
 
-/** Iterates the input list and draws a line on the graph in the appropriate
- * color. */
+/** Draws a line through the <b>count</b> points in <b>points</b> on the
+ * graph in the appropriate color. The pen is cosmetic, so the line keeps its
+ * width regardless of the graph's current scale. */
 void
-GraphFrame::paintLine(QVector<QPointF> points, QColor color, Qt::PenStyle lineStyle) 
+GraphFrame::paintLine(const QPointF *points, int count, QColor color,
+                      Qt::PenStyle lineStyle)
 {
-  /* Save the current brush, plot the line, and restore the old brush */
+  /* Save the current pen, plot the line, and restore the old pen */
   QPen oldPen = _painter->pen();
-  _painter->setPen(QPen(color, lineStyle));
-  _painter->drawPolyline(points.data(), points.size());
+  QPen pen(color, 1, lineStyle);
+  pen.setCosmetic(true);
+  _painter->setPen(pen);
+  _painter->drawPolyline(points, count);
   _painter->setPen(oldPen);
 }
 
@@ -260,7 +344,7 @@ GraphFrame::paintTotals()
     _painter->setPen(RECV_COLOR);
     _painter->drawText(x, y,
         tr("Recv: ") + totalToStr(_totalRecv) + 
-        " ("+tr("%1 KB/s").arg(_recvData->first(), 0, 'f', 2)+")");
+        " ("+tr("%1 KB/s").arg(latestValue(_recvData), 0, 'f', 2)+")");
   }
 
   /* If total sent is selected */
@@ -269,7 +353,7 @@ GraphFrame::paintTotals()
     _painter->setPen(SEND_COLOR);
     _painter->drawText(x, y,
         tr("Sent: ") + totalToStr(_totalSend) +
-        " ("+tr("%1 KB/s").arg(_sendData->first(), 0, 'f', 2)+")");
+        " ("+tr("%1 KB/s").arg(latestValue(_sendData), 0, 'f', 2)+")");
   }
 }
 
@@ -305,12 +389,12 @@ GraphFrame::labelWidth(const QString &label)
 
 /** Paints the scale on the graph. */
 void
-GraphFrame::paintScale()
+GraphFrame::paintScale(const QRect &rect)
 {
   QString label[4];
   int width[4];
-  int top = _rec.y();
-  int bottom = _rec.height();
+  int top = rect.y();
+  int bottom = rect.height();
   int scaleWidth = 0;
   qreal pos;
   qreal markStep = _maxValue * .25;
@@ -336,7 +420,7 @@ GraphFrame::paintScale()
 
     _painter->setPen(GRID_COLOR);
     _painter->drawLine(QPointF(_scaleWidth, pos),
-                       QPointF(_rec.width(), pos));
+                       QPointF(rect.width(), pos));
   }
 
   /* Draw the y-axis */
@@ -347,5 +431,6 @@ void
 GraphFrame::resizeEvent(QResizeEvent *ev)
 {
   _maxPoints = ev->size().width() - _scaleWidth;
-  _maxPoints /= SCROLL_STEP;
+  _maxPoints = qMax(1, _maxPoints / SCROLL_STEP);
+  setCapacity(_maxPoints + 1);
 }
@@ -22,6 +22,8 @@
 #include <QPainter>
 #include <QPen>
 #include <QList>
+#include <QVector>
+#include <QPointF>
 
 #define HOR_SPC       2   /** Space between data points */
 #define MIN_SCALE     10  /** 10 kB/s is the minimum scale */
@@ -72,22 +74,36 @@ private:
   /** Gets the width of the desktop, the max # of points. */
   int getNumPoints();
   /** Paints an integral and an outline of that integral for each data set
-   * (send and/or receive) that is to be displayed. */
-  void paintData();
+   * (send and/or receive) that is to be displayed, within <b>rect</b>. */
+  void paintData(const QRect &rect);
   /** Paints the send/receive totals. */
   void paintTotals();
-  /** Paints the scale in the graph. */
-  void paintScale();
+  /** Paints the scale in the graph, within <b>rect</b>. */
+  void paintScale(const QRect &rect);
   /** Returns a formatted string representation of total. */
   QString totalToStr(qreal total);
-  /** Returns a list of points on the bandwidth graph based on the supplied set
-   * of send or receive values. */
-  QVector<QPointF> pointsFromData(QList<qreal>* list);
-  /** Paints a line with the data in <b>points</b>. */
-  void paintLine(QVector<QPointF> points, QColor color, 
+  /** Paints a line through the <b>count</b> points in <b>points</b>. */
+  void paintLine(const QPointF *points, int count, QColor color,
                  Qt::PenStyle lineStyle = Qt::SolidLine);
-  /** Paints an integral using the supplied data. */
-  void paintIntegral(QVector<QPointF> points, QColor color, qreal alpha = 1.0);
+  /** Paints an integral using the <b>count</b> points in <b>points</b>. */
+  void paintIntegral(const QPointF *points, int count, QColor color,
+                     qreal alpha = 1.0);
+  /** Temporarily closes the polyline in <b>points</b> along the x-axis and
+   * returns a pointer to its first point. */
+  const QPointF* closeSeries(QVector<QPointF> &points);
+  /** Removes the closing points added by closeSeries(). */
+  void openSeries(QVector<QPointF> &points);
+
+  /** Sets the number of data points kept for each series. */
+  void setCapacity(int capacity);
+  /** Discards the oldest data point in each series. */
+  void removeOldestPoint();
+  /** Returns the larger of the sent and received values of the data point
+   * with sequence number <b>seqnum</b>. */
+  qreal pointMax(quint64 seqnum) const;
+  /** Returns the most recently added value in <b>data</b>, or 0 if the
+   * graph is empty. */
+  qreal latestValue(const QVector<qreal> &data) const;
 
   void resizeEvent(QResizeEvent *ev);
 
@@ -95,17 +111,34 @@ private:
   GraphStyle _graphStyle;
   /** A QPainter object that handles drawing the various graph elements. */
   QPainter* _painter;
-  /** Holds the received data points. */
-  QList<qreal> *_recvData;
-  /** Holds the sent data points. */
-  QList<qreal> *_sendData;
-  /** The current dimensions of the graph. */
-  QRect _rec;
+  /** Ring buffers holding the received and sent data points. The point with
+   * sequence number <i>n</i> is stored at index <i>n</i> modulo the
+   * capacity. */
+  QVector<qreal> _recvData;
+  QVector<qreal> _sendData;
+  /** Sequence number that will be given to the next data point. */
+  quint64 _nextSeqnum;
+  /** Number of data points currently stored. */
+  int _count;
+  /** Sequence numbers of the stored data points whose maximum is not
+   * exceeded by any later point, oldest first. The first entry is always
+   * the maximum of the stored data, so it never has to be rescanned. */
+  QList<quint64> _maxQueue;
+  /** Cached polylines through the received and sent data points, in
+   * unscaled graph coordinates. The point with sequence number <i>n</i> has
+   * an x-coordinate of (<i>n</i> - <b>_originSeqnum</b>) * SCROLL_STEP and
+   * its bandwidth value as the y-coordinate, so new points never move the
+   * existing ones; the painter's transform scrolls and scales them. */
+  QVector<QPointF> _recvPoints;
+  QVector<QPointF> _sendPoints;
+  /** Index of the oldest point in the cached polylines. The slot before it
+   * is always kept free for closeSeries(). */
+  int _pointsStart;
+  /** Sequence number of the data point at x-coordinate 0. */
+  quint64 _originSeqnum;
   /** The maximum data value plotted. */
   qreal _maxValue;
-  /** The position of the local maximum in the displayed bandwidth */
-  int _maxPosition;
-  /** The maximum number of points to store. */
+  /** The maximum number of points to display. */
   int _maxPoints;
   /** The total data sent/recv. */
   qreal _totalSend;
@@ -90,8 +90,8 @@ AbstractTorSettings::localValue(const QString &key) const
   return VSettings::value(key);
 }
 
-/** Returns the value associated with <b>key</b> by querying TOr via 
- * <i>getconf key</i>. */
+/** Returns the value associated with <b>key</b> in Tor's configuration, as
+ * cached by TorControl::cachedConf(). */
 QVariant
 AbstractTorSettings::torValue(const QString &key) const
 {
@@ -100,7 +100,7 @@ AbstractTorSettings::torValue(const QString &key) const
 
   defaultVal = defaultValue(key);
   if (_torControl) {
-    confValue = _torControl->getConf(key);
+    confValue = _torControl->cachedConf(key);
     confValue.convert(defaultVal.type());
   }
   return (isEmptyValue(confValue) ? localValue(key) : confValue);
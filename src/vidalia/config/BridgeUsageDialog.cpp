@@ -16,10 +16,10 @@
 
 #include "BridgeUsageDialog.h"
 #include "CountryInfo.h"
+#include "IconCache.h"
 
 #include <QHeaderView>
 #include <QTreeWidgetItem>
-#include <QPixmap>
 
 
 BridgeUsageDialog::BridgeUsageDialog(QWidget *parent)
@@ -49,7 +49,6 @@ BridgeUsageDialog::update(const QDateTime &timeStarted,
   QTreeWidgetItem *item;
   int minClients, maxClients;
   QString countryName;
-  QPixmap flag;
 
   /* Set the header with the TimeStarted value converted to local time */
   ui.lblClientSummary->setText(tr("Clients from the following countries have "
@@ -61,16 +60,12 @@ BridgeUsageDialog::update(const QDateTime &timeStarted,
     maxClients = countrySummary.value(countryCode);
     minClients = maxClients-7;
 
-    flag = QPixmap(":/images/flags/" + countryCode.toLower() + ".png");
-    if (flag.isNull())
-      flag = QPixmap(":/images/flags/unknown.png");
-
     countryName = CountryInfo::countryName(countryCode);
     if (countryName.isEmpty())
       countryName = countryCode;
 
     item = new QTreeWidgetItem();
-    item->setIcon(0, QIcon(flag));
+    item->setIcon(0, IconCache::flag(countryCode));
     item->setText(1, countryName);
     item->setText(2, QString("%1-%2").arg(minClients).arg(maxClients));
     ui.treeClientSummary->addTopLevelItem(item);
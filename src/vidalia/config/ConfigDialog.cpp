@@ -148,6 +148,9 @@ ConfigDialog::addAction(QAction *action, const char *slot)
 void
 ConfigDialog::showWindow(Page page)
 {
+  /* Settings are read from a single copy of Tor's configuration, which may be
+   * out of date if Tor can't tell us when it changes */
+  Vidalia::torControl()->expireConfCache();
   /* Load saved settings */
   loadSettings();
   /* Show the dialog. */
@@ -198,7 +198,7 @@ ServerPage::loadBridgeIdentity()
   if (tc->isConnected()) {
     tc->getInfo("address", address);
     tc->getInfo("fingerprint", fingerprint);
-    tc->getConf("ORPort", orPort);
+    orPort = tc->cachedConf("ORPort").toString();
   
     if (!address.isEmpty() && !orPort.isEmpty() && orPort != "0")
       bridge = address + ":" + orPort + " ";
@@ -236,10 +236,10 @@ ServerSettings::setServerEnabled(bool enable)
 bool
 ServerSettings::isServerEnabled()
 {
-  QString orPort;
   if (torControl()->isConnected() && !changedSinceLastApply()) {
-    if (torControl()->getConf(SETTING_ORPORT, orPort))
-      return (orPort.toUInt() > 0);
+    QVariant orPort = torControl()->cachedConf(SETTING_ORPORT);
+    if (orPort.isValid())
+      return (orPort.toString().toUInt() > 0);
   }
   return localValue(SETTING_ENABLED).toBool();
 }
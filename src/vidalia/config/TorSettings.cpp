@@ -293,15 +293,12 @@ TorSettings::getAuthenticationMethod() const
   TorControl *tc = torControl();
 
   if (tc && tc->isConnected()) {
-    QHash<QString,QString> conf;
-    conf.insert(TOR_ARG_COOKIE_AUTH, "");
-    conf.insert(TOR_ARG_HASHED_PASSWORD, "");
-    if (tc->getConf(conf)) {
-      if (conf.value(TOR_ARG_COOKIE_AUTH) == "1")
-        type = CookieAuth;
-      else if (!conf.value(TOR_ARG_HASHED_PASSWORD).isEmpty())
-        type = PasswordAuth;
-    }
+    /* HashedControlPassword can be given more than once */
+    QVariant hashedPassword = tc->cachedConf(TOR_ARG_HASHED_PASSWORD);
+    if (tc->cachedConf(TOR_ARG_COOKIE_AUTH).toString() == "1")
+      type = CookieAuth;
+    else if (!hashedPassword.toStringList().join("").isEmpty())
+      type = PasswordAuth;
   }
   if (type == UnknownAuth)
     type = toAuthenticationMethod(localValue(SETTING_AUTH_METHOD).toString());
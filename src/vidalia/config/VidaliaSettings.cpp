@@ -40,6 +40,8 @@
 #define SETTING_USE_LOCAL_GEOIP_DATABASE  "UseLocalGeoIpDatabase"
 #define SETTING_LOCAL_GEOIP_DATABASE "LocalGeoIpDatabase"
 #define SETTING_SKIP_VERSION_CHECK  "SkipVersionCheck"
+#define SETTING_EVENT_BATCH_INTERVAL  "EventBatchInterval"
+#define SETTING_SEPARATE_EVENT_CONNECTION  "SeparateEventConnection"
 
 #if defined(Q_OS_WIN32)
 #define STARTUP_REG_KEY        "Software\\Microsoft\\Windows\\CurrentVersion\\Run"
@@ -86,6 +88,8 @@ VidaliaSettings::VidaliaSettings()
   setDefault(SETTING_LOCAL_GEOIP_DATABASE, "");
   setDefault(SETTING_ICON_PREF, Both);
   setDefault(SETTING_SKIP_VERSION_CHECK, false);
+  setDefault(SETTING_EVENT_BATCH_INTERVAL, 100);
+  setDefault(SETTING_SEPARATE_EVENT_CONNECTION, false);
 }
 
 /** Gets the currently preferred language code for Vidalia. */
@@ -325,6 +329,38 @@ VidaliaSettings::setLocalGeoIpDatabase(const QString &databaseFile)
   setValue(SETTING_LOCAL_GEOIP_DATABASE, databaseFile);
 }
 
+/** Returns the number of milliseconds over which circuit, stream and log
+ * events from Tor are batched before being displayed. */
+int
+VidaliaSettings::eventBatchInterval() const
+{
+  return value(SETTING_EVENT_BATCH_INTERVAL).toInt();
+}
+
+/** Sets the number of milliseconds over which circuit, stream and log events
+ * from Tor are batched. Zero disables batching. */
+void
+VidaliaSettings::setEventBatchInterval(int msecs)
+{
+  setValue(SETTING_EVENT_BATCH_INTERVAL, msecs);
+}
+
+/** Returns true if Vidalia should receive asynchronous events from Tor on a
+ * second control connection. */
+bool
+VidaliaSettings::useSeparateEventConnection() const
+{
+  return value(SETTING_SEPARATE_EVENT_CONNECTION).toBool();
+}
+
+/** Sets whether Vidalia should receive asynchronous events from Tor on a
+ * second control connection. */
+void
+VidaliaSettings::setUseSeparateEventConnection(bool enabled)
+{
+  setValue(SETTING_SEPARATE_EVENT_CONNECTION, enabled);
+}
+
 /** Get the icon preference */
 VidaliaSettings::IconPosition
 VidaliaSettings::getIconPref()
@@ -132,6 +132,19 @@ public:
   /** Sets the file to use as a local GeoIP database. */
   void setLocalGeoIpDatabase(const QString &databaseFile);
 
+  /** Returns the number of milliseconds over which circuit, stream and log
+   * events from Tor are batched before being displayed. */
+  int eventBatchInterval() const;
+  /** Sets the number of milliseconds over which circuit, stream and log
+   * events from Tor are batched. Zero disables batching. */
+  void setEventBatchInterval(int msecs);
+  /** Returns true if Vidalia should receive asynchronous events from Tor on
+   * a second control connection. */
+  bool useSeparateEventConnection() const;
+  /** Sets whether Vidalia should receive asynchronous events from Tor on a
+   * second control connection. */
+  void setUseSeparateEventConnection(bool enabled);
+
   /** Get the icon preference */
   IconPosition getIconPref();
 
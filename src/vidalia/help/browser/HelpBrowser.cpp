@@ -85,6 +85,7 @@ HelpBrowser::HelpBrowser(QWidget *parent)
   
   /* Load the help topics from XML */
   loadContentsFromXml(":/help/" + language() + "/contents.xml");
+  _searchIndex.load(":/help/" + language() + "/search.idx");
 
   /* Show the first help topic in the tree */
   ui.treeContents->setCurrentItem(ui.treeContents->topLevelItem(0));
@@ -98,6 +99,7 @@ HelpBrowser::retranslateUi()
   ui.retranslateUi(this);
   ui.treeContents->clear();
   loadContentsFromXml(":/help/" + language() + "/contents.xml");
+  _searchIndex.load(":/help/" + language() + "/search.idx");
   ui.treeContents->setItemExpanded(ui.treeContents->topLevelItem(0), true);
   ui.treeContents->setCurrentItem(ui.treeContents->topLevelItem(0));
   ui.treeContents->setItemExpanded(ui.treeContents->topLevelItem(0), true);
@@ -245,11 +247,36 @@ HelpBrowser::searchItemChanged(QTreeWidgetItem *current, QTreeWidgetItem *prev)
   currentItemChanged(current, prev);
 
   /* Highlight search phrase */
-  QTextCursor found;
+  highlightSearch();
+}
+
+/** Selects the first instance of the last search phrase on the current page,
+ * or of its first word if the phrase isn't there, and marks every instance
+ * of each of its words. */
+void
+HelpBrowser::highlightSearch()
+{
+  QTextDocument *document = ui.txtBrowser->document();
   QTextDocument::FindFlags flags = QTextDocument::FindWholeWords;
-  found = ui.txtBrowser->document()->find(_lastSearch, 0, flags);
-  if (!found.isNull()) {
-    ui.txtBrowser->setTextCursor(found);
+  QList<QTextEdit::ExtraSelection> selections;
+  QTextCursor first;
+
+  first = document->find(_lastSearch, 0, flags);
+  foreach (QString word, help_index_words(_lastSearch)) {
+    QTextCursor found = document->find(word, 0, flags);
+    while (!found.isNull()) {
+      QTextEdit::ExtraSelection selection;
+      selection.cursor = found;
+      selection.format.setBackground(Qt::yellow);
+      selections << selection;
+      if (first.isNull())
+        first = found;
+      found = document->find(word, found, flags);
+    }
+  }
+  ui.txtBrowser->setExtraSelections(selections);
+  if (!first.isNull()) {
+    ui.txtBrowser->setTextCursor(first);
   }
 }
 
@@ -262,6 +289,7 @@ HelpBrowser::currentItemChanged(QTreeWidgetItem *current, QTreeWidgetItem *prev)
     ui.txtBrowser->setSource(QUrl(current->data(0, 
                                               ROLE_TOPIC_QRC_PATH).toString()));
   }
+  ui.txtBrowser->setExtraSelections(QList<QTextEdit::ExtraSelection>());
   _foundBefore = false;
 }
 
@@ -403,8 +431,8 @@ HelpBrowser::find(bool forward)
 }
  
 /** Searches all help pages for the phrase the Search box.
- *  Fills treeSearch with documents containing matches and sets the
- *  status bar text appropriately.
+ *  Fills treeSearch with documents containing matches, best first, and sets
+ *  the status bar text appropriately.
  */
 void
 HelpBrowser::search()
@@ -416,30 +444,51 @@ HelpBrowser::search()
   if (ui.lineSearch->text().isEmpty()) {
     return;
   }
-    
+  _lastSearch = ui.lineSearch->text();
+
+  if (_searchIndex.isLoaded()) {
+    /* Look the words up in the index and list the topics on each page
+     * found, in the order the pages were ranked */
+    foreach (HelpSearchResult result, _searchIndex.search(_lastSearch)) {
+      for (int i=0; i < _elementList.size(); ++i) {
+        if (_elementList[i].attribute(ATTRIBUTE_TOPIC_HTML) == result.page) {
+          ui.treeSearch->addTopLevelItem(
+            createTopicTreeItem(_elementList[i], 0));
+        }
+      }
+    }
+  } else {
+    searchPages();
+  }
+
+  /* Set the status bar text */
+  this->statusBar()->showMessage(tr("Found %1 results")
+                                .arg(ui.treeSearch->topLevelItemCount()));
+}
+
+/** Searches all help pages for the phrase in the Search box by loading and
+ * laying out each one, and adds the topics on pages that contain it to
+ * treeSearch. */
+void
+HelpBrowser::searchPages()
+{
   HelpTextBrowser browser;
   QTextCursor found;
   QTextDocument::FindFlags flags = QTextDocument::FindWholeWords;
 
-  _lastSearch = ui.lineSearch->text();
-
   /* Search through all the pages looking for the phrase */
   for (int i=0; i < _elementList.size(); ++i) {
     /* Load page data into browser */
     browser.setSource(QUrl(getResourcePath(_elementList[i])));
       
     /* Search current document */
-    found = browser.document()->find(ui.lineSearch->text(), 0, flags);
+    found = browser.document()->find(_lastSearch, 0, flags);
 
     /* If found, add page to tree */
     if (!found.isNull()) {
       ui.treeSearch->addTopLevelItem(createTopicTreeItem(_elementList[i], 0));
     }
   }
-
-  /* Set the status bar text */
-  this->statusBar()->showMessage(tr("Found %1 results")
-                                .arg(ui.treeSearch->topLevelItemCount()));
 }
 
 /** Overrides the default show method */
@@ -18,6 +18,7 @@
 
 #include "ui_HelpBrowser.h"
 #include "VidaliaWindow.h"
+#include "HelpSearchIndex.h"
 
 #include <QMainWindow>
 #include <QCloseEvent>
@@ -82,9 +83,16 @@ private:
   QTreeWidgetItem* findTopicItem(QTreeWidgetItem *startItem, QString topic);
   /** Shows the help browser and finds a specific a topic in the browser. */
   void showTopic(QString topic);
+  /** Searches every help page for the phrase in the Search box by loading
+   * each page. Used only if there is no search index. */
+  void searchPages();
+  /** Highlights the words of the last search on the current page. */
+  void highlightSearch();
 
   /** List of DOM elements representing topics. */
   QList<QDomElement> _elementList;
+  /** Index of the words on each help page in the current language. */
+  HelpSearchIndex _searchIndex;
   /** Last phrase used for 'Find' */
   QString _lastFind;
   /** Last phrase searched on */
@@ -0,0 +1,97 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file HelpIndexFormat.h
+** \brief Layout of the help search index written by help2idx and read by
+** HelpSearchIndex.
+**
+** An index file consists of a HelpIndexHeader, followed by
+** <i>pageCount</i> HelpIndexPage entries, <i>termCount</i> HelpIndexTerm
+** entries sorted by their text, <i>postingCount</i> HelpIndexPosting
+** entries, <i>positionCount</i> 32-bit word positions and
+** <i>stringCount</i> UTF-16 code units holding the text of every term and
+** page name. The postings of each term are sorted by page, and the
+** positions of each posting in increasing order. All values are stored in
+** the byte order of the machine that generated the index.
+*/
+
+#ifndef _HELPINDEXFORMAT_H
+#define _HELPINDEXFORMAT_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QStringList>
+
+/** Magic bytes at the start of every help search index. */
+#define HELP_INDEX_MAGIC       "VHIX"
+/** Current version of the help search index format. */
+#define HELP_INDEX_VERSION     1
+/** Value written to HelpIndexHeader::byteOrder, used to reject indexes
+ * generated on a machine with a different byte order. */
+#define HELP_INDEX_BYTE_ORDER  0x01020304
+
+struct HelpIndexHeader
+{
+  char magic[4];          /**< HELP_INDEX_MAGIC. */
+  quint32 byteOrder;      /**< HELP_INDEX_BYTE_ORDER. */
+  quint32 version;        /**< HELP_INDEX_VERSION. */
+  quint32 pageCount;      /**< Number of HelpIndexPage entries. */
+  quint32 termCount;      /**< Number of HelpIndexTerm entries. */
+  quint32 postingCount;   /**< Number of HelpIndexPosting entries. */
+  quint32 positionCount;  /**< Number of word positions. */
+  quint32 stringCount;    /**< Number of UTF-16 code units of text. */
+};
+
+struct HelpIndexPage
+{
+  quint32 name;           /**< Offset of the page's file name. */
+  quint32 nameLength;     /**< Length of the page's file name. */
+  quint32 wordCount;      /**< Number of words on the page. */
+};
+
+struct HelpIndexTerm
+{
+  quint32 text;           /**< Offset of the term's text. */
+  quint32 textLength;     /**< Length of the term's text. */
+  quint32 firstPosting;   /**< Index of the term's first posting. */
+  quint32 postingCount;   /**< Number of pages containing the term. */
+};
+
+struct HelpIndexPosting
+{
+  quint32 page;           /**< Index of the page. */
+  quint32 firstPosition;  /**< Index of the first position on the page. */
+  quint32 positionCount;  /**< Number of times the term is on the page. */
+};
+
+/** Splits <b>text</b> into lowercase words, each a run of letters and
+ * digits. help2idx indexes pages and HelpSearchIndex splits queries with
+ * this, so both agree on what a word is. */
+inline QStringList
+help_index_words(const QString &text)
+{
+  QStringList words;
+  int start = -1;
+
+  for (int i = 0; i <= text.length(); i++) {
+    bool letter = (i < text.length() && text.at(i).isLetterOrNumber());
+    if (letter && start < 0) {
+      start = i;
+    } else if (!letter && start >= 0) {
+      words << text.mid(start, i - start).toLower();
+      start = -1;
+    }
+  }
+  return words;
+}
+
+#endif
+
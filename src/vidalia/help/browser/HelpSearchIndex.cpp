@@ -0,0 +1,269 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file HelpSearchIndex.cpp
+** \brief Inverted index of the words on each help page, generated at build
+** time by help2idx
+*/
+
+#include "HelpSearchIndex.h"
+#include "Vidalia.h"
+
+#include <QFile>
+#include <QVector>
+#include <QtAlgorithms>
+
+#include <math.h>
+#include <string.h>
+
+/** Pages with the search words as a phrase score this much higher for each
+ * time the phrase appears. */
+#define PHRASE_WEIGHT  2.0
+
+
+/** Returns true if <b>a</b> should be listed before <b>b</b>. */
+static bool
+result_less_than(const HelpSearchResult &a, const HelpSearchResult &b)
+{
+  if (a.phrase != b.phrase)
+    return a.phrase;
+  return (a.score > b.score);
+}
+
+/** Returns true if the <b>count</b> entries starting at <b>first</b> lie
+ * within a table of <b>size</b> entries. */
+static bool
+in_range(quint32 first, quint32 count, quint32 size)
+{
+  return (quint64(first) + count <= size);
+}
+
+/** Default constructor. */
+HelpSearchIndex::HelpSearchIndex()
+{
+  clear();
+}
+
+/** Discards the loaded index, if any. */
+void
+HelpSearchIndex::clear()
+{
+  _data.clear();
+  _header = 0;
+  _pages = 0;
+  _terms = 0;
+  _postings = 0;
+  _positions = 0;
+  _strings = 0;
+}
+
+/** Loads the index in <b>fname</b>. Returns false, leaving the index empty,
+ * if it is missing, malformed or from an incompatible help2idx. */
+bool
+HelpSearchIndex::load(const QString &fname)
+{
+  clear();
+
+  QFile file(fname);
+  if (! file.open(QIODevice::ReadOnly)) {
+    vWarn("Unable to open help search index: %1").arg(fname);
+    return false;
+  }
+  QByteArray data = file.readAll();
+  const HelpIndexHeader *header
+    = reinterpret_cast<const HelpIndexHeader *>(data.constData());
+  if (data.size() < int(sizeof(HelpIndexHeader))
+        || memcmp(header->magic, HELP_INDEX_MAGIC, 4)
+        || header->byteOrder != HELP_INDEX_BYTE_ORDER
+        || header->version != HELP_INDEX_VERSION) {
+    vWarn("Invalid or incompatible help search index: %1").arg(fname);
+    return false;
+  }
+
+  /* Make sure every section fits before pointing into them */
+  quint64 pages = sizeof(HelpIndexHeader);
+  quint64 terms = pages + quint64(header->pageCount) * sizeof(HelpIndexPage);
+  quint64 postings = terms
+                     + quint64(header->termCount) * sizeof(HelpIndexTerm);
+  quint64 positions = postings
+                      + quint64(header->postingCount)
+                          * sizeof(HelpIndexPosting);
+  quint64 strings = positions
+                    + quint64(header->positionCount) * sizeof(quint32);
+  quint64 end = strings + quint64(header->stringCount) * sizeof(ushort);
+  if (end > quint64(data.size())) {
+    vWarn("Truncated help search index: %1").arg(fname);
+    return false;
+  }
+
+  /* Make sure every entry only refers to entries that exist, so searches
+   * can follow them without checking */
+  const char *base = data.constData();
+  const HelpIndexPage *pageTable
+    = reinterpret_cast<const HelpIndexPage *>(base + pages);
+  const HelpIndexTerm *termTable
+    = reinterpret_cast<const HelpIndexTerm *>(base + terms);
+  const HelpIndexPosting *postingTable
+    = reinterpret_cast<const HelpIndexPosting *>(base + postings);
+  bool valid = true;
+  for (quint32 i = 0; i < header->pageCount && valid; i++) {
+    valid = in_range(pageTable[i].name, pageTable[i].nameLength,
+                     header->stringCount);
+  }
+  for (quint32 i = 0; i < header->termCount && valid; i++) {
+    valid = in_range(termTable[i].text, termTable[i].textLength,
+                     header->stringCount)
+              && in_range(termTable[i].firstPosting,
+                          termTable[i].postingCount, header->postingCount);
+  }
+  for (quint32 i = 0; i < header->postingCount && valid; i++) {
+    valid = (postingTable[i].page < header->pageCount)
+              && in_range(postingTable[i].firstPosition,
+                          postingTable[i].positionCount,
+                          header->positionCount);
+  }
+  if (! valid) {
+    vWarn("Corrupt help search index: %1").arg(fname);
+    return false;
+  }
+
+  _data = data;
+  base = _data.constData();
+  _header = reinterpret_cast<const HelpIndexHeader *>(base);
+  _pages = reinterpret_cast<const HelpIndexPage *>(base + pages);
+  _terms = reinterpret_cast<const HelpIndexTerm *>(base + terms);
+  _postings = reinterpret_cast<const HelpIndexPosting *>(base + postings);
+  _positions = reinterpret_cast<const quint32 *>(base + positions);
+  _strings = reinterpret_cast<const ushort *>(base + strings);
+  return true;
+}
+
+/** Returns the <b>length</b> characters of text at <b>offset</b>. If
+ * <b>copy</b> is false, the result refers to the index's own data and is
+ * only valid while the index is loaded. */
+QString
+HelpSearchIndex::string(quint32 offset, quint32 length, bool copy) const
+{
+  if (quint64(offset) + length > _header->stringCount)
+    return QString();
+  if (copy)
+    return QString::fromUtf16(_strings + offset, length);
+  return QString::fromRawData(reinterpret_cast<const QChar *>(
+                                _strings + offset), length);
+}
+
+/** Binary searches the sorted term table for <b>word</b>. */
+const HelpIndexTerm*
+HelpSearchIndex::findTerm(const QString &word) const
+{
+  quint32 lo = 0, hi = _header->termCount;
+
+  while (lo < hi) {
+    quint32 mid = lo + (hi - lo) / 2;
+    const HelpIndexTerm *term = &_terms[mid];
+    int cmp = QString::compare(string(term->text, term->textLength, false),
+                               word);
+    if (cmp == 0)
+      return term;
+    if (cmp < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return 0;
+}
+
+/** Counts the positions of the first word in <b>hits</b> that are followed
+ * by each of the other words in turn. */
+int
+HelpSearchIndex::countPhrases(const QList<const HelpIndexPosting *> &hits)
+  const
+{
+  int phrases = 0;
+  const HelpIndexPosting *first = hits.at(0);
+
+  for (quint32 i = 0; i < first->positionCount; i++) {
+    quint32 start = _positions[first->firstPosition + i];
+    bool phrase = true;
+    for (int j = 1; j < hits.size() && phrase; j++) {
+      const quint32 *begin = _positions + hits.at(j)->firstPosition;
+      const quint32 *end = begin + hits.at(j)->positionCount;
+      phrase = (qBinaryFind(begin, end, start + j) != end);
+    }
+    if (phrase)
+      phrases++;
+  }
+  return phrases;
+}
+
+/** Intersects the postings of every word in <b>query</b>, which are sorted
+ * by page, and ranks the pages found. */
+QList<HelpSearchResult>
+HelpSearchIndex::search(const QString &query) const
+{
+  QList<HelpSearchResult> results;
+  QList<const HelpIndexTerm *> terms;
+  QStringList words = help_index_words(query);
+
+  if (!isLoaded() || words.isEmpty())
+    return results;
+
+  /* Every word must be on a page, so stop at the first one that isn't */
+  int rarest = 0;
+  foreach (QString word, words) {
+    const HelpIndexTerm *term = findTerm(word);
+    if (!term)
+      return results;
+    if (term->postingCount < terms.value(rarest, term)->postingCount)
+      rarest = terms.size();
+    terms << term;
+  }
+
+  /* Step through the postings of each word alongside those of the rarest */
+  QVector<quint32> next(terms.size(), 0);
+  const HelpIndexTerm *base = terms.at(rarest);
+  for (quint32 i = 0; i < base->postingCount; i++) {
+    quint32 page = _postings[base->firstPosting + i].page;
+    QList<const HelpIndexPosting *> hits;
+
+    for (int t = 0; t < terms.size(); t++) {
+      const HelpIndexPosting *postings = _postings + terms.at(t)->firstPosting;
+      while (next[t] < terms.at(t)->postingCount
+               && postings[next[t]].page < page)
+        next[t]++;
+      if (next[t] == terms.at(t)->postingCount
+            || postings[next[t]].page != page)
+        break;
+      hits << &postings[next[t]];
+    }
+    if (hits.size() != terms.size() || page >= _header->pageCount)
+      continue;
+
+    HelpSearchResult result;
+    result.page = string(_pages[page].name, _pages[page].nameLength);
+    result.score = 0.0;
+    for (int t = 0; t < terms.size(); t++) {
+      qreal idf = log(1.0 + qreal(_header->pageCount)
+                              / terms.at(t)->postingCount);
+      result.score += idf * hits.at(t)->positionCount;
+    }
+    result.score /= sqrt(qreal(qMax(_pages[page].wordCount, quint32(1))));
+
+    int phrases = (terms.size() > 1) ? countPhrases(hits) : 1;
+    result.phrase = (phrases > 0);
+    result.score *= 1.0 + PHRASE_WEIGHT * phrases;
+    results << result;
+  }
+
+  qStableSort(results.begin(), results.end(), result_less_than);
+  return results;
+}
+
@@ -0,0 +1,76 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file HelpSearchIndex.h
+** \brief Inverted index of the words on each help page, generated at build
+** time by help2idx
+*/
+
+#ifndef _HELPSEARCHINDEX_H
+#define _HELPSEARCHINDEX_H
+
+#include "HelpIndexFormat.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QList>
+
+
+/** A help page matching a search. */
+struct HelpSearchResult
+{
+  QString page;  /**< File name of the page, such as "log.html". */
+  qreal score;   /**< Relevance of the page. Higher is better. */
+  bool phrase;   /**< True if the page has the search words as a phrase. */
+};
+
+class HelpSearchIndex
+{
+public:
+  /** Default constructor. */
+  HelpSearchIndex();
+
+  /** Loads the index in <b>fname</b>, which is usually a resource such as
+   * ":/help/en/search.idx". Returns false, leaving the index empty, if it
+   * can't be read or was generated by an incompatible help2idx. */
+  bool load(const QString &fname);
+  /** Discards the loaded index, if any. */
+  void clear();
+  /** Returns true if an index is loaded. */
+  bool isLoaded() const { return (_header != 0); }
+
+  /** Returns the pages containing every word in <b>query</b>, best first.
+   * Pages with the words in the same order as the query rank above the
+   * others; within each group, pages are ranked by how often they use the
+   * words, weighted by how rare each word is. */
+  QList<HelpSearchResult> search(const QString &query) const;
+
+private:
+  /** Returns the index entry for <b>word</b>, or 0 if no page has it. */
+  const HelpIndexTerm* findTerm(const QString &word) const;
+  /** Returns the <b>length</b> characters of text at <b>offset</b>, copied
+   * unless <b>copy</b> is false. */
+  QString string(quint32 offset, quint32 length, bool copy = true) const;
+  /** Returns the number of places <b>hits</b> has its words in order,
+   * one after another. */
+  int countPhrases(const QList<const HelpIndexPosting *> &hits) const;
+
+  QByteArray _data;  /**< Contents of the index file. */
+  const HelpIndexHeader *_header;    /**< Start of _data. */
+  const HelpIndexPage *_pages;       /**< Page table. */
+  const HelpIndexTerm *_terms;       /**< Terms, sorted by their text. */
+  const HelpIndexPosting *_postings; /**< Pages containing each term. */
+  const quint32 *_positions;         /**< Word positions of each posting. */
+  const ushort *_strings;            /**< Text of terms and page names. */
+};
+
+#endif
+
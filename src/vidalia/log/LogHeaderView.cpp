@@ -14,12 +14,12 @@
 */
 
 #include "LogHeaderView.h"
-#include "LogTreeWidget.h"
+#include "LogMessageModel.h"
 
 /* Column indices */
-#define COL_TIME  LogTreeWidget::TimeColumn
-#define COL_TYPE  LogTreeWidget::TypeColumn
-#define COL_MESG  LogTreeWidget::MessageColumn
+#define COL_TIME  LogMessageModel::TimeColumn
+#define COL_TYPE  LogMessageModel::TypeColumn
+#define COL_MESG  LogMessageModel::MessageColumn
 
 /* Default column widths */
 #define COL_TIME_WIDTH    135
@@ -0,0 +1,558 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file LogMessageModel.cpp
+** \brief Ring buffer of Tor log messages exposed as a sortable table model
+*/
+
+#include "LogMessageModel.h"
+
+#include "stringutil.h"
+
+#include <QColor>
+
+/** Defines the format used for displaying the date and time of a log message.*/
+#define DATETIME_FMT  "MMM dd hh:mm:ss.zzz"
+
+/** Number of columns in the message log. */
+#define COLUMN_COUNT  3
+
+
+/** Default constructor. */
+LogMessageModel::LogMessageModel(QObject *parent)
+  : QAbstractTableModel(parent), _sorted(this)
+{
+  _head = 0;
+  _count = 0;
+  _firstSeqnum = 0;
+  _sortColumn = TimeColumn;
+  _sortOrder = Qt::AscendingOrder;
+  _filter = ~0u;
+  _hidden = 0;
+  _firstMatch = 0;
+}
+
+/** Returns the number of messages shown in the log. */
+int
+LogMessageModel::rowCount(const QModelIndex &parent) const
+{
+  return (parent.isValid() ? 0 : shownCount());
+}
+
+/** Returns the number of columns in the log. */
+int
+LogMessageModel::columnCount(const QModelIndex &parent) const
+{
+  return (parent.isValid() ? 0 : COLUMN_COUNT);
+}
+
+/** Returns the message with sequence number <b>seqnum</b>. */
+const LogMessage&
+LogMessageModel::messageBySeqnum(quint64 seqnum) const
+{
+  return _ring.at((_head + int(seqnum - _firstSeqnum)) % _ring.size());
+}
+
+/** Returns the sequence number of the message displayed in <b>row</b>. */
+quint64
+LogMessageModel::seqnumForRow(int row) const
+{
+  int pos = (_sortOrder == Qt::AscendingOrder) ? row
+                                              : (shownCount() - 1 - row);
+  if (! hasRowList())
+    return _firstSeqnum + pos;
+  return _sorted.at(pos);
+}
+
+/** Returns the row displaying the message with sequence number
+ * <b>seqnum</b>. */
+int
+LogMessageModel::rowForSeqnum(quint64 seqnum) const
+{
+  int pos;
+  if (! hasRowList())
+    pos = int(seqnum - _firstSeqnum);
+  else
+    pos = _sorted.position(seqnum);
+  return (_sortOrder == Qt::AscendingOrder) ? pos : (shownCount() - 1 - pos);
+}
+
+/** Compares the messages with sequence numbers <b>a</b> and <b>b</b> based
+ * on the current sort column. Ties are always broken chronologically. */
+bool
+LogMessageModel::lessThan(quint64 a, quint64 b) const
+{
+  const LogMessage &msgA = messageBySeqnum(a);
+  const LogMessage &msgB = messageBySeqnum(b);
+
+  switch (_sortColumn) {
+    case TypeColumn:
+      /* Sort by severity, then chronologically. The comparison is flipped
+       * because higher severities have lower numeric values. */
+      if (msgA.severity != msgB.severity)
+        return (msgA.severity > msgB.severity);
+      break;
+
+    case MessageColumn: {
+      /* Sort by message, then chronologically */
+      int cmp = QString::compare(msgA.message, msgB.message,
+                                 Qt::CaseInsensitive);
+      if (cmp != 0)
+        return (cmp < 0);
+      break;
+    }
+
+    default:
+      break;
+  }
+  return (a < b);
+}
+
+/** Rebuilds the list of sequence numbers of the messages shown, ordered by
+ * the current sort column. Sorting by time needs no list while every
+ * message is shown, since the ring buffer is already in chronological
+ * order. */
+void
+LogMessageModel::rebuildSortOrder()
+{
+  _sorted.clear();
+  if (! hasRowList())
+    return;
+
+  for (int i = 0; i < _count; i++) {
+    quint64 seqnum = _firstSeqnum + i;
+    if (isShown(messageBySeqnum(seqnum)))
+      _sorted.insert(seqnum);
+  }
+}
+
+/** Sorts the log by <b>column</b> in the given <b>order</b>, keeping any
+ * persistent indexes (such as the current selection) pointing at the same
+ * messages. */
+void
+LogMessageModel::sort(int column, Qt::SortOrder order)
+{
+  if (column < 0 || column >= COLUMN_COUNT)
+    column = TimeColumn;
+  if (column == _sortColumn && order == _sortOrder)
+    return;
+
+  emit layoutAboutToBeChanged();
+
+  QModelIndexList oldIndexes = persistentIndexList();
+  QList<quint64> seqnums;
+  foreach (QModelIndex oldIndex, oldIndexes) {
+    seqnums << seqnumForRow(oldIndex.row());
+  }
+
+  _sortColumn = column;
+  _sortOrder = order;
+  rebuildSortOrder();
+
+  /* Map each sequence number to its new position in a single pass, rather
+   * than doing a binary search for each persistent index */
+  int rows = shownCount();
+  QVector<quint64> sorted = _sorted.values();
+  QVector<int> positions(_count);
+  for (int i = 0; i < rows; i++) {
+    quint64 seqnum = hasRowList() ? sorted.at(i) : (_firstSeqnum + i);
+    positions[int(seqnum - _firstSeqnum)] = i;
+  }
+
+  QModelIndexList newIndexes;
+  for (int i = 0; i < oldIndexes.size(); i++) {
+    int pos = positions.at(int(seqnums.at(i) - _firstSeqnum));
+    int row = (_sortOrder == Qt::AscendingOrder) ? pos : (rows - 1 - pos);
+    newIndexes << index(row, oldIndexes.at(i).column());
+  }
+  changePersistentIndexList(oldIndexes, newIndexes);
+
+  emit layoutChanged();
+}
+
+/** Appends a message to the log, evicting the oldest message if the log is
+ * full, and returns the new message. */
+LogMessage
+LogMessageModel::log(tc::Severity severity, const QString &message,
+                     const QDateTime &timestamp)
+{
+  LogMessage msg;
+  msg.seqnum = _firstSeqnum + _count;
+  msg.severity = severity;
+  msg.timestamp = timestamp;
+  msg.message = message;
+
+  int capacity = _ring.size();
+  if (capacity <= 0)
+    return msg;
+  int matches = matchCount();
+
+  /* If we need to make room, then make some room. A hidden message has no
+   * row to remove. */
+  if (_count >= capacity) {
+    bool shown = isShown(_ring.at(_head));
+    if (shown) {
+      int row = rowForSeqnum(_firstSeqnum);
+      beginRemoveRows(QModelIndex(), row, row);
+      if (hasRowList())
+        _sorted.remove(_firstSeqnum);
+    } else {
+      _hidden--;
+    }
+    _index.removeOldest(_firstSeqnum, _ring.at(_head).message);
+    if (matchCount() > 0 && _matches.at(_firstMatch) == _firstSeqnum) {
+      /* Drop the evicted match, compacting the list once it is mostly
+       * evicted matches */
+      if (++_firstMatch > _matches.size() / 2) {
+        _matches.remove(0, _firstMatch);
+        _firstMatch = 0;
+      }
+    }
+    _ring[_head] = LogMessage();
+    _head = (_head + 1) % capacity;
+    _firstSeqnum++;
+    _count--;
+    if (shown)
+      endRemoveRows();
+    else if (! hasRowList())
+      _sorted.clear(); /* Every message is shown again */
+  }
+
+  /* Store the message in the free slot after the newest one before looking
+   * for its sorted position, since the comparison reads it from there */
+  _ring[(_head + _count) % capacity] = msg;
+
+  if (isShown(msg)) {
+    int pos = hasRowList() ? _sorted.position(msg.seqnum) : _count;
+    int row = (_sortOrder == Qt::AscendingOrder) ? pos : (shownCount() - pos);
+    beginInsertRows(QModelIndex(), row, row);
+    if (hasRowList())
+      _sorted.insert(msg.seqnum);
+    _count++;
+    endInsertRows();
+  } else {
+    /* The rows stay the same, but they no longer map directly onto the
+     * ring buffer */
+    bool hadRowList = hasRowList();
+    _count++;
+    _hidden++;
+    if (! hadRowList)
+      rebuildSortOrder();
+  }
+
+  /* Keep the index and the current search's matches up to date */
+  _index.add(msg.seqnum, msg.message);
+  if (hasSearch() && isShown(msg) && _search.indexIn(msg.message) >= 0)
+    _matches.append(msg.seqnum);
+  if (matchCount() != matches)
+    emit matchCountChanged(matchCount());
+
+  return msg;
+}
+
+/** Replaces the contents of the log with the newest <b>max</b> messages in
+ * <b>messages</b>, which must be in chronological order. Sequence numbers
+ * keep increasing across calls, so they remain valid as a chronological
+ * sort key. */
+void
+LogMessageModel::replaceMessages(const QList<LogMessage> &messages, int max)
+{
+  max = qMax(0, max);
+  int first = qMax(0, messages.size() - max);
+
+  _firstSeqnum += _count;
+  _ring = QVector<LogMessage>(max);
+  _head = 0;
+  _count = 0;
+  _hidden = 0;
+  _index.clear();
+  for (int i = first; i < messages.size(); i++) {
+    LogMessage msg = messages.at(i);
+    msg.seqnum = _firstSeqnum + _count;
+    _ring[_count++] = msg;
+    _index.add(msg.seqnum, msg.message);
+    if (! isShown(msg))
+      _hidden++;
+  }
+  rebuildSortOrder();
+  reset();
+
+  /* Sequence numbers changed, so find the current search's matches again */
+  if (hasSearch())
+    setSearch(_search);
+}
+
+/** Sets the maximum number of messages kept in the log. */
+void
+LogMessageModel::setMaximumMessageCount(int max)
+{
+  if (max != _ring.size())
+    replaceMessages(messages(), max);
+}
+
+/** Shows only the messages whose severity is set in <b>filter</b>. The
+ * other messages are kept, so they are shown again if a later filter
+ * includes their severity. */
+void
+LogMessageModel::filter(uint filter)
+{
+  if (filter == _filter)
+    return;
+
+  _filter = filter;
+  _hidden = 0;
+  for (int i = 0; i < _count; i++) {
+    if (! isShown(messageBySeqnum(_firstSeqnum + i)))
+      _hidden++;
+  }
+  rebuildSortOrder();
+  reset();
+
+  /* Only messages that are shown can match the current search */
+  if (hasSearch())
+    setSearch(_search);
+}
+
+/** Discards every message in the log. */
+void
+LogMessageModel::clear()
+{
+  replaceMessages(QList<LogMessage>(), _ring.size());
+}
+
+/** Returns the message displayed in the row of <b>index</b>. */
+LogMessage
+LogMessageModel::message(const QModelIndex &index) const
+{
+  if (!index.isValid() || index.row() >= shownCount())
+    return LogMessage();
+  return messageBySeqnum(seqnumForRow(index.row()));
+}
+
+/** Returns all messages in chronological order. */
+QList<LogMessage>
+LogMessageModel::messages() const
+{
+  QList<LogMessage> list;
+  for (int i = 0; i < _count; i++)
+    list << messageBySeqnum(_firstSeqnum + i);
+  return list;
+}
+
+/** Returns the sequence numbers of all shown messages matching
+ * <b>pattern</b>. If the pattern requires some text at least three
+ * characters long, only the messages the index lists for that text are
+ * matched against it; otherwise, every message is. */
+QVector<quint64>
+LogMessageModel::findSeqnums(const QRegExp &pattern) const
+{
+  QVector<quint64> seqnums;
+  QString text = LogSearchIndex::requiredText(pattern);
+
+  if (LogSearchIndex::canSearch(text)) {
+    foreach (quint64 seqnum, _index.candidates(text)) {
+      const LogMessage &msg = messageBySeqnum(seqnum);
+      if (isShown(msg) && pattern.indexIn(msg.message) >= 0)
+        seqnums << seqnum;
+    }
+  } else {
+    for (int i = 0; i < _count; i++) {
+      const LogMessage &msg = messageBySeqnum(_firstSeqnum + i);
+      if (isShown(msg) && pattern.indexIn(msg.message) >= 0)
+        seqnums << msg.seqnum;
+    }
+  }
+  return seqnums;
+}
+
+/** Returns the indexes of the first column of all messages containing
+ * <b>text</b>, ignoring case, in chronological order. */
+QModelIndexList
+LogMessageModel::find(const QString &text) const
+{
+  return find(QRegExp(text, Qt::CaseInsensitive, QRegExp::FixedString));
+}
+
+/** Returns the indexes of the first column of all messages matching
+ * <b>pattern</b>, in chronological order. */
+QModelIndexList
+LogMessageModel::find(const QRegExp &pattern) const
+{
+  QModelIndexList indexes;
+  foreach (quint64 seqnum, findSeqnums(pattern)) {
+    indexes << index(rowForSeqnum(seqnum), TimeColumn);
+  }
+  return indexes;
+}
+
+/** Makes <b>pattern</b> the current search and finds the messages matching
+ * it. */
+void
+LogMessageModel::setSearch(const QRegExp &pattern)
+{
+  _search = pattern;
+  _matches = findSeqnums(pattern);
+  _firstMatch = 0;
+  emit matchCountChanged(matchCount());
+}
+
+/** Clears the current search. */
+void
+LogMessageModel::clearSearch()
+{
+  _search = QRegExp();
+  _matches.clear();
+  _firstMatch = 0;
+  emit matchCountChanged(0);
+}
+
+/** Returns the indexes of the first column of every message matching the
+ * current search, in chronological order. */
+QModelIndexList
+LogMessageModel::matches() const
+{
+  QModelIndexList indexes;
+  for (int i = _firstMatch; i < _matches.size(); i++)
+    indexes << index(rowForSeqnum(_matches.at(i)), TimeColumn);
+  return indexes;
+}
+
+/** Binary searches the current search's matches for the closest one after
+ * (or before) the message at <b>from</b>, in chronological order. If
+ * <b>from</b> is invalid, the oldest (or newest) match is returned. */
+QModelIndex
+LogMessageModel::nextMatch(const QModelIndex &from, bool forward) const
+{
+  if (matchCount() == 0)
+    return QModelIndex();
+
+  const quint64 *begin = _matches.constData() + _firstMatch;
+  const quint64 *end = _matches.constData() + _matches.size();
+  const quint64 *match;
+  if (!from.isValid() || from.row() >= shownCount()) {
+    match = forward ? begin : (end - 1);
+  } else if (forward) {
+    match = qUpperBound(begin, end, seqnumForRow(from.row()));
+    if (match == end)
+      match = begin;
+  } else {
+    match = qLowerBound(begin, end, seqnumForRow(from.row()));
+    match = (match == begin) ? (end - 1) : (match - 1);
+  }
+  return index(rowForSeqnum(*match), TimeColumn);
+}
+
+/** Returns the data stored under <b>role</b> for the message and column
+ * referred to by <b>index</b>. Display strings are only built for the rows
+ * a view actually asks for. */
+QVariant
+LogMessageModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid() || index.row() >= shownCount())
+    return QVariant();
+
+  const LogMessage &msg = messageBySeqnum(seqnumForRow(index.row()));
+  switch (role) {
+    case Qt::DisplayRole:
+      switch (index.column()) {
+        case TimeColumn:    return msg.timestamp.toString(DATETIME_FMT);
+        case TypeColumn:    return severityToString(msg.severity);
+        case MessageColumn: return msg.message;
+        default: break;
+      }
+      break;
+
+    case Qt::ToolTipRole:
+      if (index.column() == TimeColumn)
+        return msg.timestamp.toString(DATETIME_FMT);
+      if (index.column() == MessageColumn)
+        return string_wrap(msg.message, 80, " ", "\r\n");
+      break;
+
+    case Qt::TextAlignmentRole:
+      if (index.column() == TypeColumn)
+        return int(Qt::AlignCenter);
+      break;
+
+    /* Change row and text color for serious warnings and errors. Critical
+     * messages are red with white text and warnings are yellow with black
+     * text. */
+    case Qt::BackgroundRole:
+      if (msg.severity == tc::ErrorSeverity)
+        return QColor(Qt::red);
+      if (msg.severity == tc::WarnSeverity)
+        return QColor(Qt::yellow);
+      break;
+
+    case Qt::ForegroundRole:
+      if (msg.severity == tc::ErrorSeverity)
+        return QColor(Qt::white);
+      break;
+
+    default:
+      break;
+  }
+  return QVariant();
+}
+
+/** Returns the column header data for <b>section</b>. */
+QVariant
+LogMessageModel::headerData(int section, Qt::Orientation orientation,
+                            int role) const
+{
+  if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+    return QVariant();
+
+  switch (section) {
+    case TimeColumn:    return tr("Time");
+    case TypeColumn:    return tr("Type");
+    case MessageColumn: return tr("Message");
+    default: break;
+  }
+  return QVariant();
+}
+
+/** Notifies views that the translated column headers and severity names
+ * have changed. */
+void
+LogMessageModel::retranslateUi()
+{
+  emit headerDataChanged(Qt::Horizontal, 0, COLUMN_COUNT-1);
+  int rows = shownCount();
+  if (rows > 0)
+    emit dataChanged(index(0, TypeColumn), index(rows-1, TypeColumn));
+}
+
+/** Returns a printable string representation of <b>msg</b>. */
+QString
+LogMessageModel::toString(const LogMessage &msg)
+{
+  return QString("%1 [%2] %3").arg(msg.timestamp.toString(DATETIME_FMT))
+                              .arg(severityToString(msg.severity))
+                              .arg(msg.message.trimmed());
+}
+
+/** Converts a tc::Severity enum value to a localized string description. */
+QString
+LogMessageModel::severityToString(tc::Severity severity)
+{
+  QString str;
+  switch (severity) {
+    case tc::DebugSeverity:  str = tr("Debug"); break;
+    case tc::InfoSeverity:   str = tr("Info"); break;
+    case tc::NoticeSeverity: str = tr("Notice"); break;
+    case tc::WarnSeverity:   str = tr("Warning"); break;
+    case tc::ErrorSeverity:  str = tr("Error"); break;
+    default: str = tr("Unknown"); break;
+  }
+  return str;
+}
+
@@ -0,0 +1,195 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file LogMessageModel.h
+** \brief Ring buffer of Tor log messages exposed as a sortable table model
+*/
+
+#ifndef _LOGMESSAGEMODEL_H
+#define _LOGMESSAGEMODEL_H
+
+#include "TorControl.h"
+#include "LogSearchIndex.h"
+#include "LogSortOrder.h"
+
+#include <QAbstractTableModel>
+#include <QDateTime>
+#include <QString>
+#include <QRegExp>
+#include <QVector>
+#include <QList>
+
+
+/** A single message in the message log. */
+struct LogMessage
+{
+  LogMessage() : seqnum(0), severity(tc::UnrecognizedSeverity) {}
+
+  quint64 seqnum;         /**< Position of the message in the log. */
+  tc::Severity severity;  /**< Severity of the message. */
+  QDateTime timestamp;    /**< Time the message was received. */
+  QString message;        /**< Message text. */
+};
+
+
+/** Stores up to a maximum number of log messages in a ring buffer and
+ * presents them as a three-column table. No per-message item objects are
+ * created; views only ask for the rows they actually display. Appending a
+ * message and evicting the oldest one take constant time when the log is
+ * sorted by time, and logarithmic time when it is sorted by another column.
+ * Messages are also kept in a LogSearchIndex, so searches only look at
+ * messages that share every trigram of the text searched for, and the
+ * matches of the current search are updated as messages come and go.
+ * Messages whose severity is filtered out are kept but not shown.
+ */
+class LogMessageModel : public QAbstractTableModel,
+                        private LogSortOrder::Compare
+{
+  Q_OBJECT
+
+public:
+  /** Log model column indices. */
+  enum LogColumns {
+    TimeColumn    = 0, /**< Timestamp column. */
+    TypeColumn    = 1, /**< Message severity type column. */
+    MessageColumn = 2  /**< Message text column. */
+  };
+
+  /** Default constructor. */
+  LogMessageModel(QObject *parent = 0);
+
+  /** Returns the number of messages shown in the log, or 0 if
+   * <b>parent</b> is a valid index. */
+  virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+  /** Returns the number of columns in the log. */
+  virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
+  /** Returns the data stored under <b>role</b> for the message and column
+   * referred to by <b>index</b>. */
+  virtual QVariant data(const QModelIndex &index,
+                        int role = Qt::DisplayRole) const;
+  /** Returns the column header data for <b>section</b>. */
+  virtual QVariant headerData(int section, Qt::Orientation orientation,
+                              int role = Qt::DisplayRole) const;
+  /** Sorts the log by <b>column</b> in the given <b>order</b>. */
+  virtual void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+  /** Returns the number of messages in the log, including those that are
+   * not shown. */
+  int messageCount() const { return _count; }
+  /** Returns the maximum number of messages kept in the log. */
+  int maximumMessageCount() const { return _ring.size(); }
+  /** Sets the maximum number of messages kept in the log, discarding the
+   * oldest messages if there are currently more than <b>max</b>. */
+  void setMaximumMessageCount(int max);
+
+  /** Appends a message to the log, evicting the oldest message if the log
+   * is full, and returns the new message. */
+  LogMessage log(tc::Severity severity, const QString &message,
+                 const QDateTime &timestamp = QDateTime::currentDateTime());
+  /** Shows only the messages whose severity is set in <b>filter</b>,
+   * keeping the others so a later filter can show them again. */
+  void filter(uint filter);
+  /** Discards every message in the log. */
+  void clear();
+
+  /** Returns the message displayed in the row of <b>index</b>. */
+  LogMessage message(const QModelIndex &index) const;
+  /** Returns all messages, shown or not, in chronological order. */
+  QList<LogMessage> messages() const;
+  /** Returns the indexes of the first column of all messages containing
+   * <b>text</b>, in chronological order. */
+  QModelIndexList find(const QString &text) const;
+  /** Returns the indexes of the first column of all messages matching
+   * <b>pattern</b>, in chronological order. */
+  QModelIndexList find(const QRegExp &pattern) const;
+
+  /** Makes <b>pattern</b> the current search. Messages matching it are
+   * found once, then kept track of as messages are added and evicted. */
+  void setSearch(const QRegExp &pattern);
+  /** Clears the current search. */
+  void clearSearch();
+  /** Returns true if there is a current search. */
+  bool hasSearch() const { return !_search.isEmpty(); }
+  /** Returns the number of messages matching the current search. */
+  int matchCount() const { return _matches.size() - _firstMatch; }
+  /** Returns the indexes of the first column of every message matching the
+   * current search, in chronological order. */
+  QModelIndexList matches() const;
+  /** Returns the index of the first column of the next message after
+   * <b>from</b>, or the previous one if <b>forward</b> is false, matching
+   * the current search. The search wraps around at either end of the log.
+   * Returns an invalid index if no message matches. */
+  QModelIndex nextMatch(const QModelIndex &from, bool forward = true) const;
+  /** Notifies views that the translated column headers have changed. */
+  void retranslateUi();
+
+  /** Returns a printable string representation of <b>msg</b>. */
+  static QString toString(const LogMessage &msg);
+  /** Converts a tc::Severity enum value to a localized string description.*/
+  static QString severityToString(tc::Severity severity);
+
+signals:
+  /** Emitted when the number of messages matching the current search
+   * changes to <b>count</b>. */
+  void matchCountChanged(int count);
+
+private:
+  /** Returns the message with sequence number <b>seqnum</b>. */
+  const LogMessage& messageBySeqnum(quint64 seqnum) const;
+  /** Returns true if the severity of <b>msg</b> is set in the current
+   * filter. */
+  bool isShown(const LogMessage &msg) const
+    { return ((_filter & msg.severity) != 0); }
+  /** Returns true if rows are mapped to messages through <b>_sorted</b>
+   * rather than directly onto the ring buffer. */
+  bool hasRowList() const
+    { return (_sortColumn != TimeColumn || _hidden > 0); }
+  /** Returns the number of messages shown. */
+  int shownCount() const { return (_count - _hidden); }
+  /** Returns the sequence number of the message displayed in <b>row</b>. */
+  quint64 seqnumForRow(int row) const;
+  /** Returns the row displaying the message with sequence number
+   * <b>seqnum</b>. */
+  int rowForSeqnum(quint64 seqnum) const;
+  /** Returns true if message <b>a</b> sorts before message <b>b</b> in the
+   * current sort column, ignoring the sort order. */
+  virtual bool lessThan(quint64 a, quint64 b) const;
+  /** Rebuilds <b>_sorted</b> for the current sort column. */
+  void rebuildSortOrder();
+  /** Replaces the contents of the log with the newest <b>max</b> messages
+   * in <b>messages</b>, which must be in chronological order. */
+  void replaceMessages(const QList<LogMessage> &messages, int max);
+  /** Returns the sequence numbers of all messages matching <b>pattern</b>,
+   * in increasing order. */
+  QVector<quint64> findSeqnums(const QRegExp &pattern) const;
+
+  QVector<LogMessage> _ring; /**< Ring buffer of messages. */
+  int _head;   /**< Index in <b>_ring</b> of the oldest message. */
+  int _count;  /**< Number of messages in <b>_ring</b>. */
+  quint64 _firstSeqnum; /**< Sequence number of the oldest message. */
+  int _sortColumn;           /**< Column the log is currently sorted by. */
+  Qt::SortOrder _sortOrder;  /**< Order the log is currently sorted in. */
+  uint _filter;  /**< Severities of the messages shown. */
+  int _hidden;   /**< Number of messages in <b>_ring</b> not shown. */
+  /** Sequence numbers of the messages shown, in ascending order of the
+   * current sort column. This is only used when not sorting by time or when
+   * some messages are not shown. */
+  LogSortOrder _sorted;
+  LogSearchIndex _index;     /**< Trigram index of every message. */
+  QRegExp _search;           /**< Pattern of the current search. */
+  /** Sequence numbers of the messages matching the current search, in
+   * increasing order, starting at <b>_firstMatch</b>. */
+  QVector<quint64> _matches;
+  int _firstMatch;  /**< Index in <b>_matches</b> of the oldest match. */
+};
+
+#endif
+
@@ -0,0 +1,206 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file LogSearchIndex.cpp
+** \brief Trigram index of the messages in the message log
+*/
+
+#include "LogSearchIndex.h"
+
+#include <QList>
+#include <QPair>
+#include <QSet>
+#include <QtAlgorithms>
+
+/** Number of characters in each indexed sequence. */
+#define TRIGRAM_LENGTH  3
+/** A list of sequence numbers is compacted once more than half of it, and at
+ * least this many entries, belong to removed messages. */
+#define MIN_COMPACT     32
+
+
+/** Returns true if list <b>a</b> has fewer entries than list <b>b</b>. */
+static bool
+shorter_than(const QPair<const quint64 *, const quint64 *> &a,
+             const QPair<const quint64 *, const quint64 *> &b)
+{
+  return ((a.second - a.first) < (b.second - b.first));
+}
+
+/** Default constructor. */
+LogSearchIndex::LogSearchIndex()
+{
+}
+
+/** Packs the three characters at <b>pos</b> in <b>text</b> into one
+ * key. */
+quint64
+LogSearchIndex::trigram(const QString &text, int pos)
+{
+  return (quint64(text.at(pos).unicode()) << 32)
+           | (quint64(text.at(pos+1).unicode()) << 16)
+           | quint64(text.at(pos+2).unicode());
+}
+
+/** Adds <b>seqnum</b> to the list of every trigram in <b>text</b>. A
+ * trigram that appears more than once in a message is only listed once. */
+void
+LogSearchIndex::add(quint64 seqnum, const QString &text)
+{
+  QString lower = text.toLower();
+
+  for (int i = 0; i + TRIGRAM_LENGTH <= lower.length(); i++) {
+    Postings &postings = _postings[trigram(lower, i)];
+    if (postings.seqnums.isEmpty() || postings.seqnums.last() != seqnum)
+      postings.seqnums.append(seqnum);
+  }
+}
+
+/** Removes <b>seqnum</b> from the front of the list of every trigram in
+ * <b>text</b>. Since it is the oldest message, it is always first in each
+ * list, so this just moves the start of the list past it. */
+void
+LogSearchIndex::removeOldest(quint64 seqnum, const QString &text)
+{
+  QString lower = text.toLower();
+
+  for (int i = 0; i + TRIGRAM_LENGTH <= lower.length(); i++) {
+    QHash<quint64, Postings>::iterator it = _postings.find(trigram(lower, i));
+    if (it == _postings.end())
+      continue;
+
+    Postings &postings = it.value();
+    if (postings.head >= postings.seqnums.size()
+          || postings.seqnums.at(postings.head) != seqnum)
+      continue;
+    if (++postings.head == postings.seqnums.size()) {
+      _postings.erase(it);
+    } else if (postings.head >= MIN_COMPACT
+                 && 2 * postings.head > postings.seqnums.size()) {
+      postings.seqnums.remove(0, postings.head);
+      postings.head = 0;
+    }
+  }
+}
+
+/** Removes every message from the index. */
+void
+LogSearchIndex::clear()
+{
+  _postings.clear();
+}
+
+/** Returns true if <b>text</b> has at least one trigram. */
+bool
+LogSearchIndex::canSearch(const QString &text)
+{
+  return (text.length() >= TRIGRAM_LENGTH);
+}
+
+/** Intersects the lists of every distinct trigram in <b>text</b>, starting
+ * with the shortest so the others only need to be binary searched. */
+QVector<quint64>
+LogSearchIndex::candidates(const QString &text) const
+{
+  typedef QPair<const quint64 *, const quint64 *> Range;
+  QString lower = text.toLower();
+  QVector<quint64> results;
+  QList<Range> lists;
+  QSet<quint64> seen;
+
+  for (int i = 0; i + TRIGRAM_LENGTH <= lower.length(); i++) {
+    quint64 key = trigram(lower, i);
+    if (seen.contains(key))
+      continue;
+    seen.insert(key);
+
+    QHash<quint64, Postings>::const_iterator it = _postings.find(key);
+    if (it == _postings.constEnd())
+      return results;
+    const QVector<quint64> &seqnums = it.value().seqnums;
+    lists << Range(seqnums.constData() + it.value().head,
+                   seqnums.constData() + seqnums.size());
+  }
+  if (lists.isEmpty())
+    return results;
+  qSort(lists.begin(), lists.end(), shorter_than);
+
+  for (const quint64 *s = lists.at(0).first; s != lists.at(0).second; ++s) {
+    bool all = true;
+    for (int j = 1; j < lists.size() && all; j++) {
+      /* Later candidates are higher, so skip what this one passed over */
+      Range &range = lists[j];
+      range.first = qLowerBound(range.first, range.second, *s);
+      all = (range.first != range.second && *range.first == *s);
+    }
+    if (all)
+      results << *s;
+  }
+  return results;
+}
+
+/** Returns the longest run of literal characters outside of any group,
+ * character class or escape sequence in <b>pattern</b>, leaving out any
+ * character made optional by the quantifier after it. Patterns with
+ * alternatives have no text that every match must contain, so an empty
+ * string is returned for them. */
+QString
+LogSearchIndex::requiredText(const QRegExp &pattern)
+{
+  QString p = pattern.pattern();
+  if (pattern.patternSyntax() == QRegExp::FixedString)
+    return p;
+  if (pattern.patternSyntax() == QRegExp::Wildcard || p.contains('|'))
+    return QString();
+
+  QString best, run;
+  int depth = 0;
+  for (int i = 0; i <= p.length(); i++) {
+    QChar c = (i < p.length()) ? p.at(i) : QChar();
+    if (!c.isNull() && depth == 0 && !QString("\\.^$[](){}*+?").contains(c)) {
+      run.append(c);
+      continue;
+    }
+
+    /* Any quantifier but '+' makes the previous character optional */
+    if (c == '*' || c == '?' || c == '{')
+      run.chop(1);
+    if (run.length() > best.length())
+      best = run;
+    run.clear();
+
+    if (c == '\\') {
+      /* Skip the escaped character, and the digits of a hexadecimal or
+       * octal character code */
+      int digits = 0;
+      if (++i < p.length() && p.at(i) == 'x')
+        digits = 4;
+      else if (i < p.length() && p.at(i) == '0')
+        digits = 3;
+      while (digits-- > 0 && i + 1 < p.length()
+               && QString("0123456789abcdefABCDEF").contains(p.at(i + 1)))
+        i++;
+    } else if (c == '(') {
+      depth++;
+    } else if (c == ')') {
+      depth = qMax(0, depth - 1);
+    } else if (c == '[' && depth == 0) {
+      /* Skip the character class, allowing ']' as its first character */
+      int end = p.indexOf(']', i + 2);
+      i = (end < 0) ? p.length() : end;
+    } else if (c == '{' && depth == 0) {
+      int end = p.indexOf('}', i + 1);
+      i = (end < 0) ? p.length() : end;
+    }
+  }
+  return best;
+}
+
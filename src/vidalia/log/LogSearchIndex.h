@@ -0,0 +1,77 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file LogSearchIndex.h
+** \brief Trigram index of the messages in the message log
+*/
+
+#ifndef _LOGSEARCHINDEX_H
+#define _LOGSEARCHINDEX_H
+
+#include <QHash>
+#include <QVector>
+#include <QString>
+#include <QRegExp>
+
+
+/** A LogSearchIndex maps every three-character sequence (trigram) of each
+ * message, ignoring case, to the sequence numbers of the messages that
+ * contain it. Messages must be added in increasing order of sequence number
+ * and removed oldest first, which keeps every list of sequence numbers
+ * sorted and lets the oldest be dropped without moving the rest. */
+class LogSearchIndex
+{
+public:
+  /** Default constructor. */
+  LogSearchIndex();
+
+  /** Indexes <b>text</b> as the message with sequence number
+   * <b>seqnum</b>, which must be higher than that of every message already
+   * indexed. */
+  void add(quint64 seqnum, const QString &text);
+  /** Removes the message with sequence number <b>seqnum</b> and text
+   * <b>text</b>, which must be the oldest message indexed. */
+  void removeOldest(quint64 seqnum, const QString &text);
+  /** Removes every message from the index. */
+  void clear();
+
+  /** Returns true if candidates() can narrow down the messages containing
+   * <b>text</b>, which needs it to be at least three characters long. */
+  static bool canSearch(const QString &text);
+  /** Returns the sequence numbers, in increasing order, of the messages
+   * that contain every trigram of <b>text</b>, ignoring case. These are the
+   * only messages that can contain <b>text</b>, but not all of them
+   * necessarily do. */
+  QVector<quint64> candidates(const QString &text) const;
+
+  /** Returns the longest run of characters that every match of
+   * <b>pattern</b> must contain, or an empty string if there is none that
+   * can be worked out without fully parsing the expression. */
+  static QString requiredText(const QRegExp &pattern);
+
+private:
+  /** Sequence numbers of the messages containing one trigram. */
+  struct Postings
+  {
+    Postings() : head(0) {}
+    QVector<quint64> seqnums; /**< Sequence numbers, in increasing order. */
+    int head; /**< Index of the first sequence number still indexed. */
+  };
+
+  /** Returns the key of the trigram starting at <b>pos</b> in the
+   * lowercase string <b>text</b>. */
+  static quint64 trigram(const QString &text, int pos);
+
+  QHash<quint64, Postings> _postings; /**< Postings of each trigram. */
+};
+
+#endif
+
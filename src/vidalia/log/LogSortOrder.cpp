@@ -0,0 +1,219 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file LogSortOrder.cpp
+** \brief Sorted list of message sequence numbers with indexed access
+*/
+
+#include "LogSortOrder.h"
+
+
+/** Constructor. */
+LogSortOrder::LogSortOrder(const Compare *compare)
+{
+  _compare = compare;
+  _root = -1;
+  _seed = 2463534242u;
+}
+
+/** Removes every sequence number. */
+void
+LogSortOrder::clear()
+{
+  _nodes.clear();
+  _freeNodes.clear();
+  _root = -1;
+}
+
+/** Returns the next value of a 32-bit xorshift generator. Its quality is
+ * plenty for keeping the tree's expected depth logarithmic. */
+quint32
+LogSortOrder::nextPriority()
+{
+  _seed ^= _seed << 13;
+  _seed ^= _seed >> 17;
+  _seed ^= _seed << 5;
+  return _seed;
+}
+
+/** Recomputes the size of <b>node</b> from its children. */
+void
+LogSortOrder::update(int node)
+{
+  Node &n = _nodes[node];
+  n.size = 1 + sizeOf(n.left) + sizeOf(n.right);
+}
+
+/** Splits the subtree at <b>node</b> around <b>seqnum</b>. */
+void
+LogSortOrder::split(int node, quint64 seqnum, int *left, int *right)
+{
+  if (node < 0) {
+    *left = *right = -1;
+    return;
+  }
+  if (_compare->lessThan(_nodes.at(node).seqnum, seqnum)) {
+    int l, r;
+    split(_nodes.at(node).right, seqnum, &l, &r);
+    _nodes[node].right = l;
+    update(node);
+    *left = node;
+    *right = r;
+  } else {
+    int l, r;
+    split(_nodes.at(node).left, seqnum, &l, &r);
+    _nodes[node].left = r;
+    update(node);
+    *left = l;
+    *right = node;
+  }
+}
+
+/** Joins <b>left</b> and <b>right</b>, keeping the node with the higher
+ * priority on top. */
+int
+LogSortOrder::merge(int left, int right)
+{
+  if (left < 0)
+    return right;
+  if (right < 0)
+    return left;
+
+  if (_nodes.at(left).priority > _nodes.at(right).priority) {
+    int r = merge(_nodes.at(left).right, right);
+    _nodes[left].right = r;
+    update(left);
+    return left;
+  }
+  int l = merge(left, _nodes.at(right).left);
+  _nodes[right].left = l;
+  update(right);
+  return right;
+}
+
+/** Returns the sequence number at position <b>pos</b>, by walking down the
+ * tree and using the subtree sizes to pick a side. */
+quint64
+LogSortOrder::at(int pos) const
+{
+  int node = _root;
+  while (node >= 0) {
+    const Node &n = _nodes.at(node);
+    int leftSize = sizeOf(n.left);
+    if (pos < leftSize) {
+      node = n.left;
+    } else if (pos == leftSize) {
+      return n.seqnum;
+    } else {
+      pos -= leftSize + 1;
+      node = n.right;
+    }
+  }
+  return 0;
+}
+
+/** Counts the sequence numbers that sort before <b>seqnum</b>. */
+int
+LogSortOrder::position(quint64 seqnum) const
+{
+  int pos = 0;
+  int node = _root;
+  while (node >= 0) {
+    const Node &n = _nodes.at(node);
+    if (_compare->lessThan(n.seqnum, seqnum)) {
+      pos += sizeOf(n.left) + 1;
+      node = n.right;
+    } else {
+      node = n.left;
+    }
+  }
+  return pos;
+}
+
+/** Returns every sequence number in the list, in order, without comparing
+ * any of them. */
+QVector<quint64>
+LogSortOrder::values() const
+{
+  QVector<quint64> values;
+  QVector<int> stack;
+  int node = _root;
+
+  values.reserve(size());
+  while (node >= 0 || !stack.isEmpty()) {
+    while (node >= 0) {
+      stack << node;
+      node = _nodes.at(node).left;
+    }
+    node = stack.last();
+    stack.resize(stack.size() - 1);
+    values << _nodes.at(node).seqnum;
+    node = _nodes.at(node).right;
+  }
+  return values;
+}
+
+/** Adds <b>seqnum</b> between the entries that sort before it and those
+ * that sort after it. */
+void
+LogSortOrder::insert(quint64 seqnum)
+{
+  int node;
+  if (!_freeNodes.isEmpty()) {
+    node = _freeNodes.last();
+    _freeNodes.resize(_freeNodes.size() - 1);
+  } else {
+    node = _nodes.size();
+    _nodes.resize(node + 1);
+  }
+  Node &n = _nodes[node];
+  n.seqnum = seqnum;
+  n.priority = nextPriority();
+  n.left = n.right = -1;
+  n.size = 1;
+
+  int left, right;
+  split(_root, seqnum, &left, &right);
+  _root = merge(merge(left, node), right);
+}
+
+/** Removes <b>seqnum</b>, replacing its node with its two subtrees merged
+ * together. */
+void
+LogSortOrder::remove(quint64 seqnum)
+{
+  _root = remove(_root, seqnum);
+}
+
+/** Removes <b>seqnum</b> from the subtree at <b>node</b> and returns the
+ * subtree's new root. */
+int
+LogSortOrder::remove(int node, quint64 seqnum)
+{
+  if (node < 0)
+    return -1;
+
+  Node n = _nodes.at(node);
+  if (n.seqnum == seqnum) {
+    _freeNodes << node;
+    return merge(n.left, n.right);
+  }
+  if (_compare->lessThan(seqnum, n.seqnum)) {
+    int left = remove(n.left, seqnum);
+    _nodes[node].left = left;
+  } else {
+    int right = remove(n.right, seqnum);
+    _nodes[node].right = right;
+  }
+  update(node);
+  return node;
+}
+
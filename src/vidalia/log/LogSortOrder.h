@@ -0,0 +1,100 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file LogSortOrder.h
+** \brief Sorted list of message sequence numbers with indexed access
+*/
+
+#ifndef _LOGSORTORDER_H
+#define _LOGSORTORDER_H
+
+#include <QVector>
+
+
+/** A LogSortOrder keeps message sequence numbers sorted by a caller-supplied
+ * order and finds the position of any of them, or the one at any position,
+ * in logarithmic time. Inserting and removing a sequence number also take
+ * logarithmic time, whereas a sorted array would have to shift every entry
+ * after it. The sequence numbers are kept in a treap, a binary search tree
+ * balanced by giving each node a random priority, whose nodes also count the
+ * entries beneath them. */
+class LogSortOrder
+{
+public:
+  /** Orders the sequence numbers in a LogSortOrder. */
+  class Compare
+  {
+  public:
+    /** Destructor. */
+    virtual ~Compare() {}
+    /** Returns true if <b>a</b> sorts before <b>b</b>. No two different
+     * sequence numbers may compare equal. */
+    virtual bool lessThan(quint64 a, quint64 b) const = 0;
+  };
+
+  /** Constructor. Sequence numbers will be ordered by <b>compare</b>. */
+  LogSortOrder(const Compare *compare);
+
+  /** Returns the number of sequence numbers in the list. */
+  int size() const { return (_root < 0 ? 0 : _nodes.at(_root).size); }
+  /** Returns the sequence number at position <b>pos</b>. */
+  quint64 at(int pos) const;
+  /** Returns the number of sequence numbers that sort before
+   * <b>seqnum</b>, which is its position if it is in the list. */
+  int position(quint64 seqnum) const;
+  /** Returns every sequence number in the list, in order. */
+  QVector<quint64> values() const;
+
+  /** Adds <b>seqnum</b>, which must not already be in the list. */
+  void insert(quint64 seqnum);
+  /** Removes <b>seqnum</b>, if it is in the list. */
+  void remove(quint64 seqnum);
+  /** Removes every sequence number. */
+  void clear();
+
+private:
+  /** A node of the treap. */
+  struct Node
+  {
+    quint64 seqnum;   /**< Sequence number stored in this node. */
+    quint32 priority; /**< Random priority; parents have higher ones. */
+    int left;         /**< Index of the left child, or -1. */
+    int right;        /**< Index of the right child, or -1. */
+    int size;         /**< Number of nodes in this subtree. */
+  };
+
+  /** Returns the size of the subtree at <b>node</b>. */
+  int sizeOf(int node) const
+    { return (node < 0 ? 0 : _nodes.at(node).size); }
+  /** Recomputes the size of <b>node</b> from its children. */
+  void update(int node);
+  /** Splits the subtree at <b>node</b> into the nodes that sort before
+   * <b>seqnum</b>, in <b>*left</b>, and the others, in <b>*right</b>. */
+  void split(int node, quint64 seqnum, int *left, int *right);
+  /** Joins the subtrees <b>left</b> and <b>right</b>, where every node of
+   * <b>left</b> sorts before those of <b>right</b>, and returns the root of
+   * the result. */
+  int merge(int left, int right);
+  /** Removes <b>seqnum</b> from the subtree at <b>node</b>, if it is there,
+   * and returns the subtree's new root. */
+  int remove(int node, quint64 seqnum);
+  /** Returns the next pseudo-random node priority. */
+  quint32 nextPriority();
+
+  const Compare *_compare; /**< Order of the sequence numbers. */
+  QVector<Node> _nodes;    /**< Every node, in use or free. */
+  QVector<int> _freeNodes; /**< Indexes of nodes free for reuse. */
+  int _root;               /**< Index of the root node, or -1. */
+  quint32 _seed;           /**< State of the priority generator. */
+};
+
+#endif
+
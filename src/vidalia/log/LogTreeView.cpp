@@ -0,0 +1,271 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file LogTreeView.cpp
+** \brief Displays the messages stored in a LogMessageModel
+*/
+
+#include "LogTreeView.h"
+#include "LogHeaderView.h"
+#include "LogMessageColumnDelegate.h"
+
+#include <QScrollBar>
+#include <QItemSelection>
+#include <QMap>
+#include <QTimer>
+
+
+/** Default constructor. */
+LogTreeView::LogTreeView(QWidget *parent)
+  : QTreeView(parent)
+{
+  _model = new LogMessageModel(this);
+  setHeader(new LogHeaderView(this));
+  setModel(_model);
+  connect(_model, SIGNAL(matchCountChanged(int)),
+          this, SIGNAL(matchCountChanged(int)));
+
+  /* Tor's log messages are always in English, so stop Qt from futzing with
+   * the message text if we're currently using a non-English RTL layout. */
+  if (layoutDirection() == Qt::RightToLeft) {
+    setItemDelegateForColumn(LogMessageModel::MessageColumn,
+                             new LogMessageColumnDelegate(this));
+  }
+
+  /* Explicitly default to sorting messages chronologically */
+  sortByColumn(LogMessageModel::TimeColumn, Qt::AscendingOrder);
+
+  /* Default to always scrolling to the most recent item added */
+  _scrollOnNewItem = true;
+  _scrollPending = false;
+  setVerticalScrollMode(QAbstractItemView::ScrollPerItem);
+  connect(verticalScrollBar(), SIGNAL(sliderReleased()),
+          this, SLOT(verticalSliderReleased()));
+}
+
+/** Called when the user moves the vertical scrollbar. If the user has the
+ * scrollbar at within one step of its maximum, then always scroll to new
+ * items when added. Otherwise, leave the scrollbar alone since they are
+ * probably looking at something in their history. */
+void
+LogTreeView::verticalSliderReleased()
+{
+  QScrollBar *scrollBar = verticalScrollBar();
+  if (header()->sortIndicatorOrder() == Qt::AscendingOrder)
+    _scrollOnNewItem = (scrollBar->value() == scrollBar->maximum());
+  else
+    _scrollOnNewItem = (scrollBar->value() == scrollBar->minimum());
+}
+
+/** The first time the log tree is shown, we need to set the default column
+ * widths. */
+void
+LogTreeView::showEvent(QShowEvent *event)
+{
+  static bool shown = false;
+  QTreeView::showEvent(event);
+  if (!shown) {
+    /* Set the default column widths the first time this is shown */
+    ((LogHeaderView *)header())->resetColumnWidths();
+    shown = true;
+  }
+}
+
+/** Clears all messages from the message log. */
+void
+LogTreeView::clearMessages()
+{
+  _model->clear();
+}
+
+/** Returns a list of all currently selected messages, in chronological
+ * order. */
+QStringList
+LogTreeView::selectedMessages()
+{
+  QMap<quint64, QString> messages;
+
+  /* Format the selected messages as strings, ordered by sequence number */
+  foreach (QModelIndex index, selectionModel()->selectedRows()) {
+    LogMessage msg = _model->message(index);
+    messages.insert(msg.seqnum, LogMessageModel::toString(msg));
+  }
+  return messages.values();
+}
+
+/** Returns a list of all messages in the log, in chronological order. */
+QStringList
+LogTreeView::allMessages()
+{
+  QStringList messages;
+
+  /* Format the messages as strings and put them in a list */
+  foreach (LogMessage msg, _model->messages()) {
+    messages << LogMessageModel::toString(msg);
+  }
+  return messages;
+}
+
+/** Returns the number of messages currently in the log. */
+int
+LogTreeView::messageCount()
+{
+  return _model->messageCount();
+}
+
+/** Sets the maximum number of messages in the log. If the new maximum is
+ * less than the current number of messages, the oldest messages are
+ * discarded. */
+void
+LogTreeView::setMaximumMessageCount(int max)
+{
+  _model->setMaximumMessageCount(max);
+}
+
+/** Deselects all currently selected messages. */
+void
+LogTreeView::deselectAll()
+{
+  clearSelection();
+}
+
+/** Adds a message to the log and returns the new message. */
+LogMessage
+LogTreeView::log(tc::Severity type, const QString &message)
+{
+  LogMessage msg = _model->log(type, message);
+
+  /* The intended vertical scrolling behavior is as follows:
+   *
+   *   1) If the message log is sorted in chronological order, and the user
+   *      previously had the vertical scroll bar at its maximum position, then
+   *      reposition the vertical scroll bar to the new maximum value.
+   *
+   *   2) If the message log is sorted in reverse chronological order, and the
+   *      user previously had the vertical scroll bar at its minimum position,
+   *      then reposition the vertical scroll bar to the new minimum value
+   *      (which is always just 0 anyway).
+   *
+   *   3) If the message log is sorted by severity level or lexicographically
+   *      by log message, or if the user manually repositioned the scroll bar,
+   *      then leave the vertical scroll bar at its previous position.
+   *
+   * Scrolling forces the view to lay out its rows, so we only do it once for
+   * any number of messages added before control returns to the event loop.
+   */
+  if (_scrollOnNewItem && !_scrollPending
+        && header()->sortIndicatorSection() == LogMessageModel::TimeColumn) {
+    _scrollPending = true;
+    QTimer::singleShot(0, this, SLOT(scrollToNewest()));
+  }
+  return msg;
+}
+
+/** Scrolls to the newest message, if the log is still sorted
+ * chronologically. */
+void
+LogTreeView::scrollToNewest()
+{
+  _scrollPending = false;
+  if (!_scrollOnNewItem
+        || header()->sortIndicatorSection() != LogMessageModel::TimeColumn)
+    return;
+
+  if (header()->sortIndicatorOrder() == Qt::AscendingOrder)
+    scrollToBottom();
+  else
+    scrollToTop();
+}
+
+/** Filters the message log based on the given filter. */
+void
+LogTreeView::filter(uint filter)
+{
+  _model->filter(filter);
+}
+
+/** Searches the log for entries that contain the given text, ignoring
+ * case, optionally selecting every match. The results are returned in
+ * chronological order. */
+QModelIndexList
+LogTreeView::find(const QString &text, bool highlight)
+{
+  return find(QRegExp(text, Qt::CaseInsensitive, QRegExp::FixedString),
+              highlight);
+}
+
+/** Searches the log for entries that match <b>pattern</b>, optionally
+ * selecting every match and making the first one the current entry. The
+ * pattern becomes the current search, whose matches the model keeps up to
+ * date from then on. The results are returned in chronological order. */
+QModelIndexList
+LogTreeView::find(const QRegExp &pattern, bool highlight)
+{
+  _model->setSearch(pattern);
+  QModelIndexList indexes = _model->matches();
+
+  if (highlight) {
+    /* Replace the current selection with our search results. */
+    QItemSelection selection;
+    foreach (QModelIndex index, indexes) {
+      selection.select(index, index);
+    }
+    selectionModel()->select(selection, QItemSelectionModel::ClearAndSelect
+                                          | QItemSelectionModel::Rows);
+    if (!indexes.isEmpty()) {
+      selectionModel()->setCurrentIndex(indexes.first(),
+                                        QItemSelectionModel::NoUpdate);
+    }
+  }
+  return indexes;
+}
+
+/** Moves the current entry to the next (or previous) one matching the
+ * current search, without changing the selection, and scrolls to it. */
+QModelIndex
+LogTreeView::findNext(bool forward)
+{
+  QModelIndex index = _model->nextMatch(currentIndex(), forward);
+  if (index.isValid()) {
+    selectionModel()->setCurrentIndex(index, QItemSelectionModel::NoUpdate);
+    scrollTo(index);
+  }
+  return index;
+}
+
+/** Clears the current search. */
+void
+LogTreeView::clearSearch()
+{
+  _model->clearSearch();
+}
+
+/** Returns true if there is a current search. */
+bool
+LogTreeView::hasSearch() const
+{
+  return _model->hasSearch();
+}
+
+/** Returns the number of entries matching the current search. */
+int
+LogTreeView::matchCount() const
+{
+  return _model->matchCount();
+}
+
+/** Updates the translated column headers and severity names. */
+void
+LogTreeView::retranslateUi()
+{
+  _model->retranslateUi();
+}
+
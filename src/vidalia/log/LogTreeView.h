@@ -0,0 +1,101 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file LogTreeView.h
+** \brief Displays the messages stored in a LogMessageModel
+*/
+
+#ifndef _LOGTREEVIEW_H
+#define _LOGTREEVIEW_H
+
+#include "LogMessageModel.h"
+
+#include "TorControl.h"
+
+#include <QString>
+#include <QStringList>
+#include <QRegExp>
+#include <QTreeView>
+#include <QShowEvent>
+
+
+class LogTreeView : public QTreeView
+{
+  Q_OBJECT
+
+public:
+  /** Default constructor. */
+  LogTreeView(QWidget *parent = 0);
+
+  /** Returns a list of all currently selected messages. */
+  QStringList selectedMessages();
+  /** Returns a list of all messages in the log. */
+  QStringList allMessages();
+  /** Deselects all currently selected messages. */
+  void deselectAll();
+
+  /** Returns the number of messages currently in the log. */
+  int messageCount();
+  /** Sets the maximum number of messages in the log. */
+  void setMaximumMessageCount(int max);
+  /** Filters the log according to the specified filter. */
+  void filter(uint filter);
+
+  /** Adds a message to the log and returns it. */
+  LogMessage log(tc::Severity severity, const QString &message);
+
+  /** Searches the log for entries that contain the given text. */
+  QModelIndexList find(const QString &text, bool highlight = true);
+  /** Searches the log for entries that match <b>pattern</b>, which becomes
+   * the current search. */
+  QModelIndexList find(const QRegExp &pattern, bool highlight = true);
+  /** Moves the current entry to the next one matching the current search,
+   * or the previous one if <b>forward</b> is false, and returns it. */
+  QModelIndex findNext(bool forward = true);
+  /** Clears the current search. */
+  void clearSearch();
+  /** Returns true if there is a current search. */
+  bool hasSearch() const;
+  /** Returns the number of entries matching the current search. */
+  int matchCount() const;
+  /** Updates the translated column headers and severity names. */
+  void retranslateUi();
+
+public slots:
+  /** Clears all contents on the message log and resets the counter. */
+  void clearMessages();
+
+signals:
+  /** Emitted when the number of entries matching the current search
+   * changes to <b>count</b>, including as messages are added or
+   * evicted. */
+  void matchCountChanged(int count);
+
+protected:
+  /** Sets the default, initial column header widths. */
+  void showEvent(QShowEvent *event);
+
+private slots:
+  /** Called when the user moves the vertical scroll bar. */
+  void verticalSliderReleased();
+  /** Scrolls to the newest message, if the log is sorted chronologically. */
+  void scrollToNewest();
+
+private:
+  LogMessageModel *_model; /**< Messages displayed in this view. */
+  bool _scrollOnNewItem; /**< Set to true if we are to scroll to the new item
+                               after adding a message to the log. */
+  bool _scrollPending; /**< Set to true if a scroll to the newest message has
+                            been scheduled but not yet performed. */
+};
+
+#endif
+
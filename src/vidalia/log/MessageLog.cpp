@@ -25,6 +25,7 @@
 #include <QInputDialog>
 #include <QMessageBox>
 #include <QClipboard>
+#include <QLabel>
 
 /* Message log settings */
 #define SETTING_MSG_FILTER          "MessageFilter"
@@ -60,10 +61,17 @@ MessageLog::MessageLog(QWidget *parent, Qt::WFlags flags)
   /* Invoke Qt Designer generated QObject setup routine */
   ui.setupUi(this);
 
+  /* Show the number of matches of the current search in the status bar */
+  _matchCount = new QLabel(this);
+  _matchCount->setVisible(false);
+  ui.statusbar->addPermanentWidget(_matchCount);
+
   /* Create necessary Message Log QObjects */
   _torControl = Vidalia::torControl();
   connect(_torControl, SIGNAL(logMessage(tc::Severity, QString)),
           this, SLOT(log(tc::Severity, QString)));
+  connect(_torControl, SIGNAL(logMessages(LogEventList)),
+          this, SLOT(log(LogEventList)));
 
   /* Bind events to actions */
   createActions();
@@ -75,8 +83,8 @@ MessageLog::MessageLog(QWidget *parent, Qt::WFlags flags)
   loadSettings();
 
   /* Sort in ascending chronological order */
-  ui.listMessages->sortItems(LogTreeWidget::TimeColumn,
-                             Qt::AscendingOrder);
+  ui.listMessages->sortByColumn(LogMessageModel::TimeColumn,
+                                Qt::AscendingOrder);
   ui.listNotifications->sortItems(0, Qt::AscendingOrder);
 }
 
@@ -105,6 +113,8 @@ MessageLog::createActions()
 
   connect(ui.actionFind, SIGNAL(triggered()),
           this, SLOT(find()));
+  connect(ui.listMessages, SIGNAL(matchCountChanged(int)),
+          this, SLOT(updateMatchCount(int)));
 
   connect(ui.actionClear, SIGNAL(triggered()),
           this, SLOT(clear()));
@@ -126,6 +136,10 @@ MessageLog::createActions()
 #endif
   ui.actionClose->setShortcut(QString("Esc"));
   Vidalia::createShortcut("Ctrl+W", this, ui.actionClose, SLOT(trigger()));
+  Vidalia::createShortcut(QKeySequence(QKeySequence::FindNext),
+                          this, this, SLOT(findNext()));
+  Vidalia::createShortcut(QKeySequence(QKeySequence::FindPrevious),
+                          this, this, SLOT(findPrevious()));
 }
 
 /** Set tooltips for Message Filter checkboxes in code because they are long
@@ -152,6 +166,7 @@ void
 MessageLog::retranslateUi()
 {
   ui.retranslateUi(this);
+  ui.listMessages->retranslateUi();
   setToolTips();
 }
 
@@ -406,7 +421,10 @@ MessageLog::clear()
 
 /** Prompts the user for a search string. If the search string is not found in
  * any of the currently displayed log entires, then a message will be
- * displayed for the user informing them that no matches were found.
+ * displayed for the user informing them that no matches were found. A
+ * search string enclosed in slashes, such as "/circuit [0-9]+/", is used as
+ * a regular expression. Searching for an empty string clears the current
+ * search.
  * \sa search()
  */
 void
@@ -414,37 +432,78 @@ MessageLog::find()
 {
   bool ok;
   QString text = QInputDialog::getText(this, tr("Find in Message Log"),
-                  tr("Find:"), QLineEdit::Normal, QString(), &ok);
-
-  if (ok && !text.isEmpty()) {
-    QTreeWidget *tree;
-    QTreeWidgetItem *firstItem = 0;
+                  tr("Find (use /pattern/ for a regular expression):"),
+                  QLineEdit::Normal, QString(), &ok);
+
+  if (ok && text.isEmpty()) {
+    ui.listMessages->clearSearch();
+  } else if (ok) {
+    bool found = false;
+
+    QRegExp pattern(text, Qt::CaseInsensitive, QRegExp::FixedString);
+    if (text.length() > 2 && text.startsWith("/") && text.endsWith("/")) {
+      pattern = QRegExp(text.mid(1, text.length() - 2), Qt::CaseInsensitive);
+      if (!pattern.isValid()) {
+        VMessageBox::warning(this, tr("Invalid Regular Expression"),
+                             p(tr("The search pattern is not valid: %1")
+                                 .arg(pattern.errorString())),
+                             VMessageBox::Ok);
+        return;
+      }
+    }
 
     /* Pick the right tree widget to search based on the current tab */
     if (ui.tabWidget->currentIndex() == 0) {
-      QList<StatusEventItem *> results = ui.listNotifications->find(text, true);
+      QList<StatusEventItem *> results
+        = ui.listNotifications->find(pattern, true);
       if (results.size() > 0) {
-        tree = ui.listNotifications;
-        firstItem = dynamic_cast<QTreeWidgetItem *>(results.at(0));
+        ui.listNotifications->scrollToItem(results.at(0));
+        found = true;
       }
     } else {
-      QList<LogTreeItem *> results = ui.listMessages->find(text, true);
+      QModelIndexList results = ui.listMessages->find(pattern, true);
       if (results.size() > 0) {
-        tree = ui.listMessages;
-        firstItem = dynamic_cast<QTreeWidgetItem *>(results.at(0));
+        ui.listMessages->scrollTo(results.at(0));
+        found = true;
       }
     }
 
-    if (! firstItem) {
+    if (! found) {
       VMessageBox::information(this, tr("Not Found"),
                                p(tr("Search found 0 matches.")),
                                VMessageBox::Ok);
-    } else {
-      tree->scrollToItem(firstItem);
     }
   }
 }
 
+/** Moves to the next message in the message history matching the current
+ * search. */
+void
+MessageLog::findNext()
+{
+  if (ui.tabWidget->currentIndex() != 0)
+    ui.listMessages->findNext(true);
+}
+
+/** Moves to the previous message in the message history matching the
+ * current search. */
+void
+MessageLog::findPrevious()
+{
+  if (ui.tabWidget->currentIndex() != 0)
+    ui.listMessages->findNext(false);
+}
+
+/** Shows <b>count</b> as the number of messages in the message history
+ * matching the current search, or hides the count if there is no search. */
+void
+MessageLog::updateMatchCount(int count)
+{
+  if (ui.listMessages->hasSearch())
+    _matchCount->setText(tr("%1 matches").arg(count));
+  _matchCount->setVisible(ui.listMessages->hasSearch());
+}
+
 /** Writes a message to the Message History and tags it with
  * the proper date, time and type.
  * \param type The message's severity type.
@@ -454,10 +513,31 @@ void
 MessageLog::log(tc::Severity type, const QString &message)
 {
   setUpdatesEnabled(false);  
+  addMessage(type, message);
+  setUpdatesEnabled(true);  
+}
+
+/** Adds every message in <b>messages</b> to the message log window, updating
+ * the window only once for the whole batch. */
+void
+MessageLog::log(const LogEventList &messages)
+{
+  setUpdatesEnabled(false);
+  foreach (LogEvent message, messages) {
+    addMessage(message.first, message.second);
+  }
+  setUpdatesEnabled(true);
+}
+
+/** Adds the message <b>message</b> with severity <b>type</b> to the message
+ * log window, and saves it to the log file if enabled. */
+void
+MessageLog::addMessage(tc::Severity type, const QString &message)
+{
   /* Only add the message if it's not being filtered out */
   if (_filter & (uint)type) {
     /* Add the message to the list and scroll to it if necessary. */
-    LogTreeItem *item = ui.listMessages->log(type, message);
+    LogMessage msg = ui.listMessages->log(type, message);
 
     /* This is a workaround to force Qt to update the statusbar text (if any
      * is currently displayed) to reflect the new message added. */
@@ -469,10 +549,9 @@ MessageLog::log(tc::Severity type, const QString &message)
 
     /* If we're saving log messages to a file, go ahead and do that now */
     if (_enableLogging) {
-      _logFile << item->toString() << "\n";
+      _logFile << LogMessageModel::toString(msg) << "\n";
     }
   }
-  setUpdatesEnabled(true);  
 }
 
 /** Displays help information about the message log. */
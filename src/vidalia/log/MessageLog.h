@@ -22,8 +22,8 @@
 #include "TorControl.h"
 #include "VidaliaSettings.h"
 
-class LogTreeItem;
 class QStringList;
+class QLabel;
 
 class MessageLog : public VidaliaWindow
 {
@@ -42,6 +42,9 @@ protected:
 private slots:
   /** Adds the passed message to the message log as the specified type **/
   void log(tc::Severity severity, const QString &msg);
+  /** Adds every message in <b>messages</b> to the message log window,
+   * updating the window only once. */
+  void log(const LogEventList &messages);
   /** Called when the user triggers the "Save All" action. */
   void saveAll();
   /** Called when the user triggers "Save Selected" action. */
@@ -56,6 +59,15 @@ private slots:
    * through all currently displayed log entries for text specified by the
    * user, highlighting the entries that contain a match. */
   void find();
+  /** Called when the user presses the "Find Next" shortcut. Moves to the
+   * next message matching the current search. */
+  void findNext();
+  /** Called when the user presses the "Find Previous" shortcut. Moves to
+   * the previous message matching the current search. */
+  void findPrevious();
+  /** Shows <b>count</b> as the number of messages matching the current
+   * search in the status bar. */
+  void updateMatchCount(int count);
   /** Called when user saves settings **/
   void saveSettings();
   /** Called when user cancels changed settings **/
@@ -78,6 +90,9 @@ private:
   void save(const QStringList &messages);
   /** Rotates the log file based on the filename and the current logging status. */
   bool rotateLogFile(const QString &filename);
+  /** Adds a single message to the message log and log file, without
+   * disabling updates of the window. */
+  void addMessage(tc::Severity type, const QString &message);
 
   /** A pointer to a TorControl object, used to register for log events */
   TorControl* _torControl;
@@ -89,6 +104,8 @@ private:
   bool _enableLogging;  
   /* The log file used to store log messages. */
   LogFile _logFile;
+  /** Shows the number of messages matching the current search. */
+  QLabel *_matchCount;
 
   /** Qt Designer generatated QObject **/
   Ui::MessageLog ui;
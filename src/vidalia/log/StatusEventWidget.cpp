@@ -17,13 +17,13 @@
 #include "StatusEventItem.h"
 #include "StatusEventItemDelegate.h"
 #include "Vidalia.h"
+#include "IconCache.h"
 
 #include "TorEvents.h"
 #include "stringutil.h"
 
 #include <QTime>
 #include <QMenu>
-#include <QPainter>
 #include <QPixmap>
 #include <QStringList>
 #include <QObject>
@@ -177,6 +177,13 @@ StatusEventWidget::customContextMenuRequested(const QPoint &pos)
 
 QList<StatusEventItem *>
 StatusEventWidget::find(const QString &text, bool highlight)
+{
+  return find(QRegExp(text, Qt::CaseInsensitive, QRegExp::FixedString),
+              highlight);
+}
+
+QList<StatusEventItem *>
+StatusEventWidget::find(const QRegExp &pattern, bool highlight)
 {
   QList<StatusEventItem *> items;
 
@@ -185,8 +192,8 @@ StatusEventWidget::find(const QString &text, bool highlight)
     if (! item)
       continue;
 
-    if (item->title().contains(text, Qt::CaseInsensitive)
-        || item->description().contains(text, Qt::CaseInsensitive)) {
+    if (pattern.indexIn(item->title()) >= 0
+        || pattern.indexIn(item->description()) >= 0) {
       items.append(item);
       if (highlight)
         item->setSelected(true);
@@ -233,26 +240,23 @@ QPixmap
 StatusEventWidget::addBadgeToPixmap(const QPixmap &pixmap,
                                     const QPixmap &badge)
 {
-  QPixmap out = pixmap;
-  QPainter painter(&out);
-  painter.drawPixmap(pixmap.width() - badge.width(),
-                     pixmap.height() - badge.height(),
-                     badge);
-  return out;
+  return IconCache::addBadge(pixmap, badge);
 }
 
 QPixmap
 StatusEventWidget::addBadgeToPixmap(const QPixmap &pixmap,
                                     const QString &badge)
 {
-  return StatusEventWidget::addBadgeToPixmap(pixmap, QPixmap(badge));
+  return IconCache::addBadge(pixmap, IconCache::pixmap(badge));
 }
 
+/* Both images come from resources, so the result is shared by every
+ * notification that uses the same combination. */
 QPixmap
 StatusEventWidget::addBadgeToPixmap(const QString &pixmap,
                                     const QString &badge)
 {
-  return StatusEventWidget::addBadgeToPixmap(QPixmap(pixmap), QPixmap(badge));
+  return IconCache::badgedPixmap(pixmap, badge);
 }
 
 void
@@ -333,7 +337,7 @@ StatusEventWidget::dangerousTorVersion(tc::TorVersionStatus reason,
 void
 StatusEventWidget::circuitEstablished()
 {
-  addNotification(QPixmap(":/images/48x48/network-connect.png"),
+  addNotification(IconCache::pixmap(":/images/48x48/network-connect.png"),
     tr("Connected to the Tor Network"),
     tr("We were able to successfully establish a connection to the Tor "
        "network. You can now configure your applications to use the Internet "
@@ -422,10 +426,11 @@ void
 StatusEventWidget::socksError(tc::SocksError type, const QString &destination)
 {
   QString title, description;
-  QPixmap icon = QPixmap(":/images/48x48/applications-internet.png");
+  QString image = ":/images/48x48/applications-internet.png";
+  QPixmap icon = IconCache::pixmap(image);
 
   if (type == tc::DangerousSocksTypeError) {
-    icon  = addBadgeToPixmap(icon, ":/images/32x32/security-medium.png");
+    icon  = addBadgeToPixmap(image, ":/images/32x32/security-medium.png");
 
     title = tr("Potentially Dangerous Connection!");
     description =
@@ -435,7 +440,7 @@ StatusEventWidget::socksError(tc::SocksError type, const QString &destination)
          "only SOCKS4a or SOCKS5 with remote hostname resolution.")
                                                             .arg(destination);
   } else if (type == tc::UnknownSocksProtocolError) {
-    icon = addBadgeToPixmap(icon, ":/images/32x32/dialog-warning.png");
+    icon = addBadgeToPixmap(image, ":/images/32x32/dialog-warning.png");
 
     title = tr("Unknown SOCKS Protocol");
     description =
@@ -444,7 +449,7 @@ StatusEventWidget::socksError(tc::SocksError type, const QString &destination)
          "you configure your applications to use only SOCKS4a or SOCKS5 with "
          "remote hostname resolution.");
   } else if (type == tc::BadSocksHostnameError) {
-    icon = addBadgeToPixmap(icon, ":/images/32x32/dialog-warning.png");
+    icon = addBadgeToPixmap(image, ":/images/32x32/dialog-warning.png");
 
     title = tr("Invalid Destination Hostname");
     description =
@@ -465,7 +470,7 @@ StatusEventWidget::externalAddressChanged(const QHostAddress &ip,
   QString hostString = hostname.isEmpty() ? QString()
                                           : QString(" (%1)").arg(hostname);
 
-  addNotification(QPixmap(":/images/48x48/applications-internet.png"),
+  addNotification(IconCache::pixmap(":/images/48x48/applications-internet.png"),
     tr("External IP Address Changed"),
     tr("Tor has determined your relay's public IP address is currently %1%2. "
        "If that is not correct, please consider setting the 'Address' option "
@@ -502,7 +507,7 @@ void
 StatusEventWidget::checkingOrPortReachability(const QHostAddress &ip,
                                               quint16 port)
 {
-  addNotification(QPixmap(":/images/48x48/network-wired.png"),
+  addNotification(IconCache::pixmap(":/images/48x48/network-wired.png"),
     tr("Checking Server Port Reachability"),
     tr("Tor is trying to determine if your relay's server port is reachable "
        "from the Tor network by connecting to itself at %1:%2. This test "
@@ -515,14 +520,15 @@ StatusEventWidget::orPortReachabilityFinished(const QHostAddress &ip,
                                               bool reachable)
 {
   QString title, description;
-  QPixmap icon = QPixmap(":/images/48x48/network-wired.png");
+  QString image = ":/images/48x48/network-wired.png";
+  QPixmap icon = IconCache::pixmap(image);
   if (reachable) {
-    icon = addBadgeToPixmap(icon, ":/images/32x32/dialog-ok-apply.png");
+    icon = addBadgeToPixmap(image, ":/images/32x32/dialog-ok-apply.png");
     title = tr("Server Port Reachability Test Successful!");
     description =
       tr("Your relay's server port is reachable from the Tor network!");
   } else {
-    icon = addBadgeToPixmap(icon, ":/images/32x32/dialog-warning.png");
+    icon = addBadgeToPixmap(image, ":/images/32x32/dialog-warning.png");
     title = tr("Server Port Reachability Test Failed");
     description =
       tr("Your relay's server port is not reachable by other Tor clients. This "
@@ -539,7 +545,7 @@ void
 StatusEventWidget::checkingDirPortReachability(const QHostAddress &ip,
                                                quint16 port)
 {
-  addNotification(QPixmap(":/images/48x48/network-wired.png"),
+  addNotification(IconCache::pixmap(":/images/48x48/network-wired.png"),
     tr("Checking Directory Port Reachability"),
     tr("Tor is trying to determine if your relay's directory port is reachable "
        "from the Tor network by connecting to itself at %1:%2. This test "
@@ -552,14 +558,15 @@ StatusEventWidget::dirPortReachabilityFinished(const QHostAddress &ip,
                                                bool reachable)
 {
   QString title, description;
-  QPixmap icon = QPixmap(":/images/48x48/network-wired.png");
+  QString image = ":/images/48x48/network-wired.png";
+  QPixmap icon = IconCache::pixmap(image);
   if (reachable) {
-    icon = addBadgeToPixmap(icon, ":/images/32x32/dialog-ok-apply.png");
+    icon = addBadgeToPixmap(image, ":/images/32x32/dialog-ok-apply.png");
     title = tr("Directory Port Reachability Test Successful!");
     description =
       tr("Your relay's directory port is reachable from the Tor network!");
   } else {
-    icon = addBadgeToPixmap(icon, ":/images/32x32/dialog-warning.png");
+    icon = addBadgeToPixmap(image, ":/images/32x32/dialog-warning.png");
     title = tr("Directory Port Reachability Test Failed");
     description =
       tr("Your relay's directory port is not reachable by other Tor clients. "
@@ -21,6 +21,7 @@
 #include "TorControl.h"
 
 #include <QList>
+#include <QRegExp>
 
 class QPixmap;
 class QString;
@@ -70,6 +71,13 @@ public:
    */
   QList<StatusEventItem *> find(const QString &text, bool highlight = true);
 
+  /** Searches the list of current status event items for any items whose
+   * title or description matches <b>pattern</b>, highlighting them as
+   * find(const QString &, bool) does.
+   */
+  QList<StatusEventItem *> find(const QRegExp &pattern,
+                                bool highlight = true);
+
 protected:
   /** Called when the user has changed the UI display language in Vidalia
    * indicating all the displayed text widgets need to be updated to
@@ -28,11 +28,24 @@
 #define CLOSED_STREAM_REMOVE_DELAY      3000
 #define FAILED_STREAM_REMOVE_DELAY      4000
 
+/** Resolution, in milliseconds, of the timer wheel used to remove closed or
+ * failed circuits and streams. */
+#define REMOVAL_TIMER_INTERVAL  500
+/** Number of slots in the removal timer wheel. This must be greater than the
+ * longest removal delay divided by REMOVAL_TIMER_INTERVAL. */
+#define REMOVAL_WHEEL_SIZE      16
+
 
 /** Default constructor. */
 CircuitListWidget::CircuitListWidget(QWidget *parent)
 : QTreeWidget(parent)
 {
+  /* Set up the timer wheel used to remove closed circuits and streams */
+  _removalWheel.resize(REMOVAL_WHEEL_SIZE);
+  _removalWheelPos = 0;
+  _removalTimer.setInterval(REMOVAL_TIMER_INTERVAL);
+  connect(&_removalTimer, SIGNAL(timeout()), this, SLOT(processRemovals()));
+
   /* Create and initialize columns */
   setHeaderLabels(QStringList() << tr("Connection") << tr("Status"));
 
@@ -150,6 +163,7 @@ CircuitListWidget::addCircuit(const Circuit &circuit)
     /* Add the new circuit */
     item = new CircuitItem(circuit);
     addTopLevelItem(item);
+    _circuits.insert(circuit.id(), item);
   } else {
     /* Circuit already exists, so update its status and path */
     item->update(circuit);
@@ -175,21 +189,24 @@ CircuitListWidget::addStream(const Stream &stream)
   if (!item) {
     CircuitItem *circuit = findCircuitItem(stream.circuitId());
     /* New stream, so try to find its circuit and add it */
-    if (circuit) {
-      circuit->addStream(new StreamItem(stream));
-      expandItem(circuit);
-    }
+    if (!circuit)
+      return;
+    item = new StreamItem(stream);
+    circuit->addStream(item);
+    _streams.insert(stream.id(), item);
+    expandItem(circuit);
   } else {
     /* Stream already exists, so just update its status */
     item->update(stream);
+  }
 
-    /* If the stream is closed or dead, schedule it for removal */
-    Stream::Status status = stream.status();
-    if (status == Stream::Closed) {
-      scheduleStreamRemoval(item, CLOSED_STREAM_REMOVE_DELAY);
-    } else if (status == Stream::Failed) {
-      scheduleStreamRemoval(item, FAILED_STREAM_REMOVE_DELAY);
-    }
+  /* If the stream is closed or dead, schedule it for removal. A new stream
+   * may already be closed if several of its events were batched together. */
+  Stream::Status status = stream.status();
+  if (status == Stream::Closed) {
+    scheduleStreamRemoval(item, CLOSED_STREAM_REMOVE_DELAY);
+  } else if (status == Stream::Failed) {
+    scheduleStreamRemoval(item, FAILED_STREAM_REMOVE_DELAY);
   }
 }
 
@@ -197,32 +214,63 @@ CircuitListWidget::addStream(const Stream &stream)
 void
 CircuitListWidget::scheduleCircuitRemoval(CircuitItem *circuit, int delay)
 {
-  if (!_circuitRemovalList.contains(circuit)) {
-    _circuitRemovalList << circuit;
-    QTimer::singleShot(delay, this, SLOT(removeCircuit()));
-  } 
+  CircuitId circid = circuit->id();
+  if (!_circuitRemovals.contains(circid)) {
+    _circuitRemovals.insert(circid);
+    _removalWheel[removalSlot(delay)].circuits << circid;
+  }
 }
 
 /** Schedules the given stream to be removed after the specified timeout. */
 void
 CircuitListWidget::scheduleStreamRemoval(StreamItem *stream, int delay)
 {
-  if (!_streamRemovalList.contains(stream)) {
-    _streamRemovalList << stream;
-    QTimer::singleShot(delay, this, SLOT(removeStream()));
-  } 
+  StreamId streamid = stream->id();
+  if (!_streamRemovals.contains(streamid)) {
+    _streamRemovals.insert(streamid);
+    _removalWheel[removalSlot(delay)].streams << streamid;
+  }
+}
+
+/** Returns the index of the removal wheel slot that will be processed
+ * <b>delay</b> milliseconds from now, rounded up to the wheel's resolution,
+ * and starts the removal timer if it is not already running. */
+int
+CircuitListWidget::removalSlot(int delay)
+{
+  int ticks = (delay + REMOVAL_TIMER_INTERVAL - 1) / REMOVAL_TIMER_INTERVAL;
+  ticks = qBound(1, ticks, REMOVAL_WHEEL_SIZE - 1);
+
+  if (!_removalTimer.isActive())
+    _removalTimer.start();
+  return (_removalWheelPos + ticks) % REMOVAL_WHEEL_SIZE;
 }
 
-/** Removes the first circuit scheduled to be removed. */
+/** Advances the removal timer wheel by one slot and removes any circuits and
+ * streams whose removal delay has expired. */
 void
-CircuitListWidget::removeCircuit()
+CircuitListWidget::processRemovals()
 {
-  if (!_circuitRemovalList.isEmpty()) {
-    CircuitItem *circuitItem = _circuitRemovalList.takeFirst();
-    Circuit circuit = circuitItem->circuit();
-    removeCircuit(circuitItem);
-    emit circuitRemoved(circuit.id());
+  _removalWheelPos = (_removalWheelPos + 1) % REMOVAL_WHEEL_SIZE;
+  RemovalSlot slot = _removalWheel[_removalWheelPos];
+  _removalWheel[_removalWheelPos] = RemovalSlot();
+
+  foreach (StreamId streamid, slot.streams) {
+    _streamRemovals.remove(streamid);
+    removeStream(_streams.value(streamid));
   }
+  foreach (CircuitId circid, slot.circuits) {
+    _circuitRemovals.remove(circid);
+    CircuitItem *circuit = _circuits.value(circid);
+    if (circuit) {
+      removeCircuit(circuit);
+      emit circuitRemoved(circid);
+    }
+  }
+
+  /* Stop ticking once nothing is left to remove */
+  if (_circuitRemovals.isEmpty() && _streamRemovals.isEmpty())
+    _removalTimer.stop();
 }
 
 /** Removes the given circuit item and all streams on that circuit. */
@@ -230,40 +278,26 @@ void
 CircuitListWidget::removeCircuit(CircuitItem *circuit)
 {
   if (circuit) {
-    /* Remove all streams (if any) on this circuit. */
+    /* Remove all streams (if any) on this circuit. Any pending removals for
+     * these streams will simply find nothing to remove. */
     QList<StreamItem *> streams = circuit->streams();
     foreach (StreamItem *stream, streams) {
-      /* Check if this stream was scheduled for removal already */
-      if (_streamRemovalList.contains(stream)) {
-        /* If this stream was already scheduled for removal, replace its pointer
-         * with 0, so it doesn't get removed twice. */
-        int index = _streamRemovalList.indexOf(stream);
-        _streamRemovalList.replace(index, (StreamItem *)0);
-      }
-      
-      /* Remove the stream item from the circuit */
+      _streams.remove(stream->id());
       circuit->removeStream(stream);
     }
     /* Remove the circuit item itself */
+    _circuits.remove(circuit->id());
     delete takeTopLevelItem(indexOfTopLevelItem(circuit));
   }
 }
 
-/** Removes the first stream scheduled to be removed. */
-void
-CircuitListWidget::removeStream()
-{
-  if (!_streamRemovalList.isEmpty()) {
-    StreamItem *stream = _streamRemovalList.takeFirst();
-    removeStream(stream);
-  }
-}
-
 /** Removes the given stream item. */
 void
 CircuitListWidget::removeStream(StreamItem *stream)
 {
   if (stream) {
+    _streams.remove(stream->id());
+
     /* Try to get the stream's parent (a circuit item) */ 
     CircuitItem *circuit = (CircuitItem *)stream->parent();
     if (circuit) {
@@ -281,8 +315,12 @@ void
 CircuitListWidget::clearCircuits()
 {
   QTreeWidget::clear();
-  _circuitRemovalList.clear();
-  _streamRemovalList.clear();
+  _circuits.clear();
+  _streams.clear();
+  _circuitRemovals.clear();
+  _streamRemovals.clear();
+  _removalWheel.fill(RemovalSlot());
+  _removalTimer.stop();
 }
 
 /** Finds the circuit with the given ID and returns a pointer to that
@@ -290,14 +328,7 @@ CircuitListWidget::clearCircuits()
 CircuitItem*
 CircuitListWidget::findCircuitItem(const CircuitId &circid)
 {
-  int numCircs = topLevelItemCount();
-  for (int i = 0; i < numCircs; i++) {
-    CircuitItem *circuit = (CircuitItem *)topLevelItem(i);
-    if (circid == circuit->id()) {
-      return circuit;
-    }
-  }
-  return 0;
+  return _circuits.value(circid);
 }
 
 /** Finds the stream with the given ID and returns a pointer to that stream's
@@ -305,21 +336,7 @@ CircuitListWidget::findCircuitItem(const CircuitId &circid)
 StreamItem*
 CircuitListWidget::findStreamItem(const StreamId &streamid)
 {
-  int numCircs = topLevelItemCount();
-  int numStreams;
-  
-  for (int i = 0; i < numCircs; i++) {
-    CircuitItem *circuit = (CircuitItem *)topLevelItem(i);
-    numStreams = circuit->childCount();
-  
-    for (int j = 0; j < numStreams; j++) {
-      StreamItem *stream = (StreamItem *)circuit->child(j);
-      if (streamid == stream->id()) {
-        return stream;
-      }
-    }
-  }
-  return 0;
+  return _streams.value(streamid);
 }
 
 /** Called when the current item selection has changed. */
@@ -21,6 +21,10 @@
 
 #include <QTreeWidget>
 #include <QList>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <QVector>
 #include <QMenu>
 #include <QAction>
 #include <QMouseEvent>
@@ -68,10 +72,9 @@ public slots:
   void clearCircuits();
 
 private slots:
-  /** Removes the first circuit scheduled to be removed.*/
-  void removeCircuit(); 
-  /** Removes the first stream scheduled to be removed. */
-  void removeStream();
+  /** Advances the removal timer wheel by one slot and removes any circuits
+   * and streams whose removal delay has expired. */
+  void processRemovals();
   /** Called when the current item selectio has changed. */
   void onSelectionChanged(QTreeWidgetItem *cur, QTreeWidgetItem *prev);
   /** Called when the user requests a context menu on a circuit or stream in
@@ -94,11 +97,31 @@ private:
   void scheduleCircuitRemoval(CircuitItem *circuit, int delay);
   /** Schedules a stream to be removed after the given timeout. */
   void scheduleStreamRemoval(StreamItem *stream, int delay);
+  /** Returns the index of the removal wheel slot that will be processed
+   * <b>delay</b> milliseconds from now, and starts the removal timer if it
+   * is not already running. */
+  int removalSlot(int delay);
 
-  /** List of circuit items to be removed. */
-  QList<CircuitItem *> _circuitRemovalList;
-  /** List of stream items to be removed. */
-  QList<StreamItem *> _streamRemovalList;
+  /** IDs of the circuits and streams to be removed in one timer wheel slot. */
+  struct RemovalSlot {
+    QList<CircuitId> circuits; /**< Circuits to remove. */
+    QList<StreamId> streams;   /**< Streams to remove. */
+  };
+
+  /** Maps circuit IDs to their items in the list. */
+  QHash<CircuitId, CircuitItem *> _circuits;
+  /** Maps stream IDs to their items in the list. */
+  QHash<StreamId, StreamItem *> _streams;
+  /** Timer wheel of pending circuit and stream removals. */
+  QVector<RemovalSlot> _removalWheel;
+  /** Index of the removal wheel slot most recently processed. */
+  int _removalWheelPos;
+  /** Timer that advances the removal wheel while removals are pending. */
+  QTimer _removalTimer;
+  /** IDs of circuits that are already scheduled to be removed. */
+  QSet<CircuitId> _circuitRemovals;
+  /** IDs of streams that are already scheduled to be removed. */
+  QSet<StreamId> _streamRemovals;
 };
 
 #endif
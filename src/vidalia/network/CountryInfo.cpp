@@ -246,18 +246,19 @@ QPair<float,float>
 CountryInfo::countryLocation(const QString &countryCode)
 {
   static QHash<QString,QPair<float,float> > db;
-  if (db.isEmpty()) {
-    /* Load the country coordinates database */
+  static bool loaded = false;
+  if (! loaded) {
+    /* Load the country coordinates database in a single read. This only
+     * happens once, even if the file turns out to be empty or missing. */
+    loaded = true;
     QFile infile(COUNTRY_LOCATION_FILE);
-    if (! infile.open(QIODevice::ReadOnly | QIODevice::Text))
+    if (! infile.open(QIODevice::ReadOnly))
       return QPair<float,float>(-180.0, -180.0);
 
-    while (! infile.atEnd()) {
-      /* Read and parse a single line from the input file */
+    foreach (QByteArray line, infile.readAll().split('\n')) {
+      /* Parse a single "cc,latitude,longitude" line */
       bool ok;
-      QString line = infile.readLine().trimmed();
-      vInfo(line);
-      QStringList parts = line.split(",");
+      QList<QByteArray> parts = line.trimmed().split(',');
       if (parts.size() >= 3) {
         float latitude = parts[1].toFloat(&ok);
         if (! ok)
@@ -265,13 +266,14 @@ CountryInfo::countryLocation(const QString &countryCode)
         float longitude = parts[2].toFloat(&ok);
         if (! ok)
           continue;
-        db.insert(parts[0], QPair<float,float>(latitude, longitude));
+        db.insert(QString::fromLatin1(parts[0]),
+                  QPair<float,float>(latitude, longitude));
       }
     }
-    vInfo("Loaded %1 country location entries from built-in database.").arg(db.size());
-    infile.close();
+    vInfo("Loaded %1 country location entries from built-in database.")
+                                                            .arg(db.size());
   }
-  
+
   QString cc = countryCode.toLower();
   if (db.contains(cc))
     return db.value(cc);
@@ -108,8 +108,13 @@ QString
 GeoIpDatabase::countryCodeByAddr(const QHostAddress &ip)
 {
   if (isOpen() && ! ip.isNull()) {
-    const char *addr = ip.toString().toAscii().constData();
-    const char *countryCode = GeoIP_country_code_by_addr(_db, addr);
+    const char *countryCode;
+    if (ip.protocol() == QAbstractSocket::IPv6Protocol) {
+      QByteArray addr = ip.toString().toAscii();
+      countryCode = GeoIP_country_code_by_addr_v6(_db, addr.constData());
+    } else {
+      countryCode = GeoIP_country_code_by_ipnum(_db, ip.toIPv4Address());
+    }
     if (countryCode)
       return QString::fromUtf8(countryCode);
   }
@@ -120,13 +125,13 @@ GeoIpRecord
 GeoIpDatabase::recordByAddr(const QHostAddress &ip)
 {
   if (isOpen() && ! ip.isNull()) {
-    const char *addr = ip.toString().toAscii().constData();
-
     GeoIPRecord *r;
-    if (ip.protocol() == QAbstractSocket::IPv6Protocol)
-      r = GeoIP_record_by_addr_v6(_db, addr);
-    else
-      r = GeoIP_record_by_addr(_db, addr);
+    if (ip.protocol() == QAbstractSocket::IPv6Protocol) {
+      QByteArray addr = ip.toString().toAscii();
+      r = GeoIP_record_by_addr_v6(_db, addr.constData());
+    } else {
+      r = GeoIP_record_by_ipnum(_db, ip.toIPv4Address());
+    }
 
     if (r) {
       QString countryCode = QString::fromUtf8(r->country_code);
@@ -139,8 +144,10 @@ GeoIpDatabase::recordByAddr(const QHostAddress &ip)
       if (regionName)
         region = QString::fromUtf8(regionName);
 
-      return GeoIpRecord(ip, r->latitude, r->longitude, city, region,
+      GeoIpRecord record(ip, r->latitude, r->longitude, city, region,
                          countryName, countryCode);
+      GeoIPRecord_delete(r);
+      return record;
     }
   }
   return GeoIpRecord();
@@ -0,0 +1,199 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file GeoIpIndex.cpp
+** \brief Memory-mapped, sorted IPv4/IPv6 range index generated from Tor's
+** geoip and geoip6 files.
+*/
+
+#include "GeoIpIndex.h"
+#include "GeoIpRecord.h"
+#include "CountryInfo.h"
+#include "Vidalia.h"
+
+#include <QString>
+#include <QHostAddress>
+
+#include <string.h>
+
+
+/** Default constructor. */
+GeoIpIndex::GeoIpIndex()
+  : _header(0), _countries(0), _ipv4(0), _ipv6(0)
+{
+}
+
+GeoIpIndex::~GeoIpIndex()
+{
+  close();
+}
+
+bool
+GeoIpIndex::isIndexFile(const QString &fname)
+{
+  QFile file(fname);
+  if (! file.open(QIODevice::ReadOnly))
+    return false;
+  return (file.read(4) == QByteArray(GEOIP_INDEX_MAGIC));
+}
+
+bool
+GeoIpIndex::open(const QString &fname)
+{
+  if (isOpen())
+    close();
+
+  _file.setFileName(fname);
+  if (! _file.open(QIODevice::ReadOnly)) {
+    vError("Unable to open GeoIP index: %1").arg(fname);
+    return false;
+  }
+
+  /* Validate the header before trusting any of the section sizes */
+  quint64 size = _file.size();
+  const uchar *data = (size >= sizeof(GeoIpIndexHeader)) ? _file.map(0, size)
+                                                          : 0;
+  const GeoIpIndexHeader *header
+    = reinterpret_cast<const GeoIpIndexHeader *>(data);
+  if (! header
+        || memcmp(header->magic, GEOIP_INDEX_MAGIC, 4)
+        || header->byteOrder != GEOIP_INDEX_BYTE_ORDER
+        || header->version != GEOIP_INDEX_VERSION) {
+    vError("Invalid or incompatible GeoIP index: %1").arg(fname);
+    _file.close();
+    return false;
+  }
+
+  quint64 countries = GEOIP_INDEX_ALIGN(sizeof(GeoIpIndexHeader));
+  quint64 ipv4 = GEOIP_INDEX_ALIGN(countries + quint64(header->countryCount)
+                                     * sizeof(GeoIpIndexCountry));
+  quint64 ipv6 = GEOIP_INDEX_ALIGN(ipv4 + quint64(header->ipv4Count)
+                                     * sizeof(GeoIpIndexRange4));
+  quint64 end = ipv6 + quint64(header->ipv6Count) * sizeof(GeoIpIndexRange6);
+  if (end > size) {
+    vError("Truncated GeoIP index: %1").arg(fname);
+    _file.close();
+    return false;
+  }
+
+  _header = header;
+  _countries = reinterpret_cast<const GeoIpIndexCountry *>(data + countries);
+  _ipv4 = reinterpret_cast<const GeoIpIndexRange4 *>(data + ipv4);
+  _ipv6 = reinterpret_cast<const GeoIpIndexRange6 *>(data + ipv6);
+
+  vInfo("Loaded GeoIP index with %1 IPv4 and %2 IPv6 ranges from %3.")
+                            .arg(header->ipv4Count)
+                            .arg(header->ipv6Count)
+                            .arg(fname);
+  return true;
+}
+
+void
+GeoIpIndex::close()
+{
+  if (isOpen()) {
+    _file.unmap(reinterpret_cast<uchar *>(const_cast<GeoIpIndexHeader *>(
+                                            _header)));
+    _header = 0;
+    _countries = 0;
+    _ipv4 = 0;
+    _ipv6 = 0;
+  }
+  _file.close();
+}
+
+const GeoIpIndexCountry*
+GeoIpIndex::countryByAddr(quint32 ip) const
+{
+  if (! isOpen())
+    return 0;
+
+  /* Find the last range that starts at or before ip */
+  quint32 lo = 0, hi = _header->ipv4Count;
+  while (lo < hi) {
+    quint32 mid = lo + (hi - lo) / 2;
+    if (_ipv4[mid].first <= ip)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0 || _ipv4[lo-1].last < ip)
+    return 0;
+
+  quint32 country = _ipv4[lo-1].country;
+  return (country < _header->countryCount) ? &_countries[country] : 0;
+}
+
+const GeoIpIndexCountry*
+GeoIpIndex::countryByAddr(quint64 high, quint64 low) const
+{
+  if (! isOpen())
+    return 0;
+
+  /* Find the last range that starts at or before (high, low) */
+  quint32 lo = 0, hi = _header->ipv6Count;
+  while (lo < hi) {
+    quint32 mid = lo + (hi - lo) / 2;
+    const GeoIpIndexRange6 &r = _ipv6[mid];
+    if (r.firstHigh < high || (r.firstHigh == high && r.firstLow <= low))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0)
+    return 0;
+
+  const GeoIpIndexRange6 &r = _ipv6[lo-1];
+  if (r.lastHigh < high || (r.lastHigh == high && r.lastLow < low))
+    return 0;
+  return (r.country < _header->countryCount) ? &_countries[r.country] : 0;
+}
+
+const GeoIpIndexCountry*
+GeoIpIndex::countryByAddr(const QHostAddress &ip) const
+{
+  if (ip.protocol() == QAbstractSocket::IPv4Protocol)
+    return countryByAddr(ip.toIPv4Address());
+
+  if (ip.protocol() == QAbstractSocket::IPv6Protocol) {
+    Q_IPV6ADDR addr = ip.toIPv6Address();
+    quint64 high = 0, low = 0;
+    for (int i = 0; i < 8; i++) {
+      high = (high << 8) | addr[i];
+      low  = (low << 8) | addr[i+8];
+    }
+    return countryByAddr(high, low);
+  }
+  return 0;
+}
+
+QString
+GeoIpIndex::countryCodeByAddr(const QHostAddress &ip) const
+{
+  const GeoIpIndexCountry *country = countryByAddr(ip);
+  if (country)
+    return QString::fromLatin1(country->code, 2);
+  return QString();
+}
+
+GeoIpRecord
+GeoIpIndex::recordByAddr(const QHostAddress &ip) const
+{
+  const GeoIpIndexCountry *country = countryByAddr(ip);
+  if (country) {
+    QString countryCode = QString::fromLatin1(country->code, 2);
+    return GeoIpRecord(ip, country->latitude, country->longitude,
+                       CountryInfo::countryName(countryCode),
+                       countryCode);
+  }
+  return GeoIpRecord();
+}
+
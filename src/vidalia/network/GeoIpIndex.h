@@ -0,0 +1,98 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file GeoIpIndex.h
+** \brief Memory-mapped, sorted IPv4/IPv6 range index generated from Tor's
+** geoip and geoip6 files.
+*/
+
+#ifndef _GEOIPINDEX_H
+#define _GEOIPINDEX_H
+
+#include "GeoIpIndexFormat.h"
+
+#include <QFile>
+
+class QString;
+class QHostAddress;
+class GeoIpRecord;
+
+
+class GeoIpIndex
+{
+public:
+  /** Default constructor.
+   */
+  GeoIpIndex();
+
+  /** Destructor. Unmaps and closes the index file if it is currently open.
+   */
+  ~GeoIpIndex();
+
+  /** Returns true if <b>fname</b> starts with the GeoIP index magic bytes.
+   * This does not validate the rest of the file.
+   */
+  static bool isIndexFile(const QString &fname);
+
+  /** Memory-maps the GeoIP index file <b>fname</b> and returns true if it is
+   * a valid index. Otherwise, returns false. An index that is already open
+   * will be closed first.
+   * \sa close()
+   */
+  bool open(const QString &fname);
+
+  /** Unmaps and closes the current index file, if any.
+   */
+  void close();
+
+  /** Returns true if this object has a currently open index file.
+   */
+  bool isOpen() const { return (_header != 0); }
+
+  /** Returns the country table entry for the range containing <b>ip</b>, or
+   * 0 if <b>ip</b> is not covered by the index. The returned pointer refers
+   * directly into the mapped file and remains valid until close() is called.
+   * This does not allocate memory.
+   */
+  const GeoIpIndexCountry* countryByAddr(const QHostAddress &ip) const;
+
+  /** Returns the country table entry for the range containing the IPv4
+   * address <b>ip</b> (in host byte order), or 0 if it is not covered.
+   */
+  const GeoIpIndexCountry* countryByAddr(quint32 ip) const;
+
+  /** Returns the country table entry for the range containing the IPv6
+   * address given by <b>high</b> and <b>low</b>, or 0 if it is not covered.
+   */
+  const GeoIpIndexCountry* countryByAddr(quint64 high, quint64 low) const;
+
+  /** Resolves <b>ip</b> to its two-letter ISO-3166 country code and returns
+   * the result on success. On failure, this returns a default-constructed
+   * QString.
+   */
+  QString countryCodeByAddr(const QHostAddress &ip) const;
+
+  /** Resolves <b>ip</b> to the approximate location of its country and
+   * returns the result on success. On failure, this returns an invalid
+   * GeoIpRecord.
+   */
+  GeoIpRecord recordByAddr(const QHostAddress &ip) const;
+
+private:
+  QFile _file; /**< Index file currently mapped into memory. */
+  const GeoIpIndexHeader *_header;     /**< Start of the mapped file. */
+  const GeoIpIndexCountry *_countries; /**< Country table. */
+  const GeoIpIndexRange4 *_ipv4;       /**< Sorted IPv4 ranges. */
+  const GeoIpIndexRange6 *_ipv6;       /**< Sorted IPv6 ranges. */
+};
+
+#endif
+
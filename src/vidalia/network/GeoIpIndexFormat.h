@@ -0,0 +1,76 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file GeoIpIndexFormat.h
+** \brief On-disk layout of the binary GeoIP range index written by geoip2idx
+** and memory-mapped by GeoIpIndex.
+**
+** An index file consists of a GeoIpIndexHeader, followed by
+** <i>countryCount</i> GeoIpIndexCountry entries, <i>ipv4Count</i>
+** GeoIpIndexRange4 entries and <i>ipv6Count</i> GeoIpIndexRange6 entries.
+** Each section starts on an 8-byte boundary. Ranges are sorted by their
+** first address and do not overlap. All values are stored in the byte order
+** of the machine that generated the index.
+*/
+
+#ifndef _GEOIPINDEXFORMAT_H
+#define _GEOIPINDEXFORMAT_H
+
+#include <QtGlobal>
+
+/** Magic bytes at the start of every GeoIP index file. */
+#define GEOIP_INDEX_MAGIC       "VGIX"
+/** Current version of the GeoIP index file format. */
+#define GEOIP_INDEX_VERSION     1
+/** Value written to GeoIpIndexHeader::byteOrder, used to reject index files
+ * generated on a machine with a different byte order. */
+#define GEOIP_INDEX_BYTE_ORDER  0x01020304
+
+/** Rounds <b>x</b> up to the next multiple of 8 bytes. */
+#define GEOIP_INDEX_ALIGN(x)    (((x) + 7) & ~((quint64)7))
+
+struct GeoIpIndexHeader
+{
+  char magic[4];        /**< GEOIP_INDEX_MAGIC. */
+  quint32 byteOrder;    /**< GEOIP_INDEX_BYTE_ORDER. */
+  quint32 version;      /**< GEOIP_INDEX_VERSION. */
+  quint32 countryCount; /**< Number of GeoIpIndexCountry entries. */
+  quint32 ipv4Count;    /**< Number of GeoIpIndexRange4 entries. */
+  quint32 ipv6Count;    /**< Number of GeoIpIndexRange6 entries. */
+};
+
+struct GeoIpIndexCountry
+{
+  char code[2];         /**< Lowercase ISO 3166-1 alpha-2 country code. */
+  quint16 reserved;     /**< Unused; always zero. */
+  float latitude;       /**< Latitude of the country, or -180.0 if unknown. */
+  float longitude;      /**< Longitude of the country, or -180.0 if unknown. */
+};
+
+struct GeoIpIndexRange4
+{
+  quint32 first;        /**< First IPv4 address in the range. */
+  quint32 last;         /**< Last IPv4 address in the range. */
+  quint32 country;      /**< Index into the country table. */
+};
+
+struct GeoIpIndexRange6
+{
+  quint64 firstHigh;    /**< High 64 bits of the first address. */
+  quint64 firstLow;     /**< Low 64 bits of the first address. */
+  quint64 lastHigh;     /**< High 64 bits of the last address. */
+  quint64 lastLow;      /**< Low 64 bits of the last address. */
+  quint32 country;      /**< Index into the country table. */
+  quint32 reserved;     /**< Unused; always zero. */
+};
+
+#endif
+
@@ -18,6 +18,8 @@
 #include "GeoIpRecord.h"
 #include "Vidalia.h"
 
+#include <QSet>
+
 
 /** Default constructor. */
 GeoIpResolver::GeoIpResolver(QObject *parent)
@@ -28,6 +30,18 @@ GeoIpResolver::GeoIpResolver(QObject *parent)
 bool
 GeoIpResolver::setLocalDatabase(const QString &databaseFile)
 {
+  _cache.clear();
+
+  /* Prefer Vidalia's own memory-mapped range index when given one, since
+   * it does not need libGeoIP at all. */
+  if (GeoIpIndex::isIndexFile(databaseFile)) {
+#if defined(USE_GEOIP)
+    _database.close();
+#endif
+    return _index.open(databaseFile);
+  }
+  _index.close();
+
 #if defined(USE_GEOIP)
   return _database.open(databaseFile);
 #else
@@ -38,6 +52,8 @@ GeoIpResolver::setLocalDatabase(const QString &databaseFile)
 void
 GeoIpResolver::setUseLocalDatabase(bool useLocalDatabase)
 {
+  if (useLocalDatabase != _useLocalDatabase)
+    _cache.clear();
   _useLocalDatabase = useLocalDatabase;
 }
 
@@ -54,9 +70,32 @@ GeoIpResolver::resolveUsingTor(const QHostAddress &ip)
   return GeoIpRecord();
 }
 
+void
+GeoIpResolver::resolveUsingTor(const QList<QHostAddress> &ips,
+                               QHash<QString,GeoIpRecord> &records)
+{
+  QHash<QString,QString> countryCodes
+    = Vidalia::torControl()->ipToCountry(ips);
+
+  foreach (QHostAddress ip, ips) {
+    QString countryCode = countryCodes.value(ip.toString());
+    if (countryCode.isEmpty())
+      continue;
+
+    QPair<float,float> coords = CountryInfo::countryLocation(countryCode);
+    records.insert(ip.toString(),
+                   GeoIpRecord(ip, coords.first, coords.second,
+                               CountryInfo::countryName(countryCode),
+                               countryCode));
+  }
+}
+
 GeoIpRecord
 GeoIpResolver::resolveUsingLocalDatabase(const QHostAddress &ip)
 {
+  if (_index.isOpen())
+    return _index.recordByAddr(ip);
+
 #if defined(USE_GEOIP)
   if (_database.type() == GeoIpDatabase::CityDatabase) {
     return _database.recordByAddr(ip);
@@ -77,10 +116,62 @@ GeoIpResolver::resolveUsingLocalDatabase(const QHostAddress &ip)
 GeoIpRecord
 GeoIpResolver::resolve(const QHostAddress &ip)
 {
-#if defined(USE_GEOIP)
+  QString key = ip.toString();
+  if (_cache.contains(key))
+    return _cache.value(key);
+
+  GeoIpRecord record;
   if (_useLocalDatabase)
-    return resolveUsingLocalDatabase(ip);
-#endif
-  return resolveUsingTor(ip); 
+    record = resolveUsingLocalDatabase(ip);
+  else
+    record = resolveUsingTor(ip);
+
+  if (record.isValid())
+    _cache.insert(key, record);
+  return record;
+}
+
+/** Resolves every IP in <b>ips</b> to a geographic location. */
+QHash<QString,GeoIpRecord>
+GeoIpResolver::resolve(const QList<QHostAddress> &ips)
+{
+  QHash<QString,GeoIpRecord> records;
+  QHash<QString,GeoIpRecord> resolved;
+  QList<QHostAddress> unresolved;
+  QSet<QString> seen;
+
+  foreach (QHostAddress ip, ips) {
+    QString key = ip.toString();
+    if (seen.contains(key))
+      continue;
+    seen.insert(key);
+
+    if (_cache.contains(key))
+      records.insert(key, _cache.value(key));
+    else
+      unresolved << ip;
+  }
+  if (unresolved.isEmpty())
+    return records;
+
+  if (_useLocalDatabase) {
+    foreach (QHostAddress ip, unresolved) {
+      GeoIpRecord record = resolveUsingLocalDatabase(ip);
+      if (record.isValid())
+        resolved.insert(ip.toString(), record);
+    }
+  } else {
+    resolveUsingTor(unresolved, resolved);
+  }
+
+  QHashIterator<QString,GeoIpRecord> it(resolved);
+  while (it.hasNext()) {
+    it.next();
+    if (it.value().isValid()) {
+      _cache.insert(it.key(), it.value());
+      records.insert(it.key(), it.value());
+    }
+  }
+  return records;
 }
 
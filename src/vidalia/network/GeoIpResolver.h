@@ -21,6 +21,7 @@ G** \file GeoIpResolver.h
 #ifdef USE_GEOIP
 #include "GeoIpDatabase.h"
 #endif
+#include "GeoIpIndex.h"
 #include "CountryInfo.h"
 
 #include <QObject>
@@ -28,8 +29,9 @@ G** \file GeoIpResolver.h
 #include <QHash>
 #include <QHostAddress>
 
+#include "GeoIpRecord.h"
+
 class QString;
-class GeoIpRecord;
 
 
 class GeoIpResolver : public QObject
@@ -41,7 +43,9 @@ public:
    */
   GeoIpResolver(QObject *parent = 0);
 
-  /** Sets the local database file to <b>databaseFile</b>. Returns true if
+  /** Sets the local database file to <b>databaseFile</b>, which may be
+   * either a GeoIP range index generated by geoip2idx or (if built with
+   * libGeoIP support) a MaxMind database. Returns true if
    * <b>databaseFile</b> could be opened for reading. Otherwise, returns
    * false.
    * \sa setUseLocalDatabase()
@@ -60,6 +64,14 @@ public:
    */
   GeoIpRecord resolve(const QHostAddress &ip);
 
+  /** Resolves every IP in <b>ips</b> to a geographic location and returns a
+   * map of each address (as a string) to its location. Addresses that have
+   * been resolved before are answered from an in-memory cache, and the
+   * rest are looked up together. Addresses that could not be resolved are
+   * omitted from the result.
+   */
+  QHash<QString,GeoIpRecord> resolve(const QList<QHostAddress> &ips);
+
 protected:
   /** Maps <b>ip</b> to a country code using Tor, and then maps the
    * country code to a geographic location using the built-in
@@ -67,6 +79,13 @@ protected:
    */
   GeoIpRecord resolveUsingTor(const QHostAddress &ip);
 
+  /** Maps every address in <b>ips</b> to a country code using batched
+   * requests to Tor, and adds each successfully resolved location to
+   * <b>records</b>.
+   */
+  void resolveUsingTor(const QList<QHostAddress> &ips,
+                       QHash<QString,GeoIpRecord> &records);
+
   /** Maps <b>ip</b> to an approximate geographic location using a local
    * GeoIP database and returns the result on success.
    * \sa setLocalDatabase()
@@ -81,7 +100,13 @@ private:
    */
   GeoIpDatabase _database;
 #endif
+  /** Memory-mapped range index used for allocation-free local lookups. */
+  GeoIpIndex _index;
   bool _useLocalDatabase;
+  /** Previously resolved locations, keyed by IP address. This is cleared
+   * whenever the source of GeoIP information changes.
+   */
+  QHash<QString,GeoIpRecord> _cache;
 };
 
 #endif
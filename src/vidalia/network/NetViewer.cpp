@@ -21,13 +21,14 @@
 
 #include <QMessageBox>
 #include <QHeaderView>
-#include <QCoreApplication>
+#include <QBitArray>
+#include <QFile>
+#include <QDir>
 
 #define IMG_MOVE    ":/images/22x22/move-map.png"
 #define IMG_ZOOMIN  ":/images/22x22/zoom-in.png"
 #define IMG_ZOOMOUT ":/images/22x22/zoom-out.png"
 
-#if 0
 /** Number of milliseconds to wait after the arrival of the last descriptor whose
  * IP needs to be resolved to geographic information, in case more descriptors
  * arrive. Then we can simply lump the IPs into a single request. */
@@ -35,7 +36,22 @@
 /** Maximum number of milliseconds to wait after the arrival of the first
  * IP address into the resolve queue, before we flush the entire queue. */
 #define MAX_RESOLVE_QUEUE_DELAY   (30*1000)
-#endif
+
+/** Events the network map needs while it is visible. */
+#define NETVIEWER_EVENTS  (TorEvents::CircuitStatus | TorEvents::StreamStatus \
+                           | TorEvents::AddressMap | TorEvents::NewDescriptor \
+                           | TorEvents::NewConsensus \
+                           | TorEvents::NetworkStatusChanged)
+
+/** Name of the relay snapshot file in Vidalia's data directory. */
+#define SNAPSHOT_FILE       "relays.snapshot"
+/** Number of milliseconds to wait after the relays change before writing a
+ * new snapshot, so that a burst of changes is written only once. */
+#define SNAPSHOT_DELAY      (60*1000)
+/** Maximum age, in seconds, of a snapshot worth showing at startup. */
+#define SNAPSHOT_MAX_AGE    (24*60*60)
+/** Name of the GeoIP range index built from Tor's geoip files, if any. */
+#define GEOIP_INDEX_FILE    "geoip.idx"
 
 /** Constructor. Loads settings from VidaliaSettings.
  * \param parent The parent widget of this NetViewer object.\
@@ -61,22 +77,30 @@ NetViewer::NetViewer(QWidget *parent)
   connect(_torControl, SIGNAL(disconnected()),
           this, SLOT(onDisconnected()));
 
-  _torControl->setEvent(TorEvents::CircuitStatus);
+  /* The events below are only registered with Tor while the window is
+   * visible. See showEvent() and hideEvent(). */
   connect(_torControl, SIGNAL(circuitStatusChanged(Circuit)),
           this, SLOT(addCircuit(Circuit)));
+  connect(_torControl, SIGNAL(circuitStatusesChanged(CircuitList)),
+          this, SLOT(addCircuits(CircuitList)));
 
-  _torControl->setEvent(TorEvents::StreamStatus);
   connect(_torControl, SIGNAL(streamStatusChanged(Stream)),
           this, SLOT(addStream(Stream)));
+  connect(_torControl, SIGNAL(streamStatusesChanged(StreamList)),
+          this, SLOT(addStreams(StreamList)));
 
-  _torControl->setEvent(TorEvents::AddressMap);
   connect(_torControl, SIGNAL(addressMapped(QString, QString, QDateTime)),
           this, SLOT(addressMapped(QString, QString, QDateTime)));
 
-  _torControl->setEvent(TorEvents::NewDescriptor);
   connect(_torControl, SIGNAL(newDescriptors(QStringList)),
           this, SLOT(newDescriptors(QStringList)));
 
+  connect(_torControl, SIGNAL(newConsensus(NetworkStatus)),
+          this, SLOT(newConsensus(NetworkStatus)));
+
+  connect(_torControl, SIGNAL(networkStatusChanged(NetworkStatus)),
+          this, SLOT(networkStatusChanged(NetworkStatus)));
+
   /* Change the column widths of the tree widgets */
   ui.treeRouterList->header()->
     resizeSection(RouterListWidget::StatusColumn, 25);
@@ -88,8 +112,6 @@ NetViewer::NetViewer(QWidget *parent)
   /* Create the TorMapWidget and add it to the dialog */
 #if defined(USE_MARBLE)
   _map = new TorMapWidget();
-  connect(_map, SIGNAL(displayRouterInfo(QString)),
-          this, SLOT(displayRouterInfo(QString)));
   connect(ui.actionZoomFullScreen, SIGNAL(triggered()),
           this, SLOT(toggleFullScreen()));
   Vidalia::createShortcut("ESC", _map, this, SLOT(toggleFullScreen()));
@@ -98,6 +120,12 @@ NetViewer::NetViewer(QWidget *parent)
   ui.actionZoomFullScreen->setVisible(false);
 #endif
   ui.gridLayout->addWidget(_map);
+  connect(_map, SIGNAL(displayRouterInfo(QString)),
+          this, SLOT(displayRouterInfo(QString)));
+
+  /* The list and the map both show routers from the same relay table */
+  ui.treeRouterList->setRelayTable(&_relays);
+  _map->setRelayTable(&_relays);
 
 
   /* Connect zoom buttons to TorMapWidget zoom slots */
@@ -106,10 +134,27 @@ NetViewer::NetViewer(QWidget *parent)
   connect(ui.actionZoomToFit, SIGNAL(triggered()), _map, SLOT(zoomToFit()));
 
   /* Create the timer that will be used to update the router list once every
-   * hour. We still receive the NEWDESC event to get new descriptors, but this
-   * needs to be called to get rid of any descriptors that were removed. */
+   * hour, if Tor is too old to tell us when it has a new consensus. We still
+   * receive the NEWDESC event to get new descriptors, but this needs to be
+   * called to get rid of any descriptors that were removed. */
   _refreshTimer.setInterval(60*60*1000);
-  connect(&_refreshTimer, SIGNAL(timeout()), this, SLOT(refresh()));
+  connect(&_refreshTimer, SIGNAL(timeout()),
+          this, SLOT(reloadNetworkStatus()));
+
+  /* Set up the timers used to batch GeoIP lookups for new descriptors */
+  _minResolveQueueTimer.setSingleShot(true);
+  _minResolveQueueTimer.setInterval(MIN_RESOLVE_QUEUE_DELAY);
+  connect(&_minResolveQueueTimer, SIGNAL(timeout()), this, SLOT(resolve()));
+  _maxResolveQueueTimer.setSingleShot(true);
+  _maxResolveQueueTimer.setInterval(MAX_RESOLVE_QUEUE_DELAY);
+  connect(&_maxResolveQueueTimer, SIGNAL(timeout()), this, SLOT(resolve()));
+
+  /* Set up the timer used to write the relay snapshot */
+  _snapshotTimer.setSingleShot(true);
+  _snapshotTimer.setInterval(SNAPSHOT_DELAY);
+  connect(&_snapshotTimer, SIGNAL(timeout()), this, SLOT(saveSnapshot()));
+  _relaysStale = false;
+  _refreshPending = false;
  
   /* Connect the necessary slots and signals */
   connect(ui.actionHelp, SIGNAL(triggered()), this, SLOT(help()));
@@ -130,6 +175,16 @@ NetViewer::NetViewer(QWidget *parent)
           _torControl, SLOT(closeStream(StreamId)));
 
   setupGeoIpResolver();
+
+  /* Show the relays from the last session until Tor tells us otherwise */
+  loadSnapshot();
+}
+
+/** Destructor. Writes any relay changes not yet saved to the snapshot. */
+NetViewer::~NetViewer()
+{
+  if (_snapshotTimer.isActive())
+    saveSnapshot();
 }
 
 /** Called when the user changes the UI translation. */
@@ -159,23 +214,51 @@ NetViewer::retranslateUi()
   }
 }
 
+/** Returns the path of the GeoIP range index installed with Vidalia, or an
+ * empty string if there is none. The index is looked for next to the
+ * executable, as in a build tree, and in the share/vidalia directory of the
+ * prefix it was installed under. */
+QString
+NetViewer::installedGeoIpIndex()
+{
+  QDir appDir(Vidalia::applicationDirPath());
+  QStringList candidates;
+  candidates << appDir.filePath(GEOIP_INDEX_FILE)
+             << appDir.filePath("../share/vidalia/" GEOIP_INDEX_FILE);
+
+  foreach (QString candidate, candidates) {
+    if (QFile::exists(candidate))
+      return QDir::cleanPath(candidate);
+  }
+  return QString();
+}
+
+/** Chooses where router locations come from: the local database file the
+ * user selected, if any, then the GeoIP range index installed with Vidalia
+ * if there is none or it can't be opened, and otherwise Tor's own GeoIP
+ * database. */
 void
 NetViewer::setupGeoIpResolver()
 {
   VidaliaSettings settings;
+  QString installedIndex = installedGeoIpIndex();
+  QStringList databaseFiles;
 
-#if defined(USE_GEOIP)
-  if (settings.useLocalGeoIpDatabase()) {
-    QString databaseFile = settings.localGeoIpDatabase();
-    if (! databaseFile.isEmpty()) {
-      _geoip.setLocalDatabase(databaseFile);
+  if (settings.useLocalGeoIpDatabase()
+        && !settings.localGeoIpDatabase().isEmpty())
+    databaseFiles << settings.localGeoIpDatabase();
+  if (! installedIndex.isEmpty())
+    databaseFiles << installedIndex;
+
+  foreach (QString databaseFile, databaseFiles) {
+    if (_geoip.setLocalDatabase(databaseFile)) {
       _geoip.setUseLocalDatabase(true);
       vInfo("Using local database file for relay mapping: %1")
                                             .arg(databaseFile);
       return;
     }
+    vWarn("Unable to open the GeoIP database file %1.").arg(databaseFile);
   }
-#endif
   vInfo("Using Tor's GeoIP database for country-level relay mapping.");
   _geoip.setUseLocalDatabase(false);
 }
@@ -184,32 +267,90 @@ NetViewer::setupGeoIpResolver()
 void
 NetViewer::onAuthenticated()
 {
-  refresh();
-  _refreshTimer.start();
   ui.actionRefresh->setEnabled(true);
+  if (! isVisible()) {
+    /* Nothing is shown, so wait until the window is */
+    _refreshPending = true;
+    return;
+  }
+  refresh();
+  if (! _torControl->supportsEvent(TorEvents::NewConsensus))
+    _refreshTimer.start();
 }
 
-/** Clears map, lists and stops timer when we get disconnected */
+/** Clears map, lists and stops timer when we get disconnected. The relays
+ * are saved and shown again from the snapshot, so the map stays populated
+ * until we reconnect. */
 void
 NetViewer::onDisconnected()
 {
+  saveSnapshot();
   clear();
+  loadSnapshot();
   _refreshTimer.stop();
+  _refreshPending = false;
   ui.actionRefresh->setEnabled(false);
 }
 
+/** Called when the window is shown. Subscribes to the events that keep the
+ * lists and the map current and, if Tor was connected while the window was
+ * hidden, refreshes them once the window has been drawn. */
+void
+NetViewer::showEvent(QShowEvent *e)
+{
+  VidaliaWindow::showEvent(e);
+  _torControl->subscribeEvents(this, NETVIEWER_EVENTS);
+  if (! _torControl->isAuthenticated())
+    return;
+
+  if (_refreshPending)
+    QTimer::singleShot(0, this, SLOT(refresh()));
+  if (! _torControl->supportsEvent(TorEvents::NewConsensus))
+    _refreshTimer.start();
+}
+
+/** Called when the window is hidden. Releases the window's events, so
+ * neither Tor nor Vidalia spend time on events nobody sees, and marks the
+ * relays stale so they are reconciled with Tor when the window is shown
+ * again. */
+void
+NetViewer::hideEvent(QHideEvent *e)
+{
+  VidaliaWindow::hideEvent(e);
+  _torControl->unsubscribeEvents(this, NETVIEWER_EVENTS);
+  _refreshTimer.stop();
+  if (! _torControl->isAuthenticated() || _refreshPending)
+    return;
+
+  /* Save any changes before the relays stop being kept current */
+  if (_snapshotTimer.isActive())
+    saveSnapshot();
+  _relaysStale = (_relays.count() > 0);
+  _refreshPending = true;
+}
+
 /** Reloads the lists of routers, circuits that Tor knows about */
 void
 NetViewer::refresh()
 {
   /* Don't let the user refresh while we're refreshing. */
   ui.actionRefresh->setEnabled(false);
-
-  /* Clear the data */
-  clear();
-
-  /* Load router information */
-  loadNetworkStatus();
+  _refreshPending = false;
+
+  if (_relaysStale) {
+    /* Keep showing the relays from the snapshot, or from before the window
+     * was hidden, and only fetch the ones that changed since. Circuits and
+     * streams may have closed in the meantime, so reload those. */
+    _relaysStale = false;
+    clearConnections();
+    updateNetworkStatus(_torControl->getNetworkStatus(), true);
+    resolve();
+  } else {
+    /* Clear the data */
+    clear();
+    /* Load router information */
+    loadNetworkStatus();
+  }
   /* Load existing address mappings */
   loadAddressMap();
   /* Load Circuits and Streams information */
@@ -228,10 +369,29 @@ NetViewer::clear()
   _map->update();
   /* Clear the address map */
   _addressMap.clear();
+  /* Drop any IPs still waiting to be resolved */
+  _resolveQueue.clear();
+  _resolveMap.clear();
+  _minResolveQueueTimer.stop();
+  _maxResolveQueueTimer.stop();
   /* Clear the lists of routers, circuits, and streams */
   ui.treeRouterList->clearRouters();
   ui.treeCircuitList->clearCircuits();
   ui.textRouterInfo->clear();
+  /* Nothing refers to the relay table's rows anymore */
+  _relays.clear();
+  _relaysStale = false;
+  _snapshotTimer.stop();
+}
+
+/** Removes every circuit and stream from the list and the map. */
+void
+NetViewer::clearConnections()
+{
+  foreach (Circuit circuit, ui.treeCircuitList->circuits()) {
+    _map->removeCircuit(circuit.id());
+  }
+  ui.treeCircuitList->clearCircuits();
 }
 
 /** Loads a list of all current address mappings. */
@@ -257,9 +417,6 @@ NetViewer::loadConnections()
   foreach (Stream stream, streams) {
     addStream(stream);
   }
-
-  /* Update the map */
-  _map->update();
 }
 
 /** Adds <b>circuit</b> to the map and the list */
@@ -272,6 +429,31 @@ NetViewer::addCircuit(const Circuit &circuit)
   _map->addCircuit(circuit.id(), circuit.routerIDs());
 }
 
+/** Adds or updates every circuit in <b>circuits</b>, repainting the list
+ * only once for the whole batch. The map repaints the area each circuit
+ * covers by itself. */
+void
+NetViewer::addCircuits(const CircuitList &circuits)
+{
+  ui.treeCircuitList->setUpdatesEnabled(false);
+  foreach (Circuit circuit, circuits) {
+    addCircuit(circuit);
+  }
+  ui.treeCircuitList->setUpdatesEnabled(true);
+}
+
+/** Adds or updates every stream in <b>streams</b>, repainting the list only
+ * once for the whole batch. */
+void
+NetViewer::addStreams(const StreamList &streams)
+{
+  ui.treeCircuitList->setUpdatesEnabled(false);
+  foreach (Stream stream, streams) {
+    addStream(stream);
+  }
+  ui.treeCircuitList->setUpdatesEnabled(true);
+}
+
 /** Adds <b>stream</b> to its associated circuit on the list of all circuits. */
 void
 NetViewer::addStream(const Stream &stream)
@@ -307,43 +489,318 @@ NetViewer::help()
 }
 
 /** Retrieves a list of all running routers from Tor and their descriptors,
- * and adds them to the RouterListWidget. */
+ * and adds them to the RouterListWidget. The network status and all known
+ * descriptors are each fetched with a single GETINFO request, rather than
+ * one request per running router. */
 void
 NetViewer::loadNetworkStatus()
 {
   NetworkStatus networkStatus = _torControl->getNetworkStatus();
+  RouterDescriptorMap descriptors = _torControl->getRouterDescriptors();
+  QHash<QString,RouterStatus> missing;
+  int relay;
+
   foreach (RouterStatus rs, networkStatus) {
     if (!rs.isRunning())
       continue;
 
-    RouterDescriptor rd = _torControl->getRouterDescriptor(rs.id());
-    if (!rd.isEmpty())
-      addRouter(rd);
+    if (descriptors.contains(rs.id())) {
+      relay = addRouter(descriptors.value(rs.id()));
+      if (relay >= 0)
+        _relays.setDescriptorDigest(relay, rs.descriptorDigest());
+    } else {
+      missing.insert(rs.id(), rs);
+    }
+  }
 
-    QCoreApplication::processEvents();
+  /* Tor may not have a recent descriptor for every running router (e.g., if
+   * it is only fetching microdescriptors), so ask for whatever is left in
+   * one more batch. Routers still without one are shown with what their
+   * network status entries say. */
+  if (! missing.isEmpty()) {
+    descriptors = _torControl->getRouterDescriptors(missing.keys());
+    foreach (RouterStatus rs, missing) {
+      if (descriptors.contains(rs.id()))
+        relay = addRouter(descriptors.value(rs.id()));
+      else
+        relay = addRouter(RouterDescriptor(rs));
+      if (relay >= 0)
+        _relays.setDescriptorDigest(relay, rs.descriptorDigest());
+    }
   }
+
+  /* Resolve every queued relay location now, rather than waiting */
+  resolve();
+
+  _consensusTime = QDateTime::currentDateTime().toUTC();
+  scheduleSnapshot();
 }
 
-/** Adds a router to our list of servers and retrieves geographic location
- * information for the server. */
-void
+/** Adds a router to our list of servers and queues its IP address to be
+ * resolved to geographic location information. Returns the router's row in
+ * the relay table, or -1. */
+int
 NetViewer::addRouter(const RouterDescriptor &rd)
 {
-  /* Add the descriptor to the list of server */
-  RouterListItem *item = ui.treeRouterList->addRouter(rd);
-  if (! item)
-    return;
+  /* Add the descriptor to the relay table and the list of servers */
+  int relay = _relays.insert(rd);
+  if (relay < 0 || ! ui.treeRouterList->addRouter(relay))
+    return -1;
 
   /* Attempt to map this relay to an approximate geographic location. The
    * accuracy of the result depends on the database information currently
-   * available to the GeoIP resolver. */
-  if (! item->location().isValid() || rd.ip() != item->location().ip()) {
-    GeoIpRecord location = _geoip.resolve(rd.ip());
-    if (location.isValid()) {
+   * available to the GeoIP resolver. The table forgets a relay's location
+   * when its IP address changes. */
+  if (! _relays.hasLocation(relay))
+    addToResolveQueue(relay);
+  return relay;
+}
+
+/** Removes the router in row <b>relay</b> of the relay table from the list,
+ * the map and the table. The table goes last, since the list and the map
+ * look up the router's ID in it. */
+void
+NetViewer::removeRouter(int relay)
+{
+  ui.treeRouterList->removeRouter(relay);
+  _map->removeRouter(relay);
+  _relays.remove(relay);
+}
+
+/** Compares the router status entries in <b>networkStatus</b> with the
+ * routers in the list. Routers that are no longer running are removed, and
+ * descriptors are fetched in a single batch for new routers and for routers
+ * that have published a new descriptor, which is where the list gets each
+ * router's bandwidth. A new router Tor has no descriptor for is shown with
+ * what its network status entry says, and a router keeps its old details if
+ * Tor doesn't have its new descriptor. Either way the router isn't asked
+ * for again until it publishes another descriptor. Routers that haven't
+ * changed aren't touched. If <b>complete</b> is true, <b>networkStatus</b>
+ * lists every router Tor knows about, so routers missing from it are
+ * removed as well. */
+void
+NetViewer::updateNetworkStatus(const NetworkStatus &networkStatus,
+                               bool complete)
+{
+  QHash<QString,RouterStatus> changed;
+  QBitArray listed(_relays.rowCount());
+  int count = _relays.count();
+  int relay;
+
+  foreach (RouterStatus rs, networkStatus) {
+    relay = _relays.indexOf(rs.id());
+    if (relay >= 0)
+      listed.setBit(relay);
+
+    if (! rs.isRunning()) {
+      if (relay >= 0)
+        removeRouter(relay);
+    } else if (relay < 0
+                 || _relays.descriptorDigest(relay) != rs.descriptorDigest()) {
+      changed.insert(rs.id(), rs);
+    }
+  }
+
+  if (complete) {
+    for (relay = 0; relay < listed.size(); relay++) {
+      if (! listed.testBit(relay) && _relays.contains(relay))
+        removeRouter(relay);
+    }
+    _consensusTime = QDateTime::currentDateTime().toUTC();
+  }
+  if (_relays.count() != count)
+    _map->update();
+
+  if (! changed.isEmpty()) {
+    RouterDescriptorMap descriptors =
+      _torControl->getRouterDescriptors(changed.keys());
+    foreach (RouterStatus rs, changed) {
+      relay = _relays.indexOf(rs.id());
+      if (descriptors.contains(rs.id()))
+        relay = addRouter(descriptors.value(rs.id()));
+      else if (relay < 0)
+        relay = addRouter(RouterDescriptor(rs));
+      if (relay >= 0)
+        _relays.setDescriptorDigest(relay, rs.descriptorDigest());
+    }
+  }
+  scheduleSnapshot();
+}
+
+/** Called when Tor has a new consensus. */
+void
+NetViewer::newConsensus(const NetworkStatus &consensus)
+{
+  updateNetworkStatus(consensus, true);
+}
+
+/** Called when Tor's view of the routers in <b>changes</b> has changed. */
+void
+NetViewer::networkStatusChanged(const NetworkStatus &changes)
+{
+  updateNetworkStatus(changes, false);
+}
+
+/** Fetches the complete network status from Tor and updates the routers
+ * that changed. */
+void
+NetViewer::reloadNetworkStatus()
+{
+  updateNetworkStatus(_torControl->getNetworkStatus(), true);
+}
+
+/** Adds the IP address of the router in row <b>relay</b> of the relay table
+ * to the queue of addresses to be resolved. The queue is flushed
+ * MIN_RESOLVE_QUEUE_DELAY milliseconds after the last address is added, or
+ * MAX_RESOLVE_QUEUE_DELAY milliseconds after the first, whichever comes
+ * first. */
+void
+NetViewer::addToResolveQueue(int relay)
+{
+  QHostAddress addr = _relays.ip(relay);
+  QString ip = addr.toString();
+  if (! _resolveMap.contains(ip))
+    _resolveQueue << addr;
+  if (! _resolveMap.contains(ip, relay))
+    _resolveMap.insert(ip, relay);
+
+  _minResolveQueueTimer.start();
+  if (! _maxResolveQueueTimer.isActive())
+    _maxResolveQueueTimer.start();
+}
+
+/** Resolves the IP addresses of all routers in the resolve queue to
+ * geographic locations and plots each router on the map. */
+void
+NetViewer::resolve()
+{
+  _minResolveQueueTimer.stop();
+  _maxResolveQueueTimer.stop();
+  if (_resolveQueue.isEmpty())
+    return;
+
+  QHash<QString,GeoIpRecord> locations = _geoip.resolve(_resolveQueue);
+
+  QHashIterator<QString,GeoIpRecord> it(locations);
+  while (it.hasNext()) {
+    it.next();
+    foreach (int relay, _resolveMap.values(it.key())) {
+      RouterListItem *item = ui.treeRouterList->findRouter(relay);
+      if (! item)
+        continue;
+
+      /* Skip routers that have since published a different address */
+      if (_relays.ip(relay).toString() != it.key())
+        continue;
+
+      item->setLocation(it.value());
+      _map->addRouter(relay, it.value());
+    }
+  }
+  _resolveQueue.clear();
+  _resolveMap.clear();
+  _map->update();
+  scheduleSnapshot();
+}
+
+/** Returns the path of the relay snapshot file. */
+QString
+NetViewer::snapshotFile() const
+{
+  return Vidalia::dataDirectory() + "/" + SNAPSHOT_FILE;
+}
+
+/** Starts the timer that writes the relay snapshot, unless it is already
+ * running. The timer isn't restarted, so a steady trickle of changes can't
+ * put off writing the snapshot forever. */
+void
+NetViewer::scheduleSnapshot()
+{
+  if (! _relaysStale && ! _snapshotTimer.isActive())
+    _snapshotTimer.start();
+}
+
+/** Writes the relay table, with its locations and the time it was last
+ * checked against the consensus, to the snapshot file. The snapshot is
+ * written to a temporary file first, so a crash can't leave a partial
+ * one behind. */
+void
+NetViewer::saveSnapshot()
+{
+  _snapshotTimer.stop();
+  /* Relays loaded from the snapshot haven't changed since it was written */
+  if (_relaysStale || ! _relays.count())
+    return;
+
+  QString fileName = snapshotFile();
+  QFile file(fileName + ".tmp");
+  if (! file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    vWarn("Unable to write the relay snapshot to %1: %2")
+      .arg(file.fileName()).arg(file.errorString());
+    return;
+  }
+  if (! _relays.save(&file, _consensusTime)) {
+    vWarn("Unable to write the relay snapshot to %1: %2")
+      .arg(file.fileName()).arg(file.errorString());
+    file.remove();
+    return;
+  }
+  file.close();
+
+  QFile::remove(fileName);
+  if (! QFile::rename(file.fileName(), fileName))
+    vWarn("Unable to replace the relay snapshot %1.").arg(fileName);
+}
+
+/** Loads the relay snapshot written by a previous session, if it isn't too
+ * old, and shows its relays in the list and on the map. The file is
+ * memory-mapped where Qt supports it, so loading costs little more than
+ * copying the table's columns. The relays are marked stale until refresh()
+ * reconciles them with Tor's current consensus. */
+void
+NetViewer::loadSnapshot()
+{
+  QFile file(snapshotFile());
+  QByteArray contents;
+  const uchar *data = 0;
+  QDateTime time;
+
+  if (! file.open(QIODevice::ReadOnly))
+    return;
+#if QT_VERSION >= 0x040400
+  data = file.map(0, file.size());
+#endif
+  if (! data) {
+    contents = file.readAll();
+    data = (const uchar *)contents.constData();
+  }
+  if (! _relays.load(data, file.size(), &time)) {
+    vWarn("Ignoring the invalid relay snapshot %1.").arg(file.fileName());
+    return;
+  }
+  file.close(); /* Also unmaps the file */
+
+  if (time.secsTo(QDateTime::currentDateTime().toUTC()) > SNAPSHOT_MAX_AGE) {
+    _relays.clear();
+    return;
+  }
+
+  for (int relay = 0; relay < _relays.rowCount(); relay++) {
+    RouterListItem *item = ui.treeRouterList->addRouter(relay);
+    if (! item)
+      continue;
+    if (_relays.hasLocation(relay)) {
+      GeoIpRecord location = _relays.location(relay);
       item->setLocation(location);
-      _map->addRouter(rd, location);
+      _map->addRouter(relay, location);
+    } else {
+      /* The snapshot was saved before this relay's location was known */
+      addToResolveQueue(relay);
     }
   }
+  _map->update();
+  _consensusTime = time;
+  _relaysStale = (_relays.count() > 0);
 }
 
 /** Called when a NEWDESC event arrives. Retrieves new router descriptors
@@ -352,10 +809,9 @@ NetViewer::addRouter(const RouterDescriptor &rd)
 void
 NetViewer::newDescriptors(const QStringList &ids)
 {
-  foreach (QString id, ids) {
-    RouterDescriptor rd = _torControl->getRouterDescriptor(id);
-    if (!rd.isEmpty())
-      addRouter(rd); /* Updates the existing entry */
+  RouterDescriptorMap descriptors = _torControl->getRouterDescriptors(ids);
+  foreach (RouterDescriptor rd, descriptors) {
+    addRouter(rd); /* Updates the existing entry */
   }
 }
 
@@ -20,6 +20,7 @@
 #include "ui_NetViewer.h"
 #include "VidaliaWindow.h"
 #include "GeoIpResolver.h"
+#include "RelayTable.h"
 
 #if defined(USE_MARBLE)
 #include "TorMapWidget.h"
@@ -32,10 +33,11 @@
 #include <QMainWindow>
 #include <QStringList>
 #include <QEvent>
+#include <QShowEvent>
+#include <QHideEvent>
 #include <QTimer>
 #include <QHash>
-
-class QDateTime;
+#include <QDateTime>
 
 
 class NetViewer : public VidaliaWindow
@@ -45,6 +47,8 @@ class NetViewer : public VidaliaWindow
 public:
   /** Default constructor */
   NetViewer(QWidget* parent = 0);
+  /** Destructor. */
+  ~NetViewer();
 
 public slots:
   /** Displays the network map window. */
@@ -56,6 +60,12 @@ public slots:
   /** Adds <b>stream</b> to the list of circuits, under the appropriate
    * circuit. */
   void addStream(const Stream &stream);
+  /** Adds or updates every circuit in <b>circuits</b> and then updates the
+   * list and the map once. */
+  void addCircuits(const CircuitList &circuits);
+  /** Adds or updates every stream in <b>streams</b>, updating the list of
+   * circuits once. */
+  void addStreams(const StreamList &streams);
 
   /** Called when a NEWDESC event arrives. Retrieves new router descriptors
    * for the router identities given in <b>ids</b> and updates the router list
@@ -63,6 +73,13 @@ public slots:
    */
   void newDescriptors(const QStringList &ids);
 
+  /** Called when Tor has a new consensus. Adds, removes and updates only
+   * the routers whose status differs from the list's. */
+  void newConsensus(const NetworkStatus &consensus);
+  /** Called when Tor's view of the routers in <b>changes</b> has changed.
+   * Updates only those routers. */
+  void networkStatusChanged(const NetworkStatus &changes);
+
   /** Called when Tor has mapped the address <b>from</b> to the address
    * <b>to</b>. <b>expires</b> indicates the time at which when the address
    * mapping will no longer be considered valid.
@@ -76,12 +93,19 @@ public slots:
 protected:
   /** Called when the user changes the UI translation. */
   void retranslateUi();
+  /** Subscribes to the events shown in the window when it is shown. */
+  void showEvent(QShowEvent *e);
+  /** Releases the window's events when it is hidden. */
+  void hideEvent(QHideEvent *e);
 
 private slots:
   /** Called when the user selects the "Help" action on the toolbar. */
   void help();
   /** Called when the user selects the "Refresh" action on the toolbar */
   void refresh();
+  /** Fetches the network status from Tor and updates the routers that
+   * changed, for versions of Tor that don't send NEWCONSENSUS events. */
+  void reloadNetworkStatus();
   /** Called when the user selects a circuit on the circuit list */
   void circuitSelected(const Circuit &circuit);
   /** Called when the user selects one or more routers in the list. */
@@ -101,25 +125,81 @@ private slots:
   /** Called when the user clicks "Full Screen" or presses Escape on the map.
    * Toggles the map between normal and a full screen viewing modes. */
   void toggleFullScreen();
+  /** Resolves the IP addresses of all routers in the resolve queue to
+   * geographic locations in a single batch and plots the routers on the
+   * map. */
+  void resolve();
+  /** Writes the relay table to the snapshot file. */
+  void saveSnapshot();
 
 private:
-  /** */
+  /** Chooses the database used to look up router locations. */
   void setupGeoIpResolver();
+  /** Returns the path of the GeoIP range index installed with Vidalia, or
+   * an empty string if there is none. */
+  static QString installedGeoIpIndex();
   /** Retrieves a list of all running routers from Tor and their descriptors,
    * and adds them to the RouterListWidget. */
   void loadNetworkStatus();
   /** Loads a list of address mappings from Tor. */
   void loadAddressMap();
-  /** Adds a router to our list of servers and retrieves geographic location
-   * information for the server. */
-  void addRouter(const RouterDescriptor &rd);
+  /** Removes every circuit and stream from the list and the map. */
+  void clearConnections();
+  /** Adds a router to our list of servers and queues its IP address to be
+   * resolved to geographic location information. Returns the router's row
+   * in the relay table, or -1. */
+  int addRouter(const RouterDescriptor &rd);
+  /** Removes the router in row <b>relay</b> of the relay table from the
+   * list, the map and the table. */
+  void removeRouter(int relay);
+  /** Updates the list and the map from the router status entries in
+   * <b>networkStatus</b>. If <b>complete</b> is true, routers missing from
+   * <b>networkStatus</b> are removed. */
+  void updateNetworkStatus(const NetworkStatus &networkStatus, bool complete);
+  /** Adds the IP address of the router in row <b>relay</b> of the relay
+   * table to the queue of addresses to be resolved and (re)starts the
+   * resolve queue timers. */
+  void addToResolveQueue(int relay);
+  /** Returns the path of the relay snapshot file. */
+  QString snapshotFile() const;
+  /** Starts the timer that writes the relay snapshot. */
+  void scheduleSnapshot();
+  /** Loads the relay snapshot from a previous session and shows its relays
+   * until they can be checked against Tor's consensus. */
+  void loadSnapshot();
 
   /** TorControl object used to talk to Tor. */
   TorControl* _torControl;
-  /** Timer that fires once an hour to update the router list. */
+  /** Timer that fires once an hour to update the router list, if Tor doesn't
+   * send NEWCONSENSUS events. */
   QTimer _refreshTimer;
+  /** Holds the routers shown in the list and on the map, along with the
+   * digest of the descriptor each was last loaded from. */
+  RelayTable _relays;
+  /** True if _relays was loaded from a snapshot and hasn't yet been checked
+   * against Tor's consensus. */
+  bool _relaysStale;
+  /** True if Tor was connected while the window was hidden, so the lists
+   * and the map must be refreshed when it is shown. */
+  bool _refreshPending;
+  /** Time (UTC) _relays was last checked against Tor's consensus. */
+  QDateTime _consensusTime;
+  /** Timer that writes the relay snapshot shortly after the relays
+   * change. */
+  QTimer _snapshotTimer;
   /** GeoIpResolver used to geolocate routers by IP address. */
   GeoIpResolver _geoip;
+  /** List of IP addresses waiting to be resolved to geographic locations. */
+  QList<QHostAddress> _resolveQueue;
+  /** Maps each queued IP address to the relay table rows of the routers
+   * using it. */
+  QMultiHash<QString,int> _resolveMap;
+  /** Timer started (and restarted) when an IP is added to the resolve
+   * queue, so that IPs arriving close together are resolved together. */
+  QTimer _minResolveQueueTimer;
+  /** Timer started when the first IP is added to an empty resolve queue,
+   * bounding how long any IP waits before it is resolved. */
+  QTimer _maxResolveQueueTimer;
   /** Stores a list of address mappings from Tor. */
   AddressMap _addressMap;
  
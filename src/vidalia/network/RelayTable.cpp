@@ -0,0 +1,553 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file RelayTable.cpp
+** \brief Compact table of the relays shown in the network map
+*/
+
+#include "RelayTable.h"
+
+#include "stringutil.h"
+
+#include <QDateTime>
+
+#include <string.h>
+
+/** Number of bytes in a RelayDigest. */
+#define DIGEST_LEN  20
+
+/** Identifies a relay table snapshot: "VRT" and the format version. It is
+ * written in native byte order, so a snapshot copied from a machine of the
+ * other byte order is simply not recognized. */
+#define SNAPSHOT_MAGIC  0x56525402u
+
+/** Header at the start of a relay table snapshot. It is followed by the
+ * shared strings, the nicknames, the contacts, and then each fixed-size
+ * column in turn.
+ * Each string is stored as its length in UTF-16 code units, as a quint32,
+ * followed by the code units themselves. */
+struct SnapshotHeader {
+  quint32 magic;   /**< SNAPSHOT_MAGIC. */
+  quint32 rows;    /**< Number of rows, including empty ones. */
+  quint32 strings; /**< Number of shared strings. */
+  quint32 unused;  /**< Padding; always zero. */
+  qint64 time;     /**< Time given to save(), in seconds since the epoch. */
+};
+
+
+/** Default constructor. Creates an all-zero digest. */
+RelayDigest::RelayDigest()
+{
+  memset(_words, 0, sizeof(_words));
+}
+
+/** Decodes the 40-character hexadecimal digest <b>hex</b>. */
+RelayDigest
+RelayDigest::fromHex(const QString &hex, bool *ok)
+{
+  RelayDigest digest;
+  QByteArray bytes;
+
+  if (hex.length() == 2*DIGEST_LEN)
+    bytes = QByteArray::fromHex(hex.toAscii());
+  /* fromHex() skips characters that aren't hexadecimal digits */
+  if (bytes.size() != DIGEST_LEN) {
+    if (ok)
+      *ok = false;
+    return digest;
+  }
+  memcpy(digest._words, bytes.constData(), DIGEST_LEN);
+  if (ok)
+    *ok = true;
+  return digest;
+}
+
+/** Returns the digest as 40 uppercase hexadecimal characters. */
+QString
+RelayDigest::toHex() const
+{
+  return base16_encode(QByteArray((const char *)_words, DIGEST_LEN));
+}
+
+/** Returns true if every byte of the digest is zero. */
+bool
+RelayDigest::isNull() const
+{
+  return !(_words[0] | _words[1] | _words[2] | _words[3] | _words[4]);
+}
+
+bool
+RelayDigest::operator==(const RelayDigest &other) const
+{
+  return !memcmp(_words, other._words, sizeof(_words));
+}
+
+/** Returns a hash of <b>digest</b>. The digest is already uniformly
+ * distributed, so its first word will do. */
+uint
+qHash(const RelayDigest &digest)
+{
+  return digest._words[0];
+}
+
+
+/** Default constructor. */
+RelayTable::RelayTable()
+{
+  clear();
+}
+
+/** Removes every relay and every stored string. */
+void
+RelayTable::clear()
+{
+  _rows.clear();
+  _freeRows.clear();
+  _strings.clear();
+  _stringIndex.clear();
+  /* Index 0 is the empty string, so a zeroed column means "not set" */
+  intern(QString());
+
+  _ids.clear();
+  _digests.clear();
+  _names.clear();
+  _ips.clear();
+  _orPorts.clear();
+  _dirPorts.clear();
+  _published.clear();
+  _uptimes.clear();
+  _avgBandwidths.clear();
+  _burstBandwidths.clear();
+  _observedBandwidths.clear();
+  _statuses.clear();
+  _platforms.clear();
+  _contacts.clear();
+  _latitudes.clear();
+  _longitudes.clear();
+  _cities.clear();
+  _regions.clear();
+  _countries.clear();
+  _countryCodes.clear();
+}
+
+/** Returns the index of <b>str</b> in the table's shared strings, adding it
+ * if it isn't there yet. Strings are never removed, since the set of
+ * distinct platforms and locations grows only slowly. */
+quint32
+RelayTable::intern(const QString &str)
+{
+  QHash<QString,quint32>::const_iterator it = _stringIndex.constFind(str);
+  if (it != _stringIndex.constEnd())
+    return it.value();
+
+  quint32 index = _strings.size();
+  _strings << str;
+  _stringIndex.insert(str, index);
+  return index;
+}
+
+/** Adds or updates the relay described by <b>rd</b> and returns its row. */
+int
+RelayTable::insert(const RouterDescriptor &rd)
+{
+  bool ok;
+  RelayDigest id = RelayDigest::fromHex(rd.id(), &ok);
+  if (!ok)
+    return -1;
+
+  int relay = _rows.value(id, -1);
+  if (relay < 0) {
+    if (!_freeRows.isEmpty()) {
+      relay = _freeRows.last();
+      _freeRows.pop_back();
+    } else {
+      /* Grow every column by one row */
+      relay = _ids.size();
+      _ids.resize(relay+1);
+      _digests.resize(relay+1);
+      _names.resize(relay+1);
+      _ips.resize(relay+1);
+      _orPorts.resize(relay+1);
+      _dirPorts.resize(relay+1);
+      _published.resize(relay+1);
+      _uptimes.resize(relay+1);
+      _avgBandwidths.resize(relay+1);
+      _burstBandwidths.resize(relay+1);
+      _observedBandwidths.resize(relay+1);
+      _statuses.resize(relay+1);
+      _platforms.resize(relay+1);
+      _contacts.resize(relay+1);
+      _latitudes.resize(relay+1);
+      _longitudes.resize(relay+1);
+      _cities.resize(relay+1);
+      _regions.resize(relay+1);
+      _countries.resize(relay+1);
+      _countryCodes.resize(relay+1);
+    }
+    _ids[relay] = id;
+    _digests[relay] = RelayDigest();
+    _ips[relay] = 0;
+    _countryCodes[relay] = 0;
+    _rows.insert(id, relay);
+  }
+
+  quint32 ip = rd.ip().toIPv4Address();
+  if (ip != _ips.at(relay)) {
+    /* The relay moved, so its old location no longer applies */
+    _ips[relay] = ip;
+    _countryCodes[relay] = 0;
+  }
+  _names[relay] = rd.name();
+  _orPorts[relay] = rd.orPort();
+  _dirPorts[relay] = rd.dirPort();
+  _published[relay] = rd.published().toTime_t();
+  _uptimes[relay] = quint32(qMin(rd.uptime(), quint64(0xffffffffu)));
+  _avgBandwidths[relay] = quint32(qMin(rd.averageBandwidth(),
+                                       quint64(0xffffffffu)));
+  _burstBandwidths[relay] = quint32(qMin(rd.burstBandwidth(),
+                                         quint64(0xffffffffu)));
+  _observedBandwidths[relay] = quint32(qMin(rd.observedBandwidth(),
+                                            quint64(0xffffffffu)));
+  _statuses[relay] = quint8(rd.offline() ? RouterDescriptor::Offline
+                            : rd.hibernating() ? RouterDescriptor::Hibernating
+                                               : RouterDescriptor::Online);
+  _platforms[relay] = intern(rd.platform());
+  _contacts[relay] = rd.contact();
+  return relay;
+}
+
+/** Removes the relay in row <b>relay</b>, leaving the row free for reuse. */
+void
+RelayTable::remove(int relay)
+{
+  if (!contains(relay))
+    return;
+
+  _rows.remove(_ids.at(relay));
+  _ids[relay] = RelayDigest();
+  _names[relay] = QString();
+  _contacts[relay] = QString();
+  _freeRows << relay;
+}
+
+/** Returns the row of the relay whose hexadecimal identity digest is
+ * <b>id</b>, or -1. */
+int
+RelayTable::indexOf(const QString &id) const
+{
+  bool ok;
+  RelayDigest digest = RelayDigest::fromHex(id, &ok);
+  return (ok ? _rows.value(digest, -1) : -1);
+}
+
+/** Returns true if row <b>relay</b> holds a relay. */
+bool
+RelayTable::contains(int relay) const
+{
+  return (relay >= 0 && relay < _ids.size() && !_ids.at(relay).isNull());
+}
+
+/** Returns the lowest of the relay's average, burst and observed
+ * bandwidths, which is the most the relay can be expected to carry. */
+quint32
+RelayTable::bandwidth(int relay) const
+{
+  return qMin(_observedBandwidths.at(relay),
+              qMin(_avgBandwidths.at(relay), _burstBandwidths.at(relay)));
+}
+
+/** Returns a RouterDescriptor built from the relay's row. This allocates a
+ * full descriptor, so it is meant for the few relays being displayed in
+ * detail rather than for every relay in the table. */
+RouterDescriptor
+RelayTable::descriptor(int relay) const
+{
+  RouterDescriptor rd;
+  if (!contains(relay))
+    return rd;
+
+  QDateTime published;
+  published.setTimeSpec(Qt::UTC);
+  published.setTime_t(_published.at(relay));
+
+  rd.setId(id(relay));
+  rd.setName(_names.at(relay));
+  rd.setIp(ip(relay));
+  rd.setOrPort(_orPorts.at(relay));
+  rd.setDirPort(_dirPorts.at(relay));
+  rd.setPublished(published);
+  rd.setUptime(_uptimes.at(relay));
+  rd.setBandwidth(_avgBandwidths.at(relay), _burstBandwidths.at(relay),
+                  _observedBandwidths.at(relay));
+  rd.setStatus((RouterDescriptor::RouterStatus)_statuses.at(relay));
+  rd.setPlatform(_strings.at(_platforms.at(relay)));
+  rd.setContact(_contacts.at(relay));
+  if (hasLocation(relay))
+    rd.setLocation(location(relay).toString());
+  return rd;
+}
+
+/** Returns the hexadecimal digest of the descriptor the relay was last
+ * loaded from, or an empty string. */
+QString
+RelayTable::descriptorDigest(int relay) const
+{
+  const RelayDigest &digest = _digests.at(relay);
+  return (digest.isNull() ? QString() : digest.toHex());
+}
+
+/** Sets the hexadecimal digest of the descriptor the relay was last loaded
+ * from. */
+void
+RelayTable::setDescriptorDigest(int relay, const QString &digest)
+{
+  _digests[relay] = RelayDigest::fromHex(digest);
+}
+
+/** Sets the relay's geographic location. */
+void
+RelayTable::setLocation(int relay, const GeoIpRecord &geoip)
+{
+  _latitudes[relay] = geoip.latitude();
+  _longitudes[relay] = geoip.longitude();
+  _cities[relay] = intern(geoip.city());
+  _regions[relay] = intern(geoip.region());
+  _countries[relay] = intern(geoip.country());
+  _countryCodes[relay] = intern(geoip.countryCode());
+}
+
+/** Returns the relay's geographic location, or an invalid GeoIpRecord. */
+GeoIpRecord
+RelayTable::location(int relay) const
+{
+  if (!hasLocation(relay))
+    return GeoIpRecord();
+  return GeoIpRecord(ip(relay), _latitudes.at(relay), _longitudes.at(relay),
+                     _strings.at(_cities.at(relay)),
+                     _strings.at(_regions.at(relay)),
+                     _strings.at(_countries.at(relay)),
+                     _strings.at(_countryCodes.at(relay)));
+}
+
+/** Writes the raw contents of <b>column</b> to <b>device</b>. */
+template <class T>
+static bool
+write_column(QIODevice *device, const QVector<T> &column)
+{
+  qint64 size = qint64(column.size()) * sizeof(T);
+  return (device->write((const char *)column.constData(), size) == size);
+}
+
+/** Fills <b>column</b> with <b>rows</b> values copied from <b>*data</b>
+ * and advances <b>*data</b> past them. Returns false if fewer bytes than
+ * that remain before <b>end</b>. */
+template <class T>
+static bool
+read_column(const uchar **data, const uchar *end, QVector<T> &column,
+            int rows)
+{
+  qint64 size = qint64(rows) * sizeof(T);
+  if (end - *data < size)
+    return false;
+  column.resize(rows);
+  memcpy(column.data(), *data, size);
+  *data += size;
+  return true;
+}
+
+/** Writes <b>str</b> to <b>device</b> as its length followed by its UTF-16
+ * code units. */
+static bool
+write_string(QIODevice *device, const QString &str)
+{
+  quint32 len = str.length();
+  qint64 size = qint64(len) * sizeof(QChar);
+  return (device->write((const char *)&len, sizeof(len)) == sizeof(len)
+            && device->write((const char *)str.unicode(), size) == size);
+}
+
+/** Reads a string written by write_string() from <b>*data</b> and
+ * advances <b>*data</b> past it. Returns false if it runs past
+ * <b>end</b>. */
+static bool
+read_string(const uchar **data, const uchar *end, QString *str)
+{
+  quint32 len;
+  if (end - *data < qint64(sizeof(len)))
+    return false;
+  memcpy(&len, *data, sizeof(len));
+  *data += sizeof(len);
+
+  qint64 size = qint64(len) * sizeof(QChar);
+  if (end - *data < size)
+    return false;
+  str->resize(len);
+  memcpy(str->data(), *data, size);
+  *data += size;
+  return true;
+}
+
+/** Returns true if every value in <b>column</b> is less than
+ * <b>limit</b>. */
+static bool
+column_below(const QVector<quint32> &column, int limit)
+{
+  for (int i = 0; i < column.size(); i++) {
+    if (column.at(i) >= quint32(limit))
+      return false;
+  }
+  return true;
+}
+
+/** Writes the table to <b>device</b>. The fixed-size columns are written
+ * as they are in memory, so load() only has to copy them back. */
+bool
+RelayTable::save(QIODevice *device, const QDateTime &time) const
+{
+  SnapshotHeader header;
+  header.magic   = SNAPSHOT_MAGIC;
+  header.rows    = _ids.size();
+  header.strings = _strings.size();
+  header.unused  = 0;
+  header.time    = time.toTime_t();
+
+  if (device->write((const char *)&header, sizeof(header)) != sizeof(header))
+    return false;
+  foreach (QString str, _strings) {
+    if (! write_string(device, str))
+      return false;
+  }
+  foreach (QString name, _names) {
+    if (! write_string(device, name))
+      return false;
+  }
+  foreach (QString contact, _contacts) {
+    if (! write_string(device, contact))
+      return false;
+  }
+  return (write_column(device, _ids)
+            && write_column(device, _digests)
+            && write_column(device, _ips)
+            && write_column(device, _orPorts)
+            && write_column(device, _dirPorts)
+            && write_column(device, _published)
+            && write_column(device, _uptimes)
+            && write_column(device, _avgBandwidths)
+            && write_column(device, _burstBandwidths)
+            && write_column(device, _observedBandwidths)
+            && write_column(device, _statuses)
+            && write_column(device, _platforms)
+            && write_column(device, _latitudes)
+            && write_column(device, _longitudes)
+            && write_column(device, _cities)
+            && write_column(device, _regions)
+            && write_column(device, _countries)
+            && write_column(device, _countryCodes));
+}
+
+/** Replaces the table's contents with the snapshot at <b>data</b>. */
+bool
+RelayTable::load(const uchar *data, qint64 size, QDateTime *time)
+{
+  const uchar *end = data + size;
+  SnapshotHeader header;
+
+  clear();
+  if (size < qint64(sizeof(header)))
+    return false;
+  memcpy(&header, data, sizeof(header));
+  data += sizeof(header);
+  if (header.magic != SNAPSHOT_MAGIC || header.strings < 1
+        || header.rows > quint32(size) || header.strings > quint32(size))
+    return false;
+
+  /* Replace the empty string clear() added with the snapshot's own */
+  _strings.clear();
+  _stringIndex.clear();
+  for (quint32 i = 0; i < header.strings; i++) {
+    QString str;
+    if (! read_string(&data, end, &str)) {
+      clear();
+      return false;
+    }
+    _strings << str;
+    _stringIndex.insert(str, i);
+  }
+  if (! _strings.first().isEmpty()
+        || ! loadColumns(data, end, header.rows, header.strings)) {
+    clear();
+    return false;
+  }
+
+  if (time) {
+    time->setTimeSpec(Qt::UTC);
+    time->setTime_t(uint(header.time));
+  }
+  return true;
+}
+
+/** Reads the nicknames, contacts and fixed-size columns of a snapshot, then
+ * rebuilds the row index from the identity digests. */
+bool
+RelayTable::loadColumns(const uchar *data, const uchar *end, int rows,
+                        int strings)
+{
+  _names.resize(rows);
+  for (int i = 0; i < rows; i++) {
+    if (! read_string(&data, end, &_names[i]))
+      return false;
+  }
+  _contacts.resize(rows);
+  for (int i = 0; i < rows; i++) {
+    if (! read_string(&data, end, &_contacts[i]))
+      return false;
+  }
+  if (! (read_column(&data, end, _ids, rows)
+           && read_column(&data, end, _digests, rows)
+           && read_column(&data, end, _ips, rows)
+           && read_column(&data, end, _orPorts, rows)
+           && read_column(&data, end, _dirPorts, rows)
+           && read_column(&data, end, _published, rows)
+           && read_column(&data, end, _uptimes, rows)
+           && read_column(&data, end, _avgBandwidths, rows)
+           && read_column(&data, end, _burstBandwidths, rows)
+           && read_column(&data, end, _observedBandwidths, rows)
+           && read_column(&data, end, _statuses, rows)
+           && read_column(&data, end, _platforms, rows)
+           && read_column(&data, end, _latitudes, rows)
+           && read_column(&data, end, _longitudes, rows)
+           && read_column(&data, end, _cities, rows)
+           && read_column(&data, end, _regions, rows)
+           && read_column(&data, end, _countries, rows)
+           && read_column(&data, end, _countryCodes, rows)))
+    return false;
+  if (data != end)
+    return false;
+
+  /* A damaged snapshot mustn't make the accessors index past _strings */
+  if (! (column_below(_platforms, strings)
+           && column_below(_cities, strings)
+           && column_below(_regions, strings)
+           && column_below(_countries, strings)
+           && column_below(_countryCodes, strings)))
+    return false;
+
+  for (int relay = 0; relay < rows; relay++) {
+    const RelayDigest &id = _ids.at(relay);
+    if (id.isNull())
+      _freeRows << relay;
+    else if (_rows.contains(id))
+      return false;
+    else
+      _rows.insert(id, relay);
+  }
+  return true;
+}
@@ -0,0 +1,188 @@
+/*
+**  This file is part of Vidalia, and is subject to the license terms in the
+**  LICENSE file, found in the top level directory of this distribution. If you
+**  did not receive the LICENSE file with this file, you may obtain it from the
+**  Vidalia source package distributed by the Vidalia Project at
+**  http://www.torproject.org/projects/vidalia.html. No part of Vidalia,
+**  including this file, may be copied, modified, propagated, or distributed
+**  except according to the terms described in the LICENSE file.
+*/
+
+/*
+** \file RelayTable.h
+** \brief Compact table of the relays shown in the network map
+*/
+
+#ifndef _RELAYTABLE_H
+#define _RELAYTABLE_H
+
+#include "RouterDescriptor.h"
+#include "GeoIpRecord.h"
+
+#include <QHash>
+#include <QVector>
+#include <QString>
+#include <QStringList>
+#include <QHostAddress>
+#include <QDateTime>
+#include <QIODevice>
+
+
+/** A 20-byte router identity key or descriptor digest, stored in binary
+ * rather than as 40 hexadecimal characters. */
+class RelayDigest
+{
+public:
+  /** Default constructor. Creates an all-zero digest. */
+  RelayDigest();
+
+  /** Decodes the hexadecimal digest <b>hex</b>. Returns an all-zero digest
+   * and sets <b>ok</b> to false if <b>hex</b> is not a 40-character
+   * hexadecimal string. */
+  static RelayDigest fromHex(const QString &hex, bool *ok = 0);
+  /** Returns the digest as 40 uppercase hexadecimal characters. */
+  QString toHex() const;
+  /** Returns true if every byte of the digest is zero. */
+  bool isNull() const;
+
+  bool operator==(const RelayDigest &other) const;
+  bool operator!=(const RelayDigest &other) const { return !(*this == other); }
+
+private:
+  friend uint qHash(const RelayDigest &digest);
+
+  quint32 _words[5]; /**< The digest's bytes, in order. */
+};
+
+/** Returns a hash of <b>digest</b> for use as a QHash key. */
+uint qHash(const RelayDigest &digest);
+
+
+/** A RelayTable holds the relays shown by the network map, one row per
+ * relay. Each field is kept in its own array, indexed by the row, and
+ * strings that many relays share (platforms and locations) are stored
+ * once. Contacts are mostly unique to a relay, so each row keeps its
+ * own. Views refer to a relay by its row index, which stays the
+ * same until the relay is removed; the row is then reused for the next
+ * relay inserted. */
+class RelayTable
+{
+public:
+  /** Default constructor. */
+  RelayTable();
+
+  /** Adds the relay described by <b>rd</b>, or updates it if it is already
+   * in the table, and returns its row. If its IP address changed, its
+   * location is cleared. Returns -1 if <b>rd</b> has no valid ID. */
+  int insert(const RouterDescriptor &rd);
+  /** Removes the relay in row <b>relay</b>. */
+  void remove(int relay);
+  /** Removes every relay and every stored string. */
+  void clear();
+
+  /** Writes every row of the table to <b>device</b> in a compact binary
+   * form, along with <b>time</b>. Returns false if the write fails. */
+  bool save(QIODevice *device, const QDateTime &time) const;
+  /** Replaces the table's contents with the <b>size</b>-byte snapshot at
+   * <b>data</b>, as written by save(), and sets <b>time</b> to the time
+   * given to save(). <b>data</b> may point into a memory-mapped file; it is
+   * not referred to after load() returns. Returns false, leaving the table
+   * empty, if the snapshot is malformed or was written by an incompatible
+   * version of Vidalia. */
+  bool load(const uchar *data, qint64 size, QDateTime *time);
+
+  /** Returns the row of the relay whose identity digest is the hexadecimal
+   * string <b>id</b>, or -1 if it is not in the table. */
+  int indexOf(const QString &id) const;
+  /** Returns true if row <b>relay</b> holds a relay. */
+  bool contains(int relay) const;
+  /** Returns the number of relays in the table. */
+  int count() const { return _rows.size(); }
+  /** Returns one more than the highest row that may hold a relay. */
+  int rowCount() const { return _ids.size(); }
+
+  /** Returns the relay's hexadecimal identity digest. */
+  QString id(int relay) const { return _ids.at(relay).toHex(); }
+  /** Returns the relay's nickname. */
+  QString name(int relay) const { return _names.at(relay); }
+  /** Returns the relay's IP address. */
+  QHostAddress ip(int relay) const { return QHostAddress(_ips.at(relay)); }
+  /** Returns the platform string from the relay's descriptor. */
+  QString platform(int relay) const
+    { return _strings.at(_platforms.at(relay)); }
+  /** Returns the lowest of the relay's average, burst and observed
+   * bandwidths, in bytes per second. */
+  quint32 bandwidth(int relay) const;
+  /** Returns true if the relay is hibernating. */
+  bool hibernating(int relay) const
+    { return (_statuses.at(relay) == RouterDescriptor::Hibernating); }
+  /** Returns true if the relay is unresponsive. */
+  bool offline(int relay) const
+    { return (_statuses.at(relay) == RouterDescriptor::Offline); }
+  /** Returns a RouterDescriptor built from the relay's row, including its
+   * location. */
+  RouterDescriptor descriptor(int relay) const;
+
+  /** Returns the hexadecimal digest of the descriptor the relay was last
+   * loaded from, as listed in the network status, or an empty string if it
+   * was never set. */
+  QString descriptorDigest(int relay) const;
+  /** Sets the hexadecimal digest of the descriptor the relay was last
+   * loaded from. */
+  void setDescriptorDigest(int relay, const QString &digest);
+
+  /** Sets the relay's geographic location. */
+  void setLocation(int relay, const GeoIpRecord &geoip);
+  /** Returns true if the relay's location is known. */
+  bool hasLocation(int relay) const { return (_countryCodes.at(relay) != 0); }
+  /** Returns the relay's geographic location, or an invalid GeoIpRecord if
+   * it is not known. */
+  GeoIpRecord location(int relay) const;
+  /** Returns the relay's two-letter country code, or an empty string. */
+  QString countryCode(int relay) const
+    { return _strings.at(_countryCodes.at(relay)); }
+
+private:
+  /** Returns the index of <b>str</b> in _strings, adding it if needed. */
+  quint32 intern(const QString &str);
+  /** Reads the columns of a snapshot. Returns false if it is truncated or
+   * refers to strings it doesn't contain. */
+  bool loadColumns(const uchar *data, const uchar *end, int rows,
+                   int strings);
+
+  /** Maps the identity digest of each relay to its row. */
+  QHash<RelayDigest,int> _rows;
+  /** Rows left empty by removed relays, reused before the table grows. */
+  QVector<int> _freeRows;
+  /** Strings shared by many relays. Index 0 is the empty string. */
+  QStringList _strings;
+  /** Maps each string in _strings to its index. */
+  QHash<QString,quint32> _stringIndex;
+
+  QVector<RelayDigest> _ids;     /**< Identity digest. */
+  QVector<RelayDigest> _digests; /**< Digest of the current descriptor. */
+  QVector<QString> _names;       /**< Nickname. */
+  QVector<quint32> _ips;         /**< IPv4 address. */
+  QVector<quint16> _orPorts;     /**< ORPort. */
+  QVector<quint16> _dirPorts;    /**< DirPort. */
+  QVector<quint32> _published;   /**< Descriptor publication time (UTC). */
+  QVector<quint32> _uptimes;     /**< Uptime when the descriptor was
+                                      published, in seconds. */
+  QVector<quint32> _avgBandwidths;      /**< Average bandwidth. */
+  QVector<quint32> _burstBandwidths;    /**< Burst bandwidth. */
+  QVector<quint32> _observedBandwidths; /**< Observed bandwidth. */
+  QVector<quint8> _statuses;     /**< RouterDescriptor::RouterStatus. */
+  QVector<quint32> _platforms;   /**< Platform, as an index in _strings. */
+  QVector<QString> _contacts;    /**< Contact. */
+  QVector<float> _latitudes;     /**< Latitude of the relay's location. */
+  QVector<float> _longitudes;    /**< Longitude of the relay's location. */
+  QVector<quint32> _cities;      /**< City, as an index in _strings. */
+  QVector<quint32> _regions;     /**< Region, as an index in _strings. */
+  QVector<quint32> _countries;   /**< Country, as an index in _strings. */
+  QVector<quint32> _countryCodes; /**< Country code, as an index in
+                                       _strings, or 0 if the location is
+                                       not known. */
+};
+
+#endif
+
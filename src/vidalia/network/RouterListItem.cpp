@@ -15,6 +15,7 @@
 
 #include "RouterListItem.h"
 #include "RouterListWidget.h"
+#include "IconCache.h"
 
 #include <QHeaderView>
 
@@ -28,81 +29,97 @@
 #define IMG_NODE_LOW_BW     ":/images/icons/node-bw-low.png"
 #define IMG_NODE_MED_BW     ":/images/icons/node-bw-med.png"
 #define IMG_NODE_HIGH_BW    ":/images/icons/node-bw-high.png"
-#define IMG_FLAG_UNKNOWN    ":/images/flags/unknown.png"
 
 
-/** Default constructor. */
-RouterListItem::RouterListItem(RouterListWidget *list, RouterDescriptor rd)
+/** Constructor. */
+RouterListItem::RouterListItem(RouterListWidget *list, int relay)
   : QTreeWidgetItem()
 {
-  _list = list;
-  _rd   = 0;
-  _countryCode = "~"; /* Force items with no country to the bottom */
-  setIcon(COUNTRY_COLUMN, QIcon(IMG_FLAG_UNKNOWN));
-  update(rd);
+  _list  = list;
+  _relay = relay;
+  setIcon(COUNTRY_COLUMN, IconCache::flag(QString()));
+  update();
 }
 
-/** Destructor. */
-RouterListItem::~RouterListItem()
+/** Returns the router's ID. */
+QString
+RouterListItem::id() const
 {
-  if (_rd)
-    delete _rd;
+  return relays()->id(_relay);
 }
 
-/** Updates the router descriptor for this item. */
+/** Returns the router's name. */
+QString
+RouterListItem::name() const
+{
+  return relays()->name(_relay);
+}
+
+/** Returns the descriptor for this router, built from the relay table. */
+RouterDescriptor
+RouterListItem::descriptor() const
+{
+  return relays()->descriptor(_relay);
+}
+
+/** Returns the location information for this router. */
+GeoIpRecord
+RouterListItem::location() const
+{
+  return relays()->location(_relay);
+}
+
+/** Updates this item from the router's row in the relay table. */
 void
-RouterListItem::update(const RouterDescriptor &rd)
+RouterListItem::update()
 {
+  RelayTable *table = relays();
   QIcon statusIcon;
-  if (_rd) {
-    delete _rd;
-  }
-  _rd = new RouterDescriptor(rd);
-  
+
   /* Determine the status value (used for sorting) and icon */
-  if (_rd->offline()) {
+  if (table->offline(_relay)) {
     _statusValue = -1;
-    statusIcon = QIcon(IMG_NODE_OFFLINE);
+    statusIcon = IconCache::icon(IMG_NODE_OFFLINE);
     setToolTip(STATUS_COLUMN, tr("Offline"));
-  } else if (_rd->hibernating()) {
+  } else if (table->hibernating(_relay)) {
     _statusValue = 0;
-    statusIcon = QIcon(IMG_NODE_SLEEPING);
+    statusIcon = IconCache::icon(IMG_NODE_SLEEPING);
     setToolTip(STATUS_COLUMN, tr("Hibernating"));
   } else {
-    _statusValue = (qint64)qMin(_rd->observedBandwidth(), 
-                                qMin(_rd->averageBandwidth(),
-                                     _rd->burstBandwidth()));
+    _statusValue = (qint64)table->bandwidth(_relay);
     if (_statusValue >= 400*1024) {
-      statusIcon = QIcon(IMG_NODE_HIGH_BW);
+      statusIcon = IconCache::icon(IMG_NODE_HIGH_BW);
     } else if (_statusValue >= 60*1024) {
-      statusIcon = QIcon(IMG_NODE_MED_BW);
+      statusIcon = IconCache::icon(IMG_NODE_MED_BW);
     } else if (_statusValue >= 20*1024) {
-      statusIcon = QIcon(IMG_NODE_LOW_BW);
+      statusIcon = IconCache::icon(IMG_NODE_LOW_BW);
     } else {
-      statusIcon = QIcon(IMG_NODE_NO_BW);
+      statusIcon = IconCache::icon(IMG_NODE_NO_BW);
     }
     setToolTip(STATUS_COLUMN, tr("%1 KB/s").arg(_statusValue/1024));
   }
-  
+
+  /* The router may have moved since its location was looked up */
+  if (!table->hasLocation(_relay)) {
+    setIcon(COUNTRY_COLUMN, IconCache::flag(QString()));
+    setToolTip(COUNTRY_COLUMN, QString());
+  }
+
   /* Make the new information visible */
+  QString name = table->name(_relay);
   setIcon(STATUS_COLUMN, statusIcon);
-  setText(NAME_COLUMN, _rd->name());
-  setToolTip(NAME_COLUMN, QString(_rd->name() + "\r\n" + _rd->platform()));
+  setText(NAME_COLUMN, name);
+  setToolTip(NAME_COLUMN, QString(name + "\r\n" + table->platform(_relay)));
 }
 
-/** Sets the location information for this item's router descriptor. */
+/** Sets the location information for this item's router. */
 void
 RouterListItem::setLocation(const GeoIpRecord &geoip)
 {
-  QPixmap flag(":/images/flags/" + geoip.countryCode().toLower() + ".png");
-  if (!flag.isNull()) {
-    setIcon(COUNTRY_COLUMN, QIcon(flag));
-  }
+  setIcon(COUNTRY_COLUMN, IconCache::flag(geoip.countryCode()));
   setToolTip(COUNTRY_COLUMN, geoip.toString());
 
-  if (_rd)
-    _rd->setLocation(geoip.toString());
-  _countryCode = geoip.countryCode();
+  relays()->setLocation(_relay, geoip);
 }
 
 /** Overload the comparison operator. */
@@ -111,6 +128,7 @@ RouterListItem::operator<(const QTreeWidgetItem &other) const
 {
   const RouterListItem *a = this;
   const RouterListItem *b = (RouterListItem *)&other;
+  QString codeA, codeB;
  
   if (_list) {
     Qt::SortOrder order = _list->header()->sortIndicatorOrder();
@@ -125,14 +143,21 @@ RouterListItem::operator<(const QTreeWidgetItem &other) const
         }
         return (a->_statusValue < b->_statusValue);
       case RouterListWidget::CountryColumn:
-        /* Compare based on country code */
-        if (a->_countryCode == b->_countryCode) {
+        /* Compare based on country code. Items with no country sort last,
+         * since "~" sorts after every country code. */
+        codeA = a->relays()->countryCode(a->_relay);
+        codeB = b->relays()->countryCode(b->_relay);
+        if (codeA.isEmpty())
+          codeA = "~";
+        if (codeB.isEmpty())
+          codeB = "~";
+        if (codeA == codeB) {
           if (order == Qt::AscendingOrder)
             return (a->_statusValue > b->_statusValue);
           else
             return (a->_statusValue < b->_statusValue);
         }
-        return (a->_countryCode < b->_countryCode);
+        return (codeA < codeB);
       case RouterListWidget::NameColumn:
         /* Case-insensitive comparison based on router name */
         if (a->name().toLower() == b->name().toLower()) {
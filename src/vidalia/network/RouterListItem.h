@@ -32,33 +32,35 @@ class RouterListItem : public QTreeWidgetItem
   Q_DECLARE_TR_FUNCTIONS(RouterListItem)
 
 public:
-  /** Default constructor. */
-  RouterListItem(RouterListWidget *list, RouterDescriptor rd);
-  /** Destructor. */
-  ~RouterListItem();
+  /** Constructor. Creates an item for the router in row <b>relay</b> of
+   * <b>list</b>'s relay table. */
+  RouterListItem(RouterListWidget *list, int relay);
 
-  /** Updates this router item using a new descriptor. */
-  void update(const RouterDescriptor &rd);
+  /** Updates this router item from its row in the relay table. */
+  void update();
+  /** Returns the router's row in the relay table. */
+  int relay() const { return _relay; }
   /** Returns the router's ID. */
-  QString id() const { return _rd->id(); }
+  QString id() const;
   /** Returns the router's name. */
-  QString name() const { return _rd->name(); }
+  QString name() const;
   /** Returns the descriptor for this router. */
-  RouterDescriptor descriptor() const { return *_rd; }
+  RouterDescriptor descriptor() const;
   /** Sets the location information for this router item. */
   void setLocation(const GeoIpRecord &geoip);
   /** Returns the location information set for this router item. */
-  GeoIpRecord location() const { return _location; }
+  GeoIpRecord location() const;
 
   /** Overload the comparison operator. */
   virtual bool operator<(const QTreeWidgetItem &other) const;
 
 private:
-  RouterDescriptor* _rd;   /**< Descriptor for this router item. */
+  /** Returns the relay table holding this item's router. */
+  RelayTable* relays() const { return _list->relays(); }
+
   RouterListWidget* _list; /**< The list for this list item. */
+  int _relay;              /**< Row of this router in the relay table. */
   qint64 _statusValue;     /**< Value used to sort items by status. */
-  GeoIpRecord _location;   /**< Location information for this router. */
-  QString _countryCode;
 };
 
 #endif
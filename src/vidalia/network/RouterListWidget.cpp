@@ -27,6 +27,8 @@
 RouterListWidget::RouterListWidget(QWidget *parent)
   : QTreeWidget(parent)
 {
+  _relays = 0;
+
   /* Create and initialize columns */
   setHeaderLabels(QStringList() << QString("")
                                 << QString("")
@@ -147,7 +149,7 @@ RouterListWidget::deselectAll()
 void
 RouterListWidget::clearRouters()
 {
-  _idmap.clear();
+  _items.clear();
   QTreeWidget::clear();
   setStatusTip(tr("%1 relays online").arg(0));
 }
@@ -193,27 +195,37 @@ RouterListWidget::keyPressEvent(QKeyEvent *event)
 RouterListItem*
 RouterListWidget::findRouterById(QString id)
 {
-  if (_idmap.contains(id)) {
-    return _idmap.value(id);
-  }
-  return 0;
+  if (!_relays)
+    return 0;
+  return findRouter(_relays->indexOf(id));
+}
+
+/** Finds the list item for the router in row <b>relay</b> of the relay
+ * table. Returns 0 if not found. */
+RouterListItem*
+RouterListWidget::findRouter(int relay) const
+{
+  if (relay < 0 || relay >= _items.size())
+    return 0;
+  return _items.at(relay);
 }
 
-/** Adds a router descriptor to the list. */
+/** Adds the router in row <b>relay</b> of the relay table to the list. */
 RouterListItem*
-RouterListWidget::addRouter(const RouterDescriptor &rd)
+RouterListWidget::addRouter(int relay)
 {
-  QString id = rd.id();
-  if (id.isEmpty())
+  if (!_relays || !_relays->contains(relay))
     return 0;
 
-  RouterListItem *item = findRouterById(id);
+  RouterListItem *item = findRouter(relay);
   if (item) {
-    item->update(rd);
+    item->update();
   } else {
-    item = new RouterListItem(this, rd);
+    item = new RouterListItem(this, relay);
     addTopLevelItem(item);
-    _idmap.insert(id, item);
+    if (relay >= _items.size())
+      _items.resize(relay+1);
+    _items[relay] = item;
   }
 
   /* Set our status tip to the number of servers in the list */
@@ -222,6 +234,21 @@ RouterListWidget::addRouter(const RouterDescriptor &rd)
   return item;
 }
 
+/** Removes the router in row <b>relay</b> of the relay table from the
+ * list. */
+void
+RouterListWidget::removeRouter(int relay)
+{
+  RouterListItem *item = findRouter(relay);
+  if (! item)
+    return;
+  _items[relay] = 0;
+  /* Deleting the item also removes it from the list */
+  delete item;
+
+  setStatusTip(tr("%1 relays online").arg(topLevelItemCount()));
+}
+
 /** Called when the selected items have changed. This emits the 
  * routerSelected() signal with the descriptor for the selected router.
  */
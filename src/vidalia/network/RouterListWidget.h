@@ -17,9 +17,11 @@
 #define _ROUTERLISTWIDGET_H
 
 #include "RouterDescriptor.h"
+#include "RelayTable.h"
 
-#include <QHash>
 #include <QList>
+#include <QVector>
+#include <QStringList>
 #include <QMenu>
 #include <QObject>
 #include <QAction>
@@ -45,8 +47,20 @@ public:
   /** Default constructor. */
   RouterListWidget(QWidget *parent = 0);
 
-  /** Adds a new descriptor the list. */
-  RouterListItem* addRouter(const RouterDescriptor &rd);
+  /** Sets the table holding the routers shown in the list. */
+  void setRelayTable(RelayTable *relays) { _relays = relays; }
+  /** Returns the table holding the routers shown in the list. */
+  RelayTable* relays() const { return _relays; }
+
+  /** Adds the router in row <b>relay</b> of the relay table to the list, or
+   * updates its item if it is already listed. */
+  RouterListItem* addRouter(int relay);
+  /** Removes the router in row <b>relay</b> of the relay table from the
+   * list. */
+  void removeRouter(int relay);
+  /** Finds the list item for the router in row <b>relay</b> of the relay
+   * table. Returns 0 if not found. */
+  RouterListItem* findRouter(int relay) const;
   /** Finds the list item whose key ID matches <b>id</b>. Returns 0 if not 
    * found. */
   RouterListItem* findRouterById(QString id);
@@ -88,8 +102,10 @@ protected:
   virtual void contextMenuEvent(QContextMenuEvent *event);
 
 private:
-  /** Maps a server ID to that server's list item. */
-  QHash<QString,RouterListItem*> _idmap;
+  /** Table holding the routers shown in the list. */
+  RelayTable *_relays;
+  /** List item for each row of the relay table, or 0 for unlisted rows. */
+  QVector<RouterListItem*> _items;
 };
 
 #endif
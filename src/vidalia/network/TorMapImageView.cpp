@@ -30,6 +30,8 @@
 #define PEN_ROUTER        QPen(QColor("#ff030d"), 1.0)
 #define PEN_CIRCUIT       QPen(Qt::yellow, 0.5)
 #define PEN_SELECTED      QPen(Qt::green, 2.0)
+/** Half the width of the widest pen above */
+#define PEN_MARGIN        1.0
 
 /** Size of the map image */
 #define IMG_WIDTH       1000
@@ -49,6 +51,25 @@
 /** Minimum allowable size for this widget */
 #define MIN_SIZE        QSize(512,256)
 
+/** Size, in map pixels, of the cells of the grid routers are indexed in */
+#define GRID_CELL       8
+#define GRID_COLUMNS    ((IMG_WIDTH+GRID_CELL-1)/GRID_CELL)
+#define GRID_ROWS       ((IMG_HEIGHT+GRID_CELL-1)/GRID_CELL)
+
+/** Approximate size, in screen pixels, of the area merged into a cluster */
+#define CLUSTER_SIZE            16
+/** Blocks with at least this many routers are drawn as a cluster */
+#define CLUSTER_MIN_ROUTERS     4
+/** Smallest and largest radius of a cluster marker, in screen pixels */
+#define CLUSTER_MIN_RADIUS      3.0
+#define CLUSTER_MAX_RADIUS      12.0
+/** QPen and QBrush used to draw clusters */
+#define PEN_CLUSTER     QPen(QColor("#ff030d"), 0)
+#define BRUSH_CLUSTER   QBrush(QColor(255, 3, 13, 96))
+
+/** Distance, in screen pixels, within which a click selects a router */
+#define HIT_RADIUS      4.0
+
 /** Robinson projection table */
 /** Length of the parallel of latitude */
 static float  plen[] = {
@@ -72,6 +93,8 @@ static float  pdfe[] = {
 TorMapImageView::TorMapImageView(QWidget *parent)
 : ZImageView(parent)
 {
+  _relays = 0;
+  _grid.resize(GRID_COLUMNS * GRID_ROWS);
   QImage map(IMG_WORLD_MAP);
   setImage(map);
 }
@@ -82,18 +105,151 @@ TorMapImageView::~TorMapImageView()
   clear();
 }
 
-/** Adds a router to the map. */
+/** Adds the router in row <b>relay</b> of the relay table to the map. */
 void
-TorMapImageView::addRouter(const RouterDescriptor &desc, const GeoIpRecord &geoip)
+TorMapImageView::addRouter(int relay, const GeoIpRecord &geoip)
 {
-  QString id = desc.id();
-  QPointF routerCoord = toMapSpace(geoip.latitude(), geoip.longitude());
-  
-  /* Add data the hash of known routers, and plot the point on the map */
-  if (_routers.contains(id))
-    _routers.value(id)->first = routerCoord;
-  else
-    _routers.insert(id, new QPair<QPointF,bool>(routerCoord, false));
+  if (relay < 0)
+    return;
+  if (relay >= _routerPoints.size()) {
+    _routerPoints.resize(relay+1);
+    _routerFlags.resize(relay+1);
+  }
+
+  /* Move the router to the grid cell of its new location */
+  QPointF point = toMapSpace(geoip.latitude(), geoip.longitude());
+  int cell = cellIndex(point);
+  if (_routerFlags.at(relay) & RouterPlotted) {
+    int oldCell = cellIndex(_routerPoints.at(relay));
+    if (oldCell == cell) {
+      _routerPoints[relay] = point;
+      return;
+    }
+    QVector<int> &routers = _grid[oldCell];
+    routers.remove(routers.indexOf(relay));
+  }
+  _grid[cell].append(relay);
+
+  /* Plot the point on the map, keeping the router selected if it was */
+  _routerPoints[relay] = point;
+  _routerFlags[relay] |= RouterPlotted;
+}
+
+/** Removes the router in row <b>relay</b> of the relay table from the
+ * map. */
+void
+TorMapImageView::removeRouter(int relay)
+{
+  if (relay < 0 || relay >= _routerFlags.size()
+        || !(_routerFlags.at(relay) & RouterPlotted))
+    return;
+
+  QVector<int> &routers = _grid[cellIndex(_routerPoints.at(relay))];
+  routers.remove(routers.indexOf(relay));
+  _routerFlags[relay] = 0;
+}
+
+/** Returns the index in _grid of the cell holding <b>point</b>. Points
+ * off the edge of the map go in the nearest cell. */
+int
+TorMapImageView::cellIndex(const QPointF &point) const
+{
+  int x = qBound(0, int(point.x()) / GRID_CELL, GRID_COLUMNS-1);
+  int y = qBound(0, int(point.y()) / GRID_CELL, GRID_ROWS-1);
+  return y * GRID_COLUMNS + x;
+}
+
+/** Returns the relay table row of the plotted router nearest to
+ * <b>point</b>, looking only in the grid cells within <b>radius</b> of it.
+ * Returns -1 if no router is within <b>radius</b>. */
+int
+TorMapImageView::routerNear(const QPointF &point, qreal radius) const
+{
+  int left   = qMax(0, int(point.x() - radius) / GRID_CELL);
+  int right  = qMin(GRID_COLUMNS-1, int(point.x() + radius) / GRID_CELL);
+  int top    = qMax(0, int(point.y() - radius) / GRID_CELL);
+  int bottom = qMin(GRID_ROWS-1, int(point.y() + radius) / GRID_CELL);
+  qreal best = radius * radius;
+  int nearest = -1;
+
+  for (int y = top; y <= bottom; y++) {
+    for (int x = left; x <= right; x++) {
+      const QVector<int> &routers = _grid.at(y * GRID_COLUMNS + x);
+      for (int i = 0; i < routers.size(); i++) {
+        QPointF d = _routerPoints.at(routers.at(i)) - point;
+        qreal distance = d.x() * d.x() + d.y() * d.y();
+        if (distance <= best) {
+          best = distance;
+          nearest = routers.at(i);
+        }
+      }
+    }
+  }
+  return nearest;
+}
+
+/** Returns the number of grid cells along each side of a cluster, so that
+ * it covers about CLUSTER_SIZE pixels on screen when the map is scaled by
+ * <b>scale</b>. */
+int
+TorMapImageView::clusterSpan(double scale)
+{
+  return qMax(1, qRound(CLUSTER_SIZE / (scale * GRID_CELL)));
+}
+
+/** Returns the radius of the marker of a cluster of routers with a total
+ * bandwidth of <b>bandwidth</b> bytes per second. The radius grows with the
+ * logarithm of the bandwidth, so the largest clusters don't hide the map. */
+qreal
+TorMapImageView::clusterRadius(quint64 bandwidth)
+{
+  qreal mbytes = qreal(bandwidth) / (1024.0 * 1024.0);
+  qreal radius = CLUSTER_MIN_RADIUS + 1.5 * (log(1.0 + mbytes) / log(2.0));
+  return qMin(radius, qreal(CLUSTER_MAX_RADIUS));
+}
+
+/** Gathers the plotted routers in the <b>span</b> by <b>span</b> block of
+ * grid cells at (<b>bx</b>, <b>by</b>) into <b>routers</b>, and returns
+ * their cluster. */
+TorMapImageView::RouterCluster
+TorMapImageView::cluster(int bx, int by, int span,
+                         QVector<int> *routers) const
+{
+  RouterCluster cluster;
+  qreal x = 0.0, y = 0.0;
+
+  routers->clear();
+  cluster.bandwidth = 0;
+  for (int cy = by * span; cy < qMin((by+1) * span, int(GRID_ROWS)); cy++) {
+    for (int cx = bx * span; cx < qMin((bx+1) * span, int(GRID_COLUMNS));
+         cx++) {
+      const QVector<int> &cell = _grid.at(cy * GRID_COLUMNS + cx);
+      for (int i = 0; i < cell.size(); i++) {
+        int relay = cell.at(i);
+        x += _routerPoints.at(relay).x();
+        y += _routerPoints.at(relay).y();
+        if (_relays)
+          cluster.bandwidth += _relays->bandwidth(relay);
+        routers->append(relay);
+      }
+    }
+  }
+  cluster.count = routers->size();
+  if (cluster.count)
+    cluster.center = QPointF(x / cluster.count, y / cluster.count);
+  return cluster;
+}
+
+/** Returns the relay table row of the plotted router whose key ID matches
+ * <b>id</b>, or -1 if it is not on the map. */
+int
+TorMapImageView::plottedRouter(const QString &id) const
+{
+  int relay = (_relays ? _relays->indexOf(id) : -1);
+  if (relay < 0 || relay >= _routerFlags.size()
+        || !(_routerFlags.at(relay) & RouterPlotted))
+    return -1;
+  return relay;
 }
 
 /** Adds a circuit to the map using the given ordered list of router IDs. */
@@ -104,14 +260,14 @@ TorMapImageView::addCircuit(const CircuitId &circid, const QStringList &path)
   
   /* Build the new circuit */
   for (int i = 0; i < path.size()-1; i++) {
-    QString fromNode = path.at(i);
-    QString toNode = path.at(i+1);
+    int fromNode = plottedRouter(path.at(i));
+    int toNode = plottedRouter(path.at(i+1));
    
     /* Add the coordinates of the hops to the circuit */
-    if (_routers.contains(fromNode) && _routers.contains(toNode)) {
+    if (fromNode >= 0 && toNode >= 0) {
       /* Find the two endpoints for this path segment */
-      QPointF fromPos = _routers.value(fromNode)->first;
-      QPointF endPos = _routers.value(toNode)->first;
+      QPointF fromPos = _routerPoints.at(fromNode);
+      QPointF endPos = _routerPoints.at(toNode);
       
       /* Draw the path segment */ 
       circPainterPath->moveTo(fromPos);
@@ -121,10 +277,12 @@ TorMapImageView::addCircuit(const CircuitId &circid, const QStringList &path)
   }
   
   /** Add the data to the hash of known circuits and plot the circuit on the map */
+  updatePath(*circPainterPath);
   if (_circuits.contains(circid)) {
     /* This circuit is being updated, so just update the path, making sure we
      * free the memory allocated to the old one. */
     QPair<QPainterPath*,bool> *circuitPair = _circuits.value(circid);
+    updatePath(*circuitPair->first);
     delete circuitPair->first;
     circuitPair->first = circPainterPath;
   } else {
@@ -138,8 +296,11 @@ void
 TorMapImageView::removeCircuit(const CircuitId &circid)
 {
   QPair<QPainterPath*,bool> *circ = _circuits.take(circid);
+  if (!circ)
+    return;
   QPainterPath *circpath = circ->first;
   if (circpath) {
+    updatePath(*circpath);
     delete circpath;
   }
   delete circ;
@@ -149,11 +310,11 @@ TorMapImageView::removeCircuit(const CircuitId &circid)
 void
 TorMapImageView::selectRouter(const QString &id)
 {
-  if (_routers.contains(id)) {
-    QPair<QPointF, bool> *routerPair = _routers.value(id);
-    routerPair->second = true;
+  int relay = plottedRouter(id);
+  if (relay >= 0) {
+    _routerFlags[relay] |= RouterSelected;
+    updateRouter(relay);
   }
-  repaint();
 }
 
 /** Selects and highlights the circuit with the id <b>circid</b> 
@@ -164,8 +325,8 @@ TorMapImageView::selectCircuit(const CircuitId &circid)
   if (_circuits.contains(circid)) {
     QPair<QPainterPath*, bool> *circuitPair = _circuits.value(circid);
     circuitPair->second = true;
+    updatePath(*circuitPair->first);
   }
-  repaint();
 }
 
 /** Deselects any highlighted routers or circuits */
@@ -173,14 +334,39 @@ void
 TorMapImageView::deselectAll()
 {
   /* Deselect all router points */
-  foreach (QString router, _routers.keys()) {
-    QPair<QPointF,bool> *routerPair = _routers.value(router);
-    routerPair->second = false;
+  for (int i = 0; i < _routerFlags.size(); i++) {
+    if (_routerFlags.at(i) & RouterSelected) {
+      _routerFlags[i] &= ~RouterSelected;
+      updateRouter(i);
+    }
   }
   /* Deselect all circuit paths */
   foreach (CircuitId circid, _circuits.keys()) {
     QPair<QPainterPath*,bool> *circuitPair = _circuits.value(circid);
-    circuitPair->second = false;
+    if (circuitPair->second) {
+      circuitPair->second = false;
+      updatePath(*circuitPair->first);
+    }
+  }
+}
+
+/** Repaints the part of the map under the router in row <b>relay</b>. */
+void
+TorMapImageView::updateRouter(int relay)
+{
+  QPointF point = _routerPoints.at(relay);
+  updateImageRect(QRectF(point.x() - PEN_MARGIN, point.y() - PEN_MARGIN,
+                         2*PEN_MARGIN, 2*PEN_MARGIN));
+}
+
+/** Repaints the part of the map under <b>path</b>, including the width of
+ * the pen it is drawn with. */
+void
+TorMapImageView::updatePath(const QPainterPath &path)
+{
+  if (!path.isEmpty()) {
+    updateImageRect(path.boundingRect().adjusted(-PEN_MARGIN, -PEN_MARGIN,
+                                                 PEN_MARGIN, PEN_MARGIN));
   }
 }
 
@@ -188,10 +374,11 @@ TorMapImageView::deselectAll()
 void
 TorMapImageView::clear()
 {
-  /* Clear out all the router points and free their memory */
-  foreach (QString router, _routers.keys()) {
-    delete _routers.take(router);
-  }
+  /* Clear out all the router points */
+  _routerPoints.clear();
+  _routerFlags.clear();
+  for (int i = 0; i < _grid.size(); i++)
+    _grid[i].clear();
   /* Clear out all the circuit paths and free their memory */
   foreach (CircuitId circid, _circuits.keys()) {
     QPair<QPainterPath*,bool> *circuitPair = _circuits.take(circid);
@@ -200,26 +387,119 @@ TorMapImageView::clear()
   }
 }
   
-/** Draws the routers and paths onto the map image. */
+/** Draws the routers and paths within <b>rect</b> over the map. The
+ * painter is already transformed to map coordinates. Only the grid cells
+ * near <b>rect</b> are visited. Blocks of cells holding many routers are
+ * drawn as a single marker sized by the routers' total bandwidth, and the
+ * remaining routers are drawn with one drawPoints() call per pen. */
 void
-TorMapImageView::paintImage(QPainter *painter)
+TorMapImageView::paintImage(QPainter *painter, const QRectF &rect)
 {
+  double scale = scaleFactor();
+  int span = clusterSpan(scale);
+  int blockSize = span * GRID_CELL;
+  /* Cluster markers can reach beyond their block */
+  qreal margin = CLUSTER_MAX_RADIUS / scale;
+  int left   = qMax(0, int(rect.left() - margin) / blockSize);
+  int right  = qMin((GRID_COLUMNS-1) / span,
+                    int(rect.right() + margin) / blockSize);
+  int top    = qMax(0, int(rect.top() - margin) / blockSize);
+  int bottom = qMin((GRID_ROWS-1) / span,
+                    int(rect.bottom() + margin) / blockSize);
+  QRectF bounds = rect.adjusted(-PEN_MARGIN, -PEN_MARGIN,
+                                PEN_MARGIN, PEN_MARGIN);
+  QVector<QPointF> points, selectedPoints;
+  QVector<int> routers;
+
   painter->setRenderHint(QPainter::Antialiasing);
-  
-  /* Draw the router points */
-  foreach(QString router, _routers.keys()) {
-    QPair<QPointF,bool> *routerPair = _routers.value(router);
-    painter->setPen((routerPair->second ? PEN_SELECTED : PEN_ROUTER)); 
-    painter->drawPoint(routerPair->first);
+
+  /* Draw the clusters, and collect the routers drawn on their own */
+  painter->setPen(PEN_CLUSTER);
+  painter->setBrush(BRUSH_CLUSTER);
+  for (int by = top; by <= bottom; by++) {
+    for (int bx = left; bx <= right; bx++) {
+      RouterCluster c = cluster(bx, by, span, &routers);
+      bool clustered = (c.count >= CLUSTER_MIN_ROUTERS);
+      if (clustered) {
+        qreal radius = clusterRadius(c.bandwidth) / scale;
+        painter->drawEllipse(QRectF(c.center.x() - radius,
+                                    c.center.y() - radius,
+                                    2*radius, 2*radius));
+      }
+      for (int i = 0; i < routers.size(); i++) {
+        QPointF point = _routerPoints.at(routers.at(i));
+        if (!bounds.contains(point))
+          continue;
+        /* Selected routers are always drawn on their own, over the rest */
+        if (_routerFlags.at(routers.at(i)) & RouterSelected)
+          selectedPoints << point;
+        else if (!clustered)
+          points << point;
+      }
+    }
   }
+  painter->setBrush(Qt::NoBrush);
+
+  /* Draw the router points */
+  painter->setPen(PEN_ROUTER);
+  painter->drawPoints(points.constData(), points.size());
+  painter->setPen(PEN_SELECTED);
+  painter->drawPoints(selectedPoints.constData(), selectedPoints.size());
+
   /* Draw the circuit paths */
-  foreach(CircuitId circid, _circuits.keys()) {
-    QPair<QPainterPath*,bool> *circuitPair = _circuits.value(circid);
-    painter->setPen((circuitPair->second ? PEN_SELECTED : PEN_CIRCUIT));
+  QPen circuitPen = PEN_CIRCUIT;
+  QPen selectedPen = PEN_SELECTED;
+  QHashIterator<CircuitId, QPair<QPainterPath*,bool>* > it(_circuits);
+  while (it.hasNext()) {
+    QPair<QPainterPath*,bool> *circuitPair = it.next().value();
+    QRectF pathRect = circuitPair->first->boundingRect();
+    if (!rect.intersects(pathRect.adjusted(-PEN_MARGIN, -PEN_MARGIN,
+                                           PEN_MARGIN, PEN_MARGIN)))
+      continue;
+    painter->setPen((circuitPair->second ? selectedPen : circuitPen));
     painter->drawPath(*(circuitPair->first));
   }
 }
 
+/** Called when the user clicks on the map at <b>pos</b>. Clicking on a
+ * cluster zooms in on it, until the routers in it can be told apart or the
+ * map can't be zoomed any further. Clicking on a router emits
+ * displayRouterInfo() with its fingerprint. */
+void
+TorMapImageView::imageClicked(const QPoint &pos)
+{
+  double scale = scaleFactor();
+  QPointF point = mapToImage(pos);
+
+  if (zoomLevel() < 1.0) {
+    int span = clusterSpan(scale);
+    int blockSize = span * GRID_CELL;
+    int bx = int(point.x()) / blockSize;
+    int by = int(point.y()) / blockSize;
+    QVector<int> routers;
+
+    /* A cluster's marker may reach into the blocks next to it */
+    for (int y = qMax(0, by-1); y <= qMin((GRID_ROWS-1) / span, by+1); y++) {
+      for (int x = qMax(0, bx-1); x <= qMin((GRID_COLUMNS-1) / span, bx+1);
+           x++) {
+        RouterCluster c = cluster(x, y, span, &routers);
+        if (c.count < CLUSTER_MIN_ROUTERS)
+          continue;
+        QPointF d = c.center - point;
+        qreal radius = clusterRadius(c.bandwidth) / scale;
+        if (d.x() * d.x() + d.y() * d.y() <= radius * radius) {
+          zoom(c.center.toPoint(), zoomLevel() + 0.3);
+          return;
+        }
+      }
+    }
+  }
+
+  int relay = routerNear(point, HIT_RADIUS / scale);
+  if (relay >= 0 && _relays)
+    emit displayRouterInfo(_relays->id(relay));
+}
+
 /** Converts world space coordinates into map space coordinates */
 QPointF
 TorMapImageView::toMapSpace(float latitude, float longitude)
@@ -304,13 +584,13 @@ TorMapImageView::zoomToCircuit(const CircuitId &circid)
 void
 TorMapImageView::zoomToRouter(const QString &id)
 {
-  QPair<QPointF,bool> *routerPair;
+  int relay = plottedRouter(id);
   
-  if (_routers.contains(id)) {
+  if (relay >= 0) {
     deselectAll();
-    routerPair = _routers.value(id);
-    routerPair->second = true;  /* Set the router point to "selected" */
-    zoom(routerPair->first.toPoint(), 1.0); 
+    _routerFlags[relay] |= RouterSelected; /* Set the router point to
+                                              "selected" */
+    zoom(_routerPoints.at(relay).toPoint(), 1.0); 
   }
 }
 
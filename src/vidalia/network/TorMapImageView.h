@@ -19,11 +19,12 @@
 #include "ZImageView.h"
 #include "GeoIpRecord.h"
 
-#include "RouterDescriptor.h"
+#include "RelayTable.h"
 #include "Circuit.h"
 
 #include <QHash>
 #include <QPair>
+#include <QVector>
 #include <QPainter>
 #include <QPainterPath>
 
@@ -38,8 +39,14 @@ public:
   /** Destructor. */
   ~TorMapImageView();
 
-  /** Plots the given router on the map using the given coordinates. */
-  void addRouter(const RouterDescriptor &desc, const GeoIpRecord &geoip);
+  /** Sets the table holding the routers plotted on the map. */
+  void setRelayTable(const RelayTable *relays) { _relays = relays; }
+  /** Plots the router in row <b>relay</b> of the relay table on the map
+   * using the given coordinates. */
+  void addRouter(int relay, const GeoIpRecord &geoip);
+  /** Removes the router in row <b>relay</b> of the relay table from the
+   * map. */
+  void removeRouter(int relay);
   /** Plots the given circuit on the map. */
   void addCircuit(const CircuitId &circid, const QStringList &path);
   /** Selects and hightlights a router on the map. */
@@ -63,9 +70,17 @@ public slots:
   /** Zoom to the circuit on the map with the given <b>circid</b>. */
   void zoomToCircuit(const CircuitId &circid);
 
+signals:
+  /** Emitted when the user clicks on a router on the map. <b>id</b>
+   * contains the router's fingerprint. */
+  void displayRouterInfo(const QString &id);
+
 protected:
-  /** Paints the current circuits and streams on the image. */
-  virtual void paintImage(QPainter *painter);
+  /** Paints the routers and circuits within <b>rect</b> over the map. */
+  virtual void paintImage(QPainter *painter, const QRectF &rect);
+  /** Zooms in on the cluster of routers at <b>pos</b>, or emits
+   * displayRouterInfo() for the router there. */
+  virtual void imageClicked(const QPoint &pos);
 
 private:
   /** Converts world space coordinates into map space coordinates */
@@ -75,9 +90,51 @@ private:
   /** Computes a bounding box around all currently displayed circuit paths on
    * the map. */
   QRectF circuitBoundingBox();
-  
-  /** Stores map locations for tor routers */
-  QHash<QString, QPair<QPointF,bool>* > _routers;
+  /** Returns the relay table row of the plotted router whose key ID matches
+   * <b>id</b>, or -1 if it is not on the map. */
+  int plottedRouter(const QString &id) const;
+  /** Repaints the part of the map under the router in row <b>relay</b>. */
+  void updateRouter(int relay);
+  /** Returns the index in _grid of the cell holding <b>point</b>. */
+  int cellIndex(const QPointF &point) const;
+  /** Returns the relay table row of the plotted router nearest to
+   * <b>point</b>, if it is no more than <b>radius</b> away, or -1. */
+  int routerNear(const QPointF &point, qreal radius) const;
+
+  /** A block of grid cells whose routers are drawn as one marker. */
+  struct RouterCluster {
+    QPointF center;     /**< Average location of the routers. */
+    quint64 bandwidth;  /**< Total bandwidth of the routers. */
+    int count;          /**< Number of routers. */
+  };
+  /** Returns the number of grid cells along each side of the blocks that
+   * are merged into clusters when the map is scaled by <b>scale</b>. */
+  static int clusterSpan(double scale);
+  /** Returns the radius, in pixels, of the marker of a cluster whose
+   * routers have a total bandwidth of <b>bandwidth</b>. */
+  static qreal clusterRadius(quint64 bandwidth);
+  /** Gathers the plotted routers in the <b>span</b> by <b>span</b> block of
+   * grid cells at (<b>bx</b>, <b>by</b>) into <b>routers</b>, and returns
+   * their cluster. */
+  RouterCluster cluster(int bx, int by, int span, QVector<int> *routers) const;
+  /** Repaints the part of the map under <b>path</b>. */
+  void updatePath(const QPainterPath &path);
+
+  /** Flags stored for each row of the relay table. */
+  enum RouterFlag {
+    RouterPlotted  = 0x01, /**< The router is on the map. */
+    RouterSelected = 0x02  /**< The router is highlighted. */
+  };
+
+  /** Table holding the routers plotted on the map. */
+  const RelayTable *_relays;
+  /** Map location of each row of the relay table. */
+  QVector<QPointF> _routerPoints;
+  /** RouterFlag values for each row of the relay table. */
+  QVector<quint8> _routerFlags;
+  /** Relay table rows of the plotted routers in each cell of a grid laid
+   * over the map, row by row. */
+  QVector<QVector<int> > _grid;
   /** Stores circuit information */
   QHash<CircuitId, QPair<QPainterPath *,bool>* > _circuits;
 };
@@ -22,6 +22,7 @@
 #include <HttpDownloadManager.h>
 
 #include <QStringList>
+#include <QTextDocument>
 
 using namespace Marble;
 
@@ -29,11 +30,24 @@ using namespace Marble;
 #define CIRCUIT_NORMAL_PEN      QPen(Qt::blue,  2.0)
 #define CIRCUIT_SELECTED_PEN    QPen(Qt::green, 3.0)
 
+/** Maximum number of routers in each KML document given to Marble. Removing
+ * a router means adding the others in its document again, so they are kept
+ * fairly small. */
+#define PLACEMARK_BATCH_SIZE    256
+/** Key under which the placemark document numbered <b>n</b> is added. */
+#define PLACEMARK_BATCH_KEY(n)  QString("relays-%1").arg(n)
+
 
 /** Default constructor */
 TorMapWidget::TorMapWidget(QWidget *parent)
   : MarbleWidget(parent)
 {
+  _relays = 0;
+  _nextBatch = 0;
+  _flushTimer.setSingleShot(true);
+  _flushTimer.setInterval(0);
+  connect(&_flushTimer, SIGNAL(timeout()), this, SLOT(flushRouters()));
+
   setMapThemeId("earth/srtm/srtm.dgml");
   setShowScaleBar(false);
   setShowCrosshairs(false);
@@ -66,44 +80,126 @@ TorMapWidget::~TorMapWidget()
   clear();
 }
 
-/** Adds a router to the map. */
+/** Returns the relay table row of the router whose key ID matches
+ * <b>id</b>, or -1 if it is not in the table. */
+int
+TorMapWidget::relayIndex(const QString &id) const
+{
+  return (_relays ? _relays->indexOf(id) : -1);
+}
+
+/** Queues the router in row <b>relay</b> of the relay table to be added to
+ * the map. Routers are added in batches, each as one KML document, rather
+ * than one document per router. If the router is already on the map, the
+ * document holding it is replaced. */
+void
+TorMapWidget::addRouter(int relay, const GeoIpRecord &geoip)
+{
+  if (!_relays || !_relays->contains(relay))
+    return;
+
+  if (_routerBatches.contains(relay))
+    unbatchRouter(relay);
+  _routers.insert(relay, GeoDataCoordinates(geoip.longitude(),
+                                            geoip.latitude(), 0.0,
+                                            GeoDataCoordinates::Degree));
+  _pendingRouters.insert(relay);
+  _flushTimer.start();
+}
+
+/** Removes the placemark for the router in row <b>relay</b> of the relay
+ * table from the map. The other routers in the same document are added
+ * again in the next batch. */
+void
+TorMapWidget::removeRouter(int relay)
+{
+  if (!_routers.remove(relay))
+    return;
+  if (!_pendingRouters.remove(relay))
+    unbatchRouter(relay);
+}
+
+/** Removes the placemark document holding the router in row <b>relay</b>
+ * and queues the other routers in it to be added again. */
 void
-TorMapWidget::addRouter(const RouterDescriptor &desc, const GeoIpRecord &geoip)
+TorMapWidget::unbatchRouter(int relay)
 {
+  int batch = _routerBatches.take(relay);
+  removePlacemarkKey(PLACEMARK_BATCH_KEY(batch));
+
+  foreach (int other, _batches.take(batch)) {
+    if (other != relay) {
+      _routerBatches.remove(other);
+      _pendingRouters.insert(other);
+    }
+  }
+  _flushTimer.start();
+}
+
+/** Returns the KML placemark for the router in row <b>relay</b>. Its
+ * fingerprint goes in the description, where TorMapWidgetPopupMenu looks for
+ * it. */
+QString
+TorMapWidget::placemark(int relay) const
+{
+  GeoIpRecord geoip = _relays->location(relay);
+  qreal lon, lat;
+  _routers.value(relay).geoCoordinates(lon, lat, GeoDataCoordinates::Degree);
+
   QString kml;
-  qreal lon = geoip.longitude();
-  qreal lat = geoip.latitude();
-  quint64 bw;
-  
-  bw = qMin(desc.averageBandwidth(), desc.burstBandwidth());
-  bw = qMin(bw, desc.observedBandwidth());
-
-  kml.append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
-             "<kml xmlns=\"http://earth.google.com/kml/2.0\">"
-             "<Document>"
-             "  <Style id=\"normalPlacemark\">"
-             "    <IconStyle><Icon><href>:/images/icons/placemark-relay.png</href></Icon></IconStyle>"
-             "  </Style>"
-             );
 
   kml.append("<Placemark>");
   kml.append("<styleUrl>#normalPlacemark</styleUrl>");
-  kml.append(QString("<name>%1</name>").arg(desc.name()));
-  kml.append(QString("<description>%1</description>").arg(desc.id()));
+  kml.append(QString("<name>%1</name>").arg(Qt::escape(_relays->name(relay))));
+  kml.append(QString("<description>%1</description>").arg(_relays->id(relay)));
   kml.append(QString("<role>1</role>"));
-  kml.append(QString("<address>%1</address>").arg(geoip.toString()));
-  kml.append(QString("<CountryNameCode>%1</CountryNameCode>").arg(geoip.country()));
-  kml.append(QString("<pop>%1</pop>").arg(10 * bw));
+  kml.append(QString("<address>%1</address>")
+               .arg(Qt::escape(geoip.toString())));
+  kml.append(QString("<CountryNameCode>%1</CountryNameCode>")
+               .arg(Qt::escape(geoip.country())));
+  kml.append(QString("<pop>%1</pop>")
+               .arg(10 * quint64(_relays->bandwidth(relay))));
   kml.append(QString("<Point>"
                      "  <coordinates>%1,%2</coordinates>"
                      "</Point>").arg(lon).arg(lat));
   kml.append("</Placemark>");
-  kml.append("</Document></kml>");
+  return kml;
+}
 
-  QString id = desc.id();
-  addPlacemarkData(kml, id);
-  _routers.insert(id, GeoDataCoordinates(lon, lat, 0.0,
-                                         GeoDataCoordinates::Degree));
+/** Adds every queued router to the map, in KML documents of up to
+ * PLACEMARK_BATCH_SIZE routers, so Marble parses a few documents instead of
+ * one per router. */
+void
+TorMapWidget::flushRouters()
+{
+  _flushTimer.stop();
+  if (_pendingRouters.isEmpty())
+    return;
+
+  QList<int> routers = _pendingRouters.toList();
+  _pendingRouters.clear();
+
+  for (int i = 0; i < routers.size(); i += PLACEMARK_BATCH_SIZE) {
+    QList<int> batch = routers.mid(i, PLACEMARK_BATCH_SIZE);
+    QString kml;
+
+    kml.append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+               "<kml xmlns=\"http://earth.google.com/kml/2.0\">"
+               "<Document>"
+               "  <Style id=\"normalPlacemark\">"
+               "    <IconStyle><Icon><href>:/images/icons/placemark-relay.png"
+               "</href></Icon></IconStyle>"
+               "  </Style>");
+    foreach (int relay, batch) {
+      kml.append(placemark(relay));
+      _routerBatches.insert(relay, _nextBatch);
+    }
+    kml.append("</Document></kml>");
+
+    addPlacemarkData(kml, PLACEMARK_BATCH_KEY(_nextBatch));
+    _batches.insert(_nextBatch, batch);
+    _nextBatch++;
+  }
 }
 
 /** Adds a circuit to the map using the given ordered list of router IDs. */
@@ -124,7 +220,7 @@ TorMapWidget::addCircuit(const CircuitId &circid, const QStringList &path)
     /* Extend an existing path */
     CircuitGeoPath *geoPath = _circuits.value(circid);
 
-    QString router = path.at(path.size()-1);
+    int router = relayIndex(path.at(path.size()-1));
     if (_routers.contains(router))
       geoPath->first.append(_routers.value(router));
   } else {
@@ -132,7 +228,8 @@ TorMapWidget::addCircuit(const CircuitId &circid, const QStringList &path)
     CircuitGeoPath *geoPath = new CircuitGeoPath();
     geoPath->second = false; /* initially unselected */
 
-    foreach (QString router, path) {
+    foreach (QString id, path) {
+      int router = relayIndex(id);
       if (_routers.contains(router))
         geoPath->first.append(_routers.value(router));
     }
@@ -140,7 +237,7 @@ TorMapWidget::addCircuit(const CircuitId &circid, const QStringList &path)
     _circuits.insert(circid, geoPath);
   }
 
-  repaint();
+  update();
 }
 
 /** Removes a circuit from the map. */
@@ -151,7 +248,7 @@ TorMapWidget::removeCircuit(const CircuitId &circid)
   if (path)
     delete path;
 
-  repaint();
+  update();
 }
 
 /** Selects and highlights the router on the map. */
@@ -163,7 +260,7 @@ TorMapWidget::selectRouter(const QString &id)
     QPair<QPointF, bool> *routerPair = _routers.value(id);
     routerPair->second = true;
   }
-  repaint();
+  update();
 #endif
 }
 
@@ -177,7 +274,7 @@ TorMapWidget::selectCircuit(const CircuitId &circid)
     path->second = true;
   }
 
-  repaint();
+  update();
 }
 
 /** Deselects any highlighted routers or circuits */
@@ -196,23 +293,28 @@ TorMapWidget::deselectAll()
     path->second = false;
   }
 
-  repaint();
+  update();
 }
 
 /** Clears the list of routers and removes all the data on the map */
 void
 TorMapWidget::clear()
 {
-  foreach (QString id, _routers.keys()) {
-    removePlacemarkKey(id);
+  foreach (int batch, _batches.keys()) {
+    removePlacemarkKey(PLACEMARK_BATCH_KEY(batch));
   }
+  _batches.clear();
+  _routerBatches.clear();
+  _pendingRouters.clear();
+  _flushTimer.stop();
+  _routers.clear();
 
   foreach (CircuitId circid, _circuits.keys()) {
     CircuitGeoPath *path = _circuits.take(circid);
     delete path;
   }
 
-  repaint();
+  update();
 }
  
 /** Zooms the map to fit entirely within the constraints of the current
@@ -252,9 +354,10 @@ TorMapWidget::zoomToCircuit(const CircuitId &circid)
 void
 TorMapWidget::zoomToRouter(const QString &id)
 {
-  if (_routers.contains(id)) {
+  int relay = relayIndex(id);
+  if (_routers.contains(relay)) {
     qreal lon, lat;
-    GeoDataCoordinates coords = _routers.value(id);
+    GeoDataCoordinates coords = _routers.value(relay);
     coords.geoCoordinates(lon, lat, GeoDataPoint::Degree);
 
     zoomView(maximumZoom());
@@ -16,7 +16,7 @@
 #ifndef _TORMAPWIDGET_H
 #define _TORMAPWIDGET_H
 
-#include "RouterDescriptor.h"
+#include "RelayTable.h"
 #include "GeoIpRecord.h"
 
 #include "Circuit.h"
@@ -28,7 +28,10 @@
 #include <GeoDataLineString.h>
 
 #include <QHash>
+#include <QSet>
+#include <QList>
 #include <QPair>
+#include <QTimer>
 #include <QPainterPath>
 
 typedef QPair<Marble::GeoDataLineString, bool> CircuitGeoPath;
@@ -44,8 +47,14 @@ public:
   /** Destructor. */
   ~TorMapWidget();
 
-  /** Plots the given router on the map using the given coordinates. */
-  void addRouter(const RouterDescriptor &desc, const GeoIpRecord &geoip);
+  /** Sets the table holding the routers plotted on the map. */
+  void setRelayTable(const RelayTable *relays) { _relays = relays; }
+  /** Plots the router in row <b>relay</b> of the relay table on the map
+   * using the given coordinates. */
+  void addRouter(int relay, const GeoIpRecord &geoip);
+  /** Removes the router in row <b>relay</b> of the relay table from the
+   * map. */
+  void removeRouter(int relay);
   /** Plots the given circuit on the map. */
   void addCircuit(const CircuitId &circid, const QStringList &path);
   /** Selects and hightlights a router on the map. */
@@ -54,6 +63,9 @@ public:
   void selectCircuit(const CircuitId &circid);
 
 public slots:
+  /** Adds the routers added since the last call to the map. This happens
+   * by itself once control returns to the event loop. */
+  void flushRouters();
   /** Removes a circuit from the map. */
   void removeCircuit(const CircuitId &circid);
   /** Deselects all the highlighted circuits and routers */
@@ -78,8 +90,33 @@ protected:
   virtual void customPaint(Marble::GeoPainter *painter);
 
 private:
-  /** Stores placemark IDs for Tor routers. */
-  QHash<QString, Marble::GeoDataCoordinates> _routers;
+  /** Returns the relay table row of the router whose key ID matches
+   * <b>id</b>, or -1 if it is not in the table. */
+  int relayIndex(const QString &id) const;
+  /** Removes the placemark document holding the router in row
+   * <b>relay</b> from the map, and queues the other routers in it to be
+   * added again. */
+  void unbatchRouter(int relay);
+  /** Returns the KML placemark for the router in row <b>relay</b>. */
+  QString placemark(int relay) const;
+
+  /** Table holding the routers plotted on the map. */
+  const RelayTable *_relays;
+  /** Stores the coordinates of each plotted router, keyed by its row in the
+   * relay table. Placemarks are added in documents keyed by
+   * PLACEMARK_BATCH_KEY() of their number in _routerBatches. */
+  QHash<int, Marble::GeoDataCoordinates> _routers;
+  /** Routers waiting to be added to the map by flushRouters(). */
+  QSet<int> _pendingRouters;
+  /** Number of the placemark document holding each router on the map. */
+  QHash<int,int> _routerBatches;
+  /** Rows of the routers in each placemark document, by its number. */
+  QHash<int, QList<int> > _batches;
+  /** Number of the next placemark document. */
+  int _nextBatch;
+  /** Timer that calls flushRouters() once control returns to the event
+   * loop. */
+  QTimer _flushTimer;
   /** Stores circuit information */
   QHash<CircuitId, CircuitGeoPath*> _circuits;
 };
@@ -16,7 +16,10 @@
 #include "ZImageView.h"
 
 #include <QPainter>
+#include <QPaintEvent>
 #include <QMouseEvent>
+#include <QRegion>
+#include <QApplication>
 
 #include <cmath>
 
@@ -28,6 +31,13 @@
 #define CURSOR_MOUSE_PRESS      QCursor(Qt::SizeAllCursor)
 #endif
 
+/** Width and height of the tiles the scaled image is cached in. */
+#define TILE_SIZE               256
+/** Mipmaps stop once they would be narrower than this. */
+#define MIN_MIPMAP_WIDTH        128
+/** Color painted around the image. */
+#define BACKGROUND_COLOR        QColor("#fdfdfd")
+
 
 /** Constructor. */
 ZImageView::ZImageView(QWidget *parent)
@@ -39,115 +49,184 @@ ZImageView::ZImageView(QWidget *parent)
   _desiredY = 0.0;
   _maxZoomFactor = 2.0;
   _padding = 60;
+  _tileScale = 0.0;
+  _doubleClicked = false;
+
+  _clickTimer.setSingleShot(true);
+  connect(&_clickTimer, SIGNAL(timeout()), this, SLOT(clickTimeout()));
 
   setCursor(CURSOR_NORMAL);
   updateViewport();
   resetZoomPoint();
-  repaint();
 }
 
-/** Sets the displayed image. */
+/** Sets the displayed image. Copies of the image scaled down by powers of
+ * two are made once here, so that drawing it at any zoom level only needs
+ * to scale the nearest copy by a factor between one and two. */
 void
 ZImageView::setImage(QImage& img)
 {
-  _image = img.copy();
+  QImage mipmap = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+  _mipmaps.clear();
+  _mipmaps << mipmap;
+  while (mipmap.width() / 2 >= MIN_MIPMAP_WIDTH) {
+    mipmap = mipmap.scaled(mipmap.width() / 2, qMax(1, mipmap.height() / 2),
+                           Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    _mipmaps << mipmap;
+  }
+  _imageRect = img.rect();
+  _tiles.clear();
+  _tileScale = 0.0;
+
   updateViewport();
   resetZoomPoint();
 
   if (isVisible()) {
-    repaint();
+    update();
   }
 }
 
-/** Draws the scaled image on the widget. */
-void
-ZImageView::drawScaledImage()
+/** Returns the factor by which the image is scaled in the viewport. The
+ * viewport has the same aspect ratio as the widget, so the vertical and
+ * horizontal scale factors are equal. */
+double
+ZImageView::scaleFactor() const
 {
-  if (!isVisible()) {
-    return;
-  }
-
-  QBrush background(QColor("#fdfdfd"));
-  if (_image.isNull()) {
-    QPainter p(this);
-    p.fillRect(rect(), background);
-    return;
-  }
-
-  QRect sRect = rect();
-  QRect iRect = _image.rect();
-  QRect r = _view;
-
-  // Think of the _view as being overlaid on the image.  The _view has the same
-  // aspect ratio as the screen, so we cut the _view region out of the _image
-  // and scale it to the screen dimensions and paint it.
-
-  // There is a slight catch in that the _view may be larger than the image in 
-  // one or both directions.  In that case, we need to reduce the _view region
-  // to lie within the image, then paint the background around it.  Copying
-  // a region from an image where the region is bigger than the image results
-  // in the parts outside the image being black, which is not what we want.
+  if (_view.width() <= 0)
+    return 1.0;
+  return double(width()) / double(_view.width());
+}
 
-  // The view has the same aspect ratio as the screen, so the vertical and 
-  // horizontal scale factors will be equal.
+/** Returns the position of the top-left corner of the image in the widget,
+ * with the image scaled by <b>scale</b>. It is rounded to whole pixels, so
+ * tiles line up without seams. */
+QPoint
+ZImageView::imageOrigin(double scale) const
+{
+  return QPoint(qRound(-_view.left() * scale), qRound(-_view.top() * scale));
+}
 
-  double scaleFactor = double(sRect.width()) / double(_view.width());
+/** Returns the point of the image shown at <b>pos</b>, in widget
+ * coordinates. */
+QPointF
+ZImageView::mapToImage(const QPoint &pos) const
+{
+  double scale = scaleFactor();
+  return QPointF(pos - imageOrigin(scale)) / scale;
+}
 
-  // Constrain r to lie entirely within the image.
-  if (r.top() < 0) {
-    r.setTop(0);
-  }
-  if (iRect.bottom() < r.bottom()) {
-    r.setBottom(iRect.bottom());
-  }
-  if (r.left() < 0) {
-    r.setLeft(0);
+/** Returns tile (<b>tx</b>, <b>ty</b>) of the image scaled by <b>scale</b>.
+ * If it isn't cached, it is rendered from the smallest mipmap that is still
+ * at least as large as the scaled image. Changing the scale discards every
+ * cached tile. */
+QPixmap
+ZImageView::tile(int tx, int ty, double scale)
+{
+  if (scale != _tileScale) {
+    _tiles.clear();
+    _tileScale = scale;
   }
-  if (iRect.right() < r.right()) {
-    r.setRight(iRect.right());
+  quint32 key = (quint32(tx) << 16) | quint32(ty);
+  QHash<quint32,QPixmap>::const_iterator it = _tiles.constFind(key);
+  if (it != _tiles.constEnd())
+    return it.value();
+
+  /* Find the mipmap to scale from */
+  int level = 0;
+  double levelScale = 1.0;
+  while (level+1 < _mipmaps.size() && levelScale / 2.0 >= scale) {
+    levelScale /= 2.0;
+    level++;
   }
-
-  // Figure out the size that the 'r' region will be when drawn to the screen.
-  QSize scaleTo(int(double(r.width()) * scaleFactor), 
-		int(double(r.height()) * scaleFactor));
-
-  /** Make a copy of the image so we don't ruin the original */
-  QImage i = _image.copy();
-  
-  /** Create a QPainter that draws directly on the copied image and call the
-   * virtual function to draw whatever the subclasses need to on the image. */
-  QPainter painter;
-  painter.begin(&i);
-  paintImage(&painter);
+  const QImage &mipmap = _mipmaps.at(level);
+  double factor = levelScale / scale;
+
+  QImage img(TILE_SIZE, TILE_SIZE, QImage::Format_ARGB32_Premultiplied);
+  img.fill(BACKGROUND_COLOR.rgb());
+  QPainter painter(&img);
+  painter.setRenderHint(QPainter::SmoothPixmapTransform);
+  painter.drawImage(QRectF(0, 0, TILE_SIZE, TILE_SIZE), mipmap,
+                    QRectF(tx * TILE_SIZE * factor, ty * TILE_SIZE * factor,
+                           TILE_SIZE * factor, TILE_SIZE * factor));
   painter.end();
 
-  /** Rescale the image copy */
-  i = i.copy(r).scaled(scaleTo,
-		     Qt::KeepAspectRatioByExpanding,
-		     Qt::SmoothTransformation);
+  QPixmap pixmap = QPixmap::fromImage(img);
+  _tiles.insert(key, pixmap);
+  return pixmap;
+}
 
-  int extraWidth = int(double(sRect.width() - i.width()) / 2.0);
-  int extraHeight = int(double(sRect.height() - i.height()) / 2.0);
+/** Draws the part of the scaled image within <b>exposed</b> on the widget,
+ * followed by whatever subclasses paint over it. The scaled image is drawn
+ * from cached tiles, so panning only renders the tiles that scroll into
+ * view and repainting a small region only touches the tiles under it. */
+void
+ZImageView::drawScaledImage(QPainter *painter, const QRect &exposed)
+{
+  QBrush background(BACKGROUND_COLOR);
+  if (_mipmaps.isEmpty()) {
+    painter->fillRect(exposed, background);
+    return;
+  }
 
-  // We don't want to paint the background
-  // because this isn't double buffered and that would flicker.
-  // We could double buffer it, but that would cost ~3 MB of memory.
-  
-  QPainter p(this);
-  if (extraWidth > 0) {
-    p.fillRect(0, 0, extraWidth, sRect.height(), background);
-    p.fillRect(sRect.width() - extraWidth, 0,
-	       sRect.width(), sRect.height(), background);
+  // Think of the _view as being overlaid on the image. The _view has the
+  // same aspect ratio as the screen, so the part of the image under it is
+  // scaled to the screen dimensions. The _view may be larger than the image
+  // in one or both directions, in which case the background is painted
+  // around the image.
+  double scale = scaleFactor();
+  QPoint origin = imageOrigin(scale);
+  QRect scaledRect(origin, QSize(int(std::ceil(_imageRect.width() * scale)),
+                                 int(std::ceil(_imageRect.height() * scale))));
+
+  // Paint the background only where the image isn't.
+  QVector<QRect> rects = QRegion(exposed).subtracted(scaledRect).rects();
+  foreach (QRect r, rects) {
+    painter->fillRect(r, background);
   }
 
-  if (extraHeight > 0) {
-    p.fillRect(0, 0, sRect.width(), extraHeight, background);
-    p.fillRect(0, sRect.height() - extraHeight,
-	       sRect.width(), sRect.height(), background);
+  // Draw the tiles that overlap the exposed part of the scaled image.
+  QRect visible = exposed.intersected(scaledRect).translated(-origin);
+  if (!visible.isEmpty()) {
+    int left   = visible.left() / TILE_SIZE;
+    int right  = visible.right() / TILE_SIZE;
+    int top    = visible.top() / TILE_SIZE;
+    int bottom = visible.bottom() / TILE_SIZE;
+    painter->save();
+    painter->setClipRect(scaledRect.intersected(exposed));
+    for (int ty = top; ty <= bottom; ty++) {
+      for (int tx = left; tx <= right; tx++) {
+        painter->drawPixmap(origin.x() + tx * TILE_SIZE,
+                            origin.y() + ty * TILE_SIZE,
+                            tile(tx, ty, scale));
+      }
+    }
+    painter->restore();
   }
 
-  // Finally, paint the image copy.
-  p.drawImage(extraWidth, extraHeight, i);
+  // Let subclasses draw over the image in image coordinates. The exposed
+  // area is widened by a pixel, since antialiased lines bleed over.
+  painter->save();
+  painter->setClipRect(exposed);
+  painter->translate(origin);
+  painter->scale(scale, scale);
+  QRectF rect(QPointF(exposed.left() - origin.x() - 1,
+                      exposed.top() - origin.y() - 1) / scale,
+              QSizeF(exposed.width() + 2, exposed.height() + 2) / scale);
+  paintImage(painter, rect);
+  painter->restore();
+}
+
+/** Schedules a repaint of the part of the widget showing <b>rect</b>, in
+ * image coordinates. The area is widened by a pixel, since antialiased
+ * edges bleed over. */
+void
+ZImageView::updateImageRect(const QRectF &rect)
+{
+  double scale = scaleFactor();
+  QPoint origin = imageOrigin(scale);
+  QRectF r(rect.topLeft() * scale + origin, rect.size() * scale);
+  update(r.toAlignedRect().adjusted(-1, -1, 1, 1));
 }
 	
 /** Updates the displayed viewport. */
@@ -160,7 +239,7 @@ ZImageView::updateViewport(int screendx, int screendy)
    * centered if the image is too small in that direction. */
 
   QRect sRect = rect();
-  QRect iRect = _image.rect();
+  QRect iRect = _imageRect;
 
   float sw = float(sRect.width());
   float sh = float(sRect.height());
@@ -265,12 +344,14 @@ ZImageView::resetZoomPoint()
 }
 
 /** Handles repainting this widget by updating the viewport and drawing the
- * scaled image. */
+ * exposed part of the scaled image. */
 void
-ZImageView::paintEvent(QPaintEvent*)
+ZImageView::paintEvent(QPaintEvent *e)
 {
   updateViewport();
-  drawScaledImage();
+
+  QPainter painter(this);
+  drawScaledImage(&painter, e->rect());
 }
 
 /** Sets the current zoom percentage to the given value and scrolls the
@@ -288,7 +369,7 @@ void
 ZImageView::zoom(float pct)
 {
   _zoom = qBound(0.0f, pct, 1.0f);
-  repaint();
+  update();
 }
 
 /** Zooms into the image by 10% */
@@ -313,6 +394,7 @@ ZImageView::mousePressEvent(QMouseEvent *e)
   setCursor(CURSOR_MOUSE_PRESS);
   _mouseX = e->x();
   _mouseY = e->y();
+  _pressPos = e->pos();
 }
 
 /** Responds to the user releasing a mouse button. */
@@ -323,6 +405,28 @@ ZImageView::mouseReleaseEvent(QMouseEvent *e)
   setCursor(CURSOR_NORMAL);
   updateViewport();
   resetZoomPoint();
+
+  /* The release ending a double-click is not a click of its own */
+  if (_doubleClicked) {
+    _doubleClicked = false;
+    return;
+  }
+  /* Releasing the button about where it was pressed is a click, but it is
+   * only handled once no second click can turn it into a double-click */
+  if (e->button() == Qt::LeftButton
+        && (e->pos() - _pressPos).manhattanLength()
+             < QApplication::startDragDistance()) {
+    _clickPos = e->pos();
+    _clickTimer.start(QApplication::doubleClickInterval());
+  }
+}
+
+/** Handles the click saved in <b>_clickPos</b> now that it did not become
+ * part of a double-click. */
+void
+ZImageView::clickTimeout()
+{
+  imageClicked(_clickPos);
 }
 
 /** Responds to the user double-clicking a mouse button on the image. A left
@@ -332,6 +436,8 @@ void
 ZImageView::mouseDoubleClickEvent(QMouseEvent *e)
 {
   e->accept();
+  _clickTimer.stop();
+  _doubleClicked = true;
   
   QPoint center = rect().center(); 
   int dx = e->x() - center.x();
@@ -358,7 +464,7 @@ ZImageView::mouseMoveEvent(QMouseEvent *e)
 
   updateViewport(dx, dy);
   if (0.001 <= _zoom) {
-    repaint();
+    update();
   }
 }
 
@@ -19,6 +19,9 @@
 #include <QImage>
 #include <QPixmap>
 #include <QWidget>
+#include <QTimer>
+#include <QVector>
+#include <QHash>
 
 
 class ZImageView : public QWidget
@@ -30,6 +33,8 @@ public:
   ZImageView(QWidget *parent = 0);
   /** Sets the displayed image. */
   void setImage(QImage& pixmap);
+  /** Returns the current zoom level, between 0.0 and 1.0. */
+  float zoomLevel() const { return _zoom; }
   
 public slots:
   /** Resets the center zoom point back to the center of the viewport. */
@@ -45,10 +50,18 @@ public slots:
   void zoomOut();
 
 protected:
-  /** Virtual method to let subclasses paint on the image before it's scaled. */
-  virtual void paintImage(QPainter *painter) { Q_UNUSED(painter); }
-  /** Updates the viewport and repaints the displayed image. */
-  virtual void paintEvent(QPaintEvent*);
+  /** Virtual method to let subclasses paint over the image. The painter
+   * draws directly on the widget, but is transformed so that coordinates
+   * are those of the image. <b>rect</b> is the part of the image being
+   * repainted; anything outside it may be skipped. */
+  virtual void paintImage(QPainter *painter, const QRectF &rect)
+    { Q_UNUSED(painter); Q_UNUSED(rect); }
+  /** Virtual method called when the user clicks on the widget without
+   * dragging the image, once it is clear the click does not start a
+   * double-click. <b>pos</b> is in widget coordinates. */
+  virtual void imageClicked(const QPoint &pos) { Q_UNUSED(pos); }
+  /** Updates the viewport and repaints the exposed part of the image. */
+  virtual void paintEvent(QPaintEvent *e);
   /** Handles the user pressing a mouse button. */
   virtual void mousePressEvent(QMouseEvent* e);
   /** Handles the user releasing a mouse button. */
@@ -66,17 +79,49 @@ protected:
    *  directions than the image, and you must deal with the 
    *  non-overlapping regions. */
   void updateViewport(int screendx=0, int screendy=0);
-  /** Redraws the scaled image in the viewport. */
-  void drawScaledImage();
-  
+  /** Redraws the part of the scaled image in the viewport that lies within
+   * <b>exposed</b>, in widget coordinates. */
+  void drawScaledImage(QPainter *painter, const QRect &exposed);
+  /** Schedules a repaint of the part of the widget showing <b>rect</b>, in
+   * image coordinates. */
+  void updateImageRect(const QRectF &rect);
+  /** Returns the factor by which the image is scaled in the viewport. */
+  double scaleFactor() const;
+  /** Returns the point of the image shown at <b>pos</b>, in widget
+   * coordinates. */
+  QPointF mapToImage(const QPoint &pos) const;
+
+private slots:
+  /** Calls imageClicked() for a click that was not followed by a second
+   * one within the double-click interval. */
+  void clickTimeout();
+
 private:
+  /** Returns the position of the image's top-left corner in the widget. */
+  QPoint imageOrigin(double scale) const;
+  /** Returns tile (<b>tx</b>, <b>ty</b>) of the image scaled by
+   * <b>scale</b>, rendering it from the nearest mipmap if it isn't
+   * cached. */
+  QPixmap tile(int tx, int ty, double scale);
+
   float _zoom;     /**< The current zoom level. */
-  QImage _image;   /**< The displayed image. */
+  QRect _imageRect; /**< Size of the displayed image. */
+  /** The displayed image, followed by copies of it scaled down by a factor
+   * of two, four, and so on. */
+  QVector<QImage> _mipmaps;
+  /** Tiles of the image scaled by _tileScale, keyed by their column in the
+   * high 16 bits and their row in the low 16 bits. */
+  QHash<quint32,QPixmap> _tiles;
+  double _tileScale; /**< Scale factor of the tiles in _tiles. */
   float _padding;  /**< Amount of padding to use on the side of the image. */
   float _maxZoomFactor;  /**< Maximum amount to zoom into the image. */
 
   int  _mouseX;     /**< The x-coordinate of the current mouse position. */
   int  _mouseY;     /**< The y-coordinate of the current mouse position. */
+  QPoint _pressPos; /**< Where the mouse button was last pressed. */
+  QPoint _clickPos; /**< Where the pending click was made. */
+  QTimer _clickTimer; /**< Delays clicks until no double-click can follow. */
+  bool _doubleClicked; /**< True from a double-click until its release. */
   
   QRect _view;      /**< The displayed viewport. */
   float _desiredX;  /**< The X value we desire (???). */